@@ -17,6 +17,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <math.h>
 
 #include "AF_InputParmeterFile.h"
 #include "AF_debug.h"
@@ -36,6 +37,13 @@ AF_InputParmeterFile::AF_InputParmeterFile()
 
 	use_chunk = false;
 	geotiff_output = false;
+	use_single_precision = false;
+	nn_spatial_index = "GRID";
+	nn_query_order = "STORAGE";
+	nn_cross_track_radius = false;
+	nn_approx_error = "0";
+	idw_neighbors = "4";
+	idw_power = "2";
 
 	/*------------------------------
 	 * init multi-value variables
@@ -622,6 +630,212 @@ void AF_InputParmeterFile::ParseByLine()
 			continue;
 		}
 
+		/*--------------------------- 
+		 * Single precision (float) radiance processing
+		 */
+		found = line.find(SINGLE_PRECISION_STR.c_str());
+		if(found != std::string::npos)
+		{
+			line = line.substr(strlen(SINGLE_PRECISION_STR.c_str()));
+			while(line[0] == ' ' || line[0] == ':')
+				line = line.substr(1);
+			std::stringstream ss(line); // Insert the string into a stream
+			std::string token;
+			std::string single_precision;
+			while (ss >> token) {  // get exact string
+				single_precision = token;
+			}
+			if(single_precision !="false" && single_precision !="False" && single_precision !="FALSE" && single_precision !="No" && single_precision !="NO" 
+				&& single_precision != "no")
+				use_single_precision = true;
+			#if DEBUG_TOOL_PARSER
+			std::cout << "DBG_PARSER " << __FUNCTION__ << ":" << __LINE__ << "> " <<  SINGLE_PRECISION_STR << ": " << use_single_precision << std::endl;
+			#endif
+			continue;
+		}
+
+		/*--------------------------- 
+		 * Search radius of each MODIS cell from its scan angle
+		 */
+		found = line.find(NN_CROSS_TRACK_RADIUS_STR.c_str());
+		if(found != std::string::npos)
+		{
+			line = line.substr(strlen(NN_CROSS_TRACK_RADIUS_STR.c_str()));
+			while(line[0] == ' ' || line[0] == ':')
+				line = line.substr(1);
+			std::stringstream ss(line); // Insert the string into a stream
+			std::string token;
+			std::string cross_track_radius;
+			while (ss >> token) {  // get exact string
+				cross_track_radius = token;
+			}
+			if(cross_track_radius !="false" && cross_track_radius !="False" && cross_track_radius !="FALSE" && cross_track_radius !="No" && cross_track_radius !="NO" 
+				&& cross_track_radius != "no" && cross_track_radius != "OFF" && cross_track_radius != "Off" && cross_track_radius != "off")
+				nn_cross_track_radius = true;
+			#if DEBUG_TOOL_PARSER
+			std::cout << "DBG_PARSER " << __FUNCTION__ << ":" << __LINE__ << "> " <<  NN_CROSS_TRACK_RADIUS_STR << ": " << nn_cross_track_radius << std::endl;
+			#endif
+			continue;
+		}
+
+		/*--------------------------- 
+		 * Nearest neighbor mapping cache directory
+		 * parse single exact token without '\n', '\r' or space.
+		 */
+		found = line.find(NN_CACHE_DIR_STR.c_str());
+		if(found != std::string::npos)
+		{
+			line = line.substr(strlen(NN_CACHE_DIR_STR.c_str()));
+			while(line[0] == ' ' || line[0] == ':')
+				line = line.substr(1);
+			pos = line.find_first_of(' ', 0);
+			std::stringstream ss(line); // Insert the string into a stream
+			std::string token;
+			while (ss >> token) {  // get exact token
+				nn_cache_dir = token;
+			}
+			#if DEBUG_TOOL_PARSER
+			std::cout << "DBG_PARSER " << __FUNCTION__ << ":" << __LINE__ << "> " <<  NN_CACHE_DIR_STR << ": " << nn_cache_dir << std::endl;
+			#endif
+			continue;
+		}
+
+		/*--------------------------- 
+		 * Nearest neighbor spatial index
+		 */
+		found = line.find(NN_SPATIAL_INDEX_STR.c_str());
+		if(found != std::string::npos)
+		{
+			line = line.substr(strlen(NN_SPATIAL_INDEX_STR.c_str()));
+			while(line[0] == ' ' || line[0] == ':')
+				line = line.substr(1);
+			pos = line.find_first_of(' ', 0);
+			std::stringstream ss(line); // Insert the string into a stream
+			std::string token;
+			while (ss >> token) {  // get exact token
+				nn_spatial_index = token;
+			}
+			#if DEBUG_TOOL_PARSER
+			std::cout << "DBG_PARSER " << __FUNCTION__ << ":" << __LINE__ << "> " <<  NN_SPATIAL_INDEX_STR << ": " << nn_spatial_index << std::endl;
+			#endif
+			continue;
+		}
+
+		/*--------------------------- 
+		 * Nearest neighbor query order
+		 */
+		found = line.find(NN_QUERY_ORDER_STR.c_str());
+		if(found != std::string::npos)
+		{
+			line = line.substr(strlen(NN_QUERY_ORDER_STR.c_str()));
+			while(line[0] == ' ' || line[0] == ':')
+				line = line.substr(1);
+			pos = line.find_first_of(' ', 0);
+			std::stringstream ss(line); // Insert the string into a stream
+			std::string token;
+			while (ss >> token) {  // get exact token
+				nn_query_order = token;
+			}
+			#if DEBUG_TOOL_PARSER
+			std::cout << "DBG_PARSER " << __FUNCTION__ << ":" << __LINE__ << "> " <<  NN_QUERY_ORDER_STR << ": " << nn_query_order << std::endl;
+			#endif
+			continue;
+		}
+
+		/*--------------------------- 
+		 * Approximate nearest neighbor search
+		 */
+		found = line.find(NN_APPROX_ERROR_STR.c_str());
+		if(found != std::string::npos)
+		{
+			line = line.substr(strlen(NN_APPROX_ERROR_STR.c_str()));
+			while(line[0] == ' ' || line[0] == ':')
+				line = line.substr(1);
+			std::stringstream ss(line); // Insert the string into a stream
+			std::string token;
+			while (ss >> token) {  // get exact token
+				nn_approx_error = token;
+			}
+			#if DEBUG_TOOL_PARSER
+			std::cout << "DBG_PARSER " << __FUNCTION__ << ":" << __LINE__ << "> " <<  NN_APPROX_ERROR_STR << ": " << nn_approx_error << std::endl;
+			#endif
+			continue;
+		}
+		/*--------------------------- 
+		 * Inverse distance weighted interpolation
+		 */
+		found = line.find(IDW_NEIGHBORS_STR.c_str());
+		if(found != std::string::npos)
+		{
+			line = line.substr(strlen(IDW_NEIGHBORS_STR.c_str()));
+			while(line[0] == ' ' || line[0] == ':')
+				line = line.substr(1);
+			std::stringstream ss(line); // Insert the string into a stream
+			std::string token;
+			while (ss >> token) {  // get exact token
+				idw_neighbors = token;
+			}
+			#if DEBUG_TOOL_PARSER
+			std::cout << "DBG_PARSER " << __FUNCTION__ << ":" << __LINE__ << "> " <<  IDW_NEIGHBORS_STR << ": " << idw_neighbors << std::endl;
+			#endif
+			continue;
+		}
+		found = line.find(IDW_POWER_STR.c_str());
+		if(found != std::string::npos)
+		{
+			line = line.substr(strlen(IDW_POWER_STR.c_str()));
+			while(line[0] == ' ' || line[0] == ':')
+				line = line.substr(1);
+			std::stringstream ss(line); // Insert the string into a stream
+			std::string token;
+			while (ss >> token) {  // get exact token
+				idw_power = token;
+			}
+			#if DEBUG_TOOL_PARSER
+			std::cout << "DBG_PARSER " << __FUNCTION__ << ":" << __LINE__ << "> " <<  IDW_POWER_STR << ": " << idw_power << std::endl;
+			#endif
+			continue;
+		}
+		/*--------------------------- 
+		 * Footprint interpolation
+		 */
+		found = line.find(FOOTPRINT_RADIUS_STR.c_str());
+		if(found != std::string::npos)
+		{
+			line = line.substr(strlen(FOOTPRINT_RADIUS_STR.c_str()));
+			while(line[0] == ' ' || line[0] == ':')
+				line = line.substr(1);
+			std::stringstream ss(line); // Insert the string into a stream
+			std::string token;
+			while (ss >> token) {  // get exact token
+				footprint_radius = token;
+			}
+			#if DEBUG_TOOL_PARSER
+			std::cout << "DBG_PARSER " << __FUNCTION__ << ":" << __LINE__ << "> " <<  FOOTPRINT_RADIUS_STR << ": " << footprint_radius << std::endl;
+			#endif
+			continue;
+		}
+		/*--------------------------- 
+		 * SUMMARY_STATISTICS
+		 * parse multiple
+		 */
+		found = line.find(SUMMARY_STATISTICS_STR.c_str());
+		if(found != std::string::npos)
+		{
+			line = line.substr(strlen(SUMMARY_STATISTICS_STR.c_str()));
+			while(line[0] == ' ' || line[0] == ':')
+				line = line.substr(1);
+			std::stringstream ss(line); // Insert the string into a stream
+			std::string token;
+			while (ss >> token) {
+				summary_Statistics.push_back(token);
+			}
+			#if DEBUG_TOOL_PARSER
+			std::cout << "DBG_PARSER " << __FUNCTION__ << ":" << __LINE__ << "> Num of summary statistics:" << summary_Statistics.size() << std::endl;
+			#endif
+			continue;
+		}
+
 
 	} // end of while
 }
@@ -659,6 +873,26 @@ int AF_InputParmeterFile::CheckParsedValues()
 	if (IsResampleMethodValid() == false) 
 		return -1; // failed
 
+	// Check if the nearest neighbor spatial index is valid.
+	if (IsNNSpatialIndexValid() == false) 
+		return -1; // failed
+
+	// Check if the nearest neighbor query order is valid.
+	if (IsNNQueryOrderValid() == false) 
+		return -1; // failed
+
+	// Check approximate nearest neighbor search error.
+	if (CheckNNApproxError() == false) 
+		return -1; // failed
+
+	// Check inverse distance weighted interpolation parameters.
+	if (CheckIDWParameters() == false) 
+		return -1; // failed
+
+	// Check extra statistics of summary interpolation.
+	if (CheckSummaryStatistics() == false) 
+		return -1; // failed
+
     
 
 	/*=================================================
@@ -712,6 +946,11 @@ int AF_InputParmeterFile::CheckParsedValues()
 			return -1; // failed
 	}
 
+	// Check footprint interpolation radius.
+	// Note: after the instrument sections, as the default comes from the target resolution
+	if (CheckFootprintRadius() == false) 
+		return -1; // failed
+
 
 	return 0; // succeed
 }
@@ -766,16 +1005,21 @@ bool AF_InputParmeterFile::IsResampleMethodValid()
 	std::cout << "DBG_PARSER " << __FUNCTION__ << ":" << __LINE__ << "> ResampleMethod: " << resampleMethod <<   ".\n";
 	#endif
 
-	if(resampleMethod !="nnInterpolate" && resampleMethod != "summaryInterpolate") { 
-		std::cerr <<"resample method must be either <nnIterpolate> or <summaryInterpolate>.  \n";
+	if(resampleMethod !="nnInterpolate" && resampleMethod != "summaryInterpolate" && resampleMethod != "idwInterpolate" && resampleMethod != "footprintInterpolate" && resampleMethod != "psfInterpolate") { 
+		std::cerr <<"resample method must be one of <nnIterpolate>, <summaryInterpolate>, <idwInterpolate>, <footprintInterpolate> or <psfInterpolate>.  \n";
 		ret = false;
 	}
 
  	if(ret == false){
 		return ret;
 	}
-	else if(sourceInstrument == "ASTER" && resampleMethod== "nnInterpolate") {
-		std::cerr <<"For ASTER, resample method must be summaryInterpolate. \n";
+	else if(sourceInstrument == "ASTER" && (resampleMethod== "nnInterpolate" || resampleMethod == "idwInterpolate")) {
+		std::cerr <<"For ASTER, resample method must be summaryInterpolate, footprintInterpolate or psfInterpolate. \n";
+		ret = false;
+	}
+	// the point spread function is the one of MODIS scan lines
+	else if(resampleMethod == "psfInterpolate" && targetInstrument != MODIS_STR) {
+		std::cerr <<"psfInterpolate is only for MODIS as target. \n";
 		ret = false;
 	}
 	return ret;
@@ -783,6 +1027,148 @@ bool AF_InputParmeterFile::IsResampleMethodValid()
 
 }
 
+/*=================================================================
+ * Check if nearest neighbor spatial index is valid
+ */
+bool AF_InputParmeterFile::IsNNSpatialIndexValid()
+{
+	#if DEBUG_TOOL_PARSER
+	std::cout << "DBG_PARSER " << __FUNCTION__ << ":" << __LINE__ << "> NN spatial index: " << nn_spatial_index <<   ".\n";
+	#endif
+
+	if(!CompareStrCaseInsensitive(nn_spatial_index, "GRID") && !CompareStrCaseInsensitive(nn_spatial_index, "KDTREE") &&
+	   !CompareStrCaseInsensitive(nn_spatial_index, "GRID_SWATH") && !CompareStrCaseInsensitive(nn_spatial_index, "DUAL_GRID")) {
+		std::cerr << NN_SPATIAL_INDEX_STR << " must be one of <GRID>, <KDTREE>, <GRID_SWATH> or <DUAL_GRID>.  \n";
+		return false;
+	}
+	return true;
+}
+
+/*=================================================================
+ * Check if nearest neighbor query order is valid
+ */
+bool AF_InputParmeterFile::IsNNQueryOrderValid()
+{
+	#if DEBUG_TOOL_PARSER
+	std::cout << "DBG_PARSER " << __FUNCTION__ << ":" << __LINE__ << "> NN query order: " << nn_query_order <<   ".\n";
+	#endif
+
+	if(!CompareStrCaseInsensitive(nn_query_order, "STORAGE") && !CompareStrCaseInsensitive(nn_query_order, "MORTON") &&
+	   !CompareStrCaseInsensitive(nn_query_order, "HILBERT")) {
+		std::cerr << NN_QUERY_ORDER_STR << " must be one of <STORAGE>, <MORTON> or <HILBERT>.  \n";
+		return false;
+	}
+	return true;
+}
+
+/*=================================================================
+ * Check approximate nearest neighbor search error.
+ * Must be between 0 (exact search) and 1 (100%).
+ *
+ * Return:
+ *  - valid : true
+ *  - not valid : false
+ */
+bool AF_InputParmeterFile::CheckNNApproxError()
+{
+	#if DEBUG_TOOL_PARSER
+	std::cout << "DBG_PARSER " << __FUNCTION__ << ":" << __LINE__ << "> NN approximate error: " << nn_approx_error << ".\n";
+	#endif
+
+	double approxError = GetNNApproxError();
+	if(!(approxError >= 0 && approxError <= 1)) {
+		std::cerr << NN_APPROX_ERROR_STR << " must be a number between 0 and 1.  \n";
+		return false;
+	}
+	return true;
+}
+
+/*=================================================================
+ * Check inverse distance weighted interpolation parameters.
+ * Only checked when the resample method is idwInterpolate.
+ *
+ * Return:
+ *  - valid : true
+ *  - not valid : false
+ */
+bool AF_InputParmeterFile::CheckIDWParameters()
+{
+	#if DEBUG_TOOL_PARSER
+	std::cout << "DBG_PARSER " << __FUNCTION__ << ":" << __LINE__ << "> IDW neighbors: " << idw_neighbors << ", power: " << idw_power << ".\n";
+	#endif
+
+	if(resampleMethod != "idwInterpolate")
+		return true;
+
+	int neighbors = GetIDW_Neighbors();
+	if(neighbors < 1 || neighbors > 16) {
+		std::cerr << IDW_NEIGHBORS_STR << " must be an integer between 1 and 16.  \n";
+		return false;
+	}
+	double power = GetIDW_Power();
+	if(!(power > 0)) {
+		std::cerr << IDW_POWER_STR << " must be greater than 0.  \n";
+		return false;
+	}
+	return true;
+}
+
+/*=================================================================
+ * Check footprint interpolation radius.
+ * Only checked when the resample method is footprintInterpolate.
+ *
+ * Return:
+ *  - valid : true
+ *  - not valid : false
+ */
+bool AF_InputParmeterFile::CheckFootprintRadius()
+{
+	#if DEBUG_TOOL_PARSER
+	std::cout << "DBG_PARSER " << __FUNCTION__ << ":" << __LINE__ << "> Footprint radius: " << footprint_radius << ".\n";
+	#endif
+
+	if(resampleMethod != "footprintInterpolate")
+		return true;
+
+	if(!(GetFootprintRadius() > 0)) {
+		std::cerr << FOOTPRINT_RADIUS_STR << " must be a number greater than 0 (in meters).  \n";
+		return false;
+	}
+	return true;
+}
+
+/*=================================================================
+ * Check extra statistics of summary interpolation.
+ * Valid names are MIN, MAX, VALID_FRACTION and MEDIAN (case insensitive).
+ * Only supported when ASTER is source, as the statistics are written
+ * next to ASTER_SD and ASTER_Count.
+ *
+ * Return:
+ *  - valid : true
+ *  - not valid : false
+ */
+bool AF_InputParmeterFile::CheckSummaryStatistics()
+{
+	if(summary_Statistics.empty())
+		return true;
+
+	if(sourceInstrument != ASTER_STR) {
+		std::cerr << SUMMARY_STATISTICS_STR << " is only supported when ASTER is source instrument.  \n";
+		return false;
+	}
+
+	for (int i = 0; i < summary_Statistics.size(); i++) {
+		if(!CompareStrCaseInsensitive(summary_Statistics[i], "MIN") &&
+		   !CompareStrCaseInsensitive(summary_Statistics[i], "MAX") &&
+		   !CompareStrCaseInsensitive(summary_Statistics[i], "VALID_FRACTION") &&
+		   !CompareStrCaseInsensitive(summary_Statistics[i], "MEDIAN")) {
+			std::cerr << SUMMARY_STATISTICS_STR << " '" << summary_Statistics[i] << "' is not valid. Must be any of < MIN MAX VALID_FRACTION MEDIAN >.  \n";
+			return false;
+		}
+	}
+	return true;
+}
+
 /*=================================================================
  * Check if source instrument is same as target instrument
  *
@@ -1380,6 +1766,63 @@ double AF_InputParmeterFile::GetMaxRadiusForNNeighborFunc(std::string instrument
 }
 
 
+/*=================================================================
+ * Along-scan size of a MODIS pixel relative to nadir at a scan angle
+ * (in radians), from the view zenith angle on a spherical earth.
+ * It is about 4.8 at the swath edges (55 degrees).
+ */
+static double ModisScanPixelGrowth(double scanAngle)
+{
+	const double earthR = 6371.0;    // km
+	const double orbitH = 705.0;     // km
+	double sinZenith = (earthR + orbitH) / earthR * sin(scanAngle);
+	double cosZenith = sqrt(1 - sinZenith * sinZenith);
+	return earthR / orbitH * ((earthR + orbitH) * cos(scanAngle) / (earthR * cosZenith) - 1);
+}
+
+/*=================================================================
+ * Get search radius of each cross-track position which can be passed
+ * to setNNIndexCellRadius().
+ * GetMaxRadiusForNNeighborFunc() of MODIS is sized for the pixels at
+ * the swath edges, which are about 5 times larger along the scan than
+ * at nadir. Each cross-track position gets it scaled by its pixel size
+ * relative to the edges, from its scan angle.
+ *
+ * Parameter:
+ *  - instrument : instrumane name string.
+ *
+ * Return:
+ *  - radius (in meters) of each cross-track position of a scan line
+ *    (1354 at 1KM, 2708 at 500m, 5416 at 250m)
+ *  - empty if the instrument has one radius for all cells, or
+ *    NN_CROSS_TRACK_RADIUS is not set
+ */
+std::vector<double> AF_InputParmeterFile::GetCrossTrackRadiusForNNeighborFunc(std::string instrument)
+{
+	std::vector<double> crossTrackRadius;
+	if(!nn_cross_track_radius || instrument != MODIS_STR)
+		return crossTrackRadius;
+
+	double maxRadius = GetMaxRadiusForNNeighborFunc(instrument);
+	float resolution = GetInstrumentResolutionValue(instrument);
+	if(maxRadius <= 0 || resolution <= 0)
+		return crossTrackRadius;
+
+	const double maxScanAngle = 55.0 * M_PI / 180;
+	int crossTrackWidth = (int)(1354 * 1000 / resolution + 0.5);
+	double edgeGrowth = ModisScanPixelGrowth(maxScanAngle);
+	crossTrackRadius.resize(crossTrackWidth);
+	for(int i = 0; i < crossTrackWidth; i++) {
+		double scanAngle = ((i + 0.5) * 2 / crossTrackWidth - 1) * maxScanAngle;
+		crossTrackRadius[i] = maxRadius * ModisScanPixelGrowth(scanAngle) / edgeGrowth;
+	}
+	#if DEBUG_TOOL_PARSER
+	std::cout << "DBG_PARSER " << __FUNCTION__ << ":" << __LINE__ << "> crossTrackWidth: " << crossTrackWidth << ", nadir radius: " << crossTrackRadius[crossTrackWidth / 2] << ", edge radius: " << crossTrackRadius[0] <<  std::endl;
+	#endif
+	return crossTrackRadius;
+}
+
+
 /* #########################################################################
  *  Functions to get input values from the input parameter file
  */
@@ -1523,6 +1966,58 @@ double AF_InputParmeterFile::GetUSER_Resolution()
 }
 
 
+int AF_InputParmeterFile::GetIDW_Neighbors()
+{
+	// convert string to int
+	int retValue = 0;
+	std::stringstream ss(idw_neighbors);
+	ss >> retValue;
+	return retValue;
+}
+
+double AF_InputParmeterFile::GetIDW_Power()
+{
+	// convert string to double
+	double retValue = 0;
+	std::stringstream ss(idw_power);
+	ss >> retValue;
+	return retValue;
+}
+
+double AF_InputParmeterFile::GetFootprintRadius()
+{
+	// not given: half the diagonal of a target cell, so the footprint covers the whole cell
+	if (footprint_radius.empty())
+		return GetInstrumentResolutionValue(targetInstrument) * sqrt(0.5);
+	// convert string to double. Not a number gives -1, which is rejected by CheckFootprintRadius()
+	double retValue = 0;
+	std::stringstream ss(footprint_radius);
+	if (!(ss >> retValue))
+		return -1;
+	return retValue;
+}
+
+double AF_InputParmeterFile::GetNNApproxError()
+{
+	// convert string to double. Not a number gives -1, which is rejected by CheckNNApproxError()
+	double retValue = 0;
+	std::stringstream ss(nn_approx_error);
+	if (!(ss >> retValue))
+		return -1;
+	return retValue;
+}
+
+
+bool AF_InputParmeterFile::IsSummaryStatisticRequested(const std::string & stat)
+{
+	for (int i = 0; i < summary_Statistics.size(); i++) {
+		if(CompareStrCaseInsensitive(summary_Statistics[i], stat))
+			return true;
+	}
+	return false;
+}
+
+
 float AF_InputParmeterFile::GetInstrumentResolutionValue(const std::string & instrument) {
 
 	float instr_resolution = -1;
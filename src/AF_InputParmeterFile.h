@@ -56,6 +56,58 @@ const std::string H5_CHUNK_STR = "USE_HDF5_CHUNK_COMPRESSION";
  */
 const std::string GEO_TIFF_OUTPUT_STR = "GEOTIFF_OUTPUT";
 
+/*===================================================================
+ * Read, resample and write radiance data in float instead of double
+ */
+const std::string SINGLE_PRECISION_STR = "USE_SINGLE_PRECISION";
+
+/*===================================================================
+ * Directory to keep nearest neighbor mapping cache files
+ */
+const std::string NN_CACHE_DIR_STR = "NN_CACHE_DIR";
+
+/*===================================================================
+ * Spatial index used for nearest neighbor search: GRID (default), KDTREE, GRID_SWATH or DUAL_GRID
+ */
+const std::string NN_SPATIAL_INDEX_STR = "NN_SPATIAL_INDEX";
+
+/*===================================================================
+ * Order target cells are queried in for nearest neighbor search: STORAGE (default), MORTON or HILBERT
+ */
+const std::string NN_QUERY_ORDER_STR = "NN_QUERY_ORDER";
+
+/*===================================================================
+ * Search radius of each MODIS cell from its scan angle instead of the radius of the swath edges
+ * when MODIS is the indexed side of nearest neighbor search. Default false
+ */
+const std::string NN_CROSS_TRACK_RADIUS_STR = "NN_CROSS_TRACK_RADIUS";
+
+/*===================================================================
+ * Approximate nearest neighbor search: relative distance error allowed (ex: 0.1 for 10%).
+ * Default 0 (exact)
+ */
+const std::string NN_APPROX_ERROR_STR = "NN_APPROX_ERROR";
+
+/*===================================================================
+ * Inverse distance weighted interpolation (RESAMPLE_METHOD: idwInterpolate):
+ * number of nearest source cells (default 4) and power of distance (default 2)
+ */
+const std::string IDW_NEIGHBORS_STR = "IDW_NEIGHBORS";
+const std::string IDW_POWER_STR = "IDW_POWER";
+
+/*===================================================================
+ * Footprint interpolation (RESAMPLE_METHOD: footprintInterpolate): radius (in meters) of the
+ * footprint of a target cell. All source cells within it are averaged, so a source cell can count
+ * for several target cells. Default is half the diagonal of a target cell
+ */
+const std::string FOOTPRINT_RADIUS_STR = "FOOTPRINT_RADIUS";
+
+/*===================================================================
+ * Extra statistics of summaryInterpolate (ASTER as source), any of < MIN MAX VALID_FRACTION MEDIAN >.
+ * Mean, SD and count are always written
+ */
+const std::string SUMMARY_STATISTICS_STR = "SUMMARY_STATISTICS";
+
 /*-------------------------
  * New types
  */
@@ -108,6 +160,17 @@ class AF_InputParmeterFile
 
 	bool GetUseH5Chunk(){return use_chunk;}
 	bool GetGeoTiffOutput(){return geotiff_output;}
+	bool GetUseSinglePrecision(){return use_single_precision;}
+	std::string GetNNCacheDir(){return nn_cache_dir;}
+	std::string GetNNSpatialIndex(){return nn_spatial_index;}
+	std::string GetNNQueryOrder(){return nn_query_order;}
+	bool GetNNCrossTrackRadius(){return nn_cross_track_radius;}
+	double GetNNApproxError();
+	int GetIDW_Neighbors();
+	double GetIDW_Power();
+	double GetFootprintRadius();
+	std::vector<std::string> GetSummaryStatistics(){return summary_Statistics;}
+	bool IsSummaryStatisticRequested(const std::string & stat);
 	float GetInstrumentResolutionValue(const std::string & instrument);
 	/*===========================================
 	 * Handle multi-value variables
@@ -127,6 +190,7 @@ class AF_InputParmeterFile
 	 * Functions to get input based parameter of internal functions
 	 */
 	double GetMaxRadiusForNNeighborFunc(std::string instrument);
+	std::vector<double> GetCrossTrackRadiusForNNeighborFunc(std::string instrument);
 
 
 	protected:
@@ -138,6 +202,12 @@ class AF_InputParmeterFile
 	bool IsSourceTargetInstrumentSame();
 	bool IsSourceTargetInstrumentValid();
 	bool IsResampleMethodValid();
+	bool IsNNSpatialIndexValid();
+	bool IsNNQueryOrderValid();
+	bool CheckNNApproxError();
+	bool CheckIDWParameters();
+	bool CheckFootprintRadius();
+	bool CheckSummaryStatistics();
 
 	// MODIS
 	bool CheckRevise_MODISresolution(std::string &str);
@@ -202,6 +272,16 @@ class AF_InputParmeterFile
 
 	bool use_chunk;
 	bool geotiff_output;
+	bool use_single_precision;
+	std::string nn_cache_dir;
+	std::string nn_spatial_index;
+	std::string nn_query_order;
+	bool nn_cross_track_radius;
+	std::string nn_approx_error;
+	std::string idw_neighbors;
+	std::string idw_power;
+	std::string footprint_radius;
+	std::vector<std::string> summary_Statistics;
 };
 
 #endif // _AF_INPUT_PARAMETER_FILE_H_
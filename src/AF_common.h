@@ -42,5 +42,9 @@ const std::string MISR_RADIANCE_DSET = "MISR_Radiance";
 const std::string ASTER_RADIANCE_DSET = "ASTER_Radiance";
 const std::string ASTER_SD_DSET = "ASTER_SD";  // Standard Deviation
 const std::string ASTER_COUNT_DSET = "ASTER_Count"; // Pixel Count
+const std::string ASTER_MIN_DSET = "ASTER_Min"; // SUMMARY_STATISTICS: MIN
+const std::string ASTER_MAX_DSET = "ASTER_Max"; // SUMMARY_STATISTICS: MAX
+const std::string ASTER_VALID_FRACTION_DSET = "ASTER_ValidFraction"; // SUMMARY_STATISTICS: VALID_FRACTION
+const std::string ASTER_MEDIAN_DSET = "ASTER_Median"; // SUMMARY_STATISTICS: MEDIAN (approximate)
 
 #endif // _AF_COMMON_H_ 
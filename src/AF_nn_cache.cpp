@@ -0,0 +1,439 @@
+/*********************************************************************
+ * DESCRIPTION:
+ *   Persistent on-disk cache of the nearest neighbor mapping
+ *   (targetNNsrcID and optionally distances) computed by
+ *   nearestNeighborBlockIndex(), or of the resampling operator
+ *   (footprintInterpolate and psfInterpolate).
+ *
+ * DEVELOPERS:
+ *  - agent (agent@local)
+ */
+
+#include "AF_nn_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sstream>
+
+#include "AF_common.h"
+#include "reproject.h"
+
+/*=====================================
+ * Cache file layout:
+ *  AF_NNCacheHeader_t
+ *  key string (keyLen bytes, padded to 8 bytes)
+ *  int nnIDs[nnCellNum] (padded to 8 bytes)
+ *  double nnDis[nnCellNum] (only if hasDistance)
+ */
+static const char NN_CACHE_MAGIC[8] = {'A','F','N','N','C','A','C','H'};
+static const uint32_t NN_CACHE_VERSION = 1;
+
+/*=====================================
+ * Operator cache file layout:
+ *  AF_NNCacheHeader_t (nnCellNum and hasDistance unused)
+ *  key string (keyLen bytes, padded to 8 bytes)
+ *  operator written by writeSummaryIndex()
+ */
+static const char OP_CACHE_MAGIC[8] = {'A','F','O','P','C','A','C','H'};
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t keyLen;
+	int64_t nnCellNum;
+	int64_t srcCellNum;
+	int64_t trgCellNum;
+	uint32_t hasDistance;
+	uint32_t reserved;
+} AF_NNCacheHeader_t;
+
+static size_t Align8(size_t size)
+{
+	return (size + 7) & ~((size_t)7);
+}
+
+
+/*=====================================
+ * Instrument resolution part of the cache key
+ */
+static std::string GetInstrumentKey(AF_InputParmeterFile &inputArgs, const std::string &instrument)
+{
+	std::ostringstream oss;
+	oss.precision(17);
+	oss << instrument << ":";
+	if (instrument == MODIS_STR)
+		oss << inputArgs.GetMODIS_Resolution();
+	else if (instrument == MISR_STR)
+		oss << inputArgs.GetMISR_Resolution();
+	else if (instrument == ASTER_STR)
+		oss << inputArgs.GetASTER_Resolution();
+	else if (instrument == USERGRID_STR)
+		oss << inputArgs.GetUSER_EPSG() << "," << inputArgs.GetUSER_xMin() << "," << inputArgs.GetUSER_xMax() << ","
+		    << inputArgs.GetUSER_yMin() << "," << inputArgs.GetUSER_yMax() << "," << inputArgs.GetUSER_Resolution();
+	return oss.str();
+}
+
+
+/*=====================================
+ * Build a cache key string which identifies the nearest neighbor mapping
+ *
+ * RETURN:
+ *  key string. Empty string if the input BF file cannot be accessed.
+ */
+static std::string GetNNCacheKey(AF_InputParmeterFile &inputArgs)
+{
+	std::string inputPath = inputArgs.GetInputBFdataPath();
+	struct stat st;
+	if (stat(inputPath.c_str(), &st) != 0) {
+		std::cerr << __FUNCTION__ << "> Error: cannot access input file - " << inputPath << "\n";
+		return "";
+	}
+	char realPath[PATH_MAX];
+	if (realpath(inputPath.c_str(), realPath) != NULL)
+		inputPath = realPath;
+
+	std::string srcInstrument = inputArgs.GetSourceInstrument();
+	std::string trgInstrument = inputArgs.GetTargetInstrument();
+	std::string resampleMethod = inputArgs.GetResampleMethod();
+	// same as main(): max radius comes from the instrument which is indexed (the target one for psfInterpolate)
+	std::string indexedInstrument = srcInstrument;
+	if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "summaryInterpolate") || inputArgs.CompareStrCaseInsensitive(resampleMethod, "psfInterpolate"))
+		indexedInstrument = trgInstrument;
+	double maxRadius = inputArgs.GetMaxRadiusForNNeighborFunc(indexedInstrument);
+	bool keepsSourceLists = inputArgs.CompareStrCaseInsensitive(resampleMethod, "footprintInterpolate") ||
+	                        inputArgs.CompareStrCaseInsensitive(resampleMethod, "psfInterpolate");
+
+	std::ostringstream oss;
+	oss.precision(17);
+	oss << "input=" << inputPath << ";size=" << (long long)st.st_size << ";mtime=" << (long long)st.st_mtime
+	    << ";src=" << GetInstrumentKey(inputArgs, srcInstrument)
+	    << ";trg=" << GetInstrumentKey(inputArgs, trgInstrument)
+	    << ";misrShift=" << inputArgs.GetMISR_Shift()
+	    << ";method=" << resampleMethod
+	    << ";index=" << inputArgs.GetNNSpatialIndex()
+	    << ";maxR=" << maxRadius;
+	// idwInterpolate keeps k neighbors and their distances; weights are recomputed from the distances
+	if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "idwInterpolate"))
+		oss << ";idwNeighbors=" << inputArgs.GetIDW_Neighbors();
+	// footprintInterpolate keeps all source cells within the footprint radius
+	if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "footprintInterpolate"))
+		oss << ";footprintR=" << inputArgs.GetFootprintRadius();
+	// search radius of each cross-track position (MODIS) may leave cells away from nadir without a neighbor
+	if (!keepsSourceLists && !inputArgs.GetCrossTrackRadiusForNNeighborFunc(indexedInstrument).empty())
+		oss << ";radius=crossTrack";
+	// approximate search may map to other (slightly farther) cells
+	if (inputArgs.GetNNApproxError() > 0)
+		oss << ";approxError=" << inputArgs.GetNNApproxError();
+	return oss.str();
+}
+
+
+/*=====================================
+ * Check the mapping of a cache file against the current resample method:
+ * nnCellNum is the count the method queries and every id is -1 (no
+ * neighbor) or a cell of the indexed side, so a corrupted file cannot
+ * make the resample functions read out of bounds.
+ *
+ * RETURN:
+ *  true if the mapping is usable
+ */
+static bool CheckNNCacheIDs(AF_InputParmeterFile &inputArgs, const AF_NNCacheHeader_t * header, const int * nnIDs)
+{
+	std::string resampleMethod = inputArgs.GetResampleMethod();
+	long long expectCellNum;
+	long long indexedCellNum;
+	if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "nnInterpolate")) {
+		expectCellNum = header->trgCellNum;
+		indexedCellNum = header->srcCellNum;
+	}
+	else if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "idwInterpolate")) {
+		expectCellNum = header->trgCellNum * inputArgs.GetIDW_Neighbors();
+		indexedCellNum = header->srcCellNum;
+	}
+	else if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "summaryInterpolate")) {
+		// source and target are swapped: the source cells are queried against the target ones
+		expectCellNum = header->srcCellNum;
+		indexedCellNum = header->trgCellNum;
+	}
+	else {
+		return false;
+	}
+	if (header->nnCellNum != expectCellNum || header->srcCellNum < 0 || indexedCellNum > INT_MAX)
+		return false;
+
+	int maxID = (int) indexedCellNum;
+	for (long long i = 0; i < header->nnCellNum; i++) {
+		if (nnIDs[i] < -1 || nnIDs[i] >= maxID)
+			return false;
+	}
+	return true;
+}
+
+
+/*=====================================
+ * Get full path of the cache file for the current input parameters.
+ */
+std::string af_GetNNCacheFilePath(AF_InputParmeterFile &inputArgs)
+{
+	std::string cacheDir = inputArgs.GetNNCacheDir();
+	if (cacheDir.empty())
+		return "";
+	std::string key = GetNNCacheKey(inputArgs);
+	if (key.empty())
+		return "";
+
+	// FNV-1a hash of the key for the file name. The full key is stored in
+	// the file and compared on load, so a collision only means a cache miss.
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < key.size(); i++) {
+		hash ^= (unsigned char)key[i];
+		hash *= 1099511628211ULL;
+	}
+	char fileName[64];
+	snprintf(fileName, sizeof(fileName), "af_nn_%016llx.cache", (unsigned long long)hash);
+
+	if (cacheDir[cacheDir.size() - 1] != '/')
+		cacheDir += "/";
+	return cacheDir + fileName;
+}
+
+
+/*=====================================
+ * Memory-map a cache file for the current input parameters.
+ */
+int af_LoadNNCache(AF_InputParmeterFile &inputArgs, AF_NNCache_t &nnCache /*OUT*/)
+{
+	memset(&nnCache, 0, sizeof(nnCache));
+
+	std::string cachePath = af_GetNNCacheFilePath(inputArgs);
+	if (cachePath.empty())
+		return FAILED;
+	std::string key = GetNNCacheKey(inputArgs);
+
+	int fd = open(cachePath.c_str(), O_RDONLY);
+	if (fd < 0)
+		return FAILED;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(AF_NNCacheHeader_t)) {
+		close(fd);
+		return FAILED;
+	}
+	size_t mapSize = (size_t)st.st_size;
+	void * mapAddr = mmap(NULL, mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapAddr == MAP_FAILED)
+		return FAILED;
+
+	const AF_NNCacheHeader_t * header = (const AF_NNCacheHeader_t *) mapAddr;
+	size_t idsOffset = Align8(sizeof(AF_NNCacheHeader_t) + header->keyLen);
+	size_t disOffset = Align8(idsOffset + sizeof(int) * header->nnCellNum);
+	size_t expectSize = header->hasDistance ? disOffset + sizeof(double) * header->nnCellNum : disOffset;
+	if (memcmp(header->magic, NN_CACHE_MAGIC, sizeof(NN_CACHE_MAGIC)) != 0 || header->version != NN_CACHE_VERSION
+	    || header->nnCellNum < 0 || header->trgCellNum < 0 || header->trgCellNum > INT_MAX || expectSize != mapSize
+	    || header->keyLen != key.size() || memcmp((const char *)mapAddr + sizeof(AF_NNCacheHeader_t), key.c_str(), key.size()) != 0) {
+		std::cerr << __FUNCTION__ << "> Warning: ignoring stale or invalid cache file - " << cachePath << "\n";
+		munmap(mapAddr, mapSize);
+		return FAILED;
+	}
+
+	// the whole id array is read by the resample functions
+	madvise(mapAddr, mapSize, MADV_WILLNEED);
+
+	if (!CheckNNCacheIDs(inputArgs, header, (const int *)((char *)mapAddr + idsOffset))) {
+		std::cerr << __FUNCTION__ << "> Warning: ignoring stale or invalid cache file - " << cachePath << "\n";
+		munmap(mapAddr, mapSize);
+		return FAILED;
+	}
+
+	nnCache.mapAddr = mapAddr;
+	nnCache.mapSize = mapSize;
+	nnCache.nnIDs = (int *)((char *)mapAddr + idsOffset);
+	nnCache.nnDis = header->hasDistance ? (double *)((char *)mapAddr + disOffset) : NULL;
+	nnCache.nnCellNum = header->nnCellNum;
+	nnCache.srcCellNum = header->srcCellNum;
+	nnCache.trgCellNum = (int) header->trgCellNum;
+
+	#if DEBUG_TOOL
+	std::cout << "DBG_TOOL " << __FUNCTION__ << "> Loaded NN cache: " << cachePath << ", nnCellNum: " << nnCache.nnCellNum << "\n";
+	#endif
+	return SUCCEED;
+}
+
+
+/*=====================================
+ * Write the nearest neighbor mapping to a cache file
+ */
+int af_SaveNNCache(AF_InputParmeterFile &inputArgs, int *nnIDs, double *nnDis, long long nnCellNum, long long srcCellNum, int trgCellNum)
+{
+	std::string cachePath = af_GetNNCacheFilePath(inputArgs);
+	if (cachePath.empty())
+		return FAILED;
+	std::string key = GetNNCacheKey(inputArgs);
+
+	std::string cacheDir = inputArgs.GetNNCacheDir();
+	if (mkdir(cacheDir.c_str(), 0755) != 0 && errno != EEXIST) {
+		std::cerr << __FUNCTION__ << "> Error: cannot create cache directory - " << cacheDir << "\n";
+		return FAILED;
+	}
+
+	AF_NNCacheHeader_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, NN_CACHE_MAGIC, sizeof(NN_CACHE_MAGIC));
+	header.version = NN_CACHE_VERSION;
+	header.keyLen = (uint32_t) key.size();
+	header.nnCellNum = nnCellNum;
+	header.srcCellNum = srcCellNum;
+	header.trgCellNum = trgCellNum;
+	header.hasDistance = (nnDis != NULL) ? 1 : 0;
+
+	char pad[8] = {0};
+	size_t keyEnd = sizeof(header) + key.size();
+	size_t idsEnd = Align8(keyEnd) + sizeof(int) * (size_t)nnCellNum;
+
+	std::ostringstream tmpName;
+	tmpName << cachePath << ".tmp." << getpid();
+	std::string tmpPath = tmpName.str();
+	FILE * fp = fopen(tmpPath.c_str(), "wb");
+	if (fp == NULL) {
+		std::cerr << __FUNCTION__ << "> Error: cannot create cache file - " << tmpPath << "\n";
+		return FAILED;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+	ok = ok && fwrite(key.c_str(), 1, key.size(), fp) == key.size();
+	ok = ok && fwrite(pad, 1, Align8(keyEnd) - keyEnd, fp) == Align8(keyEnd) - keyEnd;
+	ok = ok && fwrite(nnIDs, sizeof(int), nnCellNum, fp) == (size_t)nnCellNum;
+	ok = ok && fwrite(pad, 1, Align8(idsEnd) - idsEnd, fp) == Align8(idsEnd) - idsEnd;
+	if (nnDis != NULL)
+		ok = ok && fwrite(nnDis, sizeof(double), nnCellNum, fp) == (size_t)nnCellNum;
+	if (fclose(fp) != 0)
+		ok = false;
+
+	if (!ok || rename(tmpPath.c_str(), cachePath.c_str()) != 0) {
+		std::cerr << __FUNCTION__ << "> Error: failed writing cache file - " << cachePath << "\n";
+		unlink(tmpPath.c_str());
+		return FAILED;
+	}
+
+	#if DEBUG_TOOL
+	std::cout << "DBG_TOOL " << __FUNCTION__ << "> Saved NN cache: " << cachePath << "\n";
+	#endif
+	return SUCCEED;
+}
+
+
+/*=====================================
+ * Unmap a cache loaded by af_LoadNNCache().
+ */
+void af_ReleaseNNCache(AF_NNCache_t &nnCache)
+{
+	if (nnCache.mapAddr)
+		munmap(nnCache.mapAddr, nnCache.mapSize);
+	memset(&nnCache, 0, sizeof(nnCache));
+}
+
+
+/*=====================================
+ * Read a resampling operator from a cache file for the current input
+ * parameters.
+ */
+int af_LoadOperatorCache(AF_InputParmeterFile &inputArgs, struct SummaryIndex ** op /*OUT*/, long long &srcCellNum /*OUT*/, int &trgCellNum /*OUT*/)
+{
+	*op = NULL;
+
+	std::string cachePath = af_GetNNCacheFilePath(inputArgs);
+	if (cachePath.empty())
+		return FAILED;
+	std::string key = GetNNCacheKey(inputArgs);
+
+	FILE * fp = fopen(cachePath.c_str(), "rb");
+	if (fp == NULL)
+		return FAILED;
+	AF_NNCacheHeader_t header;
+	std::string fileKey(key.size(), '\0');
+	bool ok = fread(&header, sizeof(header), 1, fp) == 1
+	          && memcmp(header.magic, OP_CACHE_MAGIC, sizeof(OP_CACHE_MAGIC)) == 0 && header.version == NN_CACHE_VERSION
+	          && header.keyLen == key.size() && fread(&fileKey[0], 1, key.size(), fp) == key.size() && fileKey == key
+	          && fseek(fp, Align8(sizeof(header) + key.size()), SEEK_SET) == 0;
+	if (ok) {
+		*op = readSummaryIndex(fp);
+		ok = (*op != NULL) && header.trgCellNum >= 0 && header.trgCellNum <= INT_MAX;
+	}
+	fclose(fp);
+	if (!ok) {
+		std::cerr << __FUNCTION__ << "> Warning: ignoring stale or invalid cache file - " << cachePath << "\n";
+		freeSummaryIndex(*op);
+		*op = NULL;
+		return FAILED;
+	}
+	srcCellNum = header.srcCellNum;
+	trgCellNum = (int) header.trgCellNum;
+
+	#if DEBUG_TOOL
+	std::cout << "DBG_TOOL " << __FUNCTION__ << "> Loaded operator cache: " << cachePath << "\n";
+	#endif
+	return SUCCEED;
+}
+
+
+/*=====================================
+ * Write a resampling operator to a cache file
+ */
+int af_SaveOperatorCache(AF_InputParmeterFile &inputArgs, const struct SummaryIndex * op, long long srcCellNum, int trgCellNum)
+{
+	std::string cachePath = af_GetNNCacheFilePath(inputArgs);
+	if (cachePath.empty())
+		return FAILED;
+	std::string key = GetNNCacheKey(inputArgs);
+
+	std::string cacheDir = inputArgs.GetNNCacheDir();
+	if (mkdir(cacheDir.c_str(), 0755) != 0 && errno != EEXIST) {
+		std::cerr << __FUNCTION__ << "> Error: cannot create cache directory - " << cacheDir << "\n";
+		return FAILED;
+	}
+
+	AF_NNCacheHeader_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, OP_CACHE_MAGIC, sizeof(OP_CACHE_MAGIC));
+	header.version = NN_CACHE_VERSION;
+	header.keyLen = (uint32_t) key.size();
+	header.srcCellNum = srcCellNum;
+	header.trgCellNum = trgCellNum;
+
+	char pad[8] = {0};
+	size_t keyEnd = sizeof(header) + key.size();
+
+	std::ostringstream tmpName;
+	tmpName << cachePath << ".tmp." << getpid();
+	std::string tmpPath = tmpName.str();
+	FILE * fp = fopen(tmpPath.c_str(), "wb");
+	if (fp == NULL) {
+		std::cerr << __FUNCTION__ << "> Error: cannot create cache file - " << tmpPath << "\n";
+		return FAILED;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+	ok = ok && fwrite(key.c_str(), 1, key.size(), fp) == key.size();
+	ok = ok && fwrite(pad, 1, Align8(keyEnd) - keyEnd, fp) == Align8(keyEnd) - keyEnd;
+	ok = ok && writeSummaryIndex(op, fp) == 0;
+	if (fclose(fp) != 0)
+		ok = false;
+
+	if (!ok || rename(tmpPath.c_str(), cachePath.c_str()) != 0) {
+		std::cerr << __FUNCTION__ << "> Error: failed writing cache file - " << cachePath << "\n";
+		unlink(tmpPath.c_str());
+		return FAILED;
+	}
+
+	#if DEBUG_TOOL
+	std::cout << "DBG_TOOL " << __FUNCTION__ << "> Saved operator cache: " << cachePath << "\n";
+	#endif
+	return SUCCEED;
+}
@@ -0,0 +1,118 @@
+#ifndef _AF_NN_CACHE_H_
+#define _AF_NN_CACHE_H_
+/*********************************************************************
+ * DESCRIPTION:
+ *   Persistent on-disk cache of the nearest neighbor mapping
+ *   (targetNNsrcID and optionally distances) computed by
+ *   nearestNeighborBlockIndex().
+ *
+ *   A cache file is identified by the input BF file (path, size and
+ *   modification time), source/target instruments and resolutions,
+ *   MISR shift, resample method (and IDW_NEIGHBORS for idwInterpolate)
+ *   and the max radius. A re-run with the same settings but different
+ *   bands or cameras memory-maps the cached mapping instead of reading
+ *   source geolocation and rebuilding the index.
+ *
+ *   footprintInterpolate and psfInterpolate keep lists of (weighted)
+ *   source cells instead of a mapping. Their resampling operator is
+ *   cached as a whole, so it can be applied to later runs with the same
+ *   geometry.
+ *
+ * DEVELOPERS:
+ *  - agent (agent@local)
+ */
+
+#include <string>
+
+#include "AF_InputParmeterFile.h"
+
+struct SummaryIndex;
+
+/*=====================================
+ * Loaded (memory-mapped) cache content.
+ * nnIDs and nnDis point into the mapped region, so release it with
+ * af_ReleaseNNCache() instead of free() or delete[].
+ */
+typedef struct {
+	void * mapAddr;
+	size_t mapSize;
+	int * nnIDs;	 // nnCellNum items
+	double * nnDis;  // nnCellNum items or NULL if not stored
+	long long nnCellNum;
+	long long srcCellNum;
+	int trgCellNum;
+} AF_NNCache_t;
+
+/*=====================================
+ * Get full path of the cache file for the current input parameters.
+ *
+ * RETURN:
+ *  cache file path. Empty string if NN_CACHE_DIR is not specified or
+ *  the input BF file cannot be accessed.
+ */
+std::string af_GetNNCacheFilePath(AF_InputParmeterFile &inputArgs);
+
+/*=====================================
+ * Memory-map a cache file for the current input parameters.
+ * A file whose mapping does not fit the current resample method (count
+ * or cell ids out of range) is ignored as stale.
+ *
+ * RETURN:
+ *  0 : SUCCEED (cache hit)
+ * -1 : FAILED (no usable cache file)
+ *
+ * OUT parameters:
+ * - nnCache : mapped cache content.
+ */
+int af_LoadNNCache(AF_InputParmeterFile &inputArgs, AF_NNCache_t &nnCache /*OUT*/);
+
+/*=====================================
+ * Write the nearest neighbor mapping to a cache file for the current
+ * input parameters. The file is written to a temporary name and renamed,
+ * so concurrent runs never see a partial file.
+ *
+ * PARAMETER:
+ * - nnIDs : nearest neighbor ids, nnCellNum items
+ * - nnDis : nearest neighbor distances, nnCellNum items. NULL to skip.
+ * - nnCellNum : number of items in nnIDs (and nnDis)
+ * - srcCellNum : number of source instrument cells
+ * - trgCellNum : number of target instrument cells (not shifted)
+ *
+ * RETURN:
+ *  0 : SUCCEED
+ * -1 : FAILED
+ */
+int af_SaveNNCache(AF_InputParmeterFile &inputArgs, int *nnIDs, double *nnDis, long long nnCellNum, long long srcCellNum, int trgCellNum);
+
+/*=====================================
+ * Unmap a cache loaded by af_LoadNNCache().
+ */
+void af_ReleaseNNCache(AF_NNCache_t &nnCache);
+
+/*=====================================
+ * Read the resampling operator of footprintInterpolate or psfInterpolate
+ * from a cache file for the current input parameters.
+ *
+ * RETURN:
+ *  0 : SUCCEED (cache hit)
+ * -1 : FAILED (no usable cache file)
+ *
+ * OUT parameters:
+ * - op : the operator. Release it with freeSummaryIndex().
+ * - srcCellNum : number of source instrument cells
+ * - trgCellNum : number of target instrument cells (not shifted)
+ */
+int af_LoadOperatorCache(AF_InputParmeterFile &inputArgs, struct SummaryIndex ** op /*OUT*/, long long &srcCellNum /*OUT*/, int &trgCellNum /*OUT*/);
+
+/*=====================================
+ * Write the resampling operator of footprintInterpolate or psfInterpolate
+ * to a cache file for the current input parameters, the same way as
+ * af_SaveNNCache().
+ *
+ * RETURN:
+ *  0 : SUCCEED
+ * -1 : FAILED
+ */
+int af_SaveOperatorCache(AF_InputParmeterFile &inputArgs, const struct SummaryIndex * op, long long srcCellNum, int trgCellNum);
+
+#endif // _AF_NN_CACHE_H_
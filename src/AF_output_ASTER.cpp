@@ -53,8 +53,8 @@
  *	- Fail : FAILED  (defined in AF_common.h)
  *
  * NOTE:
- *	- TODO: if radiance data becomes all float internally, use float directly
- *	  without converting via HDF5 
+ *	- T_IN is float in single precision mode (USE_SINGLE_PRECISION), so the
+ *	  data is written without converting via HDF5
  */
 // T_IN : input data type
 // T_OUT : output data type
@@ -149,12 +149,12 @@ static int af_WriteSingleRadiance_AsterAsSrc(AF_InputParmeterFile &inputArgs, hi
 			float valid_min = 0.;
 			float valid_max = 0.;
 			unsigned short handle_flag = 0;
-			if (outputDsetName == "ASTER_Radiance") {
+			if (outputDsetName == "ASTER_Radiance" || outputDsetName == "ASTER_Min" || outputDsetName == "ASTER_Max" || outputDsetName == "ASTER_Median") {
 				units = "Watts/m^2/micrometer/steradian";
 				valid_min = 0.;
 				valid_max = 569.0;
 			}
-			if (outputDsetName == "ASTER_Count" || outputDsetName == "ASTER_SD") {
+			if (outputDsetName == "ASTER_Count" || outputDsetName == "ASTER_SD" || outputDsetName == "ASTER_ValidFraction") {
 				handle_flag = 1;
 			}
 			// Don't add valid_min attribute by making valid_min argument
@@ -180,6 +180,22 @@ static int af_WriteSingleRadiance_AsterAsSrc(AF_InputParmeterFile &inputArgs, hi
 					return FAILED;
 				}
 			}
+			else if(outputDsetName == "ASTER_Min" || outputDsetName == "ASTER_Max" || outputDsetName == "ASTER_ValidFraction" || outputDsetName == "ASTER_Median") {
+				std::string long_name_value;
+				if(outputDsetName == "ASTER_Min")
+					long_name_value = "Minimum of ASTER pixels in a resampled cell";
+				else if(outputDsetName == "ASTER_Max")
+					long_name_value = "Maximum of ASTER pixels in a resampled cell";
+				else if(outputDsetName == "ASTER_ValidFraction")
+					long_name_value = "Fraction of ASTER pixels with valid radiance in a resampled cell";
+				else
+					long_name_value = "Approximate median of ASTER pixels in a resampled cell";
+				if(H5LTset_attribute_string(outputFile,dsetPath.c_str(),long_name,long_name_value.c_str())<0) {
+					H5Dclose(aster_dataset);
+					std::cerr << __FUNCTION__ << ":" << __LINE__ << "> Error: cannot generate long_name attribute for " << outputDsetName << std::endl;
+					return FAILED;
+				}
+			}
 			else {
 
 				// Write long_name 
@@ -263,6 +279,10 @@ static int af_WriteSingleRadiance_AsterAsSrc(AF_InputParmeterFile &inputArgs, hi
 				std::string resample_method_value = "Summary Interpolation";
 				if(inputArgs.GetResampleMethod()=="nnInterpolate")
 					resample_method_value = "Nearest Neighbor Interpolation";
+				else if(inputArgs.GetResampleMethod()=="footprintInterpolate")
+					resample_method_value = "Footprint Interpolation";
+				else if(inputArgs.GetResampleMethod()=="psfInterpolate")
+					resample_method_value = "PSF Interpolation";
 
 				if(H5LTset_attribute_string(outputFile,dsetPath.c_str(),"resample_method",resample_method_value.c_str())<0) {
 					H5Dclose(aster_dataset);
@@ -344,7 +364,10 @@ static int af_WriteSingleRadiance_AsterAsSrc(AF_InputParmeterFile &inputArgs, hi
 			double userResolution = inputArgs.GetUSER_Resolution();
 			gdalIORegister();
 			
-			writeGeoTiff((char*)op_geotiff_fname.c_str(),(double*)processedData, userOutputEPSG, userXmin, userYmin, userXmax, userYmax, userResolution);
+			if (std::is_same<T_IN, float>::value)
+				writeGeoTiff((char*)op_geotiff_fname.c_str(),(float*)processedData, userOutputEPSG, userXmin, userYmin, userXmax, userYmax, userResolution);
+			else
+				writeGeoTiff((char*)op_geotiff_fname.c_str(),(double*)processedData, userOutputEPSG, userXmin, userYmin, userXmax, userYmax, userResolution);
 		}
 	}
 
@@ -364,6 +387,8 @@ static int af_WriteSingleRadiance_AsterAsSrc(AF_InputParmeterFile &inputArgs, hi
  *	- inputArgs : a class object contains all the user input parameter info
  *	- outputFile : HDF5 id for output file
  *	- targetNNsrcID : got from nearestNeighborBlockIndex()
+ *	- targetFootprint : got from queryRadiusNNIndex() for footprintInterpolate or
+ *	  queryPSFNNIndex() for psfInterpolate, NULL otherwise
  *	- trgCellNumNoShift : number of target instrument data cells before
  *	  applying shift (if MISR is target)
  *	- srcFile : HDF5 id for input file
@@ -375,7 +400,8 @@ static int af_WriteSingleRadiance_AsterAsSrc(AF_InputParmeterFile &inputArgs, hi
  *	- Success: SUCCEED	(defined in AF_common.h)
  *	- Fail : FAILED  (defined in AF_common.h)
  */
-int af_GenerateOutputCumulative_AsterAsSrc(AF_InputParmeterFile &inputArgs, hid_t outputFile, int *targetNNsrcID,  int trgCellNumNoShift, hid_t srcFile, int srcCellNum, std::map<std::string, strVec_t> &inputMultiVarsMap,hid_t ctrackDset,hid_t atrackDset)
+template <typename T>
+static int af_GenerateOutputCumulative_AsterAsSrc(AF_InputParmeterFile &inputArgs, hid_t outputFile, int *targetNNsrcID, struct SummaryIndex *targetFootprint, int trgCellNumNoShift, hid_t srcFile, long long srcCellNum, std::map<std::string, strVec_t> &inputMultiVarsMap,hid_t ctrackDset,hid_t atrackDset)
 {
 	#if DEBUG_TOOL
 	std::cout << "DBG_TOOL " << __FUNCTION__ << "> BEGIN \n";
@@ -398,8 +424,8 @@ int af_GenerateOutputCumulative_AsterAsSrc(AF_InputParmeterFile &inputArgs, hid_
     
 	//-----------------------------------
 	// define data types for hdf5 data
-	hid_t dataTypeDoubleH5 = H5Tcopy(H5T_NATIVE_DOUBLE);
-	herr_t	status = H5Tset_order(dataTypeDoubleH5, H5T_ORDER_LE);
+	hid_t dataTypeValH5 = H5Tcopy(std::is_same<T, float>::value ? H5T_NATIVE_FLOAT : H5T_NATIVE_DOUBLE);
+	herr_t	status = H5Tset_order(dataTypeValH5, H5T_ORDER_LE);
 	if(status < 0) {
 		printf("Error: ASTER write error in H5Tset_order\n");
 		return FAILED;
@@ -444,15 +470,27 @@ int af_GenerateOutputCumulative_AsterAsSrc(AF_InputParmeterFile &inputArgs, hid_
 	std::cout << "DBG_TOOL " << __FUNCTION__ << "> srcOutputWidth: " << srcOutputWidth <<  "\n";
 	#endif
 	int numCells;
-	double *asterSingleData=NULL;
+	long long srcBandCellNum;  // full orbit can exceed the int range
+	T *asterSingleData=NULL;
 
 	//-----------------------------------------------------------------
 	// TODO: improve by preparing these memory allocation out of loop
 	// srcProcessedData, SD, srcPixelCount
 	// asterSingleData
-	double * srcProcessedData = NULL; // radiance
-	double * SD = NULL;  // Standard Deviation
+	T * srcProcessedData = NULL; // radiance
+	T * SD = NULL;  // Standard Deviation
 	int * srcPixelCount = NULL; // count
+	// extra statistics of summaryInterpolate (SUMMARY_STATISTICS), NULL if not requested
+	const int numExtraStats = 4;
+	const std::string extraStatNames[numExtraStats] = {"MIN", "MAX", "VALID_FRACTION", "MEDIAN"};
+	const std::string extraStatDsets[numExtraStats] = {ASTER_MIN_DSET, ASTER_MAX_DSET, ASTER_VALID_FRACTION_DSET, ASTER_MEDIAN_DSET};
+	T * extraStats[numExtraStats];
+	// summaryInterpolate: list the source cells of each target cell once, then every band is a gather per target cell.
+	// footprintInterpolate and psfInterpolate already have the lists.
+	struct SummaryIndex * summaryIndex = targetFootprint;
+	if (inputArgs.CompareStrCaseInsensitive(inputArgs.GetResampleMethod(), "summaryInterpolate")) {
+		summaryIndex = buildSummaryIndex(targetNNsrcID, srcCellNum, trgCellNumNoShift);
+	}
 	// Note: This is Combination case only
 	for (int i=0; i< bands.size(); i++) {
 		#if DEBUG_TOOL
@@ -464,13 +502,13 @@ int af_GenerateOutputCumulative_AsterAsSrc(AF_InputParmeterFile &inputArgs, hid_
 		#if DEBUG_ELAPSE_TIME
 		StartElapseTime();
 		#endif
-		asterSingleData = get_ast_rad(srcFile, (char*)asterResolution.c_str(), (char*)bands[i].c_str(), &numCells);
+		asterSingleData = get_ast_rad_as<T>(srcFile, (char*)asterResolution.c_str(), (char*)bands[i].c_str(), &srcBandCellNum);
 		if (asterSingleData == NULL) {
 			std::cerr << __FUNCTION__ <<  "> Error: failed to get ASTER band.\n";
 			return FAILED;
 		}
 		#if DEBUG_TOOL
-		std::cout << "DBG_TOOL " << __FUNCTION__ << "> numCells: " << numCells << "\n";
+		std::cout << "DBG_TOOL " << __FUNCTION__ << "> srcBandCellNum: " << srcBandCellNum << "\n";
 		#endif
 		#if DEBUG_ELAPSE_TIME
 		StopElapseTimeAndShow("DBG_TIME> Read source ASTER single band data	DONE.");
@@ -479,7 +517,9 @@ int af_GenerateOutputCumulative_AsterAsSrc(AF_InputParmeterFile &inputArgs, hid_
 		//-------------------------------------------------
 		// handle resample method
 		// Note: resample should be done with trgCellNumNoShift
-		srcProcessedData = new double [trgCellNumNoShift];
+		srcProcessedData = new T [trgCellNumNoShift];
+		for (int s = 0; s < numExtraStats; s++)
+			extraStats[s] = NULL;
 		//Interpolating
 		std::string resampleMethod =  inputArgs.GetResampleMethod();
 		std::cout << "Interpolating with '" << resampleMethod << "' method on " << inputArgs.GetSourceInstrument() << " by " << bands[i] << ".\n";
@@ -489,10 +529,15 @@ int af_GenerateOutputCumulative_AsterAsSrc(AF_InputParmeterFile &inputArgs, hid_
 		if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "nnInterpolate")) {
 			nnInterpolate(asterSingleData, srcProcessedData, targetNNsrcID, trgCellNumNoShift);
 		}
-		else if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "summaryInterpolate")) {
-			SD = new double [trgCellNumNoShift];
+		else if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "summaryInterpolate") || inputArgs.CompareStrCaseInsensitive(resampleMethod, "footprintInterpolate")) {
+			SD = new T [trgCellNumNoShift];
 			srcPixelCount = new int [trgCellNumNoShift];
-			summaryInterpolate(asterSingleData, targetNNsrcID, srcCellNum, srcProcessedData, SD, srcPixelCount, trgCellNumNoShift);
+			for (int s = 0; s < numExtraStats; s++) {
+				if (inputArgs.IsSummaryStatisticRequested(extraStatNames[s]))
+					extraStats[s] = new T [trgCellNumNoShift];
+			}
+			// all statistics in one gather over the source cells of each target cell
+			summaryStatistics(asterSingleData, summaryIndex, srcProcessedData, SD, srcPixelCount, extraStats[0], extraStats[1], extraStats[2], extraStats[3]);
 			#if 0 // DEBUG_TOOL
 			std::cout << "DBG_TOOL> No nodata values: \n";
 			for(int i = 0; i < trgCellNumNoShift; i++) {
@@ -502,6 +547,12 @@ int af_GenerateOutputCumulative_AsterAsSrc(AF_InputParmeterFile &inputArgs, hid_
 			}
 			#endif
 		}
+		// a band is as large as the whole ASTER orbit, so the PSF weights are applied one band at a time
+		else if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "psfInterpolate")) {
+			SD = new T [trgCellNumNoShift];
+			srcPixelCount = new int [trgCellNumNoShift];
+			resampleMultiBand(&asterSingleData, summaryIndex, &srcProcessedData, &SD, &srcPixelCount, 1);
+		}
 		#if DEBUG_ELAPSE_TIME
 		StopElapseTimeAndShow("DBG> nnInterpolate  DONE.");
 		#endif
@@ -510,11 +561,11 @@ int af_GenerateOutputCumulative_AsterAsSrc(AF_InputParmeterFile &inputArgs, hid_
 		//-----------------------------------------------------------------------
 		// check if need to shift by MISR (shift==ON & target) case before writing
 		// radiance data
-		double * srcRadianceDataShifted = NULL;
-		double * srcRadianceDataPtr = NULL;
+		T * srcRadianceDataShifted = NULL;
+		T * srcRadianceDataPtr = NULL;
 		// standard deviation data
-		double * srcSDDataShifted = NULL;
-		double * srcSDDataPtr = NULL;
+		T * srcSDDataShifted = NULL;
+		T * srcSDDataPtr = NULL;
 		// pixel count data
 		int * srcPixelCountDataShifted = NULL;
 		int * srcPixelCountDataPtr = NULL;
@@ -528,8 +579,8 @@ int af_GenerateOutputCumulative_AsterAsSrc(AF_InputParmeterFile &inputArgs, hid_
 			/*-------------------- 
 			 * shift radiance data
 			 */
-			srcRadianceDataShifted = new double [widthShifted * heightShifted];
-			MISRBlockOffset<double>(srcProcessedData, srcRadianceDataShifted, (inputArgs.GetMISR_Resolution() == "L") ? 0 : 1);
+			srcRadianceDataShifted = new T [widthShifted * heightShifted];
+			MISRBlockOffset<T>(srcProcessedData, srcRadianceDataShifted, (inputArgs.GetMISR_Resolution() == "L") ? 0 : 1);
 			// use srcRadianceDataShifted instead of srcProcessedData, and free memory
 			if(srcProcessedData) {
 				delete [] srcProcessedData;
@@ -539,8 +590,8 @@ int af_GenerateOutputCumulative_AsterAsSrc(AF_InputParmeterFile &inputArgs, hid_
 			/*-------------------- 
 			 * shift SD data
 			 */
-			srcSDDataShifted = new double [widthShifted * heightShifted];
-			MISRBlockOffset<double>(SD, srcSDDataShifted, (inputArgs.GetMISR_Resolution() == "L") ? 0 : 1);
+			srcSDDataShifted = new T [widthShifted * heightShifted];
+			MISRBlockOffset<T>(SD, srcSDDataShifted, (inputArgs.GetMISR_Resolution() == "L") ? 0 : 1);
 			// use srcSDDataShifted instead of SD, and free memory
 			if(SD) {
 				delete [] SD;
@@ -557,6 +608,18 @@ int af_GenerateOutputCumulative_AsterAsSrc(AF_InputParmeterFile &inputArgs, hid_
 				delete [] srcPixelCount;
 				srcPixelCount = NULL;
 			}
+
+			/*-------------------- 
+			 * shift extra statistics data, and replace with shifted
+			 */
+			for (int s = 0; s < numExtraStats; s++) {
+				if (extraStats[s] == NULL)
+					continue;
+				T * extraStatShifted = new T [widthShifted * heightShifted];
+				MISRBlockOffset<T>(extraStats[s], extraStatShifted, (inputArgs.GetMISR_Resolution() == "L") ? 0 : 1);
+				delete [] extraStats[s];
+				extraStats[s] = extraStatShifted;
+			}
 			#if DEBUG_ELAPSE_TIME
 			StopElapseTimeAndShow("DBG_TIME> source ASTER radiance MISR-base shift DONE.");
 			#endif
@@ -579,13 +642,13 @@ int af_GenerateOutputCumulative_AsterAsSrc(AF_InputParmeterFile &inputArgs, hid_
 		StartElapseTime();
 		#endif
 		// output radiance dset
-		ret = af_WriteSingleRadiance_AsterAsSrc<double, float>(inputArgs,outputFile, ASTER_RADIANCE_DSET, dataTypeDoubleH5, asterDataspace,  srcRadianceDataPtr, numCells /*processed size*/, srcOutputWidth, i /*bandIdx*/,bands,ctrackDset,atrackDset,bandDset);
+		ret = af_WriteSingleRadiance_AsterAsSrc<T, float>(inputArgs,outputFile, ASTER_RADIANCE_DSET, dataTypeValH5, asterDataspace,  srcRadianceDataPtr, numCells /*processed size*/, srcOutputWidth, i /*bandIdx*/,bands,ctrackDset,atrackDset,bandDset);
 		if (ret == FAILED) {
 			std::cerr << __FUNCTION__ << "> Error: returned fail.\n";
 		}
 
 		// output standard deviation dset
-		ret = af_WriteSingleRadiance_AsterAsSrc<double, float>(inputArgs,outputFile, ASTER_SD_DSET, dataTypeDoubleH5, asterDataspace,  srcSDDataPtr, numCells /*processed size*/, srcOutputWidth, i /*bandIdx*/,bands,ctrackDset,atrackDset,bandDset);
+		ret = af_WriteSingleRadiance_AsterAsSrc<T, float>(inputArgs,outputFile, ASTER_SD_DSET, dataTypeValH5, asterDataspace,  srcSDDataPtr, numCells /*processed size*/, srcOutputWidth, i /*bandIdx*/,bands,ctrackDset,atrackDset,bandDset);
 		if (ret == FAILED) {
 			std::cerr << __FUNCTION__ << "> Error: returned fail.\n";
 		}
@@ -595,6 +658,16 @@ int af_GenerateOutputCumulative_AsterAsSrc(AF_InputParmeterFile &inputArgs, hid_
 		if (ret == FAILED) {
 			std::cerr << __FUNCTION__ << "> Error: returned fail.\n";
 		}
+
+		// output extra statistics dsets
+		for (int s = 0; s < numExtraStats; s++) {
+			if (extraStats[s] == NULL)
+				continue;
+			ret = af_WriteSingleRadiance_AsterAsSrc<T, float>(inputArgs,outputFile, extraStatDsets[s], dataTypeValH5, asterDataspace,  extraStats[s], numCells /*processed size*/, srcOutputWidth, i /*bandIdx*/,bands,ctrackDset,atrackDset,bandDset);
+			if (ret == FAILED) {
+				std::cerr << __FUNCTION__ << "> Error: returned fail.\n";
+			}
+		}
 		#if DEBUG_ELAPSE_TIME
 		StopElapseTimeAndShow("DBG_TIME> Write source ASTER data (randiance, SD, count) of single band DONE.");
 		#endif
@@ -617,9 +690,15 @@ int af_GenerateOutputCumulative_AsterAsSrc(AF_InputParmeterFile &inputArgs, hid_
 			delete [] srcPixelCountDataShifted;
 		if(srcSDDataShifted)
 			delete [] srcSDDataShifted;
+		for (int s = 0; s < numExtraStats; s++) {
+			if (extraStats[s])
+				delete [] extraStats[s];
+		}
 	} // i loop
+	if (summaryIndex != targetFootprint)
+		freeSummaryIndex(summaryIndex);
 
-	H5Tclose(dataTypeDoubleH5);
+	H5Tclose(dataTypeValH5);
 	H5Sclose(asterDataspace);
 	H5Dclose(bandDset);
 
@@ -629,3 +708,11 @@ int af_GenerateOutputCumulative_AsterAsSrc(AF_InputParmeterFile &inputArgs, hid_
 
 	return ret;
 }
+
+// T is float in single precision mode (USE_SINGLE_PRECISION), double otherwise
+int af_GenerateOutputCumulative_AsterAsSrc(AF_InputParmeterFile &inputArgs, hid_t outputFile, int *targetNNsrcID, struct SummaryIndex *targetFootprint, int trgCellNumNoShift, hid_t srcFile, long long srcCellNum, std::map<std::string, strVec_t> &inputMultiVarsMap,hid_t ctrackDset,hid_t atrackDset)
+{
+	if (inputArgs.GetUseSinglePrecision())
+		return af_GenerateOutputCumulative_AsterAsSrc<float>(inputArgs, outputFile, targetNNsrcID, targetFootprint, trgCellNumNoShift, srcFile, srcCellNum, inputMultiVarsMap, ctrackDset, atrackDset);
+	return af_GenerateOutputCumulative_AsterAsSrc<double>(inputArgs, outputFile, targetNNsrcID, targetFootprint, trgCellNumNoShift, srcFile, srcCellNum, inputMultiVarsMap, ctrackDset, atrackDset);
+}
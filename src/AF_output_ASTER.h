@@ -11,6 +11,7 @@
  */
 
 #include "AF_InputParmeterFile.h"
+#include "reproject.h"
 #include <hdf5.h>
 #include <hdf5_hl.h>
 
@@ -19,7 +20,7 @@
 
 
 //  ASTER as Source instrument, generate radiance data
-int af_GenerateOutputCumulative_AsterAsSrc(AF_InputParmeterFile &inputArgs, hid_t outputFile, int *targetNNsrcID,  int trgCellNumNoShift, hid_t srcFile, int srcCellNum, std::map<std::string, strVec_t> &inputMultiVarsMap,hid_t ctrackDset, hid_t atrackDset);
+int af_GenerateOutputCumulative_AsterAsSrc(AF_InputParmeterFile &inputArgs, hid_t outputFile, int *targetNNsrcID, struct SummaryIndex *targetFootprint, int trgCellNumNoShift, hid_t srcFile, long long srcCellNum, std::map<std::string, strVec_t> &inputMultiVarsMap,hid_t ctrackDset, hid_t atrackDset);
 
 
 #endif // _AF_OUTPUT_ASTER_H
@@ -20,6 +20,7 @@
 #include "io.h"
 #include "reproject.h"
 #include "misrutil.h"
+#include <algorithm>
 
 
 /*#############################################################################
@@ -49,8 +50,8 @@
  *  - Fail : FAILED  (defined in AF_common.h)
  *
  * NOTE:
- *  - TODO: if radiance data becomes all float internally, use float directly
- *    without converting via HDF5
+ *  - T_IN is float in single precision mode (USE_SINGLE_PRECISION), so the
+ *    data is written without converting via HDF5
  */
 // T_IN : input data type
 // T_OUT : output data type
@@ -292,7 +293,8 @@ done:
  *  - Success: SUCCEED  (defined in AF_common.h)
  *  - Fail : FAILED  (defined in AF_common.h)
  */
-int af_GenerateOutputCumulative_MisrAsTrg(AF_InputParmeterFile &inputArgs, hid_t outputFile,hid_t srcFile, int trgCellNumOri, std::map<std::string, strVec_t> &inputMultiVarsMap,hid_t ctrackDset, hid_t atrackDset)
+template <typename T>
+static int af_GenerateOutputCumulative_MisrAsTrg(AF_InputParmeterFile &inputArgs, hid_t outputFile,hid_t srcFile, int trgCellNumOri, std::map<std::string, strVec_t> &inputMultiVarsMap,hid_t ctrackDset, hid_t atrackDset)
 {
 	#if DEBUG_TOOL
 	std::cout << "DBG_TOOL " << __FUNCTION__ << "> BEGIN \n";
@@ -300,7 +302,7 @@ int af_GenerateOutputCumulative_MisrAsTrg(AF_InputParmeterFile &inputArgs, hid_t
 	int ret;
 
 	// data type
-	hid_t misrDatatype = H5Tcopy(H5T_NATIVE_DOUBLE);
+	hid_t misrDatatype = H5Tcopy(std::is_same<T, float>::value ? H5T_NATIVE_FLOAT : H5T_NATIVE_DOUBLE);
 	herr_t	status = H5Tset_order(misrDatatype, H5T_ORDER_LE);
 	if(status < 0) {
 		std::cerr << __FUNCTION__ <<  "> Error: MISR write error in H5Tset_order.\n";
@@ -359,8 +361,8 @@ int af_GenerateOutputCumulative_MisrAsTrg(AF_InputParmeterFile &inputArgs, hid_t
 
 	std::string misrShift = inputArgs.GetMISR_Shift();
 	int numCells;
-	double *misrSingleDataPtr = NULL;
-	double *misrSingleData = NULL;
+	T *misrSingleDataPtr = NULL;
+	T *misrSingleData = NULL;
 	std::string misrCamera;
 	std::string misrRadiance;
 
@@ -377,7 +379,7 @@ int af_GenerateOutputCumulative_MisrAsTrg(AF_InputParmeterFile &inputArgs, hid_t
 			#if DEBUG_ELAPSE_TIME
 			StartElapseTime();
 			#endif
-			misrSingleData = get_misr_rad(srcFile, (char*)misrCamera.c_str(), (char*)misrResolution.c_str(),(char*) misrRadiance.c_str(), &numCells);
+			misrSingleData = get_misr_rad_as<T>(srcFile, (char*)misrCamera.c_str(), (char*)misrResolution.c_str(),(char*) misrRadiance.c_str(), &numCells);
 			if (misrSingleData == NULL) {
 				std::cerr << __FUNCTION__ <<  "> Error: failed to get MISR radiance.\n";
 				return FAILED;
@@ -391,14 +393,14 @@ int af_GenerateOutputCumulative_MisrAsTrg(AF_InputParmeterFile &inputArgs, hid_t
 			#endif
 			//-----------------------------------------------------------------------
 			// check if need to shift by MISR_TARGET_BLOCKUNSTACK==ON & MISR target case for writing
-			double * misrSingleDataShifted = NULL;
+			T * misrSingleDataShifted = NULL;
 			if(misrShift == "ON") {
 				std::cout << "\nTarget MISR radiance block unstacking...\n";
 				#if DEBUG_ELAPSE_TIME
 				StartElapseTime();
 				#endif
-				misrSingleDataShifted = (double *) malloc(sizeof(double) * widthShifted * heightShifted);
-				MISRBlockOffset<double>(misrSingleData, misrSingleDataShifted, (misrResolution == "L") ? 0 : 1);
+				misrSingleDataShifted = (T *) malloc(sizeof(T) * widthShifted * heightShifted);
+				MISRBlockOffset<T>(misrSingleData, misrSingleDataShifted, (misrResolution == "L") ? 0 : 1);
 				#if DEBUG_ELAPSE_TIME
 				StopElapseTimeAndShow("DBG_TIME> target MISR radiance block unstack DONE.");
 				#endif
@@ -415,12 +417,12 @@ int af_GenerateOutputCumulative_MisrAsTrg(AF_InputParmeterFile &inputArgs, hid_t
 			#if DEBUG_ELAPSE_TIME
 			StartElapseTime();
 			#endif
-			af_WriteSingleRadiance_MisrAsTrg<double, float>(inputArgs,outputFile, misrDatatype, misrDataspace,  misrSingleDataPtr, numCells, targetOutputWidth, i, j,ctrackDset,atrackDset,cameraDset,bandDset);
+			af_WriteSingleRadiance_MisrAsTrg<T, float>(inputArgs,outputFile, misrDatatype, misrDataspace,  misrSingleDataPtr, numCells, targetOutputWidth, i, j,ctrackDset,atrackDset,cameraDset,bandDset);
 			#if DEBUG_ELAPSE_TIME
 			StopElapseTimeAndShow("DBG_TIME> Write target MISR single band data  DONE.");
 			#endif
 
-			// TODO: buffer is not reused. make memory allocation out of get_misr_rad() to improve performance
+			// TODO: buffer is not reused. make memory allocation out of get_misr_rad_as<T>() to improve performance
 			if (misrSingleData)
 				free(misrSingleData);
 
@@ -441,6 +443,14 @@ int af_GenerateOutputCumulative_MisrAsTrg(AF_InputParmeterFile &inputArgs, hid_t
 	return SUCCEED;
 }
 
+// T is float in single precision mode (USE_SINGLE_PRECISION), double otherwise
+int af_GenerateOutputCumulative_MisrAsTrg(AF_InputParmeterFile &inputArgs, hid_t outputFile,hid_t srcFile, int trgCellNumOri, std::map<std::string, strVec_t> &inputMultiVarsMap,hid_t ctrackDset, hid_t atrackDset)
+{
+	if (inputArgs.GetUseSinglePrecision())
+		return af_GenerateOutputCumulative_MisrAsTrg<float>(inputArgs, outputFile, srcFile, trgCellNumOri, inputMultiVarsMap, ctrackDset, atrackDset);
+	return af_GenerateOutputCumulative_MisrAsTrg<double>(inputArgs, outputFile, srcFile, trgCellNumOri, inputMultiVarsMap, ctrackDset, atrackDset);
+}
+
 
 
 /*#############################################################################
@@ -470,8 +480,8 @@ int af_GenerateOutputCumulative_MisrAsTrg(AF_InputParmeterFile &inputArgs, hid_t
  *  - Fail : FAILED  (defined in AF_common.h)
  *
  * NOTE:
- *  - TODO: if radiance data becomes all float internally, use float directly
- *    without converting via HDF5
+ *  - T_IN is float in single precision mode (USE_SINGLE_PRECISION), so the
+ *    data is written without converting via HDF5
  */
 // T_IN : input data type
 // T_OUT : output data type
@@ -646,6 +656,12 @@ static int af_WriteSingleRadiance_MisrAsSrc(AF_InputParmeterFile &inputArgs,hid_
 			std::string resample_method_value = "Summary Interpolation";
 			if(inputArgs.GetResampleMethod()=="nnInterpolate")
 				resample_method_value = "Nearest Neighbor Interpolation";
+			else if(inputArgs.GetResampleMethod()=="idwInterpolate")
+				resample_method_value = "Inverse Distance Weighted Interpolation";
+			else if(inputArgs.GetResampleMethod()=="footprintInterpolate")
+				resample_method_value = "Footprint Interpolation";
+			else if(inputArgs.GetResampleMethod()=="psfInterpolate")
+				resample_method_value = "PSF Interpolation";
 
 			if(H5LTset_attribute_string(outputFile,dsetPath.c_str(),"resample_method",resample_method_value.c_str())<0) {
 				H5Dclose(misr_dataset);
@@ -745,6 +761,9 @@ done:
  *  - inputArgs : a class object contains all the user input parameter info
  *  - outputFile : HDF5 id for output file
  *  - targetNNsrcID : got from nearestNeighborBlockIndex()
+ *  - targetNNWeights : got from idwWeights() for idwInterpolate, NULL
+ *  - targetFootprint : got from queryRadiusNNIndex() for footprintInterpolate or
+ *    queryPSFNNIndex() for psfInterpolate, NULL otherwise
  *  - trgCellNum : number of target instrument data cells
  *  - srcFile : HDF5 id for input file
  *  - srcCellNum : number of source instrument data cells
@@ -755,7 +774,8 @@ done:
  *  - Success: SUCCEED  (defined in AF_common.h)
  *  - Fail : FAILED  (defined in AF_common.h)
  */
-int af_GenerateOutputCumulative_MisrAsSrc(AF_InputParmeterFile &inputArgs, hid_t outputFile, int *targetNNsrcID,  int trgCellNum, hid_t srcFile, int srcCellNum, std::map<std::string, strVec_t> &inputMultiVarsMap,hid_t ctrackDset, hid_t atrackDset)
+template <typename T>
+static int af_GenerateOutputCumulative_MisrAsSrc(AF_InputParmeterFile &inputArgs, hid_t outputFile, int *targetNNsrcID, float *targetNNWeights, struct SummaryIndex *targetFootprint, int trgCellNum, hid_t srcFile, long long srcCellNum, std::map<std::string, strVec_t> &inputMultiVarsMap,hid_t ctrackDset, hid_t atrackDset)
 {
 	#if DEBUG_TOOL
 	std::cout << "DBG_TOOL " << __FUNCTION__ << "> BEGIN \n";
@@ -783,7 +803,7 @@ int af_GenerateOutputCumulative_MisrAsSrc(AF_InputParmeterFile &inputArgs, hid_t
 	}
 
 // data type
-	hid_t misrDatatype = H5Tcopy(H5T_NATIVE_DOUBLE);
+	hid_t misrDatatype = H5Tcopy(std::is_same<T, float>::value ? H5T_NATIVE_FLOAT : H5T_NATIVE_DOUBLE);
 	herr_t	status = H5Tset_order(misrDatatype, H5T_ORDER_LE);
 	if(status < 0) {
 		printf("Error: MISR write error in H5Tset_order\n");
@@ -817,27 +837,46 @@ int af_GenerateOutputCumulative_MisrAsSrc(AF_InputParmeterFile &inputArgs, hid_t
 	std::cout << "DBG_TOOL " << __FUNCTION__ << "> srcOutputWidth: " << srcOutputWidth <<  "\n";
 	#endif
 	int numCells;
-	double *misrSingleData=NULL;
+	T *misrSingleData=NULL;
 
 	std::string singleRad;
 	std::string singleCamera;
 	//-----------------------------------------------------------------
+	// Every resample method is a resampling operator built once below. A batch of
+	// camera/radiance pairs is read and resampled in one pass over the operator.
+	std::string resampleMethod =  inputArgs.GetResampleMethod();
+	int nPairs = cameras.size() * radiances.size();
+	int batchSize = af_GetMultiBandBatchSize(srcCellNum, trgCellNum, nPairs);
+	std::vector<T *> misrBatchData(batchSize, (T *) NULL);
+	std::vector<T *> srcBatchProcessedData(batchSize, (T *) NULL);
+	//-----------------------------------------------------------------
 	// TODO: improve by preparing these memory allocation out of loop
-	// srcProcessedData , nsrcPixels
+	// srcProcessedData
 	// misrSingleData 
-	double * srcProcessedData = NULL;
-	int * nsrcPixels = NULL;
-	// Note: This is Combination case only
-	for(int j=0; j < cameras.size(); j++) {
-		singleCamera = cameras[j];
-		#if DEBUG_TOOL
-		std::cout << "DBG_TOOL " << __FUNCTION__ << "> cameras[" << j << "]" << cameras[j] << "\n";
-		#endif
-		for (int i=0; i< radiances.size(); i++) {
+	T * srcProcessedData = NULL;
+	// summaryInterpolate: list the source cells of each target cell once, then every camera/radiance pair is a gather per target cell.
+	// nnInterpolate and idwInterpolate use the neighbor IDs (and weights) as they are.
+	// footprintInterpolate and psfInterpolate already have the lists.
+	struct SummaryIndex * summaryIndex = targetFootprint;
+	if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "summaryInterpolate")) {
+		summaryIndex = buildSummaryIndex(targetNNsrcID, srcCellNum, trgCellNum);
+	}
+	else if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "nnInterpolate")) {
+		summaryIndex = nnSummaryIndex(targetNNsrcID, srcCellNum, trgCellNum);
+	}
+	else if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "idwInterpolate")) {
+		summaryIndex = idwSummaryIndex(targetNNsrcID, targetNNWeights, inputArgs.GetIDW_Neighbors(), srcCellNum, trgCellNum);
+	}
+	// Note: This is Combination case only. Pairs are in camera major order (j: camera, i: radiance)
+	for (int batchBegin = 0; batchBegin < nPairs; batchBegin += batchSize) {
+		int nBatch = std::min(batchSize, nPairs - batchBegin);
+		for (int k = 0; k < nBatch; k++) {
+			int j = (batchBegin + k) / radiances.size();
+			int i = (batchBegin + k) % radiances.size();
+			singleCamera = cameras[j];
 			#if DEBUG_TOOL
-			std::cout << "DBG_TOOL " << __FUNCTION__ << "> radiances[" << i << "]" << radiances[i] << "\n";
+			std::cout << "DBG_TOOL " << __FUNCTION__ << "> cameras[" << j << "]" << cameras[j] << ", radiances[" << i << "]" << radiances[i] << "\n";
 			#endif
-			// insert to only begin
 			singleRad =  radiances[i];
 	
 			//---------------------------------
@@ -845,8 +884,8 @@ int af_GenerateOutputCumulative_MisrAsSrc(AF_InputParmeterFile &inputArgs, hid_t
 			#if DEBUG_ELAPSE_TIME
 			StartElapseTime();
 			#endif
-			misrSingleData = get_misr_rad(srcFile, (char*) singleCamera.c_str(), (char*)misrResolution.c_str(), (char*)singleRad.c_str(), &numCells);
-			if (misrSingleData == NULL) {
+			misrBatchData[k] = get_misr_rad_as<T>(srcFile, (char*) singleCamera.c_str(), (char*)misrResolution.c_str(), (char*)singleRad.c_str(), &numCells);
+			if (misrBatchData[k] == NULL) {
 				std::cerr << __FUNCTION__ <<  "> Error: failed to get MISR radiance.\n";
 				return FAILED;
 			}
@@ -856,41 +895,32 @@ int af_GenerateOutputCumulative_MisrAsSrc(AF_InputParmeterFile &inputArgs, hid_t
 			#if DEBUG_ELAPSE_TIME
 			StopElapseTimeAndShow("DBG_TIME> Read source MISR single band data	DONE.");
 			#endif
-	
-			//-------------------------------------------------
-			// handle resample method
-			srcProcessedData = new double [trgCellNum];
-			//Interpolating
-			std::string resampleMethod =  inputArgs.GetResampleMethod();
+			srcBatchProcessedData[k] = new T [trgCellNum];
 			std::cout << "Interpolating with '" << resampleMethod << "' method on " << inputArgs.GetSourceInstrument() << " by " << cameras[j] << " : " << radiances[i] << ".\n";
-			#if DEBUG_ELAPSE_TIME
-			StartElapseTime();
-			#endif
-			if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "nnInterpolate")) {
-				nnInterpolate(misrSingleData, srcProcessedData, targetNNsrcID, trgCellNum);
-			}
-			else if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "summaryInterpolate")) {
-				nsrcPixels = new int [trgCellNum];
-				summaryInterpolate(misrSingleData, targetNNsrcID, srcCellNum, srcProcessedData, NULL, nsrcPixels, trgCellNum);
-				#if 0 // DEBUG_TOOL
-				std::cout << "DBG_TOOL> No nodata values: \n";
-				for(int i = 0; i < trgCellNum; i++) {
-					if(nsrcPixels[i] > 0) {
-						printf("%d,\t%lf\n", nsrcPixels[i], srcProcessedData[i]);
-					}
-				}
-				#endif
-			}
-			#if DEBUG_ELAPSE_TIME
-			StopElapseTimeAndShow("DBG> nnInterpolate  DONE.");
-			#endif
+		}
 	
+		//-------------------------------------------------
+		// handle resample method
+		#if DEBUG_ELAPSE_TIME
+		StartElapseTime();
+		#endif
+		resampleMultiBand(&misrBatchData[0], summaryIndex, &srcBatchProcessedData[0], NULL, NULL, nBatch);
+		#if DEBUG_ELAPSE_TIME
+		StopElapseTimeAndShow("DBG> resample  DONE.");
+		#endif
+	
+		for (int k = 0; k < nBatch; k++) {
+			int j = (batchBegin + k) / radiances.size();
+			int i = (batchBegin + k) % radiances.size();
+			misrSingleData = misrBatchData[k];
+			srcProcessedData = srcBatchProcessedData[k];
+
 			//---------------------------------
 			// write src radiance to AF file
 			#if DEBUG_ELAPSE_TIME
 			StartElapseTime();
 			#endif
-			ret = af_WriteSingleRadiance_MisrAsSrc<double,float>(inputArgs,outputFile, misrDatatype, misrDataspace,  srcProcessedData, trgCellNum /*processed size*/, srcOutputWidth, j /*cameraIdx*/, i /*radIdx*/,ctrackDset,atrackDset,cameraDset,bandDset);
+			ret = af_WriteSingleRadiance_MisrAsSrc<T, float>(inputArgs,outputFile, misrDatatype, misrDataspace,  srcProcessedData, trgCellNum /*processed size*/, srcOutputWidth, j /*cameraIdx*/, i /*radIdx*/,ctrackDset,atrackDset,cameraDset,bandDset);
 			if (ret == FAILED) {
 				std::cerr << __FUNCTION__ << "> Error: returned fail.\n";
 			}
@@ -898,19 +928,17 @@ int af_GenerateOutputCumulative_MisrAsSrc(AF_InputParmeterFile &inputArgs, hid_t
 			StopElapseTimeAndShow("DBG_TIME> Write source MISR single band data  DONE.");
 			#endif
 			//
-			// TODO: buffer is not reused. make memory allocation out of get_misr_rad() to improve performance
+			// TODO: buffer is not reused. make memory allocation out of get_misr_rad_as<T>() to improve performance
 	
 			// free memory
 			if (misrSingleData)
 				free(misrSingleData);
 			if(srcProcessedData)
 				delete [] srcProcessedData;
-			if (nsrcPixels) {
-				delete [] nsrcPixels;
-                                nsrcPixels = NULL;
-                        }
-		} // i loop
-	} // j loop
+		}
+	} // batch loop
+	if (summaryIndex != targetFootprint)
+		freeSummaryIndex(summaryIndex);
 
 	H5Dclose(cameraDset);
 	H5Dclose(bandDset);
@@ -923,3 +951,11 @@ int af_GenerateOutputCumulative_MisrAsSrc(AF_InputParmeterFile &inputArgs, hid_t
 
 	return ret;
 }
+
+// T is float in single precision mode (USE_SINGLE_PRECISION), double otherwise
+int af_GenerateOutputCumulative_MisrAsSrc(AF_InputParmeterFile &inputArgs, hid_t outputFile, int *targetNNsrcID, float *targetNNWeights, struct SummaryIndex *targetFootprint, int trgCellNum, hid_t srcFile, long long srcCellNum, std::map<std::string, strVec_t> &inputMultiVarsMap,hid_t ctrackDset, hid_t atrackDset)
+{
+	if (inputArgs.GetUseSinglePrecision())
+		return af_GenerateOutputCumulative_MisrAsSrc<float>(inputArgs, outputFile, targetNNsrcID, targetNNWeights, targetFootprint, trgCellNum, srcFile, srcCellNum, inputMultiVarsMap, ctrackDset, atrackDset);
+	return af_GenerateOutputCumulative_MisrAsSrc<double>(inputArgs, outputFile, targetNNsrcID, targetNNWeights, targetFootprint, trgCellNum, srcFile, srcCellNum, inputMultiVarsMap, ctrackDset, atrackDset);
+}
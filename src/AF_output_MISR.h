@@ -11,6 +11,7 @@
 
 
 #include "AF_InputParmeterFile.h"
+#include "reproject.h"
 #include <hdf5.h>
 #include <hdf5_hl.h>
 
@@ -19,6 +20,6 @@ int af_GenerateOutputCumulative_MisrAsTrg(AF_InputParmeterFile &inputArgs, hid_t
 
 
 //  MODIS as Source instrument, generate radiance data
-int af_GenerateOutputCumulative_MisrAsSrc(AF_InputParmeterFile &inputArgs, hid_t outputFile, int *targetNNsrcID,  int trgCellNum, hid_t srcFile, int srcCellNum, std::map<std::string, strVec_t> &inputMultiVarsMap,hid_t ctrackDset,hid_t atrackDset);
+int af_GenerateOutputCumulative_MisrAsSrc(AF_InputParmeterFile &inputArgs, hid_t outputFile, int *targetNNsrcID, float *targetNNWeights, struct SummaryIndex *targetFootprint, int trgCellNum, hid_t srcFile, long long srcCellNum, std::map<std::string, strVec_t> &inputMultiVarsMap,hid_t ctrackDset,hid_t atrackDset);
 
 #endif // _AF_OUTPUT_MISR_H_
@@ -56,8 +56,8 @@ const std::string All_bands_250m = "1,2";
  *	- Fail : FAILED  (defined in AF_common.h)
  *
  * NOTE:
- *	- TODO: if radiance data becomes all float internally, use float directly
- *	  without converting via HDF5
+ *	- T_IN is float in single precision mode (USE_SINGLE_PRECISION), so the
+ *	  data is written without converting via HDF5
  */
 // T_IN : input data type
 // T_OUT : output data type
@@ -303,7 +303,8 @@ done:
  *	- Success: SUCCEED	(defined in AF_common.h)
  *	- Fail : FAILED  (defined in AF_common.h)
  */
-int af_GenerateOutputCumulative_ModisAsTrg(AF_InputParmeterFile &inputArgs, hid_t outputFile,hid_t srcFile, int trgCellNum, std::map<std::string, strVec_t> &inputMultiVarsMap,hid_t ctrackDset, hid_t atrackDset)
+template <typename T>
+static int af_GenerateOutputCumulative_ModisAsTrg(AF_InputParmeterFile &inputArgs, hid_t outputFile,hid_t srcFile, int trgCellNum, std::map<std::string, strVec_t> &inputMultiVarsMap,hid_t ctrackDset, hid_t atrackDset)
 {
 	#if DEBUG_TOOL
 	std::cout << "DBG_TOOL " << __FUNCTION__ << "> BEGIN \n";
@@ -328,7 +329,7 @@ int af_GenerateOutputCumulative_ModisAsTrg(AF_InputParmeterFile &inputArgs, hid_
 	}
         
 	// data type
-	hid_t modisDatatype = H5Tcopy(H5T_NATIVE_DOUBLE);
+	hid_t modisDatatype = H5Tcopy(std::is_same<T, float>::value ? H5T_NATIVE_FLOAT : H5T_NATIVE_DOUBLE);
 	herr_t	status = H5Tset_order(modisDatatype, H5T_ORDER_LE);
 	if(status < 0) {
 		std::cerr << __FUNCTION__ <<  "> Error: MODIS write error in H5Tset_order.\n";
@@ -358,7 +359,7 @@ int af_GenerateOutputCumulative_ModisAsTrg(AF_InputParmeterFile &inputArgs, hid_
 	hid_t modisDataspace = H5Screate_simple(rankSpace, modis_dim, NULL);
 
 	int numCells;
-	double *modisSingleData;
+	T *modisSingleData;
 	std::vector<std::string> singleBandVec;
 	for (int i=0; i< bands.size(); i++) {
 		std::cout << "Processing MODIS band: " << bands[i] << "\n";
@@ -380,7 +381,7 @@ int af_GenerateOutputCumulative_ModisAsTrg(AF_InputParmeterFile &inputArgs, hid_
 		#if DEBUG_ELAPSE_TIME
 		StartElapseTime();
 		#endif
-		modisSingleData = get_modis_rad(srcFile, (char*)modisResolution.c_str(), singleBandVec, 1, &numCells);
+		modisSingleData = get_modis_rad_as<T>(srcFile, (char*)modisResolution.c_str(), singleBandVec, 1, &numCells);
 		if (modisSingleData == NULL) {
 			std::cerr << __FUNCTION__ <<  "> Error: failed to get MODIS radiance.\n";
 			return FAILED;
@@ -397,12 +398,12 @@ int af_GenerateOutputCumulative_ModisAsTrg(AF_InputParmeterFile &inputArgs, hid_
 		#if DEBUG_ELAPSE_TIME
 		StartElapseTime();
 		#endif
-		af_WriteSingleRadiance_ModisAsTrg<double,float>(inputArgs,outputFile, modisDatatype, modisDataspace,modisSingleData, numCells, targetOutputWidth, i,has_refsb,bands,ctrackDset,atrackDset,bandDset);
+		af_WriteSingleRadiance_ModisAsTrg<T, float>(inputArgs,outputFile, modisDatatype, modisDataspace,modisSingleData, numCells, targetOutputWidth, i,has_refsb,bands,ctrackDset,atrackDset,bandDset);
 		#if DEBUG_ELAPSE_TIME
 		StopElapseTimeAndShow("DBG_TIME> Write target MODIS single band data  DONE.");
 		#endif
 		//
-		// TODO: buffer is not reused. make memory allocation out of get_modis_rad() to improve performance
+		// TODO: buffer is not reused. make memory allocation out of get_modis_rad_as<T>() to improve performance
 		free(modisSingleData);
 	}
 
@@ -417,6 +418,14 @@ int af_GenerateOutputCumulative_ModisAsTrg(AF_InputParmeterFile &inputArgs, hid_
 	return SUCCEED;
 }
 
+// T is float in single precision mode (USE_SINGLE_PRECISION), double otherwise
+int af_GenerateOutputCumulative_ModisAsTrg(AF_InputParmeterFile &inputArgs, hid_t outputFile,hid_t srcFile, int trgCellNum, std::map<std::string, strVec_t> &inputMultiVarsMap,hid_t ctrackDset, hid_t atrackDset)
+{
+	if (inputArgs.GetUseSinglePrecision())
+		return af_GenerateOutputCumulative_ModisAsTrg<float>(inputArgs, outputFile, srcFile, trgCellNum, inputMultiVarsMap, ctrackDset, atrackDset);
+	return af_GenerateOutputCumulative_ModisAsTrg<double>(inputArgs, outputFile, srcFile, trgCellNum, inputMultiVarsMap, ctrackDset, atrackDset);
+}
+
 
 
 /*#############################################################################
@@ -445,8 +454,8 @@ int af_GenerateOutputCumulative_ModisAsTrg(AF_InputParmeterFile &inputArgs, hid_
  *	- Fail : FAILED  (defined in AF_common.h)
  *
  * NOTE:
- *	- TODO: if radiance data becomes all float internally, use float directly
- *	  without converting via HDF5
+ *	- T_IN is float in single precision mode (USE_SINGLE_PRECISION), so the
+ *	  data is written without converting via HDF5
  */
 // T_IN : input data type
 // T_OUT : output data type
@@ -644,6 +653,10 @@ static int af_WriteSingleRadiance_ModisAsSrc(AF_InputParmeterFile &inputArgs,hid
 			std::string resample_method_value = "Summary Interpolation";
 			if(inputArgs.GetResampleMethod()=="nnInterpolate")
 				resample_method_value = "Nearest Neighbor Interpolation";
+			else if(inputArgs.GetResampleMethod()=="idwInterpolate")
+				resample_method_value = "Inverse Distance Weighted Interpolation";
+			else if(inputArgs.GetResampleMethod()=="footprintInterpolate")
+				resample_method_value = "Footprint Interpolation";
 
 			if(H5LTset_attribute_string(outputFile,dsetPath.c_str(),"resample_method",resample_method_value.c_str())<0) {
 				H5Dclose(modis_dataset);
@@ -745,6 +758,9 @@ static int af_WriteSingleRadiance_ModisAsSrc(AF_InputParmeterFile &inputArgs,hid
  *	- inputArgs : a class object contains all the user input parameter info
  *	- outputFile : HDF5 id for output file
  *	- targetNNsrcID : got from nearestNeighborBlockIndex()
+ *	- targetNNWeights : got from idwWeights() for idwInterpolate, NULL
+ *	- targetFootprint : got from queryRadiusNNIndex() for footprintInterpolate, NULL
+ *	  otherwise
  *	- trgCellNumNoShift : number of target instrument data cells before
  *	  applying shift (if MISR is target)
  *	- srcFile : HDF5 id for input file
@@ -756,7 +772,8 @@ static int af_WriteSingleRadiance_ModisAsSrc(AF_InputParmeterFile &inputArgs,hid
  *	- Success: SUCCEED	(defined in AF_common.h)
  *	- Fail : FAILED  (defined in AF_common.h)
  */
-int af_GenerateOutputCumulative_ModisAsSrc(AF_InputParmeterFile &inputArgs, hid_t outputFile, int *targetNNsrcID,  int trgCellNumNoShift, hid_t srcFile, int srcCellNum, std::map<std::string, strVec_t> &inputMultiVarsMap,hid_t ctrackDset, hid_t atrackDset)
+template <typename T>
+static int af_GenerateOutputCumulative_ModisAsSrc(AF_InputParmeterFile &inputArgs, hid_t outputFile, int *targetNNsrcID, float *targetNNWeights, struct SummaryIndex *targetFootprint, int trgCellNumNoShift, hid_t srcFile, long long srcCellNum, std::map<std::string, strVec_t> &inputMultiVarsMap,hid_t ctrackDset, hid_t atrackDset)
 {
 	#if DEBUG_TOOL
 	std::cout << "DBG_TOOL " << __FUNCTION__ << "> BEGIN \n";
@@ -784,7 +801,7 @@ int af_GenerateOutputCumulative_ModisAsSrc(AF_InputParmeterFile &inputArgs, hid_
 			break;
 	}
 	// data type
-	hid_t modisDatatype = H5Tcopy(H5T_NATIVE_DOUBLE);
+	hid_t modisDatatype = H5Tcopy(std::is_same<T, float>::value ? H5T_NATIVE_FLOAT : H5T_NATIVE_DOUBLE);
 	herr_t	status = H5Tset_order(modisDatatype, H5T_ORDER_LE);
 	if(status < 0) {
 		printf("Error: MODIS write error in H5Tset_order\n");
@@ -823,118 +840,130 @@ int af_GenerateOutputCumulative_ModisAsSrc(AF_InputParmeterFile &inputArgs, hid_
 	std::cout << "DBG_TOOL " << __FUNCTION__ << "> srcOutputWidth: " << srcOutputWidth <<  "\n";
 	#endif
 	int numCells;
-	double *modisSingleData=NULL;
+	T *modisSingleData=NULL;
 
 	std::vector<std::string> singleBandVec;
 	//-----------------------------------------------------------------
+	// Every resample method is a resampling operator built once below. A batch
+	// of bands is read and resampled in one pass over the operator.
+	std::string resampleMethod =  inputArgs.GetResampleMethod();
+	int batchSize = af_GetMultiBandBatchSize(srcCellNum, trgCellNumNoShift, bands.size());
+	std::vector<T *> modisBatchData(batchSize, (T *) NULL);
+	std::vector<T *> srcBatchProcessedData(batchSize, (T *) NULL);
+	//-----------------------------------------------------------------
 	// TODO: improve by preparing these memory allocation out of loop
-	// srcProcessedData , nsrcPixels
+	// srcProcessedData
 	// modisSingleData
-	double * srcProcessedData = NULL;
-	int * nsrcPixels = NULL;
+	T * srcProcessedData = NULL;
+	// summaryInterpolate: list the source cells of each target cell once, then every band is a gather per target cell.
+	// nnInterpolate and idwInterpolate use the neighbor IDs (and weights) as they are.
+	// footprintInterpolate already has the lists.
+	struct SummaryIndex * summaryIndex = targetFootprint;
+	if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "summaryInterpolate")) {
+		summaryIndex = buildSummaryIndex(targetNNsrcID, srcCellNum, trgCellNumNoShift);
+	}
+	else if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "nnInterpolate")) {
+		summaryIndex = nnSummaryIndex(targetNNsrcID, srcCellNum, trgCellNumNoShift);
+	}
+	else if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "idwInterpolate")) {
+		summaryIndex = idwSummaryIndex(targetNNsrcID, targetNNWeights, inputArgs.GetIDW_Neighbors(), srcCellNum, trgCellNumNoShift);
+	}
 	// Note: This is Combination case only
-	for (int i=0; i< bands.size(); i++) {
-		#if DEBUG_TOOL
-		std::cout << "DBG_TOOL " << __FUNCTION__ << "> bands[" << i << "]" << bands[i] << "\n";
-		#endif
-		// insert to only begin
-		singleBandVec.insert(singleBandVec.begin(), bands[i]);
+	for (int batchBegin = 0; batchBegin < bands.size(); batchBegin += batchSize) {
+		int nBatch = std::min(batchSize, (int) bands.size() - batchBegin);
+		for (int k = 0; k < nBatch; k++) {
+			int i = batchBegin + k;
+			#if DEBUG_TOOL
+			std::cout << "DBG_TOOL " << __FUNCTION__ << "> bands[" << i << "]" << bands[i] << "\n";
+			#endif
+			// insert to only begin
+			singleBandVec.insert(singleBandVec.begin(), bands[i]);
 
-		//---------------------------------
-		// read src band from BF file
-		#if DEBUG_ELAPSE_TIME
-		StartElapseTime();
-		#endif
-		modisSingleData = get_modis_rad(srcFile, (char*)modisResolution.c_str(), singleBandVec, 1, &numCells);
-		if (modisSingleData == NULL) {
-			std::cerr << __FUNCTION__ <<  "> Error: failed to get MODIS band.\n";
-			return FAILED;
+			//---------------------------------
+			// read src band from BF file
+			#if DEBUG_ELAPSE_TIME
+			StartElapseTime();
+			#endif
+			modisBatchData[k] = get_modis_rad_as<T>(srcFile, (char*)modisResolution.c_str(), singleBandVec, 1, &numCells);
+			if (modisBatchData[k] == NULL) {
+				std::cerr << __FUNCTION__ <<  "> Error: failed to get MODIS band.\n";
+				return FAILED;
+			}
+			#if DEBUG_TOOL
+			std::cout << "DBG_TOOL " << __FUNCTION__ << "> numCells: " << numCells << "\n";
+			#endif
+			#if DEBUG_ELAPSE_TIME
+			StopElapseTimeAndShow("DBG_TIME> Read source MODIS single band data	DONE.");
+			#endif
+			// Note: resample should be done with trgCellNumNoShift
+			srcBatchProcessedData[k] = new T [trgCellNumNoShift];
+			std::cout << "Interpolating with '" << resampleMethod << "' method on " << inputArgs.GetSourceInstrument() << " by " << bands[i] << ".\n";
 		}
-		#if DEBUG_TOOL
-		std::cout << "DBG_TOOL " << __FUNCTION__ << "> numCells: " << numCells << "\n";
-		#endif
-		#if DEBUG_ELAPSE_TIME
-		StopElapseTimeAndShow("DBG_TIME> Read source MODIS single band data	DONE.");
-		#endif
 
 		//-------------------------------------------------
 		// handle resample method
-		srcProcessedData = new double [trgCellNumNoShift];
-		// Note: resample should be done with trgCellNumNoShift
-		//Interpolating
-		std::string resampleMethod =  inputArgs.GetResampleMethod();
-		std::cout << "Interpolating with '" << resampleMethod << "' method on " << inputArgs.GetSourceInstrument() << " by " << bands[i] << ".\n";
 		#if DEBUG_ELAPSE_TIME
 		StartElapseTime();
 		#endif
-		if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "nnInterpolate")) {
-			nnInterpolate(modisSingleData, srcProcessedData, targetNNsrcID, trgCellNumNoShift);
-		}
-		else if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "summaryInterpolate")) {
-			nsrcPixels = new int [trgCellNumNoShift];
-			summaryInterpolate(modisSingleData, targetNNsrcID, srcCellNum, srcProcessedData, NULL, nsrcPixels, trgCellNumNoShift);
-			#if 0 // DEBUG_TOOL
-			std::cout << "DBG_TOOL> No nodata values: \n";
-			for(int i = 0; i < trgCellNumNoShift; i++) {
-				if(nsrcPixels[i] > 0) {
-					printf("%d,\t%lf\n", nsrcPixels[i], srcProcessedData[i]);
-				}
-			}
-			#endif
-		}
+		resampleMultiBand(&modisBatchData[0], summaryIndex, &srcBatchProcessedData[0], NULL, NULL, nBatch);
 		#if DEBUG_ELAPSE_TIME
-		StopElapseTimeAndShow("DBG> nnInterpolate  DONE.");
+		StopElapseTimeAndShow("DBG> resample  DONE.");
 		#endif
 
+		for (int k = 0; k < nBatch; k++) {
+			int i = batchBegin + k;
+			modisSingleData = modisBatchData[k];
+			srcProcessedData = srcBatchProcessedData[k];
+
+			//-----------------------------------------------------------------------
+			// check if need to shift by MISR (shift==ON & target) case before writing
+			T * srcProcessedDataShifted = NULL;
+			T * srcProcessedDataPtr = NULL;
+			if(inputArgs.GetMISR_Shift() == "ON" && inputArgs.GetTargetInstrument() == MISR_STR) {
+				std::cout << "\nSource MODIS radiance MISR-base shifting...\n";
+				#if DEBUG_ELAPSE_TIME
+				StartElapseTime();
+				#endif
+				srcProcessedDataShifted = new T [widthShifted * heightShifted];
+				MISRBlockOffset<T>(srcProcessedData, srcProcessedDataShifted, (inputArgs.GetMISR_Resolution() == "L") ? 0 : 1);
+				#if DEBUG_ELAPSE_TIME
+				StopElapseTimeAndShow("DBG_TIME> source MODIS radiance MISR-base shift DONE.");
+				#endif
+
+				srcProcessedDataPtr = srcProcessedDataShifted;
+				numCells = widthShifted * heightShifted;
+			}
+			else { // no misr-trg shift
+				srcProcessedDataPtr = srcProcessedData;
+				numCells = trgCellNum;
+			}
 
-		//-----------------------------------------------------------------------
-		// check if need to shift by MISR (shift==ON & target) case before writing
-		double * srcProcessedDataShifted = NULL;
-		double * srcProcessedDataPtr = NULL;
-		if(inputArgs.GetMISR_Shift() == "ON" && inputArgs.GetTargetInstrument() == MISR_STR) {
-			std::cout << "\nSource MODIS radiance MISR-base shifting...\n";
+			//---------------------------------
+			// write src band to AF file
 			#if DEBUG_ELAPSE_TIME
 			StartElapseTime();
 			#endif
-			srcProcessedDataShifted = new double [widthShifted * heightShifted];
-			MISRBlockOffset<double>(srcProcessedData, srcProcessedDataShifted, (inputArgs.GetMISR_Resolution() == "L") ? 0 : 1);
+			ret = af_WriteSingleRadiance_ModisAsSrc<T, float>(inputArgs,outputFile, modisDatatype, modisDataspace,  srcProcessedDataPtr, numCells /*processed size*/, srcOutputWidth, i /*bandIdx*/,has_refsb/*radiance has refSB*/,bands,ctrackDset,atrackDset,bandDset);
+			if (ret == FAILED) {
+				std::cerr << __FUNCTION__ << "> Error: returned fail.\n";
+			}
 			#if DEBUG_ELAPSE_TIME
-			StopElapseTimeAndShow("DBG_TIME> source MODIS radiance MISR-base shift DONE.");
+			StopElapseTimeAndShow("DBG_TIME> Write source MODIS single band data  DONE.");
 			#endif
-
-			srcProcessedDataPtr = srcProcessedDataShifted;
-			numCells = widthShifted * heightShifted;
-		}
-		else { // no misr-trg shift
-			srcProcessedDataPtr = srcProcessedData;
-			numCells = trgCellNum;
-		}
-
-		//---------------------------------
-		// write src band to AF file
-		#if DEBUG_ELAPSE_TIME
-		StartElapseTime();
-		#endif
-		ret = af_WriteSingleRadiance_ModisAsSrc<double, float>(inputArgs,outputFile, modisDatatype, modisDataspace,  srcProcessedDataPtr, numCells /*processed size*/, srcOutputWidth, i /*bandIdx*/,has_refsb/*radiance has refSB*/,bands,ctrackDset,atrackDset,bandDset);
-		if (ret == FAILED) {
-			std::cerr << __FUNCTION__ << "> Error: returned fail.\n";
+			//
+			// TODO: buffer is not reused. make memory allocation out of get_modis_rad_as<T>() to improve performance
+
+			// free memory
+			if (modisSingleData)
+				free(modisSingleData);
+			if(srcProcessedData)
+				delete [] srcProcessedData;
+			if(srcProcessedDataShifted)
+				delete [] srcProcessedDataShifted;
 		}
-		#if DEBUG_ELAPSE_TIME
-		StopElapseTimeAndShow("DBG_TIME> Write source MODIS single band data  DONE.");
-		#endif
-		//
-		// TODO: buffer is not reused. make memory allocation out of get_modis_rad() to improve performance
-
-		// free memory
-		if (modisSingleData)
-			free(modisSingleData);
-		if(srcProcessedData)
-			delete [] srcProcessedData;
-		if (nsrcPixels)
-			delete [] nsrcPixels;
-		if(srcProcessedDataShifted)
-			delete [] srcProcessedDataShifted;
-	} // i loop
+	} // batch loop
+	if (summaryIndex != targetFootprint)
+		freeSummaryIndex(summaryIndex);
 
 	H5Dclose(bandDset);
 	H5Tclose(modisDatatype);
@@ -947,3 +976,11 @@ int af_GenerateOutputCumulative_ModisAsSrc(AF_InputParmeterFile &inputArgs, hid_
 	return ret;
 }
 
+// T is float in single precision mode (USE_SINGLE_PRECISION), double otherwise
+int af_GenerateOutputCumulative_ModisAsSrc(AF_InputParmeterFile &inputArgs, hid_t outputFile, int *targetNNsrcID, float *targetNNWeights, struct SummaryIndex *targetFootprint, int trgCellNumNoShift, hid_t srcFile, long long srcCellNum, std::map<std::string, strVec_t> &inputMultiVarsMap,hid_t ctrackDset, hid_t atrackDset)
+{
+	if (inputArgs.GetUseSinglePrecision())
+		return af_GenerateOutputCumulative_ModisAsSrc<float>(inputArgs, outputFile, targetNNsrcID, targetNNWeights, targetFootprint, trgCellNumNoShift, srcFile, srcCellNum, inputMultiVarsMap, ctrackDset, atrackDset);
+	return af_GenerateOutputCumulative_ModisAsSrc<double>(inputArgs, outputFile, targetNNsrcID, targetNNWeights, targetFootprint, trgCellNumNoShift, srcFile, srcCellNum, inputMultiVarsMap, ctrackDset, atrackDset);
+}
+
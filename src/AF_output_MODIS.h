@@ -11,6 +11,7 @@
  */
 
 #include "AF_InputParmeterFile.h"
+#include "reproject.h"
 #include <hdf5.h>
 #include <hdf5_hl.h>
 
@@ -18,7 +19,7 @@
 int af_GenerateOutputCumulative_ModisAsTrg(AF_InputParmeterFile &inputArgs, hid_t outputFile,hid_t srcFile, int trgCellNum, std::map<std::string, strVec_t> &inputMultiVarsMap,hid_t ctrackDset, hid_t atrackDset);
 
 //  MODIS as Source instrument, generate radiance data
-int af_GenerateOutputCumulative_ModisAsSrc(AF_InputParmeterFile &inputArgs, hid_t outputFile, int *targetNNsrcID,  int trgCellNumNoShift, hid_t srcFile, int srcCellNum, std::map<std::string, strVec_t> &inputMultiVarsMap,hid_t ctrackDset, hid_t atrackDset);
+int af_GenerateOutputCumulative_ModisAsSrc(AF_InputParmeterFile &inputArgs, hid_t outputFile, int *targetNNsrcID, float *targetNNWeights, struct SummaryIndex *targetFootprint, int trgCellNumNoShift, hid_t srcFile, long long srcCellNum, std::map<std::string, strVec_t> &inputMultiVarsMap,hid_t ctrackDset, hid_t atrackDset);
 
 
 #endif // _AF_OUTPUT_MODIS_H_
@@ -87,6 +87,28 @@ int af_GetWidthAndHeightForOutputDataSize(std::string instrument, AF_InputParmet
 	return 0;
 }
 
+/*=====================================
+ * Get number of bands (or camera/radiance pairs) to read and resample
+ * together, within AF_MULTIBAND_MEMORY_BUDGET
+ *
+ * RETURN:
+ *  number of bands per batch, between 1 and nBands
+ */
+int af_GetMultiBandBatchSize(long long srcCellNum, int trgCellNum, int nBands)
+{
+	// a source band and its resampled band, both in double
+	long long bandBytes = (srcCellNum + trgCellNum) * sizeof(double);
+	long long batchSize = (bandBytes > 0) ? AF_MULTIBAND_MEMORY_BUDGET / bandBytes : nBands;
+	if (batchSize > nBands)
+		batchSize = nBands;
+	if (batchSize < 1)
+		batchSize = 1;
+	#if DEBUG_TOOL
+	std::cout << "DBG_TOOL " << __FUNCTION__ << "> bands per batch: " << batchSize << "\n";
+	#endif
+	return (int) batchSize;
+}
+
 std::string get_gtiff_fname(AF_InputParmeterFile &inputArgs,int camera_index,int band_index) {
 	
 	std::string err_fname ="";
@@ -26,6 +26,26 @@
  *						If 0, caller should not use this.
  */
 int af_GetWidthAndHeightForOutputDataSize(std::string instrument, AF_InputParmeterFile &inputArgs, int &crossTrackWidth /*OUT*/, int &alongTrackHeight /*OUT*/);
+/*=====================================
+ * Memory budget (bytes) for source and resampled data of the bands
+ * which are resampled together by nnInterpolateMultiBand()
+ */
+const long long AF_MULTIBAND_MEMORY_BUDGET = 2LL * 1024 * 1024 * 1024;
+
+/*=====================================
+ * Get number of bands (or camera/radiance pairs) to read and resample
+ * together, within AF_MULTIBAND_MEMORY_BUDGET
+ *
+ * PARAMETER:
+ * - srcCellNum : number of source instrument cells of a band
+ * - trgCellNum : number of target instrument cells (not shifted)
+ * - nBands : total number of bands
+ *
+ * RETURN:
+ *  number of bands per batch, between 1 and nBands
+ */
+int af_GetMultiBandBatchSize(long long srcCellNum, int trgCellNum, int nBands);
+
 std::string get_gtiff_fname(AF_InputParmeterFile &inputArgs,int camera_index,int band_index); 
 	
 
@@ -19,6 +19,7 @@
 #include <algorithm>
 #include <stdlib.h>
 #include <stdio.h>
+#include <limits.h>
 #include <sys/time.h>
 #include <vector>
 #include <sstream>
@@ -34,6 +35,7 @@
 #include "AF_output_MODIS.h"
 #include "AF_output_MISR.h"
 #include "AF_output_ASTER.h"
+#include "AF_nn_cache.h"
 
 
 void Usage(int &argc, char *argv[])
@@ -59,18 +61,19 @@ void Usage(int &argc, char *argv[])
  *  - inputFile : HDF5 id for input file
  *  - latitude : retrived latitude data
  *  - longitude : retrived longitude data
- *  - cellNum : retrived number of total cells
+ *  - cellNum : retrived number of total cells (ASTER can exceed the int range)
  *
  * RETURN:
  *  - Success: SUCCEED  (defined in AF_common.h)
  *  - Fail : FAILED  (defined in AF_common.h)
  *
  */
-int AF_GetGeolocationDataFromInstrument(std::string instrument, AF_InputParmeterFile &inputArgs, hid_t inputFile, double **latitude /*OUT*/, double **longitude /*OUT*/, int &cellNum /*OUT*/)
+int AF_GetGeolocationDataFromInstrument(std::string instrument, AF_InputParmeterFile &inputArgs, hid_t inputFile, double **latitude /*OUT*/, double **longitude /*OUT*/, long long &cellNum /*OUT*/)
 {
 	#if DEBUG_TOOL
 	std::cout << "DBG_TOOL " << __FUNCTION__ << "> BEGIN \n";
 	#endif
+	int intCellNum = 0;  // for the readers of int cell number
 
 	/*======================================================
  	 * MODIS section
@@ -80,16 +83,17 @@ int AF_GetGeolocationDataFromInstrument(std::string instrument, AF_InputParmeter
 		#if DEBUG_TOOL
 		std::cout << "DBG_TOOL " << __FUNCTION__ << "> Modis resolution: " << resolution << "\n";
 		#endif
-		*latitude = get_modis_lat(inputFile, (char*) resolution.c_str(), &cellNum);
+		*latitude = get_modis_lat(inputFile, (char*) resolution.c_str(), &intCellNum);
 		if (*latitude == NULL) {
 			std::cerr << __FUNCTION__ <<  "> Error: failed to get MODIS latitude.\n";
 			return FAILED;
 		}
-		*longitude = get_modis_long(inputFile, (char*) resolution.c_str(), &cellNum);
+		*longitude = get_modis_long(inputFile, (char*) resolution.c_str(), &intCellNum);
 		if (*longitude == NULL) {
 			std::cerr << __FUNCTION__ <<  "> Error: failed to get MODIS longitude.\n";
 			return FAILED;
 		}
+		cellNum = intCellNum;
 	}
 	/*======================================================
  	 * MISR section
@@ -99,16 +103,17 @@ int AF_GetGeolocationDataFromInstrument(std::string instrument, AF_InputParmeter
 		#if DEBUG_TOOL
 		std::cout << "DBG_TOOL " << __FUNCTION__ << "> Misr resolution: " << resolution << "\n";
 		#endif
-		*latitude = get_misr_lat(inputFile, (char*) resolution.c_str(), &cellNum);
+		*latitude = get_misr_lat(inputFile, (char*) resolution.c_str(), &intCellNum);
 		if (*latitude == NULL) {
 			std::cerr << __FUNCTION__ <<  "> Error: failed to get MISR latitude.\n";
 			return FAILED;
 		}
-		*longitude = get_misr_long(inputFile, (char*) resolution.c_str(), &cellNum);
+		*longitude = get_misr_long(inputFile, (char*) resolution.c_str(), &intCellNum);
 		if (*longitude == NULL) {
 			std::cerr << __FUNCTION__ <<  "> Error: failed to get MISR longitude.\n";
 			return FAILED;
 		}
+		cellNum = intCellNum;
 
 	}
 	/*======================================================
@@ -119,6 +124,7 @@ int AF_GetGeolocationDataFromInstrument(std::string instrument, AF_InputParmeter
 		std::string resolution = inputArgs.GetASTER_Resolution();
 		strVec_t bands = inputArgs.GetASTER_Bands();
 		// pass the first band (bands[0]) as it always exists and lat&lon is the same for a resolution.
+		// full orbit of ASTER can have more than 2 billion cells, so use long long cellNum directly.
 		*latitude = get_ast_lat(inputFile, (char*) resolution.c_str(), (char*)bands[0].c_str(), &cellNum);
 		if (*latitude == NULL) {
 			std::cerr << __FUNCTION__ <<  "> Error: failed to get ASTER latitude.\n";
@@ -171,6 +177,110 @@ int AF_GetGeolocationDataFromInstrument(std::string instrument, AF_InputParmeter
 
 
 
+/*=============================================================================
+ * DESCRIPTION:
+ *   Build the nearest neighbor spatial index of source cells selected by
+ *   NN_SPATIAL_INDEX (GRID, KDTREE or GRID_SWATH).
+ *   Input geolocation is not changed, so the index can serve several
+ *   targets, and the geolocation can be used again after the search.
+ *   Only source cells within maxR of the region of the query cells are
+ *   indexed (ex: ASTER scenes cover a small part of a MODIS granule),
+ *   which gives the same search results with less memory and time.
+ *   Query cells are searched in the order selected by NN_QUERY_ORDER
+ *   (STORAGE, MORTON or HILBERT), and approximately if NN_APPROX_ERROR
+ *   is set.
+ *
+ * PARAMETER:
+ *  - souLat, souLon : source cell geolocation, nSou items
+ *  - tarLat, tarLon : query cell geolocation, nTar items
+ *  - maxR : the maximum distance (in meters) to define neighboring cells
+ *
+ * RETURN:
+ *  index to query with queryNNIndex() and release with freeNNIndex()
+ */
+struct NNIndex * AF_BuildNNIndex(AF_InputParmeterFile &inputArgs, const double *souLat, const double *souLon, int nSou, const double *tarLat, const double *tarLon, long long nTar, double maxR)
+{
+	int indexType = NN_INDEX_GRID;
+	if (inputArgs.CompareStrCaseInsensitive(inputArgs.GetNNSpatialIndex(), "KDTREE")) {
+		std::cout << "Using k-d tree spatial index.\n";
+		indexType = NN_INDEX_KDTREE;
+	}
+	else if (inputArgs.CompareStrCaseInsensitive(inputArgs.GetNNSpatialIndex(), "GRID_SWATH")) {
+		std::cout << "Using swath-seeded block index.\n";
+		indexType = NN_INDEX_GRID_SWATH;
+	}
+	else if (inputArgs.CompareStrCaseInsensitive(inputArgs.GetNNSpatialIndex(), "DUAL_GRID")) {
+		std::cout << "Using block index joined with tiles of query cells.\n";
+		indexType = NN_INDEX_DUAL_GRID;
+	}
+	struct LatLonRegion tarRegion;
+	latLonRegion(tarLat, tarLon, nTar, maxR, &tarRegion);
+	#if DEBUG_TOOL
+	std::cout << "DBG_TOOL " << __FUNCTION__ << "> query region lat: " << tarRegion.latMin << " ~ " << tarRegion.latMax << ", lon: " << tarRegion.lonWest << " + " << tarRegion.lonWidth << "\n";
+	#endif
+	struct NNIndex * nnIndex = buildNNIndexInRegion(souLat, souLon, nSou, maxR, indexType, &tarRegion);
+	if (inputArgs.GetNNApproxError() > 0) {
+		std::cout << "Using approximate nearest neighbor search within " << inputArgs.GetNNApproxError() * 100 << "% of the nearest distance.\n";
+		setNNIndexApproximation(nnIndex, inputArgs.GetNNApproxError());
+	}
+	if (inputArgs.CompareStrCaseInsensitive(inputArgs.GetNNQueryOrder(), "MORTON")) {
+		std::cout << "Querying in Morton curve order.\n";
+		setNNIndexQueryOrder(nnIndex, NN_QUERY_ORDER_MORTON);
+	}
+	else if (inputArgs.CompareStrCaseInsensitive(inputArgs.GetNNQueryOrder(), "HILBERT")) {
+		std::cout << "Querying in Hilbert curve order.\n";
+		setNNIndexQueryOrder(nnIndex, NN_QUERY_ORDER_HILBERT);
+	}
+	return nnIndex;
+}
+
+
+/*=============================================================================
+ * DESCRIPTION:
+ *   Give each indexed cell its own search radius when the pixel size of the
+ *   indexed instrument varies across the swath (MODIS grows with the scan
+ *   angle), so cells near nadir are not searched with the radius of the
+ *   swath edges. Indexed cells are stored scan line by scan line. Only with
+ *   NN_CROSS_TRACK_RADIUS set.
+ *
+ * PARAMETER:
+ *  - nnIndex : index built by AF_BuildNNIndex()
+ *  - instrument : instrument of the indexed cells
+ */
+void AF_SetNNCellRadius(AF_InputParmeterFile &inputArgs, struct NNIndex *nnIndex, const std::string &instrument)
+{
+	std::vector<double> crossTrackRadius = inputArgs.GetCrossTrackRadiusForNNeighborFunc(instrument);
+	if (crossTrackRadius.empty())
+		return;
+	std::cout << "Using " << instrument << " search radius from " << crossTrackRadius[crossTrackRadius.size() / 2] << " (nadir) to "
+	          << crossTrackRadius[0] << " (swath edges) meters.\n";
+	setNNIndexCellRadius(nnIndex, &crossTrackRadius[0], (int) crossTrackRadius.size());
+}
+
+
+/*=============================================================================
+ * DESCRIPTION:
+ *   Report the distance error of approximate nearest neighbor search
+ *   (NN_APPROX_ERROR), measured on a sample of the query cells by also
+ *   searching them exactly.
+ *
+ * PARAMETER:
+ *  - nnIndex : index built by AF_BuildNNIndex()
+ *  - tarLat, tarLon : query cell geolocation, nTar items
+ */
+void AF_ReportNNApproximation(AF_InputParmeterFile &inputArgs, const struct NNIndex *nnIndex, const double *tarLat, const double *tarLon, long long nTar)
+{
+	if (inputArgs.GetNNApproxError() <= 0)
+		return;
+	const long long nSample = 10000;
+	double maxError, meanError;
+	long long nChecked = approximateNNError(nnIndex, tarLat, tarLon, nTar, nSample, &maxError, &meanError);
+	std::cout << "Approximate nearest neighbor distance error on " << nChecked << " sampled cells: max " << maxError * 100 << "%, mean "
+	          << meanError * 100 << "% (allowed " << inputArgs.GetNNApproxError() * 100 << "%).\n";
+}
+
+
+
 /*=============================================================================
  * DESCRIPTION:
  *   Generate Target instrument radiance data to output file
@@ -297,6 +407,11 @@ int   AF_GenerateTargetRadiancesOutput(AF_InputParmeterFile &inputArgs, hid_t ou
  *  - inputArgs : a class object contains all the user input parameter info
  *  - outputFile : HDF5 id for output file
  *  - targetNNsrcID : got from nearestNeighborBlockIndex()
+ *  - targetNNWeights : inverse distance weights from idwWeights() for the
+ *    idwInterpolate method (IDW_NEIGHBORS items per target cell). NULL otherwise.
+ *  - targetFootprint : source cells within the footprint of each target cell
+ *    from queryRadiusNNIndex() for the footprintInterpolate method, or weighted
+ *    source cells from queryPSFNNIndex() for the psfInterpolate method. NULL otherwise.
  *  - trgCellNum : number of total cells of target instrument data
  *  - srcFile : HDF5 id for input file
  *  - srcInputMultiVarsMap :  user input parameter directives which allows
@@ -307,7 +422,7 @@ int   AF_GenerateTargetRadiancesOutput(AF_InputParmeterFile &inputArgs, hid_t ou
  *  - Fail : FAILED  (defined in AF_common.h)
  *
  */
-int   AF_GenerateSourceRadiancesOutput(AF_InputParmeterFile &inputArgs, hid_t outputFile, int * targetNNsrcID, int trgCellNum, hid_t srcFile, int srcCellNum, std::map<std::string, strVec_t> & srcInputMultiVarsMap,hid_t ctrackDset,hid_t atrackDset)
+int   AF_GenerateSourceRadiancesOutput(AF_InputParmeterFile &inputArgs, hid_t outputFile, int * targetNNsrcID, float * targetNNWeights, struct SummaryIndex * targetFootprint, int trgCellNum, hid_t srcFile, long long srcCellNum, std::map<std::string, strVec_t> & srcInputMultiVarsMap,hid_t ctrackDset,hid_t atrackDset)
 {
 	#if DEBUG_TOOL
 	std::cout << "DBG_TOOL " << __FUNCTION__ << "> BEGIN \n";
@@ -358,7 +473,7 @@ int   AF_GenerateSourceRadiancesOutput(AF_InputParmeterFile &inputArgs, hid_t ou
 			return FAILED;
 		}
 
-		ret = af_GenerateOutputCumulative_ModisAsSrc(inputArgs, outputFile, targetNNsrcID,  trgCellNum, srcFile, srcCellNum, srcInputMultiVarsMap,ctrackDset,atrackDset);
+		ret = af_GenerateOutputCumulative_ModisAsSrc(inputArgs, outputFile, targetNNsrcID, targetNNWeights, targetFootprint, trgCellNum, srcFile, srcCellNum, srcInputMultiVarsMap,ctrackDset,atrackDset);
 		if (ret == FAILED) {
 			std::cout << __FUNCTION__ << ":" << __LINE__ <<  "> failed generating output for MODIS.\n";
 			ret = FAILED;
@@ -376,7 +491,7 @@ int   AF_GenerateSourceRadiancesOutput(AF_InputParmeterFile &inputArgs, hid_t ou
 			goto done;
 		}
 
-		ret = af_GenerateOutputCumulative_MisrAsSrc(inputArgs, outputFile, targetNNsrcID,  trgCellNum, srcFile, srcCellNum, srcInputMultiVarsMap,ctrackDset,atrackDset);
+		ret = af_GenerateOutputCumulative_MisrAsSrc(inputArgs, outputFile, targetNNsrcID, targetNNWeights, targetFootprint, trgCellNum, srcFile, srcCellNum, srcInputMultiVarsMap,ctrackDset,atrackDset);
 		if (ret == FAILED) {
 			std::cout << __FUNCTION__ << ":" << __LINE__ <<  "> failed generating output for MISR.\n";
 			ret = FAILED;
@@ -393,7 +508,7 @@ int   AF_GenerateSourceRadiancesOutput(AF_InputParmeterFile &inputArgs, hid_t ou
 			return FAILED;
 		}
 
-		ret = af_GenerateOutputCumulative_AsterAsSrc(inputArgs, outputFile, targetNNsrcID,  trgCellNum, srcFile, srcCellNum, srcInputMultiVarsMap,ctrackDset,atrackDset);
+		ret = af_GenerateOutputCumulative_AsterAsSrc(inputArgs, outputFile, targetNNsrcID, targetFootprint, trgCellNum, srcFile, srcCellNum, srcInputMultiVarsMap,ctrackDset,atrackDset);
 		if (ret == FAILED) {
 			std::cout << __FUNCTION__ << ":" << __LINE__ <<  "> failed generating output for ASTER.\n";
 			ret = FAILED;
@@ -623,25 +738,53 @@ int main(int argc, char *argv[])
 		H5Fclose(inputFile);
 		H5Fclose(output_file);
 	}  
+	/* ===================================================
+	 * Look up nearest neighbor mapping cache
+	 * If found, source geolocation is not needed at all.
+	 */
+	AF_NNCache_t nnCache;
+	bool nnCacheHit = false;
+	// footprintInterpolate and psfInterpolate keep lists of source cells, which are cached as a resampling operator
+	bool keepsSourceLists = inputArgs.CompareStrCaseInsensitive(inputArgs.GetResampleMethod(), "footprintInterpolate") ||
+	                        inputArgs.CompareStrCaseInsensitive(inputArgs.GetResampleMethod(), "psfInterpolate");
+	struct SummaryIndex * targetFootprint = NULL;  // only for footprintInterpolate and psfInterpolate
+	long long opCacheSrcCellNum = 0;
+	int opCacheTrgCellNum = 0;
+	if (!inputArgs.GetNNCacheDir().empty() && !keepsSourceLists) {
+		std::cout << "\nLooking up nearest neighbor mapping cache...\n";
+		nnCacheHit = (af_LoadNNCache(inputArgs, nnCache) == SUCCEED);
+		std::cout << (nnCacheHit ? "Using cached nearest neighbor mapping.\n" : "No cached nearest neighbor mapping found.\n");
+	}
+	else if (!inputArgs.GetNNCacheDir().empty()) {
+		std::cout << "\nLooking up resampling operator cache...\n";
+		nnCacheHit = (af_LoadOperatorCache(inputArgs, &targetFootprint, opCacheSrcCellNum, opCacheTrgCellNum) == SUCCEED);
+		std::cout << (nnCacheHit ? "Using cached resampling operator.\n" : "No cached resampling operator found.\n");
+	}
+
 	/* ===================================================
 	 * Get Source instrument latitude and longitude
 	 */
-	std::cout << "\nGetting source instrument latitude & longitude data...\n";
-	int srcCellNum;
+	long long srcCellNum;
 	double* srcLatitude = NULL;
 	double* srcLongitude = NULL;
-	#if DEBUG_ELAPSE_TIME
-	StartElapseTime();
-	#endif
-	ret = AF_GetGeolocationDataFromInstrument(srcInstrument, inputArgs, inputFile, &srcLatitude /*OUT*/, &srcLongitude /*OUT*/, srcCellNum /*OUT*/);
-	// TODO: error handling: release the allocated memory srcLatitude....
-	if (ret == FAILED) {
-		std::cerr << __FUNCTION__ << "> Error getting geolocation data from source instrument - " << srcInstrument << ".\n";
-		return FAILED;
+	if (nnCacheHit) {
+		srcCellNum = targetFootprint ? opCacheSrcCellNum : nnCache.srcCellNum;
+	}
+	else {
+		std::cout << "\nGetting source instrument latitude & longitude data...\n";
+		#if DEBUG_ELAPSE_TIME
+		StartElapseTime();
+		#endif
+		ret = AF_GetGeolocationDataFromInstrument(srcInstrument, inputArgs, inputFile, &srcLatitude /*OUT*/, &srcLongitude /*OUT*/, srcCellNum /*OUT*/);
+		// TODO: error handling: release the allocated memory srcLatitude....
+		if (ret == FAILED) {
+			std::cerr << __FUNCTION__ << "> Error getting geolocation data from source instrument - " << srcInstrument << ".\n";
+			return FAILED;
+		}
+		#if DEBUG_ELAPSE_TIME
+		StopElapseTimeAndShow("DBG_TIME> get source lat/long DONE.");
+		#endif
 	}
-	#if DEBUG_ELAPSE_TIME
-	StopElapseTimeAndShow("DBG_TIME> get source lat/long DONE.");
-	#endif
 	#if DEBUG_TOOL
 	std::cout << "DBG_TOOL main> srcCellNum: " <<  srcCellNum << "\n";
 	#endif
@@ -652,23 +795,33 @@ int main(int argc, char *argv[])
 	 * Get Target instrument latitude and longitude
 	 */
 	std::cout << "\nGetting target instrument latitude & longitude data...\n";
-	int trgCellNumNoShift;
+	long long trgCellNumAll;
 	double* targetLatitude = NULL;
 	double* targetLongitude = NULL;
 	#if DEBUG_ELAPSE_TIME
 	StartElapseTime();
 	#endif
-	ret = AF_GetGeolocationDataFromInstrument(trgInstrument, inputArgs, inputFile, &targetLatitude /*OUT*/, &targetLongitude /*OUT*/, trgCellNumNoShift /*OUT*/);
+	ret = AF_GetGeolocationDataFromInstrument(trgInstrument, inputArgs, inputFile, &targetLatitude /*OUT*/, &targetLongitude /*OUT*/, trgCellNumAll /*OUT*/);
 	if (ret == FAILED) {
 		std::cerr << __FUNCTION__ << "> Error: getting geolocation data from target instrument - " << trgInstrument << ".\n";
 		return FAILED;
 	}
+	// target cells are kept in int (nearest neighbor IDs and output datasets)
+	if (trgCellNumAll > INT_MAX) {
+		std::cerr << __FUNCTION__ << "> Error: too many target cells - " << trgCellNumAll << ".\n";
+		return FAILED;
+	}
+	int trgCellNumNoShift = (int) trgCellNumAll;
 	#if DEBUG_ELAPSE_TIME
 	StopElapseTimeAndShow("DBG_TIME> get target lat/long DONE.");
 	#endif
 	#if DEBUG_TOOL
 	std::cout << "DBG_TOOL main> trgCellNumNoShift: " <<  trgCellNumNoShift << "\n";
 	#endif
+	if (nnCacheHit && (targetFootprint ? opCacheTrgCellNum : nnCache.trgCellNum) != trgCellNumNoShift) {
+		std::cerr << __FUNCTION__ << "> Error: cached nearest neighbor mapping does not match target cells. Remove " << af_GetNNCacheFilePath(inputArgs) << " and re-run.\n";
+		return FAILED;
+	}
 	
 
 
@@ -822,29 +975,113 @@ int main(int argc, char *argv[])
 	 * Note: use not shifted trgCellNum for this
 	 */
 	int * targetNNsrcID = NULL;
+	double * targetNNsrcDis = NULL;  // distances, only kept for idwInterpolate
+	float * targetNNWeights = NULL;
 	
-	std::cout <<  "\nRunning nearest neighbor block index method... \n";
-	#if DEBUG_ELAPSE_TIME
-	StartElapseTime();
-	#endif
-	std::string resampleMethod =  inputArgs.GetResampleMethod();
-	// source is low and target is similar or high resolution case (ex: MISRtoMODIS and vice versa)
-	if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "nnInterpolate")) {
-		targetNNsrcID = new int [trgCellNumNoShift];
-		double maxRadius = inputArgs.GetMaxRadiusForNNeighborFunc(srcInstrument);
-		nearestNeighborBlockIndex(&srcLatitude, &srcLongitude, srcCellNum, targetLatitude, targetLongitude, targetNNsrcID, NULL, trgCellNumNoShift, maxRadius);
-	} 
-	// source is high and target is low resolution case (ex: ASTERtoMODIS)
-	else if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "summaryInterpolate")) {
-		// when summaryInterpolate is used, need to swap source and target. This is cases for projecting high resolution to low resolution case like ASTER to MODIS
-		targetNNsrcID = new int [srcCellNum];
-		// get it from src instrument of nearestNeighbor point of view, which is switched for this case, thus use target instrument.
-		double maxRadius = inputArgs.GetMaxRadiusForNNeighborFunc(trgInstrument);
-		nearestNeighborBlockIndex(&targetLatitude, &targetLongitude, trgCellNumNoShift, srcLatitude, srcLongitude, targetNNsrcID, NULL, srcCellNum, maxRadius);
+	if (nnCacheHit) {
+		// a cached resampling operator is already in targetFootprint
+		if (!keepsSourceLists) {
+			targetNNsrcID = nnCache.nnIDs;
+			targetNNsrcDis = nnCache.nnDis;
+		}
+	}
+	else {
+		std::cout <<  "\nRunning nearest neighbor method... \n";
+		#if DEBUG_ELAPSE_TIME
+		StartElapseTime();
+		#endif
+		long long nnCellNum = 0;
+		std::string resampleMethod =  inputArgs.GetResampleMethod();
+		// nearest neighbor IDs are int, so the indexed side must fit in int
+		if (!inputArgs.CompareStrCaseInsensitive(resampleMethod, "summaryInterpolate") && srcCellNum > INT_MAX) {
+			std::cerr << __FUNCTION__ << "> Error: too many source cells for " << resampleMethod << " - " << srcCellNum << ".\n";
+			return FAILED;
+		}
+		// source is low and target is similar or high resolution case (ex: MISRtoMODIS and vice versa)
+		if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "nnInterpolate")) {
+			nnCellNum = trgCellNumNoShift;
+			targetNNsrcID = new int [nnCellNum];
+			double maxRadius = inputArgs.GetMaxRadiusForNNeighborFunc(srcInstrument);
+			struct NNIndex * nnIndex = AF_BuildNNIndex(inputArgs, srcLatitude, srcLongitude, (int) srcCellNum, targetLatitude, targetLongitude, trgCellNumNoShift, maxRadius);
+			AF_SetNNCellRadius(inputArgs, nnIndex, srcInstrument);
+			queryNNIndex(nnIndex, targetLatitude, targetLongitude, targetNNsrcID, NULL, trgCellNumNoShift);
+			AF_ReportNNApproximation(inputArgs, nnIndex, targetLatitude, targetLongitude, trgCellNumNoShift);
+			freeNNIndex(nnIndex);
+		} 
+		// source is high and target is low resolution case (ex: ASTERtoMODIS)
+		else if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "summaryInterpolate")) {
+			// when summaryInterpolate is used, need to swap source and target. This is cases for projecting high resolution to low resolution case like ASTER to MODIS
+			nnCellNum = srcCellNum;
+			targetNNsrcID = new int [nnCellNum];
+			// get it from src instrument of nearestNeighbor point of view, which is switched for this case, thus use target instrument.
+			double maxRadius = inputArgs.GetMaxRadiusForNNeighborFunc(trgInstrument);
+			struct NNIndex * nnIndex = AF_BuildNNIndex(inputArgs, targetLatitude, targetLongitude, trgCellNumNoShift, srcLatitude, srcLongitude, srcCellNum, maxRadius);
+			AF_SetNNCellRadius(inputArgs, nnIndex, trgInstrument);
+			queryNNIndex(nnIndex, srcLatitude, srcLongitude, targetNNsrcID, NULL, srcCellNum);
+			AF_ReportNNApproximation(inputArgs, nnIndex, srcLatitude, srcLongitude, srcCellNum);
+			freeNNIndex(nnIndex);
+		}
+		// source is low or similar and target is high resolution case, blending k nearest source cells (ex: MODIStoMISR)
+		else if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "idwInterpolate")) {
+			int neighbors = inputArgs.GetIDW_Neighbors();
+			nnCellNum = (long long)trgCellNumNoShift * neighbors;
+			targetNNsrcID = new int [nnCellNum];
+			targetNNsrcDis = new double [nnCellNum];
+			double maxRadius = inputArgs.GetMaxRadiusForNNeighborFunc(srcInstrument);
+			struct NNIndex * nnIndex = AF_BuildNNIndex(inputArgs, srcLatitude, srcLongitude, (int) srcCellNum, targetLatitude, targetLongitude, trgCellNumNoShift, maxRadius);
+			AF_SetNNCellRadius(inputArgs, nnIndex, srcInstrument);
+			queryKNNIndex(nnIndex, targetLatitude, targetLongitude, neighbors, targetNNsrcID, targetNNsrcDis, trgCellNumNoShift);
+			freeNNIndex(nnIndex);
+		}
+		// all source cells within the footprint of each target cell, so a source cell can count for several target cells (ex: ASTERtoMODIS)
+		else if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "footprintInterpolate")) {
+			double footprintRadius = inputArgs.GetFootprintRadius();
+			std::cout << "Footprint radius: " << footprintRadius << " meters.\n";
+			struct NNIndex * nnIndex = AF_BuildNNIndex(inputArgs, srcLatitude, srcLongitude, (int) srcCellNum, targetLatitude, targetLongitude, trgCellNumNoShift, footprintRadius);
+			targetFootprint = queryRadiusNNIndex(nnIndex, targetLatitude, targetLongitude, footprintRadius, trgCellNumNoShift);
+			freeNNIndex(nnIndex);
+		}
+		// source cells weighted by the point spread function of each MODIS target cell (ex: ASTERtoMODIS, MISRtoMODIS)
+		else if (inputArgs.CompareStrCaseInsensitive(resampleMethod, "psfInterpolate")) {
+			int trgWidth, trgHeight;
+			if (af_GetWidthAndHeightForOutputDataSize(trgInstrument, inputArgs, trgWidth, trgHeight) == FAILED) {
+				std::cerr << __FUNCTION__ << ":" << __LINE__ <<  "> Error in af_GetWidthAndHeightForOutputDataSize() \n";
+				return FAILED;
+			}
+			// the largest support is at the edge of the scan, about the search radius of a target cell there
+			double maxRadius = inputArgs.GetMaxRadiusForNNeighborFunc(trgInstrument);
+			struct NNIndex * nnIndex = AF_BuildNNIndex(inputArgs, srcLatitude, srcLongitude, (int) srcCellNum, targetLatitude, targetLongitude, trgCellNumNoShift, maxRadius);
+			targetFootprint = queryPSFNNIndex(nnIndex, srcLatitude, srcLongitude, targetLatitude, targetLongitude, trgWidth, trgCellNumNoShift);
+			freeNNIndex(nnIndex);
+		}
+		#if DEBUG_ELAPSE_TIME
+		StopElapseTimeAndShow("DBG_TIME> nearest neighbor search DONE.");
+		#endif
+
+		// keep the mapping for re-runs. Failing to write cache is not fatal.
+		if (!inputArgs.GetNNCacheDir().empty() && targetNNsrcID) {
+			if (af_SaveNNCache(inputArgs, targetNNsrcID, targetNNsrcDis, nnCellNum, srcCellNum, trgCellNumNoShift) == FAILED)
+				std::cerr << "Warning: failed to save nearest neighbor mapping cache.\n";
+		}
+		if (!inputArgs.GetNNCacheDir().empty() && targetFootprint) {
+			if (af_SaveOperatorCache(inputArgs, targetFootprint, srcCellNum, trgCellNumNoShift) == FAILED)
+				std::cerr << "Warning: failed to save resampling operator cache.\n";
+		}
+	}
+
+	// inverse distance weights are computed once here and applied to every band and camera
+	if (inputArgs.CompareStrCaseInsensitive(inputArgs.GetResampleMethod(), "idwInterpolate")) {
+		if (targetNNsrcDis == NULL) {
+			std::cerr << __FUNCTION__ << "> Error: no neighbor distances for idwInterpolate. Remove " << af_GetNNCacheFilePath(inputArgs) << " and re-run.\n";
+			return FAILED;
+		}
+		int neighbors = inputArgs.GetIDW_Neighbors();
+		targetNNWeights = new float [(long long)trgCellNumNoShift * neighbors];
+		idwWeights(targetNNsrcID, targetNNsrcDis, targetNNWeights, neighbors, inputArgs.GetIDW_Power(), trgCellNumNoShift);
+		if (!nnCacheHit)
+			delete [] targetNNsrcDis;
+		targetNNsrcDis = NULL;
 	}
-	#if DEBUG_ELAPSE_TIME
-	StopElapseTimeAndShow("DBG_TIME> nearestNeighborBlockIndex DONE.");
-	#endif
 
 	if(srcLatitude)
 		free(srcLatitude);
@@ -891,15 +1128,21 @@ int main(int argc, char *argv[])
 	}
 	// write source instrument radiances to output file
 	// Note: pass not-shifted-trgCellNum as it will internally replace if condition met
-	ret = AF_GenerateSourceRadiancesOutput(inputArgs, output_file, targetNNsrcID, trgCellNumNoShift, inputFile, srcCellNum, srcInputMultiVarsMap,ctrackDset,atrackDset);
+	ret = AF_GenerateSourceRadiancesOutput(inputArgs, output_file, targetNNsrcID, targetNNWeights, targetFootprint, trgCellNumNoShift, inputFile, srcCellNum, srcInputMultiVarsMap,ctrackDset,atrackDset);
 	if (ret < 0) {
 		std::cerr << "Error: generate source radiance output.\n";
 		return FAILED;
 	}
 	std::cout << "Writing source radiance output done.\n";
 
-	if (targetNNsrcID)
+	if (nnCacheHit && !keepsSourceLists)
+		af_ReleaseNNCache(nnCache);
+	else if (targetNNsrcID)
 		delete [] targetNNsrcID;
+	if (targetNNWeights)
+		delete [] targetNNWeights;
+	if (targetFootprint)
+		freeSummaryIndex(targetFootprint);
 
 	H5Dclose(ctrackDset);
 	H5Dclose(atrackDset);
@@ -0,0 +1,184 @@
+/*
+ * PROGRMMER:
+ *	- agent (agent@local)
+ *
+ * PROGRAM DESCRIPTION:
+ *	Benchmark of nearest neighbor spatial index backends. It reads the source and target
+ *	geolocation of an instrument pair as specified by an AFtool input parameter file, then
+ *	runs the lat/lon block grid (nearestNeighborBlockIndex), the k-d tree (nearestNeighborKDTree)
+ *	and the swath-seeded block grid (nearestNeighborSwath) on the same data, and reports elapsed
+ *	time and agreement.
+ *
+ *	Run it once per instrument pair, e.g.:
+ *	  ./bench_nnindex inputParameters_MISR2MODIS.txt
+ *	  ./bench_nnindex inputParameters_MODIS2MISR.txt
+ *	  ./bench_nnindex inputParameters_ASTER2MODIS.txt
+ *
+ *	Target cells are queried in the order set by NN_QUERY_ORDER of the parameter file (STORAGE, MORTON
+ *	or HILBERT). To measure the cache misses saved by a space-filling curve order on a pair, run it
+ *	under perf with each order and compare, e.g.:
+ *	  perf stat -e cache-misses,cache-references ./bench_nnindex inputParameters_MODIS2USER.txt
+ */
+
+#include <iostream>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include <hdf5.h>
+
+#include "reproject.h"
+#include "gdalio.h"
+#include "io.h"
+#include "AF_InputParmeterFile.h"
+#include "AF_common.h"
+
+
+/*=============================================================================
+ * Read latitude and longitude of an instrument (same as AFtool)
+ */
+static int ReadGeolocation(std::string instrument, AF_InputParmeterFile &inputArgs, hid_t inputFile, double **latitude, double **longitude, int &cellNum)
+{
+	*latitude = NULL;
+	*longitude = NULL;
+	if (instrument == MODIS_STR) {
+		std::string resolution = inputArgs.GetMODIS_Resolution();
+		*latitude = get_modis_lat(inputFile, (char*) resolution.c_str(), &cellNum);
+		*longitude = get_modis_long(inputFile, (char*) resolution.c_str(), &cellNum);
+	}
+	else if (instrument == MISR_STR) {
+		std::string resolution = inputArgs.GetMISR_Resolution();
+		*latitude = get_misr_lat(inputFile, (char*) resolution.c_str(), &cellNum);
+		*longitude = get_misr_long(inputFile, (char*) resolution.c_str(), &cellNum);
+	}
+	else if (instrument == ASTER_STR) {
+		std::string resolution = inputArgs.GetASTER_Resolution();
+		strVec_t bands = inputArgs.GetASTER_Bands();
+		*latitude = get_ast_lat(inputFile, (char*) resolution.c_str(), (char*)bands[0].c_str(), &cellNum);
+		*longitude = get_ast_long(inputFile, (char*) resolution.c_str(), (char*)bands[0].c_str(), &cellNum);
+	}
+	else if (instrument == USERGRID_STR) {
+		cellNum = getCellCenterLatLon(inputArgs.GetUSER_EPSG(), inputArgs.GetUSER_xMin(), inputArgs.GetUSER_yMin(), inputArgs.GetUSER_xMax(), inputArgs.GetUSER_yMax(), inputArgs.GetUSER_Resolution(), longitude, latitude);
+	}
+
+	if (*latitude == NULL || *longitude == NULL || cellNum <= 0) {
+		std::cerr << __FUNCTION__ << "> Error: failed to get geolocation of " << instrument << ".\n";
+		return FAILED;
+	}
+	return SUCCEED;
+}
+
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		std::cout << "Usage: " << argv[0] << " <AFtool input parameter file>\n";
+		return FAILED;
+	}
+
+	AF_InputParmeterFile inputArgs;
+	inputArgs.headerFileName = argv[1];
+	inputArgs.ParseByLine();
+	if (inputArgs.CheckParsedValues() < 0) {
+		std::cerr << "Invalid Input parameters.\n";
+		return FAILED;
+	}
+
+	std::string srcInstrument = inputArgs.GetSourceInstrument();
+	std::string trgInstrument = inputArgs.GetTargetInstrument();
+	std::string inputDataPath = inputArgs.GetInputBFdataPath();
+	hid_t inputFile;
+	if(0 > (inputFile = af_open((char*)inputDataPath.c_str()))) {
+		std::cerr << "Error: File not found - " << inputDataPath << std::endl;
+		return FAILED;
+	}
+
+	int srcCellNum, trgCellNum;
+	double *srcLat, *srcLon, *trgLat, *trgLon;
+	if (ReadGeolocation(srcInstrument, inputArgs, inputFile, &srcLat, &srcLon, srcCellNum) == FAILED)
+		return FAILED;
+	if (ReadGeolocation(trgInstrument, inputArgs, inputFile, &trgLat, &trgLon, trgCellNum) == FAILED)
+		return FAILED;
+	af_close(inputFile);
+
+	// same role assignment as AFtool: summaryInterpolate indexes target cells and queries source cells
+	const double *indexLat, *indexLon, *queryLat, *queryLon;
+	int nIndex, nQuery;
+	double maxRadius;
+	if (inputArgs.CompareStrCaseInsensitive(inputArgs.GetResampleMethod(), "summaryInterpolate")) {
+		indexLat = trgLat; indexLon = trgLon; nIndex = trgCellNum;
+		queryLat = srcLat; queryLon = srcLon; nQuery = srcCellNum;
+		maxRadius = inputArgs.GetMaxRadiusForNNeighborFunc(trgInstrument);
+	}
+	else {
+		indexLat = srcLat; indexLon = srcLon; nIndex = srcCellNum;
+		queryLat = trgLat; queryLon = trgLon; nQuery = trgCellNum;
+		maxRadius = inputArgs.GetMaxRadiusForNNeighborFunc(srcInstrument);
+	}
+
+	int queryOrder = NN_QUERY_ORDER_STORAGE;
+	if (inputArgs.CompareStrCaseInsensitive(inputArgs.GetNNQueryOrder(), "MORTON"))
+		queryOrder = NN_QUERY_ORDER_MORTON;
+	else if (inputArgs.CompareStrCaseInsensitive(inputArgs.GetNNQueryOrder(), "HILBERT"))
+		queryOrder = NN_QUERY_ORDER_HILBERT;
+
+	printf("%s -> %s (%s): indexed cells %d, query cells %d, maxR %.1f m, query order %s, %d threads\n", srcInstrument.c_str(), trgInstrument.c_str(),
+		inputArgs.GetResampleMethod().c_str(), nIndex, nQuery, maxRadius, inputArgs.GetNNQueryOrder().c_str(), omp_get_max_threads());
+
+	const int nMethods = 4;
+	const char * names[nMethods] = {"GRID", "KDTREE", "GRID_SWATH", "DUAL_GRID"};
+	const int types[nMethods] = {NN_INDEX_GRID, NN_INDEX_KDTREE, NN_INDEX_GRID_SWATH, NN_INDEX_DUAL_GRID};
+	int * nnID[nMethods];
+	double * nnDis[nMethods];
+	for (int m = 0; m < nMethods; m++) {
+		nnID[m] = (int *) malloc(sizeof(int) * nQuery);
+		nnDis[m] = (double *) malloc(sizeof(double) * nQuery);
+		if (nnID[m] == NULL || nnDis[m] == NULL) {
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+
+		// the index API leaves the geolocation unchanged, so all methods share the same arrays
+		double start = omp_get_wtime();
+		struct NNIndex * index = buildNNIndex(indexLat, indexLon, nIndex, maxRadius, types[m]);
+		double built = omp_get_wtime();
+		setNNIndexQueryOrder(index, queryOrder);
+		queryNNIndex(index, queryLat, queryLon, nnID[m], nnDis[m], nQuery);
+		double queried = omp_get_wtime();
+		freeNNIndex(index);
+
+		int nFound = 0;
+		for (int i = 0; i < nQuery; i++) {
+			if (nnID[m][i] >= 0)
+				nFound ++;
+		}
+		printf("%-10s build: %8.3f sec, query: %8.3f sec, matched cells: %d\n", names[m], built - start, queried - built, nFound);
+	}
+
+	// all backends are exact, so different IDs are only expected for equally distant cells
+	int nDiffDisAll = 0;
+	for (int m = 1; m < nMethods; m++) {
+		int nDiffID = 0, nDiffDis = 0;
+		for (int i = 0; i < nQuery; i++) {
+			if (nnID[0][i] != nnID[m][i]) {
+				nDiffID ++;
+				if (fabs(nnDis[0][i] - nnDis[m][i]) > 1e-6)
+					nDiffDis ++;
+			}
+		}
+		printf("%s vs %s: different IDs: %d, different distances: %d\n", names[m], names[0], nDiffID, nDiffDis);
+		nDiffDisAll += nDiffDis;
+	}
+
+	for (int m = 0; m < nMethods; m++) {
+		free(nnID[m]);
+		free(nnDis[m]);
+	}
+	free(srcLat);
+	free(srcLon);
+	free(trgLat);
+	free(trgLon);
+
+	return (nDiffDisAll == 0) ? SUCCEED : FAILED;
+}
@@ -156,7 +156,7 @@ int getCellCenterLatLon(int outputEPSG, double xMin, double yMin, double xMax, d
  *	double yMax: 		north boundary of output area
  * 	double cellSize:	output raste cell size
  */
-void writeGeoTiff(char * fileName, double * grid, int outputEPSG, double xMin, double yMin, double xMax, double yMax, double cellSize)
+static void writeGeoTiffOfType(char * fileName, void * grid, GDALDataType dataType, int outputEPSG, double xMin, double yMin, double xMax, double yMax, double cellSize)
 {	
 	int nRow = ceil((yMax - yMin) / cellSize);
 	int nCol = ceil((xMax - xMin) / cellSize);
@@ -173,7 +173,7 @@ void writeGeoTiff(char * fileName, double * grid, int outputEPSG, double xMin, d
 
 	GDALDatasetH hDstDS;
 	char *papszOptions[] = {"COMPRESS=LZW",NULL};
-	hDstDS = GDALCreate(hDriver, fileName, nCol, nRow, 1, GDT_Float64, papszOptions);
+	hDstDS = GDALCreate(hDriver, fileName, nCol, nRow, 1, dataType, papszOptions);
 	
 	double adfGeoTransform[6];
 	adfGeoTransform[0] = xMin;
@@ -199,13 +199,27 @@ void writeGeoTiff(char * fileName, double * grid, int outputEPSG, double xMin, d
 	GDALRasterBandH hBand;
 	hBand=GDALGetRasterBand(hDstDS,1);
 	GDALSetRasterNoDataValue(hBand,-999.0);
-	GDALRasterIO(hBand, GF_Write, 0, 0, nCol, nRow, grid, nCol, nRow, GDT_Float64, 0, 0 );
+	GDALRasterIO(hBand, GF_Write, 0, 0, nCol, nRow, grid, nCol, nRow, dataType, 0, 0 );
 
 	GDALClose(hDstDS);
 
 	return;
 }
 
+void writeGeoTiff(char * fileName, double * grid, int outputEPSG, double xMin, double yMin, double xMax, double yMax, double cellSize)
+{
+	writeGeoTiffOfType(fileName, grid, GDT_Float64, outputEPSG, xMin, yMin, xMax, yMax, cellSize);
+}
+
+/**
+ * NAME:	writeGeoTiff
+ * DESCRIPTION:	Same as above, for single precision grid (written as Float32 GeoTiff)
+ */
+void writeGeoTiff(char * fileName, float * grid, int outputEPSG, double xMin, double yMin, double xMax, double yMax, double cellSize)
+{
+	writeGeoTiffOfType(fileName, grid, GDT_Float32, outputEPSG, xMin, yMin, xMax, yMax, cellSize);
+}
+
 /**
  * NAME:	getMaxRadiusOfUserdefine
  * DESCRIPTION:	Get the maximum distance (in meters) for user-defined-grid to be used in "nearestNeighbor" when using summary interpolate
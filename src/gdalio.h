@@ -50,6 +50,7 @@ int getCellCenterLatLon(int outputEPSG, double xMin, double yMin, double xMax, d
  * 	double cellSize:	output raste cell size
  */
 void writeGeoTiff(char * fileName, double * grid, int outputEPSG, double xMin, double yMin, double xMax, double yMax, double cellSize);
+void writeGeoTiff(char * fileName, float * grid, int outputEPSG, double xMin, double yMin, double xMax, double yMax, double cellSize);	// single precision
 
 
 /**
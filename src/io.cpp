@@ -17,6 +17,7 @@
 #include <strings.h>
 #include <string.h>
 #include <assert.h>
+#include <limits.h>
 #include "io.h"
 #include "AF_debug.h"
 #include "hdf5.h"
@@ -29,6 +30,14 @@ char* km_1_ref_list[15] = {"8", "9", "10", "11", "12", "13L", "13H", "14L", "14H
 char* kme_1_list[16] = {"20", "21", "22", "23", "24", "25", "27", "28", "29", "30", "31", "32", "33", "34", "35", "36"};
 
 
+//Read a dataset in double (af_read) or float (af_read_float)
+template <typename T> static T* af_read_as(hid_t file, char* dataset_name);
+template <> double* af_read_as<double>(hid_t file, char* dataset_name) { return af_read(file, dataset_name); }
+template <> float* af_read_as<float>(hid_t file, char* dataset_name) { return af_read_float(file, dataset_name); }
+
+template <typename T> static T* get_modis_rad_by_band_as(hid_t file, char* resolution, char* d_name, int* band_index, int* size);
+
+
 /*
 						get_misr_rad
 	DESCRIPTION:
@@ -52,9 +61,13 @@ char* kme_1_list[16] = {"20", "21", "22", "23", "24", "25", "27", "28", "29", "3
 		Returns down_data (1D array) if the data requires downsampling
 		Returns data (1D array) in normal situations
 		
+	NOTE:
+		get_misr_rad_as<float> keeps the float32 radiance values as they are stored (single precision mode). The 4x4 averaging is done in double.
+		
 */
 
-double* get_misr_rad(hid_t file, char* camera_angle, char* resolution, char* radiance, int* size)
+template <typename T>
+T* get_misr_rad_as(hid_t file, char* camera_angle, char* resolution, char* radiance, int* size)
 {
 	//Path to dataset proccessing 
 	int down_sampling = 0;
@@ -78,7 +91,7 @@ double* get_misr_rad(hid_t file, char* camera_angle, char* resolution, char* rad
 	printf("Reading MISR\n");
 	/*Dimensions - 180 blocks, 512 x 2048 ordered in 1D Array*/
 	//Retrieve radiance dataset and dataspace
-	double* data = af_read(file, rad_dataset_name);
+	T* data = af_read_as<T>(file, rad_dataset_name);
 	*size = dim_sum_free(af_read_size(file, rad_dataset_name), 3);
 
 	if(*size == 0){
@@ -92,7 +105,7 @@ double* get_misr_rad(hid_t file, char* camera_angle, char* resolution, char* rad
 	}
 	printf("Reading successful\n");
 	//Variable containing down sampled data
-	double* down_data;
+	T* down_data;
 	if(down_sampling == 1){
 		printf("Undergoing downsampling\n");
 		hsize_t* dims = af_read_size(file, rad_dataset_name);
@@ -102,7 +115,7 @@ double* get_misr_rad(hid_t file, char* camera_angle, char* resolution, char* rad
  		}
 			
 		*size = dims[0] * (dims[1]/4) * (dims[2]/4);
-		down_data = (double*) malloc(dims[0] * (dims[1]/4) * (dims[2]/4) * sizeof(double));
+		down_data = (T*) malloc(dims[0] * (dims[1]/4) * (dims[2]/4) * sizeof(T));
 		int i, j, k;
 		for(i = 0; i < dims[0]; i++){
 			for(j = 0; j < dims[1]; j = j + 4){
@@ -156,6 +169,14 @@ double* get_misr_rad(hid_t file, char* camera_angle, char* resolution, char* rad
     
 }
 
+template double* get_misr_rad_as<double>(hid_t file, char* camera_angle, char* resolution, char* radiance, int* size);
+template float* get_misr_rad_as<float>(hid_t file, char* camera_angle, char* resolution, char* radiance, int* size);
+
+double* get_misr_rad(hid_t file, char* camera_angle, char* resolution, char* radiance, int* size)
+{
+	return get_misr_rad_as<double>(file, camera_angle, resolution, radiance, size);
+}
+
 /*
 						get_misr_lat
 	DESCRIPTION:
@@ -348,8 +369,12 @@ void* get_misr_attr(hid_t file, char* camera_angle, char* resolution, char* radi
 	RETURN:
 		Returns result_data upon sucessful retrieval 
 		Returns NULL upon error
+		
+	NOTE:
+		get_modis_rad_as<float> keeps the float32 radiance values as they are stored (single precision mode).
 */
-double* get_modis_rad(hid_t file, char* resolution, std::vector<std::string> &bands, int band_size, int* size)
+template <typename T>
+T* get_modis_rad_as(hid_t file, char* resolution, std::vector<std::string> &bands, int band_size, int* size)
 {
 	printf("Reading MODIS rad\n");
 	
@@ -465,15 +490,15 @@ double* get_modis_rad(hid_t file, char* resolution, std::vector<std::string> &ba
 	printf("DBG_IO %s:%d> Get total data size: %d\n", __FUNCTION__, __LINE__, total_size);
 	#endif
 	
-	double* result_data = (double*) calloc(total_size, sizeof(double));
+	T* result_data = (T*) calloc(total_size, sizeof(T));
 	int start_point = 0;
 	
 	//Start reading data
 	int n;
 	for(n = 0; n < band_size; n++){
 		int file_size = 0;
-		double * MODIS_rad = get_modis_rad_by_band(file, resolution, dnames[n], &band_indices[n], &file_size);
-		memcpy(&result_data[start_point], MODIS_rad, file_size*sizeof(double));
+		T * MODIS_rad = get_modis_rad_by_band_as<T>(file, resolution, dnames[n], &band_indices[n], &file_size);
+		memcpy(&result_data[start_point], MODIS_rad, file_size*sizeof(T));
 		free(MODIS_rad);
 		start_point += file_size;
 	}
@@ -487,6 +512,14 @@ double* get_modis_rad(hid_t file, char* resolution, std::vector<std::string> &ba
 	return result_data;
 }
 
+template double* get_modis_rad_as<double>(hid_t file, char* resolution, std::vector<std::string> &bands, int band_size, int* size);
+template float* get_modis_rad_as<float>(hid_t file, char* resolution, std::vector<std::string> &bands, int band_size, int* size);
+
+double* get_modis_rad(hid_t file, char* resolution, std::vector<std::string> &bands, int band_size, int* size)
+{
+	return get_modis_rad_as<double>(file, resolution, bands, band_size, size);
+}
+
 
 
 /*
@@ -514,7 +547,8 @@ double* get_modis_rad(hid_t file, char* resolution, std::vector<std::string> &ba
 */
 
 
-double* get_modis_rad_by_band(hid_t file, char* resolution, char* d_name, int* band_index, int* size)
+template <typename T>
+static T* get_modis_rad_by_band_as(hid_t file, char* resolution, char* d_name, int* band_index, int* size)
 {
 	#if DEBUG_IO
 	printf("DBG_IO %s:%d> Reading MODIS rad by band\n", __FUNCTION__, __LINE__);
@@ -609,14 +643,14 @@ double* get_modis_rad_by_band(hid_t file, char* resolution, char* d_name, int* b
 	printf("Total Size: %d\n", total_size);
 	
 	//Allocate data size
-	double* result_data = (double*)calloc(total_size, sizeof(double));
+	T* result_data = (T*)calloc(total_size, sizeof(T));
 	
 	//Retreving data
 	int h;
 	int curr_size = 0;
 	int read_first = -1;
 	for(h = 0; h < store_count; h++){
-		double* data;
+		T* data;
 		//Path formation
 		char* name = names[h];
 		const char* d_arr[] = {instrument, name, resolution, d_fields, d_name};
@@ -662,7 +696,7 @@ double* get_modis_rad_by_band(hid_t file, char* resolution, char* d_name, int* b
 	
 			band_length = curr_dim[1] * curr_dim[2];
 
-			data = af_read(file, dataset_name);
+			data = af_read_as<T>(file, dataset_name);
 
 			if(data == NULL){
 				printf("Dataset %s does not exits.\n", dataset_name);
@@ -676,7 +710,7 @@ double* get_modis_rad_by_band(hid_t file, char* resolution, char* d_name, int* b
 			#if DEBUG_IO
 			printf("DBG_IO> test data: %f\n", data[2748619]);
 			#endif
-			memcpy(&(result_data[curr_size]), &(data[read_offset]), band_length*sizeof(double));
+			memcpy(&(result_data[curr_size]), &(data[read_offset]), band_length*sizeof(T));
 		
 			free(data);
 
@@ -697,6 +731,11 @@ double* get_modis_rad_by_band(hid_t file, char* resolution, char* d_name, int* b
 	return result_data;
 }
 
+double* get_modis_rad_by_band(hid_t file, char* resolution, char* d_name, int* band_index, int* size)
+{
+	return get_modis_rad_by_band_as<double>(file, resolution, d_name, band_index, size);
+}
+
 
 
 /*
@@ -1713,7 +1752,7 @@ double* get_mop_long(hid_t file, int* size)
 		0. file -- A hdf file variable that points to the BasicFusion file
 		1. subsystem (TIR/VNIR/SWIR) -- A string variable that specifies the subsystem to retrieve
 		2. d_name -- A string variable that specifies the dataset name 
-		3. size -- An integer pointer that points to the size of the ASTER radiance data after the retreival 
+		3. size -- A long long pointer that points to the size of the ASTER radiance data after the retreival 
 		
 	EFFECT:
 		Memory would be allocated for the retrieved ASTER radiance data, with the variable size set as the size of the data
@@ -1721,10 +1760,14 @@ double* get_mop_long(hid_t file, int* size)
 	RETURN:
 		Returns result_data upon successful retrieval
 		Returns NULL upon error
+		
+	NOTE:
+		get_ast_rad_as<float> returns the radiance values in single precision (single precision mode).
 */
 
 
-double* get_ast_rad(hid_t file, char* subsystem, char* d_name, int*size)
+template <typename T>
+T* get_ast_rad_as(hid_t file, char* subsystem, char* d_name, long long* size)
 {
 	printf("Reading ASTER radiance\n");
 	//Path variables
@@ -1775,7 +1818,7 @@ double* get_ast_rad(hid_t file, char* subsystem, char* d_name, int*size)
 	
 	//Get total data size
 	printf("Get total data size\n");
-	int total_size = 0;
+	long long total_size = 0;
 	for(i = 0; i < num_groups; i++){
 		char* name = names[i];
 		if(strcmp(name, "") == 0) {
@@ -1796,13 +1839,13 @@ double* get_ast_rad(hid_t file, char* subsystem, char* d_name, int*size)
 		free(dataset_name);
 	}
 	#if DEBUG_IO
-	printf("DBG_IO %s:%d> Get total_size: %d\n", __FUNCTION__, __LINE__, total_size);
+	printf("DBG_IO %s:%d> Get total_size: %lld\n", __FUNCTION__, __LINE__, total_size);
 	#endif
 	
 	printf("Reading values\n");
-	double* result_data = (double*)calloc(total_size, sizeof(double));
+	T* result_data = (T*)calloc(total_size, sizeof(T));
 	
-	int curr_size = 0;
+	long long curr_size = 0;
 	for(i = 0; i < num_groups; i++){
 		//Path formation
 		char* name = names[i];
@@ -1815,7 +1858,7 @@ double* get_ast_rad(hid_t file, char* subsystem, char* d_name, int*size)
 		#if DEBUG_IO
 		printf("DBG_IO %s:%d> Read in dataset_name: %s\n", __FUNCTION__, __LINE__, dataset_name);
 		#endif
-		double* data = af_read(file, dataset_name);
+		T* data = af_read_as<T>(file, dataset_name);
 		if(data == NULL){
 			#if DEBUG_IO
 			printf("DBG_IO %s:%d> Warn: data is NULL of dataset_name: %s\n", __FUNCTION__, __LINE__, dataset_name);
@@ -1830,7 +1873,7 @@ double* get_ast_rad(hid_t file, char* subsystem, char* d_name, int*size)
 		}
 		#endif
 		int gran_size = curr_dim[0] * curr_dim[1];
-		memcpy(&result_data[curr_size], data, sizeof(double) * gran_size);
+		memcpy(&result_data[curr_size], data, sizeof(T) * gran_size);
 		curr_size += gran_size;
 		free(data);
 		free(curr_dim);
@@ -1841,6 +1884,37 @@ double* get_ast_rad(hid_t file, char* subsystem, char* d_name, int*size)
 	return result_data;
 }
 
+template double* get_ast_rad_as<double>(hid_t file, char* subsystem, char* d_name, long long* size);
+template float* get_ast_rad_as<float>(hid_t file, char* subsystem, char* d_name, long long* size);
+
+double* get_ast_rad(hid_t file, char* subsystem, char* d_name, long long* size)
+{
+	return get_ast_rad_as<double>(file, subsystem, d_name, size);
+}
+
+/*
+						get_ast_rad (int size)
+	DESCRIPTION:	
+		Same as above, for callers which keep the cell count in an int. Fails if the data has more cells than an int can hold.
+		
+	RETURN:
+		Returns result_data upon successful retrieval
+		Returns NULL upon error
+*/
+
+double* get_ast_rad(hid_t file, char* subsystem, char* d_name, int* size)
+{
+	long long total_size = 0;
+	double* result_data = get_ast_rad(file, subsystem, d_name, &total_size);
+	if(result_data != NULL && total_size > INT_MAX) {
+		printf("\nError: ASTER radiance data has more than 2 billion pixels. Use the 64-bit (long long size) version.\n");
+		free(result_data);
+		return NULL;
+	}
+	*size = (int)total_size;
+	return result_data;
+}
+
 /*
 						get_ast_lat
 	DESCRIPTION:	
@@ -1852,7 +1926,7 @@ double* get_ast_rad(hid_t file, char* subsystem, char* d_name, int*size)
 		0. file -- A hdf file variable that points to the BasicFusion file
 		1. subsystem (TIR/VNIR/SWIR) -- A string variable that specifies the subsystem to retrieve
 		2. d_name -- A string variable that specifies the dataset name 
-		3. size -- An integer pointer that points to the size of the ASTER latitude data after the retreival 
+		3. size -- A long long pointer that points to the size of the ASTER latitude data after the retreival 
 		
 	EFFECT:
 		Memory would be allocated for the retrieved ASTER geological latitude data, with the variable size set as the size of the data
@@ -1862,7 +1936,7 @@ double* get_ast_rad(hid_t file, char* subsystem, char* d_name, int*size)
 		Returns NULL upon error
 */
 
-double* get_ast_lat(hid_t file, char* subsystem, char* d_name, int*size)
+double* get_ast_lat(hid_t file, char* subsystem, char* d_name, long long* size)
 {
 	printf("Reading ASTER lat\n");
 	//Path variables
@@ -1917,7 +1991,7 @@ double* get_ast_lat(hid_t file, char* subsystem, char* d_name, int*size)
 
 	//Get total data size
 	printf("Getting total data size\n");
-	int total_size = 0;
+	long long total_size = 0;
 	for(i = 0; i < num_groups; i++){
 		char* name = names[i];
 		if(strcmp(name, "") == 0) {
@@ -1936,30 +2010,18 @@ double* get_ast_lat(hid_t file, char* subsystem, char* d_name, int*size)
 		total_size += curr_dim[0]*curr_dim[1];
 		free(curr_dim);
 		#if DEBUG_IO
-		printf("DBG_IO %s:%d> Get total_size: %d\n", __FUNCTION__, __LINE__, total_size);
+		printf("DBG_IO %s:%d> Get total_size: %lld\n", __FUNCTION__, __LINE__, total_size);
 		#endif
 
-		// check overflow
-		if(total_size < 0) {
-			/* As lone as using 'int' for total cell number in the code; because
-			 * total cell number variable type was started as int type from the beginning,
-			 * and 'int' type limit is about 2 billion.
-			 * To remedy this, use long type which probably can cover all instrument cases.
-			 * This update involves refactoring all the functions generting,passing,receving
-			 * the total cell number.
-			 */
-			printf("\nError: Failed to continue reading ASTER latitude data due to the 2 billion pixel limit.\n");
-			return NULL;
-		}
 		free(dataset_name);
 	}
 	#if DEBUG_IO
-	printf("DBG_IO %s:%d> Get total_size: %d\n", __FUNCTION__, __LINE__, total_size);
+	printf("DBG_IO %s:%d> Get total_size: %lld\n", __FUNCTION__, __LINE__, total_size);
 	#endif
 	
 	printf("Reading values\n");
 	double* lat_data = (double*)calloc(total_size, sizeof(double));
-	int curr_lat_size = 0;
+	long long curr_lat_size = 0;
 	int read_first = -1;
 	for(i = 0; i < num_groups; i++){
 		//Path formation
@@ -1999,6 +2061,29 @@ double* get_ast_lat(hid_t file, char* subsystem, char* d_name, int*size)
 	return lat_data;
 }
 
+/*
+						get_ast_lat (int size)
+	DESCRIPTION:	
+		Same as above, for callers which keep the cell count in an int. Fails if the data has more cells than an int can hold.
+		
+	RETURN:
+		Returns lat_data upon successful retrieval
+		Returns NULL upon error
+*/
+
+double* get_ast_lat(hid_t file, char* subsystem, char* d_name, int* size)
+{
+	long long total_size = 0;
+	double* lat_data = get_ast_lat(file, subsystem, d_name, &total_size);
+	if(lat_data != NULL && total_size > INT_MAX) {
+		printf("\nError: ASTER latitude data has more than 2 billion pixels. Use the 64-bit (long long size) version.\n");
+		free(lat_data);
+		return NULL;
+	}
+	*size = (int)total_size;
+	return lat_data;
+}
+
 /*
 						get_ast_long
 	DESCRIPTION:	
@@ -2010,7 +2095,7 @@ double* get_ast_lat(hid_t file, char* subsystem, char* d_name, int*size)
 		0. file -- A hdf file variable that points to the BasicFusion file
 		1. subsystem (TIR/VNIR/SWIR) -- A string variable that specifies the subsystem to retrieve
 		2. d_name -- A string variable that specifies the dataset name 
-		3. size -- An integer pointer that points to the size of the ASTER longitude data after the retreival 
+		3. size -- A long long pointer that points to the size of the ASTER longitude data after the retreival 
 		
 	EFFECT:
 		Memory would be allocated for the retrieved ASTER geological longitude data, with the variable size set as the size of the data
@@ -2021,7 +2106,7 @@ double* get_ast_lat(hid_t file, char* subsystem, char* d_name, int*size)
 */
 
 
-double* get_ast_long(hid_t file, char* subsystem, char* d_name, int* size)
+double* get_ast_long(hid_t file, char* subsystem, char* d_name, long long* size)
 {
 	printf("Reading ASTER long\n");
 	//Path variables
@@ -2074,7 +2159,7 @@ double* get_ast_long(hid_t file, char* subsystem, char* d_name, int* size)
 	
 	//Get total data size
 	printf("Getting total data size\n");
-	int total_size = 0;
+	long long total_size = 0;
 	int store_count = 0;
 	for(i = 0; i < num_groups; i++){
 		char* name = names[i];
@@ -2095,30 +2180,18 @@ double* get_ast_long(hid_t file, char* subsystem, char* d_name, int* size)
 		free(curr_dim);
 
 		#if DEBUG_IO
-		printf("DBG_IO %s:%d> Get total_size: %d\n", __FUNCTION__, __LINE__, total_size);
+		printf("DBG_IO %s:%d> Get total_size: %lld\n", __FUNCTION__, __LINE__, total_size);
 		#endif
 
-		// check overflow
-		if(total_size < 0) {
-			/* As lone as using 'int' for total cell number in the code; because
-			 * total cell number variable type was started as int type from the beginning,
-			 * and 'int' type limit is about 2 billion.
-			 * To remedy this, use long type which probably can cover all instrument cases.
-			 * This update involves refactoring all the functions generting,passing,receving
-			 * the total cell number.
-			 */
-			printf("\nError: Failed to continue reading ASTER longitude data due to the 2 billion pixel limit.\n");
-			return NULL;
-		}
 		free(dataset_name);
 	}
 	#if DEBUG_IO
-	printf("DBG_IO %s:%d> Get total_size: %d\n", __FUNCTION__, __LINE__, total_size);
+	printf("DBG_IO %s:%d> Get total_size: %lld\n", __FUNCTION__, __LINE__, total_size);
 	#endif
 	
 	printf("Reading values\n");
 	double* long_data = (double*)calloc(total_size, sizeof(double));
-	int curr_long_size = 0;
+	long long curr_long_size = 0;
 	for(i = 0; i < num_groups; i++){
 		//Path formation
 		char* name = names[i];
@@ -2157,6 +2230,29 @@ double* get_ast_long(hid_t file, char* subsystem, char* d_name, int* size)
 	return long_data;
 }
 
+/*
+						get_ast_long (int size)
+	DESCRIPTION:	
+		Same as above, for callers which keep the cell count in an int. Fails if the data has more cells than an int can hold.
+		
+	RETURN:
+		Returns long_data upon successful retrieval
+		Returns NULL upon error
+*/
+
+double* get_ast_long(hid_t file, char* subsystem, char* d_name, int* size)
+{
+	long long total_size = 0;
+	double* long_data = get_ast_long(file, subsystem, d_name, &total_size);
+	if(long_data != NULL && total_size > INT_MAX) {
+		printf("\nError: ASTER longitude data has more than 2 billion pixels. Use the 64-bit (long long size) version.\n");
+		free(long_data);
+		return NULL;
+	}
+	*size = (int)total_size;
+	return long_data;
+}
+
 
 /*
 						get_ast_rad_by_gran
@@ -2516,6 +2612,63 @@ double* af_read(hid_t file, char* dataset_name)
 	}
 }
 
+/*
+						af_read_float
+	DESCRIPTION:	
+		Same as af_read, but keeps the data in 32-bit floating point numbers. HDF5 converts the data in the file to float while reading,
+		so no double copy is made. Used for radiance data in the single precision mode.
+		
+	ARGUMENTS:
+		0. file -- A hdf file variable that points to the BasicFusion file
+		1. dataset_name -- A string variable that specifies the dataset name, which should be the full path within the BasicFusion file
+		
+	EFFECT:
+		Memory would be allocated for data that is read in.
+		
+	RETURN:
+		Returns data upon successful retrieval
+		Returns NULL upon error
+		
+*/
+
+
+float* af_read_float(hid_t file, char* dataset_name)
+{
+	hid_t dataset = H5Dopen2(file, dataset_name, H5P_DEFAULT);
+	if(dataset < 0){
+		printf("Dataset open error\n");
+		return NULL; 
+	}
+	hid_t dataspace = H5Dget_space(dataset);
+	if(dataspace < 0){
+		H5Dclose(dataset);
+		printf("Dataspace open error\n");
+		return NULL;	
+	}
+	hssize_t npoints = H5Sget_simple_extent_npoints(dataspace);
+	H5Sclose(dataspace);
+	if(npoints <= 0) {
+		H5Dclose(dataset);
+		printf("H5Sget_simple_extent_npoints failed\n");
+		return NULL;
+	}
+
+	float* data = (float*)malloc(npoints * sizeof(float));
+	if(data == NULL) {
+		H5Dclose(dataset);
+		printf("Allocate memory failed\n");
+		return NULL;
+	}
+	herr_t status = H5Dread(dataset, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+	H5Dclose(dataset);
+	if(status < 0){
+		printf("read error: %d\n", status);
+		free(data);
+		return NULL;
+	}
+	return data;
+}
+
 /*
 						af_write_misr_on_modis
 	DESCRIPTION:	
@@ -25,6 +25,7 @@
 hid_t af_open(char* file_path);
 herr_t af_close(hid_t file);
 double* af_read(hid_t file, char* dataset_name);
+float* af_read_float(hid_t file, char* dataset_name);
 double* af_read_hyperslab(hid_t file, char*dataset_name, int x_offset, int y_offset, int z_offset);
 hsize_t* af_read_size(hid_t file, char* dataset_name);
 int af_write_misr_on_modis(hid_t output_file, double* misr_out, double* modis, int modis_size, int modis_band_size, int misr_size);
@@ -36,10 +37,12 @@ int af_write_cf_attributes(hid_t dset, char* units, float _FillValue,
     
 //Instrument data retrieval functions
 double* get_misr_rad(hid_t file, char* camera_angle, char* resolution, char* radiance, int* size);
+template <typename T> T* get_misr_rad_as(hid_t file, char* camera_angle, char* resolution, char* radiance, int* size);  // T: double or float
 double* get_misr_lat(hid_t file, char* resolution, int* size);
 double* get_misr_long(hid_t file, char* resolution, int* size);
 void* get_misr_attr(hid_t file, char* camera_angle, char* resolution, char* radiance, char* attr_name, int geo, void* attr_pt);
 double* get_modis_rad(hid_t file, char* resolution, std::vector<std::string> &bands, int band_size, int* size);
+template <typename T> T* get_modis_rad_as(hid_t file, char* resolution, std::vector<std::string> &bands, int band_size, int* size);  // T: double or float
 double* get_modis_rad_by_band(hid_t file, char* resolution, char* d_name, int* band_index, int* size);
 double* get_modis_lat(hid_t file, char* resolution, int* size);
 double* get_modis_long(hid_t file, char* resolution, int* size);
@@ -51,6 +54,11 @@ double* get_ceres_long(hid_t file, char* camera, char* d_name, int* size);
 double* get_mop_rad(hid_t file, int* size);
 double* get_mop_lat(hid_t file, int*size);
 double* get_mop_long(hid_t file, int* size);
+// ASTER full orbits can exceed 2 billion cells, so use the long long size versions for them
+double* get_ast_rad(hid_t file, char* subsystem, char* d_name, long long* size);
+template <typename T> T* get_ast_rad_as(hid_t file, char* subsystem, char* d_name, long long* size);  // T: double or float
+double* get_ast_lat(hid_t file, char* subsystem, char* d_name, long long* size);
+double* get_ast_long(hid_t file, char* subsystem, char* d_name, long long* size);
 double* get_ast_rad(hid_t file, char* subsystem, char* d_name, int*size);
 double* get_ast_lat(hid_t file, char* subsystem, char* d_name, int*size);
 double* get_ast_long(hid_t file, char* subsystem, char* d_name, int*size);
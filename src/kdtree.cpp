@@ -0,0 +1,606 @@
+/**
+ * kdtree.cpp
+ * Authors: agent <agent@local>
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <omp.h>
+#include <algorithm>
+
+#include "kdtree.h"
+#include "AF_debug.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// the maximum number of source cells in a leaf node
+#define KD_LEAF_SIZE 16
+// subtrees larger than this are built in separate OpenMP tasks
+#define KD_TASK_SIZE 65536
+
+/**
+ * struct KDTree: a balanced k-d tree over 3D unit vectors. Nodes are numbered as a binary heap (root is 1, children of n are 2n and 2n+1)
+ * and each node covers a contiguous range of the (reordered) point arrays, so no child pointers or ranges need to be stored
+ * ITEMS:
+ *	int nPoints:		the number of points
+ *	double * x, * y, * z:	the unit vectors of points in tree order
+ *	int * oriID:		the original IDs of points in tree order
+ *	int nNodes:		the number of slots in splitDim and splitVal
+ *	char * splitDim:	the splitting dimension (0, 1, 2) of each internal node, or -1 for leaf nodes
+ *	double * splitVal:	the splitting value of each internal node
+ */
+struct KDTree {
+	int nPoints;
+	double * x;
+	double * y;
+	double * z;
+	int * oriID;
+	int nNodes;
+	char * splitDim;
+	double * splitVal;
+};
+
+static inline char isValidLatLon(double lat, double lon) {
+	return (lat >= -90 && lat <= 90 && lon >= -180 && lon <= 180) ? 1 : 0;
+}
+
+struct KDPointCompare {
+	const double * coord;
+	bool operator()(int a, int b) const { return coord[a] < coord[b]; }
+};
+
+static void buildKDNode(struct KDTree * tree, double ** coords, int * idx, int node, int lo, int hi) {
+
+	if(hi - lo <= KD_LEAF_SIZE) {
+		tree->splitDim[node] = -1;
+		return;
+	}
+
+	// split along the dimension with the largest extent
+	double minV[3], maxV[3];
+	for(int d = 0; d < 3; d++) {
+		minV[d] = coords[d][idx[lo]];
+		maxV[d] = minV[d];
+	}
+	for(int i = lo + 1; i < hi; i++) {
+		for(int d = 0; d < 3; d++) {
+			double v = coords[d][idx[i]];
+			if(v < minV[d]) {
+				minV[d] = v;
+			}
+			if(v > maxV[d]) {
+				maxV[d] = v;
+			}
+		}
+	}
+	int dim = 0;
+	for(int d = 1; d < 3; d++) {
+		if(maxV[d] - minV[d] > maxV[dim] - minV[dim]) {
+			dim = d;
+		}
+	}
+
+	int mid = lo + (hi - lo) / 2;
+	KDPointCompare comp;
+	comp.coord = coords[dim];
+	std::nth_element(idx + lo, idx + mid, idx + hi, comp);
+
+	tree->splitDim[node] = (char)dim;
+	tree->splitVal[node] = coords[dim][idx[mid]];
+
+#pragma omp task if(mid - lo > KD_TASK_SIZE)
+	buildKDNode(tree, coords, idx, 2 * node, lo, mid);
+#pragma omp task if(hi - mid > KD_TASK_SIZE)
+	buildKDNode(tree, coords, idx, 2 * node + 1, mid, hi);
+#pragma omp taskwait
+}
+
+/**
+ * NAME:	buildKDTree
+ * DESCRIPTION:	Build a k-d tree over the unit vectors of points
+ * PARAMETERS:
+ *	double * x, * y, * z:	the unit vectors of points (the data are reordered into tree order in this function)
+ *	char * valid:		whether each point is a valid location; invalid points are left out of the tree
+ *	int count:		the number of points
+ * Output:
+ *	a pointer to the tree, which owns x, y and z afterwards (free with "freeKDTreeIndex")
+ */
+static struct KDTree * buildKDTree(double * x, double * y, double * z, char * valid, int count) {
+
+	struct KDTree * tree;
+	if(NULL == (tree = (struct KDTree *)malloc(sizeof(struct KDTree)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	if(NULL == (tree->oriID = (int *)malloc(sizeof(int) * count))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	int i;
+	int nValid = 0;
+	for(i = 0; i < count; i++) {
+		if(valid[i]) {
+			tree->oriID[nValid] = i;
+			nValid ++;
+		}
+	}
+
+	// heap numbering of a tree whose leaves hold at most KD_LEAF_SIZE points
+	int nLeaves = 1;
+	while((long long)nLeaves * KD_LEAF_SIZE < nValid) {
+		nLeaves *= 2;
+	}
+	tree->nPoints = nValid;
+	tree->nNodes = 2 * nLeaves;
+	if(NULL == (tree->splitDim = (char *)malloc(sizeof(char) * tree->nNodes))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (tree->splitVal = (double *)malloc(sizeof(double) * tree->nNodes))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	double * coords[3] = {x, y, z};
+#pragma omp parallel
+#pragma omp single
+	buildKDNode(tree, coords, tree->oriID, 1, 0, nValid);
+
+	// reorder the coordinates into tree order, so that leaf scans are contiguous
+	double * tmp;
+	if(NULL == (tmp = (double *)malloc(sizeof(double) * nValid))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	for(int d = 0; d < 3; d++) {
+#pragma omp parallel for
+		for(i = 0; i < nValid; i++) {
+			tmp[i] = coords[d][tree->oriID[i]];
+		}
+#pragma omp parallel for
+		for(i = 0; i < nValid; i++) {
+			coords[d][i] = tmp[i];
+		}
+	}
+	free(tmp);
+
+	tree->x = x;
+	tree->y = y;
+	tree->z = z;
+
+	return tree;
+}
+
+/**
+ * NAME:	freeKDTreeIndex
+ * DESCRIPTION:	Release a k-d tree built by "buildKDTreeIndex"
+ */
+void freeKDTreeIndex(struct KDTree * tree) {
+	free(tree->x);
+	free(tree->y);
+	free(tree->z);
+	free(tree->splitDim);
+	free(tree->splitVal);
+	free(tree->oriID);
+	free(tree);
+}
+
+/**
+ * NAME:	queryKDTree
+ * DESCRIPTION:	Find the k nearest points to a unit vector, within a squared chord length
+ * PARAMETERS:
+ *	struct KDTree * tree:	the k-d tree
+ *	double tX, tY, tZ:	the unit vector of the query location
+ *	int k:			the number of nearest points to find
+ *	double * knnDis:	input: k copies of the (exclusive) squared chord bound; output: the squared chords to the nearest points, nearest first
+ *	int * knnID:		input: k copies of -1; output: the indices (in tree order) of the nearest points, -1 for the slots not found
+ *	double pruneScale:	1 for exact search. Otherwise, once k points are found, a subtree is skipped unless it may hold a point whose squared
+ *				chord is less than pruneScale times the k-th nearest one (approximate search)
+ * Output:
+ *	double * knnDis, int * knnID are updated. A point replaces the k-th nearest one only if it is strictly closer, and equally distant points
+ *	keep the order they are found in
+ */
+static void queryKDTree(const struct KDTree * tree, double tX, double tY, double tZ, int k, double * knnDis, int * knnID, double pruneScale) {
+
+	double q[3] = {tX, tY, tZ};
+	double bestDis = knnDis[k - 1];
+	double pruneDis = (knnID[k - 1] >= 0) ? bestDis * pruneScale : bestDis;
+
+	// explicit stack of (node, lo, hi, squared distance to the splitting plane)
+	int stackNode[64], stackLo[64], stackHi[64];
+	double stackBound[64];
+	int top = 0;
+
+	stackNode[0] = 1;
+	stackLo[0] = 0;
+	stackHi[0] = tree->nPoints;
+	stackBound[0] = 0;
+	top = 1;
+
+	while(top > 0) {
+		top --;
+		if(stackBound[top] >= pruneDis) {
+			continue;
+		}
+		int node = stackNode[top];
+		int lo = stackLo[top];
+		int hi = stackHi[top];
+
+		// walk down to a leaf, pushing the far side of every split
+		while(tree->splitDim[node] >= 0) {
+			int dim = tree->splitDim[node];
+			int mid = lo + (hi - lo) / 2;
+			double diff = q[dim] - tree->splitVal[node];
+			double bound = diff * diff;
+			if(diff < 0) {
+				if(bound < pruneDis) {
+					stackNode[top] = 2 * node + 1;
+					stackLo[top] = mid;
+					stackHi[top] = hi;
+					stackBound[top] = bound;
+					top ++;
+				}
+				node = 2 * node;
+				hi = mid;
+			}
+			else {
+				if(bound < pruneDis) {
+					stackNode[top] = 2 * node;
+					stackLo[top] = lo;
+					stackHi[top] = mid;
+					stackBound[top] = bound;
+					top ++;
+				}
+				node = 2 * node + 1;
+				lo = mid;
+			}
+		}
+
+		for(int l = lo; l < hi; l++) {
+			double dX = tree->x[l] - tX;
+			double dY = tree->y[l] - tY;
+			double dZ = tree->z[l] - tZ;
+			double pDis = dX * dX + dY * dY + dZ * dZ;
+			if(pDis < bestDis) {
+				// insertion into the sorted k nearest
+				int m = k - 1;
+				while(m > 0 && knnDis[m - 1] > pDis) {
+					knnDis[m] = knnDis[m - 1];
+					knnID[m] = knnID[m - 1];
+					m --;
+				}
+				knnDis[m] = pDis;
+				knnID[m] = l;
+				bestDis = knnDis[k - 1];
+				pruneDis = (knnID[k - 1] >= 0) ? bestDis * pruneScale : bestDis;
+			}
+		}
+	}
+}
+
+
+/**
+ * NAME:	radiusKDTree
+ * DESCRIPTION:	Find the points within a squared chord length of a unit vector
+ * PARAMETERS:
+ *	struct KDTree * tree:	the k-d tree
+ *	double tX, tY, tZ:	the unit vector of the query location
+ *	double chord2:		the (inclusive) squared chord bound
+ *	long long * outID:	the output original IDs of the points found (NULL to only count them)
+ * Output:
+ *	the number of points found
+ */
+static int radiusKDTree(const struct KDTree * tree, double tX, double tY, double tZ, double chord2, long long * outID) {
+
+	double q[3] = {tX, tY, tZ};
+	int n = 0;
+
+	// explicit stack of (node, lo, hi), as in "queryKDTree"
+	int stackNode[64], stackLo[64], stackHi[64];
+	int top = 0;
+
+	stackNode[0] = 1;
+	stackLo[0] = 0;
+	stackHi[0] = tree->nPoints;
+	top = 1;
+
+	while(top > 0) {
+		top --;
+		int node = stackNode[top];
+		int lo = stackLo[top];
+		int hi = stackHi[top];
+
+		while(tree->splitDim[node] >= 0) {
+			int dim = tree->splitDim[node];
+			int mid = lo + (hi - lo) / 2;
+			double diff = q[dim] - tree->splitVal[node];
+			if(diff < 0) {
+				if(diff * diff <= chord2) {
+					stackNode[top] = 2 * node + 1;
+					stackLo[top] = mid;
+					stackHi[top] = hi;
+					top ++;
+				}
+				node = 2 * node;
+				hi = mid;
+			}
+			else {
+				if(diff * diff <= chord2) {
+					stackNode[top] = 2 * node;
+					stackLo[top] = lo;
+					stackHi[top] = mid;
+					top ++;
+				}
+				node = 2 * node + 1;
+				lo = mid;
+			}
+		}
+
+		for(int l = lo; l < hi; l++) {
+			double dX = tree->x[l] - tX;
+			double dY = tree->y[l] - tY;
+			double dZ = tree->z[l] - tZ;
+			if(dX * dX + dY * dY + dZ * dZ <= chord2) {
+				if(outID != NULL) {
+					outID[n] = tree->oriID[l];
+				}
+				n ++;
+			}
+		}
+	}
+	return n;
+}
+
+
+/**
+ * NAME:	buildKDTreeIndex
+ * DESCRIPTION:	Build a balanced k-d tree over 3D unit vectors of source cells. The input arrays are not changed
+ * PARAMETERS:
+ *	double * souLat:	the latitudes of source cells
+ *	double * souLon:	the longitudes of source cells
+ *	int nSou:		the number of source cells
+ * Output:
+ *	the k-d tree (release it with "freeKDTreeIndex")
+ */
+struct KDTree * buildKDTreeIndex(const double * souLat, const double * souLon, int nSou) {
+
+	double * souX;
+	double * souY;
+	double * souZ;
+	if(NULL == (souX = (double *)malloc(sizeof(double) * nSou))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (souY = (double *)malloc(sizeof(double) * nSou))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (souZ = (double *)malloc(sizeof(double) * nSou))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	// same as the block index, cells out of the valid latitude/longitude range (e.g. fill values) are never matched
+	char * souValid;
+	if(NULL == (souValid = (char *)malloc(sizeof(char) * nSou))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	int i;
+#pragma omp parallel for
+	for(i = 0; i < nSou; i++) {
+		souValid[i] = isValidLatLon(souLat[i], souLon[i]);
+		double sLat = souLat[i] * M_PI / 180;
+		double sLon = souLon[i] * M_PI / 180;
+		souX[i] = cos(sLat) * cos(sLon);
+		souY[i] = cos(sLat) * sin(sLon);
+		souZ[i] = sin(sLat);
+	}
+
+	struct KDTree * souTree = buildKDTree(souX, souY, souZ, souValid, nSou);
+	free(souValid);
+
+	return souTree;
+}
+
+/**
+ * NAME:	remapKDTreeIndexIDs
+ * DESCRIPTION:	Replace the source cell IDs returned by queries of a k-d tree with other IDs
+ * PARAMETERS:
+ *	struct KDTree * souTree:	the k-d tree of source cells
+ *	int * newID:		the new ID of each source cell the tree was built on
+ */
+void remapKDTreeIndexIDs(struct KDTree * souTree, const int * newID) {
+	int i;
+#pragma omp parallel for
+	for(i = 0; i < souTree->nPoints; i++) {
+		souTree->oriID[i] = newID[souTree->oriID[i]];
+	}
+}
+
+
+/**
+ * NAME:	queryKDTreeIndex
+ * DESCRIPTION:	Find the nearest neighboring source cell's ID for each target cell, using a k-d tree built by "buildKDTreeIndex". The input arrays are not changed
+ * PARAMETERS:
+ *	struct KDTree * souTree:	the k-d tree of source cells
+ *	double * tarLat:	the latitudes of target cells
+ *	double * tarLon:	the longitudes of target cells
+ *	int * tarNNSouID:	the output IDs of nearest neighboring source cells
+ *	double * tarNNDis	the output nearest distance for each target cell (input NULL if you don't need this field)
+ *	long long nTar:		the number of target cells
+ *	double maxR:		the maximum distance (in meters) to define neighboring cells
+ *	double approxFactor:	1 for exact search, or 1 + the relative distance error allowed (each found cell is within approxFactor times the distance
+ *				of the nearest one)
+ * Output:
+ *	int * tarNNSouID:	the output IDs of nearest neighboring source cells
+ *	double * tarNNDis	the output nearest distance for each target cell (input NULL if you don't need this field)
+ */
+void queryKDTreeIndex(const struct KDTree * souTree, const double * tarLat, const double * tarLon, int * tarNNSouID, double * tarNNDis, long long nTar, double maxR, double approxFactor) {
+
+	const double earthRadius = 6371009;
+	double maxradian = maxR / earthRadius;
+	double maxChord = 2 * sin(maxradian / 2);
+	double maxChord2 = maxChord * maxChord;
+
+	// The tree prunes on chord length. The ratio of great circle distance to chord grows with the distance, so the bound on chords is
+	// tightened by that ratio at maxR to keep the bound on great circle distances
+	double pruneScale = 1;
+	if(approxFactor > 1 && maxradian > 0) {
+		double chordFactor = approxFactor * maxChord / maxradian;
+		if(chordFactor > 1) {
+			pruneScale = 1 / (chordFactor * chordFactor);
+		}
+	}
+
+	long long i;
+#pragma omp parallel for schedule(dynamic, 1024)
+	for(i = 0; i < nTar; i++) {
+
+		if(!isValidLatLon(tarLat[i], tarLon[i])) {
+			tarNNSouID[i] = -1;
+			if(tarNNDis != NULL) {
+				tarNNDis[i] = -1;
+			}
+			continue;
+		}
+
+		double tLat = tarLat[i] * M_PI / 180;
+		double tLon = tarLon[i] * M_PI / 180;
+
+		// start just above the squared chord of maxR, so a candidate at exactly maxR is still accepted
+		double nnDis = nextafter(maxChord2, 4.0);
+		int nnSouIndex = -1;
+		queryKDTree(souTree, cos(tLat) * cos(tLon), cos(tLat) * sin(tLon), sin(tLat), 1, &nnDis, &nnSouIndex, pruneScale);
+
+		if(nnSouIndex < 0) {
+			tarNNSouID[i] = -1;
+			if(tarNNDis != NULL) {
+				tarNNDis[i] = -1;
+			}
+		}
+		else {
+			tarNNSouID[i] = souTree->oriID[nnSouIndex];
+			if(tarNNDis != NULL) {
+				tarNNDis[i] = 2 * asin(sqrt(nnDis) / 2) * earthRadius;
+			}
+		}
+	}
+}
+
+/**
+ * NAME:	queryKNNKDTreeIndex
+ * DESCRIPTION:	Find the k nearest neighboring source cells' IDs for each target cell, using a k-d tree built by "buildKDTreeIndex". The input arrays are not changed
+ * PARAMETERS:
+ *	struct KDTree * souTree:	the k-d tree of source cells
+ *	double * tarLat:	the latitudes of target cells
+ *	double * tarLon:	the longitudes of target cells
+ *	int k:			the number of nearest neighbors for each target cell
+ *	int * tarKNNSouID:	the output IDs of k nearest neighboring source cells (nTar * k, nearest first, -1 for the slots not found)
+ *	double * tarKNNDis:	the output distances (in meters) to the k nearest neighboring source cells (nTar * k, -1 for the slots not found)
+ *	long long nTar:		the number of target cells
+ *	double maxR:		the maximum distance (in meters) to define neighboring cells
+ * Output:
+ *	int * tarKNNSouID:	the output IDs of k nearest neighboring source cells
+ *	double * tarKNNDis:	the output distances to the k nearest neighboring source cells
+ */
+void queryKNNKDTreeIndex(const struct KDTree * souTree, const double * tarLat, const double * tarLon, int k, int * tarKNNSouID, double * tarKNNDis, long long nTar, double maxR) {
+
+	const double earthRadius = 6371009;
+	double maxradian = maxR / earthRadius;
+	double maxChord = 2 * sin(maxradian / 2);
+	double maxChord2 = maxChord * maxChord;
+
+	long long i;
+#pragma omp parallel for schedule(dynamic, 1024)
+	for(i = 0; i < nTar; i++) {
+
+		int * knnID = tarKNNSouID + (size_t)i * k;
+		double * knnDis = tarKNNDis + (size_t)i * k;
+
+		// start just above the squared chord of maxR, so a candidate at exactly maxR is still accepted
+		for(int l = 0; l < k; l++) {
+			knnID[l] = -1;
+			knnDis[l] = nextafter(maxChord2, 4.0);
+		}
+
+		if(isValidLatLon(tarLat[i], tarLon[i])) {
+			double tLat = tarLat[i] * M_PI / 180;
+			double tLon = tarLon[i] * M_PI / 180;
+			queryKDTree(souTree, cos(tLat) * cos(tLon), cos(tLat) * sin(tLon), sin(tLat), k, knnDis, knnID, 1);
+		}
+
+		for(int l = 0; l < k; l++) {
+			if(knnID[l] < 0) {
+				knnDis[l] = -1;
+			}
+			else {
+				knnID[l] = souTree->oriID[knnID[l]];
+				knnDis[l] = 2 * asin(sqrt(knnDis[l]) / 2) * earthRadius;
+			}
+		}
+	}
+}
+
+/**
+ * NAME:	queryRadiusKDTreeIndex
+ * DESCRIPTION:	Find all source cells within a distance of one target cell, using a k-d tree built by "buildKDTreeIndex"
+ * PARAMETERS:
+ *	struct KDTree * souTree:	the k-d tree of source cells
+ *	double tarLat, tarLon:	the latitude and longitude of the target cell
+ *	double radius:		the distance (in meters); cells at exactly this distance are included
+ *	long long * souID:	the output IDs of the source cells found, in no particular order (NULL to only count them)
+ * Output:
+ *	the number of source cells found (0 for a target cell out of the valid latitude/longitude range)
+ */
+int queryRadiusKDTreeIndex(const struct KDTree * souTree, double tarLat, double tarLon, double radius, long long * souID) {
+
+	const double earthRadius = 6371009;
+
+	if(!isValidLatLon(tarLat, tarLon)) {
+		return 0;
+	}
+	double chord = 2 * sin(radius / earthRadius / 2);
+	double tLat = tarLat * M_PI / 180;
+	double tLon = tarLon * M_PI / 180;
+	return radiusKDTree(souTree, cos(tLat) * cos(tLon), cos(tLat) * sin(tLon), sin(tLat), chord * chord, souID);
+}
+
+/**
+ * NAME:	nearestNeighborKDTree
+ * DESCRIPTION:	Find the nearest neighboring source cell's ID for each target cell, using a balanced k-d tree over 3D unit vectors of source cells
+ * PARAMETERS:
+ *	double ** psouLat:	the pointer to the array of latitudes of source cells (not changed)
+ *	double ** psouLon:	the pointer to the array of longitudes of source cells (not changed)
+ *	int nSou:		the number of source cells
+ *	double * tarLat:	the latitudes of target cells
+ *	double * tarLon:	the longitudes of target cells
+ *	int * tarNNSouID:	the output IDs of nearest neighboring source cells
+ *	double * tarNNDis	the output nearest distance for each target cell (input NULL if you don't need this field)
+ *	int nTar:		the number of target cells
+ *	double maxR:		the maximum distance (in meters) to define neighboring cells
+ * Output:
+ *	int * tarNNSouID:	the output IDs of nearest neighboring source cells
+ *	double * tarNNDis	the output nearest distance for each target cell (input NULL if you don't need this field)
+ */
+void nearestNeighborKDTree(double ** psouLat, double ** psouLon, int nSou, double * tarLat, double * tarLon, int * tarNNSouID, double * tarNNDis, int nTar, double maxR) {
+
+#if DEBUG_ELAPSE_TIME
+	double buildStart = omp_get_wtime();
+#endif
+	struct KDTree * souTree = buildKDTreeIndex(*psouLat, *psouLon, nSou);
+#if DEBUG_ELAPSE_TIME
+	double queryStart = omp_get_wtime();
+#endif
+	queryKDTreeIndex(souTree, tarLat, tarLon, tarNNSouID, tarNNDis, nTar, maxR, 1);
+#if DEBUG_ELAPSE_TIME
+	printf("DBG_TIME> %s: index build %.3f sec, query %.3f sec\n", __FUNCTION__, queryStart - buildStart, omp_get_wtime() - queryStart);
+#endif
+	freeKDTreeIndex(souTree);
+}
@@ -0,0 +1,113 @@
+/**
+ * kdtree.h
+ * Authors: agent <agent@local>
+ */
+
+#ifndef KDTREEH
+#define KDTREEH
+
+/**
+ * struct KDTree: a balanced k-d tree over 3D unit vectors of source cells
+ */
+struct KDTree;
+
+/**
+ * NAME:	buildKDTreeIndex
+ * DESCRIPTION:	Build a balanced k-d tree over 3D unit vectors of source cells. The input arrays are not changed
+ * PARAMETERS:
+ *	double * souLat:	the latitudes of source cells
+ *	double * souLon:	the longitudes of source cells
+ *	int nSou:		the number of source cells
+ * Output:
+ *	the k-d tree (release it with "freeKDTreeIndex")
+ */
+struct KDTree * buildKDTreeIndex(const double * souLat, const double * souLon, int nSou);
+
+/**
+ * NAME:	remapKDTreeIndexIDs
+ * DESCRIPTION:	Replace the source cell IDs returned by queries of a k-d tree (positions in the arrays it was built on) with other IDs,
+ *		e.g. the IDs in the full source arrays when the tree was built on a subset of them
+ * PARAMETERS:
+ *	struct KDTree * souTree:	the k-d tree of source cells
+ *	int * newID:		the new ID of each source cell the tree was built on
+ */
+void remapKDTreeIndexIDs(struct KDTree * souTree, const int * newID);
+
+/**
+ * NAME:	queryKDTreeIndex
+ * DESCRIPTION:	Find the nearest neighboring source cell's ID for each target cell, using a k-d tree built by "buildKDTreeIndex". The input arrays are not changed
+ * PARAMETERS:
+ *	struct KDTree * souTree:	the k-d tree of source cells
+ *	double * tarLat:	the latitudes of target cells
+ *	double * tarLon:	the longitudes of target cells
+ *	int * tarNNSouID:	the output IDs of nearest neighboring source cells
+ *	double * tarNNDis	the output nearest distance for each target cell (input NULL if you don't need this field)
+ *	long long nTar:		the number of target cells
+ *	double maxR:		the maximum distance (in meters) to define neighboring cells
+ *	double approxFactor:	1 for exact search, or 1 + the relative distance error allowed (each found cell is within approxFactor times the distance
+ *				of the nearest one)
+ * Output:
+ *	int * tarNNSouID:	the output IDs of nearest neighboring source cells
+ *	double * tarNNDis	the output nearest distance for each target cell (input NULL if you don't need this field)
+ */
+void queryKDTreeIndex(const struct KDTree * souTree, const double * tarLat, const double * tarLon, int * tarNNSouID, double * tarNNDis, long long nTar, double maxR, double approxFactor);
+
+/**
+ * NAME:	queryKNNKDTreeIndex
+ * DESCRIPTION:	Find the k nearest neighboring source cells' IDs for each target cell, using a k-d tree built by "buildKDTreeIndex". The input arrays are not changed
+ * PARAMETERS:
+ *	struct KDTree * souTree:	the k-d tree of source cells
+ *	double * tarLat:	the latitudes of target cells
+ *	double * tarLon:	the longitudes of target cells
+ *	int k:			the number of nearest neighbors for each target cell
+ *	int * tarKNNSouID:	the output IDs of k nearest neighboring source cells (nTar * k, nearest first, -1 for the slots not found)
+ *	double * tarKNNDis:	the output distances (in meters) to the k nearest neighboring source cells (nTar * k, -1 for the slots not found)
+ *	long long nTar:		the number of target cells
+ *	double maxR:		the maximum distance (in meters) to define neighboring cells
+ * Output:
+ *	int * tarKNNSouID:	the output IDs of k nearest neighboring source cells
+ *	double * tarKNNDis:	the output distances to the k nearest neighboring source cells
+ */
+void queryKNNKDTreeIndex(const struct KDTree * souTree, const double * tarLat, const double * tarLon, int k, int * tarKNNSouID, double * tarKNNDis, long long nTar, double maxR);
+
+/**
+ * NAME:	queryRadiusKDTreeIndex
+ * DESCRIPTION:	Find all source cells within a distance of one target cell, using a k-d tree built by "buildKDTreeIndex"
+ * PARAMETERS:
+ *	struct KDTree * souTree:	the k-d tree of source cells
+ *	double tarLat, tarLon:	the latitude and longitude of the target cell
+ *	double radius:		the distance (in meters); cells at exactly this distance are included
+ *	long long * souID:	the output IDs of the source cells found, in no particular order (NULL to only count them)
+ * Output:
+ *	the number of source cells found (0 for a target cell out of the valid latitude/longitude range)
+ */
+int queryRadiusKDTreeIndex(const struct KDTree * souTree, double tarLat, double tarLon, double radius, long long * souID);
+
+/**
+ * NAME:	freeKDTreeIndex
+ * DESCRIPTION:	Release a k-d tree built by "buildKDTreeIndex"
+ */
+void freeKDTreeIndex(struct KDTree * tree);
+
+/**
+ * NAME:	nearestNeighborKDTree
+ * DESCRIPTION:	Find the nearest neighboring source cell's ID for each target cell, using a balanced k-d tree over 3D unit vectors of source cells
+ *		instead of the latitude/longitude block grid. Results are the same as "nearestNeighborBlockIndex" (exact search within maxR), but
+ *		query cost does not depend on a fixed block size, which suits sources with uneven density (e.g. MODIS edge of scan or scattered ASTER scenes)
+ * PARAMETERS:
+ *	double ** psouLat:	the pointer to the array of latitudes of source cells (not changed)
+ *	double ** psouLon:	the pointer to the array of longitudes of source cells (not changed)
+ *	int nSou:		the number of source cells
+ *	double * tarLat:	the latitudes of target cells
+ *	double * tarLon:	the longitudes of target cells
+ *	int * tarNNSouID:	the output IDs of nearest neighboring source cells
+ *	double * tarNNDis	the output nearest distance for each target cell (input NULL if you don't need this field)
+ *	int nTar:		the number of target cells
+ *	double maxR:		the maximum distance (in meters) to define neighboring cells
+ * Output:
+ *	int * tarNNSouID:	the output IDs of nearest neighboring source cells
+ *	double * tarNNDis	the output nearest distance for each target cell (input NULL if you don't need this field)
+ */
+void nearestNeighborKDTree(double ** psouLat, double ** psouLon, int nSou, double * tarLat, double * tarLon, int * tarNNSouID, double * tarNNDis, int nTar, double maxR);
+
+#endif
@@ -8,7 +8,17 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <string.h>
 #include <omp.h>
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "reproject.h"
+#include "kdtree.h"
+#include "AF_debug.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -19,146 +29,300 @@
  * ITEMS:
  * 	double blockSizeR:	the longtitude range of each block
  * 	int nBlocks:		the number of longtitude blocks in this row
- *	int * indexID:		the starting and ending index (of the long arrays of data) of locations in each block
+ *	int firstBlock:		the first block kept in this row (the block of the western boundary of the locations)
+ *	int nStored:		the number of blocks kept in this row, from firstBlock eastward (wrapping around the dateline).
+ *				Blocks farther east hold no location, so the index only takes memory for the longitude range of the locations
+ *	int * indexID:		the starting and ending index (of the long arrays of data) of locations in each kept block
+ *				(rows point into one flat CSR array: the ending index of a row is the starting index of the next row)
  */
 struct LonBlocks {
 	double blockSizeR;
 	int nBlocks;
+	int firstBlock;
+	int nStored;
 	int * indexID;
 };
 
-struct LonBlocks * pointIndexOnLatLon(double ** plat, double ** plon, int * oriID, int count, int nBlockY, double maxradian) {
+/**
+ * NAME:	pointIndexOnLatLon
+ * DESCRIPTION:	Build the latitude/longitude block index of locations (in radians). Locations are reordered block by block (and in the original order
+ *		within a block), and locations outside the valid latitude/longitude range are dropped. Only the rows holding locations, and in each
+ *		row the blocks from the western boundary of the locations to the easternmost location, are kept, so fine blocks over a small
+ *		region do not take memory for the whole globe.
+ *		The index is built in parallel: per-thread histograms of rows, a prefix sum and a parallel scatter into rows, and then
+ *		each row is sorted into its blocks (counting sort) by one thread.
+ * PARAMETERS:
+ *	double ** plat:		the pointer to the array of latitudes (replaced by the reordered array)
+ *	double ** plon:		the pointer to the array of longitudes (replaced by the reordered array)
+ *	int * oriID:		the output original IDs of reordered locations
+ *	int count:		the number of locations
+ *	int nBlockY:		the number of rows
+ *	double maxradian:	the minimum longitude range (in radians on the sphere) of a block
+ *	double lonWest:		the western boundary (in radians) of the longitude range of the locations (-M_PI if they span all longitudes)
+ *	int * rowBegin, int * rowEnd:	the output range of rows kept in the index (at least one row)
+ * Output:
+ *	the block index of rows rowBegin to rowEnd - 1 (release it with "freeLatLonIndex")
+ */
+struct LonBlocks * pointIndexOnLatLon(double ** plat, double ** plon, int * oriID, int count, int nBlockY, double maxradian, double lonWest, int * rowBegin, int * rowEnd) {
 
 	double *lat = *plat;
 	double *lon = *plon;
 
-	struct LonBlocks * blockIndex;
-	int ** pointsInB;
-	if(NULL == (blockIndex = (struct LonBlocks *)malloc(sizeof(struct LonBlocks) * nBlockY))) {
+	double latBlockR = M_PI/nBlockY;
+
+	int * cellRow;
+	int * cellCol;
+	int * rowOriID;
+	int * rowCol;
+	if(NULL == (cellRow = (int *)malloc(sizeof(int) * (count > 0 ? count : 1)))) {
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);	
+		exit(1);
 	}
-	if(NULL == (pointsInB = (int **)malloc(sizeof(int *) * nBlockY))) {
+	if(NULL == (cellCol = (int *)malloc(sizeof(int) * (count > 0 ? count : 1)))) {
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);	
+		exit(1);
 	}
-
-	double latBlockR = M_PI/nBlockY;
-
-	blockIndex[0].blockSizeR = 2 * M_PI;
-	blockIndex[0].nBlocks = 1;
-	if(NULL == (blockIndex[0].indexID = (int *) malloc (sizeof(int) * 2))) {
+	if(NULL == (rowOriID = (int *)malloc(sizeof(int) * (count > 0 ? count : 1)))) {
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);	
+		exit(1);
 	}
-	if(NULL == (pointsInB[0] = (int *)malloc(sizeof(int)))) {
+	if(NULL == (rowCol = (int *)malloc(sizeof(int) * (count > 0 ? count : 1)))) {
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);	
+		exit(1);
+	}
+
+	// rows of locations, and the range of rows holding them
+	int minRow = nBlockY;
+	int maxRow = -1;
+	int i, j;
+#pragma omp parallel for reduction(min:minRow) reduction(max:maxRow)
+	for(i = 0; i < count; i++) {
+		int rowID = (int)((lat[i] + M_PI/2) / latBlockR);
+		if(rowID >= 0 && rowID < nBlockY) {
+			if(rowID < minRow) {
+				minRow = rowID;
+			}
+			if(rowID > maxRow) {
+				maxRow = rowID;
+			}
+		}
+		else {
+			rowID = -1;
+		}
+		cellRow[i] = rowID;
 	}
-	pointsInB[0][0] = 0;
+	if(maxRow < minRow) {
+		minRow = 0;
+		maxRow = 0;
+	}
+	int nRows = maxRow - minRow + 1;
+	*rowBegin = minRow;
+	*rowEnd = maxRow + 1;
 
-	blockIndex[nBlockY - 1].blockSizeR = 2 * M_PI;
-	blockIndex[nBlockY - 1].nBlocks = 1;
-	if(NULL == (blockIndex[nBlockY - 1].indexID = (int *) malloc (sizeof(int) * 2))) {
+	struct LonBlocks * blockIndex;
+	int * rowBlockStart;
+	int * rowStart;
+	if(NULL == (blockIndex = (struct LonBlocks *)malloc(sizeof(struct LonBlocks) * nRows))) {
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);	
 	}
-	if(NULL == (pointsInB[nBlockY - 1] = (int *)malloc(sizeof(int)))) {
+	if(NULL == (rowBlockStart = (int *)malloc(sizeof(int) * (nRows + 1)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);	
+	}
+	if(NULL == (rowStart = (int *)malloc(sizeof(int) * (nRows + 1)))) {
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);	
 	}
-	pointsInB[nBlockY - 1][0] = 0;
-
 
-	int i, j;
-	double highestLat;
-	for(i = 1; i < nBlockY - 1; i++) {
+#pragma omp parallel for
+	for(j = 0; j < nRows; j++) {
 
-		if(i < (nBlockY + 1) / 2) {
-			highestLat = -M_PI/2 + latBlockR * i;
+		int row = minRow + j;
+		if(row == 0 || row == nBlockY - 1) {
+			blockIndex[j].nBlocks = 1;
 		}
 		else {
-			highestLat = -M_PI/2 + latBlockR * (i + 1);
-		}
-		blockIndex[i].nBlocks = (int)(2 * M_PI * cos(highestLat)/ maxradian);
-//		printf("%d,%d\n", i, blockIndex[i].nBlocks);
-		if(blockIndex[i].nBlocks < 4) {
-			blockIndex[i].nBlocks = 1;
+			double highestLat;
+			if(row < (nBlockY + 1) / 2) {
+				highestLat = -M_PI/2 + latBlockR * row;
+			}
+			else {
+				highestLat = -M_PI/2 + latBlockR * (row + 1);
+			}
+			blockIndex[j].nBlocks = (int)(2 * M_PI * cos(highestLat)/ maxradian);
+			if(blockIndex[j].nBlocks < 4) {
+				blockIndex[j].nBlocks = 1;
+			}
 		}
-		blockIndex[i].blockSizeR = 2 * M_PI / blockIndex[i].nBlocks;
-
-		if(NULL == (blockIndex[i].indexID = (int *) malloc (sizeof(int) * (blockIndex[i].nBlocks + 1)))) {
-			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-			exit(1);
-        	}
-		if(NULL == (pointsInB[i] = (int *) malloc (sizeof(int) * (blockIndex[i].nBlocks + 1)))) {
-			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-			exit(1);
-        	}
-		for(j = 0; j < blockIndex[i].nBlocks; j++) {
-			pointsInB[i][j] = 0; 
+		blockIndex[j].blockSizeR = 2 * M_PI / blockIndex[j].nBlocks;
+		blockIndex[j].firstBlock = (int)((lonWest + M_PI) / blockIndex[j].blockSizeR);
+		if(blockIndex[j].firstBlock < 0 || blockIndex[j].firstBlock >= blockIndex[j].nBlocks) {
+			blockIndex[j].firstBlock = 0;
 		}
-		
+		blockIndex[j].nStored = 0;
 	}
 
-	int rowID, colID;
+	// blocks of locations, counted eastward from the first block of their row
+#pragma omp parallel for
 	for(i = 0; i < count; i++) {
 	
-		rowID = (int)((lat[i] + M_PI/2) / latBlockR);
+		int rowID = cellRow[i];
+		int colID = -1;
 		
-		if(rowID >= 0 && rowID < nBlockY) {
+		if(rowID >= 0) {
+			rowID -= minRow;
 			colID = (int)((lon[i] + M_PI) / blockIndex[rowID].blockSizeR);
-			if(colID >= 0 && colID < blockIndex[rowID].nBlocks) {
-				pointsInB[rowID][colID] ++;
+			if(colID < 0 || colID >= blockIndex[rowID].nBlocks) {
+				rowID = -1;
+			}
+			else {
+				colID -= blockIndex[rowID].firstBlock;
+				if(colID < 0) {
+					colID += blockIndex[rowID].nBlocks;
+				}
+			}
+		}
+		cellRow[i] = rowID;
+		cellCol[i] = colID;
+	}
+
+	// Locations are scattered into rows. Each thread counts and then scatters the same (static) range of locations,
+	// so the original order is kept within each row.
+	int * rowCount = NULL;
+#pragma omp parallel private(i, j)
+	{
+		int tid = omp_get_thread_num();
+		int nThreads = omp_get_num_threads();
+
+#pragma omp single
+		{
+			if(NULL == (rowCount = (int *)calloc((size_t)nThreads * nRows, sizeof(int)))) {
+				printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+				exit(1);
+			}
+		}
+
+		int * hist = rowCount + (size_t)tid * nRows;
+#pragma omp for schedule(static)
+		for(i = 0; i < count; i++) {
+			if(cellRow[i] >= 0) {
+				hist[cellRow[i]] ++;
+			}
+		}
+
+#pragma omp single
+		{
+			int newCount = 0;
+			for(j = 0; j < nRows; j++) {
+				rowStart[j] = newCount;
+				for(int t = 0; t < nThreads; t++) {
+					int c = rowCount[(size_t)t * nRows + j];
+					rowCount[(size_t)t * nRows + j] = newCount;
+					newCount += c;
+				}
+			}
+			rowStart[nRows] = newCount;
+		}
+
+#pragma omp for schedule(static)
+		for(i = 0; i < count; i++) {
+			if(cellRow[i] >= 0) {
+				int pos = hist[cellRow[i]] ++;
+				rowOriID[pos] = i;
+				rowCol[pos] = cellCol[i];
 			}
 		}
 	}
 
-	int newCount = 0;
+	free(rowCount);
+	free(cellRow);
+	free(cellCol);
 
-	for(i = 0; i < nBlockY; i++) {
-//		printf("%d:\t%d\n", i, newCount);
-		blockIndex[i].indexID[0] = newCount;
-		for(j = 0; j < blockIndex[i].nBlocks; j++)	{
-			newCount += pointsInB[i][j];
-			blockIndex[i].indexID[j+1] = newCount;
-			pointsInB[i][j] = blockIndex[i].indexID[j];
+	// each row keeps its blocks up to the easternmost location
+#pragma omp parallel for private(i) schedule(dynamic, 16)
+	for(j = 0; j < nRows; j++) {
+		int nStored = 0;
+		for(i = rowStart[j]; i < rowStart[j + 1]; i++) {
+			if(rowCol[i] + 1 > nStored) {
+				nStored = rowCol[i] + 1;
+			}
+		}
+		blockIndex[j].nStored = nStored;
+	}
+
+	int maxBlocks = 1;
+	rowBlockStart[0] = 0;
+	for(j = 0; j < nRows; j++) {
+		rowBlockStart[j + 1] = rowBlockStart[j] + blockIndex[j].nStored;
+		if(blockIndex[j].nStored > maxBlocks) {
+			maxBlocks = blockIndex[j].nStored;
 		}
 	}
 
+	int * indexID;
+	if(NULL == (indexID = (int *) malloc (sizeof(int) * (rowBlockStart[nRows] + 1)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	for(j = 0; j < nRows; j++) {
+		blockIndex[j].indexID = indexID + rowBlockStart[j];
+	}
 
 	double * newLat;
 	double * newLon;
-	if(NULL == (newLon = (double *)malloc(sizeof(double) * count))) {
+	if(NULL == (newLon = (double *)malloc(sizeof(double) * (count > 0 ? count : 1)))) {
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);
 	} 
-	if(NULL == (newLat = (double *)malloc(sizeof(double) * count))) {
+	if(NULL == (newLat = (double *)malloc(sizeof(double) * (count > 0 ? count : 1)))) {
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);
 	}
-	
-	for(i = 0; i < count; i++) {
-	
-		rowID = (int)((lat[i] + M_PI/2) / latBlockR);
-		
-		if(rowID >= 0 && rowID < nBlockY) {
-			colID = (int)((lon[i] + M_PI) / blockIndex[rowID].blockSizeR);
-			if(colID >= 0 && colID < blockIndex[rowID].nBlocks) {
-				
-				newLon[pointsInB[rowID][colID]] = lon[i];
-				newLat[pointsInB[rowID][colID]] = lat[i];
-				oriID[pointsInB[rowID][colID]] = i;
-				pointsInB[rowID][colID] ++;
+
+	// counting sort of each row into its blocks
+#pragma omp parallel private(i, j)
+	{
+		int * pointsInB;
+		if(NULL == (pointsInB = (int *)malloc(sizeof(int) * maxBlocks))) {
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+
+#pragma omp for schedule(dynamic, 16)
+		for(j = 0; j < nRows; j++) {
+			int nBlocks = blockIndex[j].nStored;
+			int * rowIndexID = blockIndex[j].indexID;
+			int k;
+
+			for(k = 0; k < nBlocks; k++) {
+				pointsInB[k] = 0;
+			}
+			for(i = rowStart[j]; i < rowStart[j + 1]; i++) {
+				pointsInB[rowCol[i]] ++;
+			}
+			int newCount = rowStart[j];
+			for(k = 0; k < nBlocks; k++) {
+				rowIndexID[k] = newCount;
+				newCount += pointsInB[k];
+				pointsInB[k] = rowIndexID[k];
+			}
+			for(i = rowStart[j]; i < rowStart[j + 1]; i++) {
+				int pos = pointsInB[rowCol[i]] ++;
+				newLon[pos] = lon[rowOriID[i]];
+				newLat[pos] = lat[rowOriID[i]];
+				oriID[pos] = rowOriID[i];
 			}
 		}
+
+		free(pointsInB);
 	}
-	
-	for(i = 0; i < nBlockY; i++) {
-		free(pointsInB[i]);
-	}
+	indexID[rowBlockStart[nRows]] = rowStart[nRows];
 
-	free(pointsInB);
+	free(rowOriID);
+	free(rowCol);
+	free(rowBlockStart);
+	free(rowStart);
 
 	free(lon);
 	free(lat);
@@ -169,8 +333,29 @@ struct LonBlocks * pointIndexOnLatLon(double ** plat, double ** plon, int * oriI
 	return blockIndex;
 }
 
+/**
+ * NAME:	freeLatLonIndex
+ * DESCRIPTION:	Release a block index generated from "pointIndexOnLatLon"
+ */
+static void freeLatLonIndex(struct LonBlocks * blockIndex) {
+	free(blockIndex[0].indexID);
+	free(blockIndex);
+}
 
 
+/**
+ * NAME:	pointIndexOnLat
+ * DESCRIPTION:	Build the latitude block index of locations (in radians), in parallel with per-thread histograms, a prefix sum and a parallel scatter.
+ *		Locations are reordered row by row (and in the original order within a row), and locations outside the valid latitude range are dropped.
+ * PARAMETERS:
+ *	double ** plat:		the pointer to the array of latitudes (replaced by the reordered array)
+ *	double ** plon:		the pointer to the array of longitudes (replaced by the reordered array)
+ *	int * oriID:		the output original IDs of reordered locations
+ *	int count:		the number of locations
+ *	int nBlockY:		the number of rows
+ * Output:
+ *	the starting and ending index of locations in each row (nBlockY + 1 items)
+ */
 int * pointIndexOnLat(double ** plat, double ** plon,  int * oriID, int count, int nBlockY) {
 
 	double *lat = *plat;
@@ -179,7 +364,8 @@ int * pointIndexOnLat(double ** plat, double ** plon,  int * oriID, int count, i
 	double blockR = M_PI/nBlockY;
 
 	int * index;
-	int * pointsInB;
+	int * cellRow;
+	int * rowCount = NULL;
 	
 	double * newLon;
 	double * newLat;
@@ -190,536 +376,4492 @@ int * pointIndexOnLat(double ** plat, double ** plon,  int * oriID, int count, i
 		exit(1);
 	}
 
-	if(NULL == (pointsInB = (int *)malloc(sizeof(int) * nBlockY)))
+	if(NULL == (cellRow = (int *)malloc(sizeof(int) * count)))
 	{
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);
 	}
 
-	for(int i = 0; i < nBlockY; i++)
-	{
-		pointsInB[i] = 0;
+	int i;
+#pragma omp parallel for
+	for(i = 0; i < count; i++) {
+		int blockID = (int)((lat[i] + M_PI/2) / blockR);
+		cellRow[i] = (blockID >= 0 && blockID < nBlockY) ? blockID : -1;
 	}
 
-	int blockID;
-		
-	for(int i = 0; i < count; i++) {
-	
-		blockID = (int)((lat[i] + M_PI/2) / blockR);
-		
-		if(blockID >= 0 && blockID < nBlockY) {
-			pointsInB[blockID] ++;
+#pragma omp parallel private(i)
+	{
+		int tid = omp_get_thread_num();
+		int nThreads = omp_get_num_threads();
+
+#pragma omp single
+		{
+			if(NULL == (rowCount = (int *)calloc((size_t)nThreads * nBlockY, sizeof(int)))) {
+				printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+				exit(1);
+			}
 		}
-	}
 
-	index[0] = 0;
-	for(int i = 1; i < nBlockY + 1; i++) {
-		index[i] = index[i - 1] + pointsInB[i - 1];
-	}
+		int * hist = rowCount + (size_t)tid * nBlockY;
+#pragma omp for schedule(static)
+		for(i = 0; i < count; i++) {
+			if(cellRow[i] >= 0) {
+				hist[cellRow[i]] ++;
+			}
+		}
 
-	if(NULL == (newLon = (double *)malloc(sizeof(double) * index[nBlockY]))) {
-		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);
-	} 
-	if(NULL == (newLat = (double *)malloc(sizeof(double) * index[nBlockY]))) {
-		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);
-	}
-	
-	pointsInB[0] = 0;
-	for(int i = 1; i < nBlockY; i++) {
-		pointsInB[i] = index[i];
-	}
-	
-	for(int i = 0; i < count; i++) {
-		
-		blockID = (int)((lat[i] + M_PI/2) / blockR);
-		if(blockID >= 0 && blockID < nBlockY) {
-			newLon[pointsInB[blockID]] = lon[i];
-			newLat[pointsInB[blockID]] = lat[i];
-			oriID[pointsInB[blockID]] = i;
-			pointsInB[blockID] ++;
-	
+#pragma omp single
+		{
+			int newCount = 0;
+			for(int j = 0; j < nBlockY; j++) {
+				index[j] = newCount;
+				for(int t = 0; t < nThreads; t++) {
+					int c = rowCount[(size_t)t * nBlockY + j];
+					rowCount[(size_t)t * nBlockY + j] = newCount;
+					newCount += c;
+				}
+			}
+			index[nBlockY] = newCount;
+
+			if(NULL == (newLon = (double *)malloc(sizeof(double) * newCount))) {
+				printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+				exit(1);
+			} 
+			if(NULL == (newLat = (double *)malloc(sizeof(double) * newCount))) {
+				printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+				exit(1);
+			}
 		}
-	}
-	
 
+#pragma omp for schedule(static)
+		for(i = 0; i < count; i++) {
+			if(cellRow[i] >= 0) {
+				int pos = hist[cellRow[i]] ++;
+				newLon[pos] = lon[i];
+				newLat[pos] = lat[i];
+				oriID[pos] = i;
+			}
+		}
+	}
 
-	free(pointsInB);
+	free(rowCount);
+	free(cellRow);
 	free(lon);
 	free(lat);
 
-	count = index[nBlockY];
 	*plon = newLon;
 	*plat = newLat;
 
-//	printf("%0x\n", lat);
-
 	return index;
 }
 
- /**
- * NAME:	nearestNeighborBlockIndex
- * DESCRIPTION:	Find the nearest neighboring source cell's ID for each target cell
+/**
+ * NAME:	latLonToUnitVector
+ * DESCRIPTION:	Convert locations (in radians) to 3D unit vectors on the sphere. The output arrays may be the same as the input arrays (in place conversion)
  * PARAMETERS:
- *	double ** psouLat:	the pointer to the array of latitudes of source cells (the data are changed during in the function, so please do the output before this function)
- *	double ** psouLon:	the pointer to the array of longitudes of source cells (the data are changed during in the function, so please do the output before this function)
- *	int nSou:		the number of source cells
- *	double * tarLat:	the latitudes of target cells
- *	double * tarLon:	the longitudes of target cells
- *	int * tarNNSouID:	the output IDs of nearest neighboring source cells 
- *	double * tarNNDis	the output nearest distance for each target cell (input NULL if you don't need this field)
- *	int nTar:		the number of target cells
- *	double maxR:		the maximum distance (in meters) to define neighboring cells
- * Output: 	
- *	int * tarNNSouID:	the output IDs of nearest neighboring source cells 
- *	double * tarNNDis	the output nearest distance for each target cell (input NULL if you don't need this field)
+ *	double * lat:	the latitudes (in radians)
+ *	double * lon:	the longitudes (in radians)
+ *	double * x, * y, * z:	the output unit vector components
+ *	int count:	the number of locations
  */
-void nearestNeighborBlockIndex(double ** psouLat, double ** psouLon, int nSou, double * tarLat, double * tarLon, int * tarNNSouID, double * tarNNDis, int nTar, double maxR) {
-
-	double * souLat = *psouLat;
-	double * souLon = *psouLon;
-
-	const double earthRadius = 6371009;
-	//const double earthRadius = 6367444;
-	double maxradian = maxR / earthRadius;
-
-	double blockSizeRadian = maxradian;
-	if(maxR < 1000) {
-		blockSizeRadian = 1000 / earthRadius;
-	}
-
-	int nBlockY = M_PI / blockSizeRadian;
-
-	double latBlockR = M_PI / nBlockY;
+static void latLonToUnitVector(double * lat, double * lon, double * x, double * y, double * z, int count) {
 
-	int i, j, k, kk, l;
+	int i;
 #pragma omp parallel for
-	for(i = 0; i < nSou; i++) {
-		
-/*		if(i == 0)
-		{
-			printf("%d threads\n", omp_get_num_threads());
-		}
-*/
-		souLat[i] = souLat[i] * M_PI / 180;
-		souLon[i] = souLon[i] * M_PI / 180;
+	for(i = 0; i < count; i++) {
+		double cosLat = cos(lat[i]);
+		double sinLat = sin(lat[i]);
+		double cosLon = cos(lon[i]);
+		double sinLon = sin(lon[i]);
+		x[i] = cosLat * cosLon;
+		y[i] = cosLat * sinLon;
+		z[i] = sinLat;
 	}
+}
 
-#pragma omp parallel for
-	for(i = 0; i < nTar; i++) {
-		tarLat[i] = tarLat[i] * M_PI / 180;
-		tarLon[i] = tarLon[i] * M_PI / 180;
-	}
+/**
+ * Squared chord length between two unit vectors separated by a great circle distance (in radians), and the inverse.
+ * Unlike acos of the dot product, these keep full precision for ASTER-scale (15-90 m) distances.
+ */
+static inline double chordSquareFromRadian(double radian) {
+	double chord = 2 * sin(radian / 2);
+	return chord * chord;
+}
 
-	int * souID;
-	if(NULL == (souID = (int *)malloc(sizeof(double) * nSou))) {
-		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
-		exit(1);
-	}
+static inline double radianFromChordSquare(double chord2) {
+	return 2 * asin(sqrt(chord2) / 2);
+}
 
-	struct LonBlocks * souIndex = pointIndexOnLatLon(psouLat, psouLon, souID, nSou, nBlockY, blockSizeRadian);
+/**
+ * NAME:	scanNearestCandidate
+ * DESCRIPTION:	Scan a contiguous run [begin, end) of source unit vectors (structure of arrays) for the one closest to a target.
+ *		Uses AVX-512 (8 candidates) or AVX2 (4 candidates) per instruction when compiled with -mavx512f or -mavx2, with a scalar fallback and tail.
+ *		A candidate replaces the current nearest one only if it is strictly closer, and ties within the run go to the lowest index,
+ *		so the result is the same as a plain sequential scan.
+ * PARAMETERS:
+ *	double * souX, * souY, * souZ:	the unit vectors of source cells
+ *	int begin, int end:	the range of source cells to scan
+ *	double tX, tY, tZ:	the unit vector of the target cell
+ *	double * nnDis:		the current nearest squared chord length (initialize it to just above the squared chord of maxR)
+ *	int * nnID:		the current nearest source cell (index into souX, -1 if none)
+ * Output:
+ *	double * nnDis, int * nnID are updated if a closer candidate is found
+ */
+static inline void scanNearestCandidate(const double * souX, const double * souY, const double * souZ, int begin, int end, double tX, double tY, double tZ, double * nnDis, int * nnID) {
 
-	souLat = *psouLat;
-	souLon = *psouLon;
+	int l = begin;
+	double bestDis = *nnDis;
+	int bestID = *nnID;
 
-#pragma omp parallel for private(j, k, kk, l)
-	for(i = 0; i < nTar; i ++) {
-		
-/*		if(i == 0)
-		{
-			printf("%d threads\n", omp_get_num_threads());
+#if defined(__AVX512F__) || defined(__AVX2__)
+#if defined(__AVX512F__)
+	const int nLanes = 8;
+	if(end - begin >= nLanes) {
+		__m512d vTX = _mm512_set1_pd(tX);
+		__m512d vTY = _mm512_set1_pd(tY);
+		__m512d vTZ = _mm512_set1_pd(tZ);
+		__m512d vBest = _mm512_set1_pd(bestDis);
+		__m512d vBestID = _mm512_set1_pd(-1);
+		// candidate indices are kept as doubles, which are exact for any int
+		__m512d vID = _mm512_setr_pd(l, l + 1, l + 2, l + 3, l + 4, l + 5, l + 6, l + 7);
+		__m512d vStep = _mm512_set1_pd(nLanes);
+		for(; l + nLanes <= end; l += nLanes) {
+			__m512d dX = _mm512_sub_pd(_mm512_loadu_pd(souX + l), vTX);
+			__m512d dY = _mm512_sub_pd(_mm512_loadu_pd(souY + l), vTY);
+			__m512d dZ = _mm512_sub_pd(_mm512_loadu_pd(souZ + l), vTZ);
+			__m512d pDis = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(dX, dX), _mm512_mul_pd(dY, dY)), _mm512_mul_pd(dZ, dZ));
+			__mmask8 closer = _mm512_cmp_pd_mask(pDis, vBest, _CMP_LT_OQ);
+			vBest = _mm512_mask_blend_pd(closer, vBest, pDis);
+			vBestID = _mm512_mask_blend_pd(closer, vBestID, vID);
+			vID = _mm512_add_pd(vID, vStep);
 		}
-*/
-		double tLat = tarLat[i];
-		double tLon = tarLon[i];
-		double sLat, sLon;
-		int rowID, colID;
-		double pDis;
-		double nnDis;
-		int nnSouID = -1;
-/*
-		if(i == 0) {
-			printf("%d\n", omp_get_num_threads());
+		double laneDis[8], laneID[8];
+		_mm512_storeu_pd(laneDis, vBest);
+		_mm512_storeu_pd(laneID, vBestID);
+#else
+	const int nLanes = 4;
+	if(end - begin >= nLanes) {
+		__m256d vTX = _mm256_set1_pd(tX);
+		__m256d vTY = _mm256_set1_pd(tY);
+		__m256d vTZ = _mm256_set1_pd(tZ);
+		__m256d vBest = _mm256_set1_pd(bestDis);
+		__m256d vBestID = _mm256_set1_pd(-1);
+		// candidate indices are kept as doubles, which are exact for any int
+		__m256d vID = _mm256_setr_pd(l, l + 1, l + 2, l + 3);
+		__m256d vStep = _mm256_set1_pd(nLanes);
+		for(; l + nLanes <= end; l += nLanes) {
+			__m256d dX = _mm256_sub_pd(_mm256_loadu_pd(souX + l), vTX);
+			__m256d dY = _mm256_sub_pd(_mm256_loadu_pd(souY + l), vTY);
+			__m256d dZ = _mm256_sub_pd(_mm256_loadu_pd(souZ + l), vTZ);
+			__m256d pDis = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dX, dX), _mm256_mul_pd(dY, dY)), _mm256_mul_pd(dZ, dZ));
+			__m256d closer = _mm256_cmp_pd(pDis, vBest, _CMP_LT_OQ);
+			vBest = _mm256_blendv_pd(vBest, pDis, closer);
+			vBestID = _mm256_blendv_pd(vBestID, vID, closer);
+			vID = _mm256_add_pd(vID, vStep);
 		}
-*/
-		rowID = (tLat + M_PI / 2) / latBlockR;
-
-		nnDis = -1;
-
-		for(j = rowID - 1; j < rowID + 2; j ++) {
-			if(j < 0 || j >= nBlockY) {
+		double laneDis[4], laneID[4];
+		_mm256_storeu_pd(laneDis, vBest);
+		_mm256_storeu_pd(laneID, vBestID);
+#endif
+		// min-reduction over lanes: smallest distance, then lowest index
+		double runDis = bestDis;
+		int runID = -1;
+		for(int v = 0; v < nLanes; v++) {
+			if(laneID[v] < 0) {
 				continue;
 			}
-			colID = (tLon + M_PI) / souIndex[j].blockSizeR;
-
-			if(souIndex[j].nBlocks == 1) {
-				for(l = souIndex[j].indexID[0]; l < souIndex[j].indexID[1]; l++) {
-					
-					sLat = souLat[l];
-					sLon = souLon[l];
-
-					pDis = acos(sin(tLat) * sin(sLat) + cos(tLat) * cos(sLat) * cos(tLon - sLon));
-
-					if((nnDis < 0 || nnDis > pDis) && pDis <= maxradian) {
-
-						nnDis = pDis;
-						nnSouID = souID[l];
-					}
-				}
-			} 
-			else {
-				for(k = colID - 1; k < colID + 2; k ++) {
-					kk = k;
-					if(kk < 0) {
-						kk = souIndex[j].nBlocks-1; 
-					}
-					if(kk >= souIndex[j].nBlocks) {
-						kk = 0;
-					}
-					for(l = souIndex[j].indexID[kk]; l < souIndex[j].indexID[kk+1]; l++) {
-						
-						sLat = souLat[l];
-						sLon = souLon[l];
-
-						pDis = acos(sin(tLat) * sin(sLat) + cos(tLat) * cos(sLat) * cos(tLon - sLon));
-
-						if((nnDis < 0 || nnDis > pDis) && pDis <= maxradian) {
-
-							nnDis = pDis;
-							nnSouID = souID[l];
-						}
-				
-					}
-				}
-			}
-		}
-
-
-		if(nnDis < 0) {
-			tarNNSouID[i] = -1;
-			if(tarNNDis != NULL) { 
-				tarNNDis[i] = -1;
+			if(runID < 0 || laneDis[v] < runDis || (laneDis[v] == runDis && (int)laneID[v] < runID)) {
+				runDis = laneDis[v];
+				runID = (int)laneID[v];
 			}
 		}
-		else {
-			tarNNSouID[i] = nnSouID;
-			if(tarNNDis != NULL) {
-				tarNNDis[i] = nnDis * earthRadius;
-			}
+		if(runID >= 0) {
+			bestDis = runDis;
+			bestID = runID;
 		}
-			
-	}	
+	}
+#endif
 
-	free(souID);
-	for(i = 0; i < nBlockY; i++) {
-//		printf("%d,\t%lf\n", souIndex[i].nBlocks, souIndex[i].blockSizeR);
-		free(souIndex[i].indexID);
+	for(; l < end; l++) {
+		double dX = souX[l] - tX;
+		double dY = souY[l] - tY;
+		double dZ = souZ[l] - tZ;
+		double pDis = dX * dX + dY * dY + dZ * dZ;
+		if(pDis < bestDis) {
+			bestDis = pDis;
+			bestID = l;
+		}
 	}
-	free(souIndex);
 
-	return; 
+	*nnDis = bestDis;
+	*nnID = bestID;
 }
 
-
 /**
- * NAME:	nearestNeighbor
- * DESCRIPTION:	Find the nearest neighboring source cell's ID for each target cell
- * PARAMETERS:
- *	double ** psouLat:	the pointer to the array of latitudes of source cells (the data are changed during in the function, so please do the output before this function)
- *	double ** psouLon:	the pointer to the array of longitudes of source cells (the data are changed during in the function, so please do the output before this function)
- *	int nSou:		the number of source cells
- *	double * tarLat:	the latitudes of target cells
- *	double * tarLon:	the longitudes of target cells
- *	int * tarNNSouID:	the output IDs of nearest neighboring source cells 
- *	double * tarNNDis	the output nearest distance for each target cell (input NULL if you don't need this field)
- *	int nTar:		the number of target cells
- *	double maxR:		the maximum distance (in meters) to define neighboring cells
- * Output: 	
- *	int * tarNNSouID:	the output IDs of nearest neighboring source cells 
- *	double * tarNNDis	the output nearest distance for each target cell (input NULL if you don't need this field)
- */ 
-void nearestNeighbor(double ** psouLat, double ** psouLon, int nSou, double * tarLat, double * tarLon, int * tarNNSouID, double * tarNNDis, int nTar, double maxR) {
+ * Number of consecutive target cells (about one MODIS/MISR scan line) processed in order by one thread in "nearestNeighborSwath".
+ * The first target of each run is searched without a seed. Runs are fixed, so the result does not depend on the number of threads.
+ */
+#define SWATH_RUN_SIZE 1024
 
-	//printf("%0x\n", souLat);
-	double * souLat = *psouLat;
-	double * souLon = *psouLon;
+/**
+ * Maximum number of steps of the local walk (along source cell IDs) from the seed in "nearestNeighborSwath"
+ */
+#define SWATH_WALK_STEPS 8
 
-	const double earthRadius = 6371009;
-	//const double earthRadius = 6367444;
-	double maxradian = maxR / earthRadius;
-	int nBlockY = M_PI / maxradian;
+/**
+ * Block size of the grid index ("buildNNIndexInRegion") in spacings of the indexed source cells, so a block holds about
+ * NN_BLOCK_SPACINGS^2 cells whatever the resolution of the source
+ */
+#define NN_BLOCK_SPACINGS 2
 
-	double blockR = M_PI / nBlockY;
-	
-	int i, j;
-#pragma omp parallel for
-	for(i = 0; i < nSou; i++) {
-		souLat[i] = souLat[i] * M_PI / 180;
-		souLon[i] = souLon[i] * M_PI / 180;
+/**
+ * Maximum number of blocks searched on each side of a target's block (blocks are at least maxR / NN_BLOCK_WINDOW_MAX wide).
+ * Blocks of a few cells keep the number of candidates small when maxR spans many source cells (e.g. MODIS, whose maxR covers the
+ * pixel growth at the swath edges)
+ */
+#define NN_BLOCK_WINDOW_MAX 3
+
+/**
+ * Number of latitude rows at each pole searched on a grid in azimuthal projection ("buildPolarCaps") instead of longitude blocks.
+ * Blocks of these rows are wedges (and the row at the pole is a single block), which hold more cells than a block elsewhere
+ */
+#define POLAR_CAP_ROWS 8
+
+/**
+ * Number of polar cap grid cells along the size of a block. Small grid cells keep a seeded query (NN_INDEX_GRID_SWATH) to few candidates
+ */
+#define POLAR_CAP_CELL_SPLIT 4
+
+/**
+ * struct ZSortItem: a source cell's z (sine of latitude) and its position in the block index, for sorting cells in each block by latitude
+ */
+struct ZSortItem {
+	double z;
+	int pos;
+};
+
+static int compareZSortItem(const void * a, const void * b) {
+	const struct ZSortItem * p = (const struct ZSortItem *)a;
+	const struct ZSortItem * q = (const struct ZSortItem *)b;
+	if(p->z < q->z) {
+		return -1;
+	}
+	if(p->z > q->z) {
+		return 1;
 	}
+	return p->pos - q->pos;
+}
 
-#pragma omp parallel for
-	for(i = 0; i < nTar; i++) {
-		tarLat[i] = tarLat[i] * M_PI / 180;
-		tarLon[i] = tarLon[i] * M_PI / 180;
+/**
+ * NAME:	lowerBoundZ
+ * DESCRIPTION:	Binary search for the first cell in [begin, end) of a z-sorted block whose z is not less than value
+ */
+static inline int lowerBoundZ(const double * souZ, int begin, int end, double value) {
+	while(begin < end) {
+		int mid = begin + (end - begin) / 2;
+		if(souZ[mid] < value) {
+			begin = mid + 1;
+		}
+		else {
+			end = mid;
+		}
 	}
+	return begin;
+}
 
-	int * souID;
-	if(NULL == (souID = (int *)malloc(sizeof(double) * nSou))) {
+/**
+ * NAME:	sortBlocksByZ
+ * DESCRIPTION:	Sort the source cells within each block of the index by z (i.e. latitude), so that a query only needs to scan
+ *		the cells within a latitude band of its current nearest distance
+ * PARAMETERS:
+ *	struct LonBlocks * souIndex:	the block index (generated from "pointIndexOnLatLon")
+ *	int nRows:			the number of rows kept in the block index
+ *	double * souX, * souY, * souZ:	the unit vectors of indexed source cells (reordered in place)
+ *	int * souID:			the original IDs of indexed source cells (reordered in place)
+ */
+static void sortBlocksByZ(struct LonBlocks * souIndex, int nRows, double * souX, double * souY, double * souZ, int * souID) {
+
+	int count = souIndex[nRows - 1].indexID[souIndex[nRows - 1].nStored];
+
+	struct ZSortItem * items;
+	double * tmp;
+	int * tmpID;
+	if(NULL == (items = (struct ZSortItem *)malloc(sizeof(struct ZSortItem) * count))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (tmp = (double *)malloc(sizeof(double) * count))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (tmpID = (int *)malloc(sizeof(int) * count))) {
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);
 	}
-	int * souIndex = pointIndexOnLat(psouLat, psouLon, souID, nSou, nBlockY);
-	souLat = *psouLat;
-	souLon = *psouLon;
 
+	int i, j, k;
+#pragma omp parallel for
+	for(i = 0; i < count; i++) {
+		items[i].z = souZ[i];
+		items[i].pos = i;
+	}
 
-#pragma omp parallel for private(j)
-	for(i = 0; i < nTar; i ++) {
+#pragma omp parallel for private(k) schedule(dynamic)
+	for(j = 0; j < nRows; j++) {
+		for(k = 0; k < souIndex[j].nStored; k++) {
+			int begin = souIndex[j].indexID[k];
+			int end = souIndex[j].indexID[k + 1];
+			if(end - begin > 1) {
+				qsort(items + begin, end - begin, sizeof(struct ZSortItem), compareZSortItem);
+			}
+		}
+	}
 
-		double tLat = tarLat[i];
-		double tLon = tarLon[i];
-		
-		double pDis;	
-		double nnDis;
-		int nnSouID =-1;
+	double * coord[3] = {souX, souY, souZ};
+	for(k = 0; k < 3; k++) {
+#pragma omp parallel for
+		for(i = 0; i < count; i++) {
+			tmp[i] = coord[k][items[i].pos];
+		}
+#pragma omp parallel for
+		for(i = 0; i < count; i++) {
+			coord[k][i] = tmp[i];
+		}
+	}
+#pragma omp parallel for
+	for(i = 0; i < count; i++) {
+		tmpID[i] = souID[items[i].pos];
+	}
+#pragma omp parallel for
+	for(i = 0; i < count; i++) {
+		souID[i] = tmpID[i];
+	}
 
-		int blockID = (tLat + M_PI / 2) / blockR;
-		int startBlock = blockID - 1;
-		int endBlock = blockID + 1;
+	free(items);
+	free(tmp);
+	free(tmpID);
+}
 
-		if(startBlock < 0) {
-			startBlock = 0;
+/**
+ * struct SwathRecord: an indexed source cell's unit vector and its position in the index, stored by original ID for walking along the swath.
+ * The walk only moves to the previous or next ID, so its candidates share one or two cache lines instead of a line in each of the
+ * coordinate, ID and position arrays. The record is padded to 32 bytes and the records are allocated on a 64-byte boundary, so none
+ * of them crosses a cache line
+ */
+struct SwathRecord {
+	double x;
+	double y;
+	double z;
+	int pos;
+};
+
+/**
+ * NAME:	walkNearestCandidate
+ * DESCRIPTION:	Starting from the current nearest source cell, move to the source cell with the previous or next original ID
+ *		(i.e. the swath neighbor along the scan line) while it is closer to the target
+ * PARAMETERS:
+ *	struct SwathRecord * souWalk:	the records of indexed source cells by original ID, from ID walkBegin (pos is -1 if not indexed)
+ *	int walkBegin, int walkEnd:	the range of original IDs held by souWalk
+ *	double tX, tY, tZ:		the unit vector of the target cell
+ *	double * nnDis:			the current nearest squared chord length
+ *	int * nnID:			the original ID of the current nearest source cell (must not be -1)
+ * Output:
+ *	double * nnDis, int * nnID are updated if a closer candidate is found
+ */
+static inline void walkNearestCandidate(const struct SwathRecord * souWalk, int walkBegin, int walkEnd, double tX, double tY, double tZ, double * nnDis, int * nnID) {
+
+	for(int step = 0; step < SWATH_WALK_STEPS; step++) {
+		int cur = *nnID;
+		for(int d = -1; d <= 1; d += 2) {
+			int neighbor = cur + d;
+			if(neighbor < walkBegin || neighbor >= walkEnd) {
+				continue;
+			}
+			const struct SwathRecord * rec = souWalk + (neighbor - walkBegin);
+			if(rec->pos < 0) {
+				continue;
+			}
+			double dX = rec->x - tX;
+			double dY = rec->y - tY;
+			double dZ = rec->z - tZ;
+			double pDis = dX * dX + dY * dY + dZ * dZ;
+			if(pDis < *nnDis) {
+				*nnDis = pDis;
+				*nnID = neighbor;
+			}
 		}
-		if(endBlock > nBlockY - 1) {
-			endBlock = nBlockY - 1;
+		if(*nnID == cur) {
+			break;
 		}
+	}
+}
 
-		nnDis = -1;
-		
-		for(j = souIndex[startBlock]; j < souIndex[endBlock+1]; j++) {
-			
-		        double sLat = souLat[j];
-			double sLon = souLon[j];
+/**
+ * Number of longitude bins used by "latLonRegion" to find the longitude range of a set of cells (0.1 degree each)
+ */
+#define REGION_LON_BINS 3600
 
-			pDis = acos(sin(tLat) * sin(sLat) + cos(tLat) * cos(sLat) * cos(tLon - sLon));
-				
-			if((nnDis < 0 || nnDis > pDis) && pDis <= maxradian) {
-				nnDis = pDis;
-				nnSouID = souID[j];
+/**
+ * NAME:	inRegion
+ * DESCRIPTION:	Check if a location (in degrees) is in a region computed by "latLonRegion"
+ */
+static inline int inRegion(const struct LatLonRegion * region, double lat, double lon) {
+	if(region->nCells == 0 || !(lat >= region->latMin && lat <= region->latMax)) {
+		return 0;
+	}
+	if(region->lonWidth >= 360) {
+		return 1;
+	}
+	double d = fmod(lon - region->lonWest, 360.0);
+	if(d < 0) {
+		d += 360;
+	}
+	return (d <= region->lonWidth) ? 1 : 0;
+}
+
+/**
+ * NAME:	latLonRegion
+ * DESCRIPTION:	Compute the region bounding a set of cells, extended by a distance. Each thread marks the 0.1 degree longitude bins holding cells,
+ *		and the longitude range is the complement of the largest (circular) gap of empty bins, so a set crossing the dateline does not
+ *		span all longitudes. The region covers all longitudes if it reaches a pole. Cells outside the valid latitude/longitude range are ignored
+ * PARAMETERS:
+ *	double * lat:		the latitudes of cells
+ *	double * lon:		the longitudes of cells
+ *	long long n:		the number of cells
+ *	double maxR:		the distance (in meters) to extend the region by
+ * Output:
+ *	struct LatLonRegion * region:	the region
+ */
+void latLonRegion(const double * lat, const double * lon, long long n, double maxR, struct LatLonRegion * region) {
+
+	const double earthRadius = 6371009;
+
+	int maxThreads = omp_get_max_threads();
+	unsigned char * lonBins;
+	if(NULL == (lonBins = (unsigned char *)calloc((size_t)maxThreads * REGION_LON_BINS, sizeof(unsigned char)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	double latMin = 90;
+	double latMax = -90;
+	long long nCells = 0;
+	long long i;
+#pragma omp parallel num_threads(maxThreads) reduction(min:latMin) reduction(max:latMax) reduction(+:nCells)
+	{
+		unsigned char * bins = lonBins + (size_t)omp_get_thread_num() * REGION_LON_BINS;
+#pragma omp for
+		for(i = 0; i < n; i++) {
+			if(!(lat[i] >= -90 && lat[i] <= 90 && lon[i] >= -180 && lon[i] <= 180)) {
+				continue;
 			}
-				
+			if(lat[i] < latMin) {
+				latMin = lat[i];
+			}
+			if(lat[i] > latMax) {
+				latMax = lat[i];
+			}
+			int b = (int)((lon[i] + 180) * REGION_LON_BINS / 360);
+			if(b >= REGION_LON_BINS) {
+				b = REGION_LON_BINS - 1;
+			}
+			bins[b] = 1;
+			nCells ++;
 		}
+	}
 
-		if(nnDis < 0) {
-			tarNNSouID[i] = -1;
-			if(tarNNDis != NULL) {
-				tarNNDis[i] = -1;
-			}
+	region->nCells = nCells;
+	region->latMin = latMin;
+	region->latMax = latMax;
+	region->lonWest = -180;
+	region->lonWidth = 360;
+	if(nCells == 0) {
+		free(lonBins);
+		return;
+	}
+
+	// merge the bins of all threads, then find the largest gap (walking around twice, so a gap crossing the dateline is found)
+	for(int t = 1; t < maxThreads; t++) {
+		for(int b = 0; b < REGION_LON_BINS; b++) {
+			lonBins[b] |= lonBins[(size_t)t * REGION_LON_BINS + b];
+		}
+	}
+	int gapLen = 0;
+	int gapEnd = -1;
+	int run = 0;
+	for(int b = 0; b < 2 * REGION_LON_BINS; b++) {
+		if(lonBins[b % REGION_LON_BINS]) {
+			run = 0;
 		}
 		else {
-			tarNNSouID[i] = nnSouID;
-			if(tarNNDis != NULL) {
-				tarNNDis[i] = nnDis * earthRadius;
+			run ++;
+			if(run > gapLen) {
+				gapLen = run;
+				gapEnd = b;
 			}
 		}
-	
-		 
+	}
+	free(lonBins);
+	if(gapLen > 0) {
+		region->lonWest = -180 + ((gapEnd + 1) % REGION_LON_BINS) * 360.0 / REGION_LON_BINS;
+		region->lonWidth = (REGION_LON_BINS - gapLen) * 360.0 / REGION_LON_BINS;
 	}
 
-	free(souID);
-	free(souIndex);
-	
-	return;	
+	// extend by maxR, with a small margin so rounding never drops a cell at exactly maxR
+	double r = maxR / earthRadius * (1 + 1e-9) + 1e-12;
+	double rDeg = r * 180 / M_PI;
+	region->latMin -= rDeg;
+	region->latMax += rDeg;
+	if(region->latMin <= -90 || region->latMax >= 90) {
+		// the region reaches a pole, so it covers all longitudes
+		region->lonWest = -180;
+		region->lonWidth = 360;
+		return;
+	}
+	double maxAbsLat = fabs(region->latMin) > fabs(region->latMax) ? fabs(region->latMin) : fabs(region->latMax);
+	double sinDLon = sin(r) / cos(maxAbsLat * M_PI / 180);
+	if(region->lonWidth < 360 && sinDLon < 1) {
+		double dLon = asin(sinDLon) * 180 / M_PI;
+		region->lonWest -= dLon;
+		region->lonWidth += 2 * dLon;
+		if(region->lonWest < -180) {
+			region->lonWest += 360;
+		}
+	}
+	else {
+		region->lonWidth = 360;
+	}
+	if(region->lonWidth >= 360) {
+		region->lonWest = -180;
+		region->lonWidth = 360;
+	}
+}
+
+int isInLatLonRegion(const struct LatLonRegion * region, double lat, double lon) {
+	return inRegion(region, lat, lon);
+}
+
+/**
+ * Number of bits of each coordinate of the grid "spaceFillingCurveOrder" maps cells to (2^16 x 2^16 cells, 32-bit keys)
+ */
+#define CURVE_BITS 16
+
+/**
+ * NAME:	mortonKey
+ * DESCRIPTION:	The position of a grid cell along a Morton (Z-order) curve, by interleaving the bits of x and y
+ */
+static inline unsigned int mortonKey(unsigned int x, unsigned int y) {
+	x = (x | (x << 8)) & 0x00FF00FF;
+	x = (x | (x << 4)) & 0x0F0F0F0F;
+	x = (x | (x << 2)) & 0x33333333;
+	x = (x | (x << 1)) & 0x55555555;
+	y = (y | (y << 8)) & 0x00FF00FF;
+	y = (y | (y << 4)) & 0x0F0F0F0F;
+	y = (y | (y << 2)) & 0x33333333;
+	y = (y | (y << 1)) & 0x55555555;
+	return x | (y << 1);
+}
+
+/**
+ * NAME:	hilbertKey
+ * DESCRIPTION:	The position of a grid cell along a Hilbert curve. Unlike a Morton curve, consecutive positions are always adjacent grid cells
+ */
+static inline unsigned int hilbertKey(unsigned int x, unsigned int y) {
+	const unsigned int n = 1u << CURVE_BITS;
+	unsigned int d = 0;
+	for(unsigned int s = n >> 1; s > 0; s >>= 1) {
+		unsigned int rx = (x & s) ? 1 : 0;
+		unsigned int ry = (y & s) ? 1 : 0;
+		d += s * s * ((3 * rx) ^ ry);
+		// rotate the quadrant
+		if(ry == 0) {
+			if(rx == 1) {
+				x = n - 1 - x;
+				y = n - 1 - y;
+			}
+			unsigned int t = x;
+			x = y;
+			y = t;
+		}
+	}
+	return d;
+}
+
+/**
+ * NAME:	spaceFillingCurveOrder
+ * DESCRIPTION:	Order a set of cells along a space-filling curve, so cells next to each other in the order are close on the sphere.
+ *		Cells are mapped to a 2^16 x 2^16 grid over their region (see "latLonRegion", so a set crossing the dateline is not split),
+ *		and sorted by their position along the curve with a two-pass radix sort (stable, so cells in the same grid cell keep their order).
+ *		Cells outside the valid latitude/longitude range (e.g. fill values) are placed at the end
+ * PARAMETERS:
+ *	double * lat:		the latitudes of cells
+ *	double * lon:		the longitudes of cells
+ *	long long n:		the number of cells
+ *	int curve:		NN_QUERY_ORDER_MORTON or NN_QUERY_ORDER_HILBERT
+ * Output:
+ *	long long * order:	the IDs of cells along the curve (n items)
+ */
+void spaceFillingCurveOrder(const double * lat, const double * lon, long long n, int curve, long long * order) {
+
+	struct LatLonRegion region;
+	latLonRegion(lat, lon, n, 0, &region);
+	double latMin = region.latMin;
+	double latScale = (region.latMax > region.latMin) ? ((1 << CURVE_BITS) - 1) / (region.latMax - region.latMin) : 0;
+	double lonWest = region.lonWest;
+	double lonScale = (region.lonWidth > 0) ? ((1 << CURVE_BITS) - 1) / region.lonWidth : 0;
+	const unsigned int maxCoord = (1 << CURVE_BITS) - 1;
+
+	unsigned int * key;
+	unsigned int * tmpKey;
+	long long * tmpOrder;
+	if(NULL == (key = (unsigned int *)malloc(sizeof(unsigned int) * n))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (tmpKey = (unsigned int *)malloc(sizeof(unsigned int) * n))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (tmpOrder = (long long *)malloc(sizeof(long long) * n))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	long long i;
+#pragma omp parallel for
+	for(i = 0; i < n; i++) {
+		order[i] = i;
+		if(!(lat[i] >= -90 && lat[i] <= 90 && lon[i] >= -180 && lon[i] <= 180)) {
+			key[i] = 0xFFFFFFFF;
+			continue;
+		}
+		double d = fmod(lon[i] - lonWest, 360.0);
+		if(d < 0) {
+			d += 360;
+		}
+		double fx = d * lonScale;
+		double fy = (lat[i] - latMin) * latScale;
+		unsigned int x = (fx >= maxCoord) ? maxCoord : (unsigned int)fx;
+		unsigned int y = (fy >= maxCoord) ? maxCoord : ((fy <= 0) ? 0 : (unsigned int)fy);
+		key[i] = (curve == NN_QUERY_ORDER_HILBERT) ? hilbertKey(x, y) : mortonKey(x, y);
+	}
+
+	// LSD radix sort on the low and the high 16 bits of keys
+	long long * count;
+	if(NULL == (count = (long long *)malloc(sizeof(long long) * 65536))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	for(int pass = 0; pass < 2; pass++) {
+		int shift = pass * 16;
+		const unsigned int * inKey = (pass == 0) ? key : tmpKey;
+		unsigned int * outKey = (pass == 0) ? tmpKey : key;
+		const long long * inOrder = (pass == 0) ? order : tmpOrder;
+		long long * outOrder = (pass == 0) ? tmpOrder : order;
+		for(int b = 0; b < 65536; b++) {
+			count[b] = 0;
+		}
+		for(i = 0; i < n; i++) {
+			count[(inKey[i] >> shift) & 0xFFFF]++;
+		}
+		long long pos = 0;
+		for(int b = 0; b < 65536; b++) {
+			long long c = count[b];
+			count[b] = pos;
+			pos += c;
+		}
+		for(i = 0; i < n; i++) {
+			long long p = count[(inKey[i] >> shift) & 0xFFFF]++;
+			outKey[p] = inKey[i];
+			outOrder[p] = inOrder[i];
+		}
+	}
+	free(count);
+	free(key);
+	free(tmpKey);
+	free(tmpOrder);
+}
+
+/**
+ * Maximum number of cells of the grid of search radii ("setNNIndexCellRadius"). Grid cells are made larger over larger regions
+ */
+#define RADIUS_GRID_MAX_CELLS (1 << 20)
+
+/**
+ * struct CellRadiusGrid: the largest search radius of the indexed source cells in each cell of a latitude/longitude grid over the region
+ * of the index (see "setNNIndexCellRadius"). Grid cells are at least maxR on each side, so the source cells within maxR of a target are
+ * in the 3 x 3 grid cells around it
+ * ITEMS:
+ *	int nX, nY:			the number of grid cells along longitude and latitude
+ *	double latSouth, lonWest:	the southwestern corner of the grid (in degrees)
+ *	double cellLat, cellLon:	the size of a grid cell (in degrees)
+ *	double * maxChord2:		the largest squared chord of the search radii of the source cells in each grid cell (nX * nY items, row by row)
+ */
+struct CellRadiusGrid {
+	int nX;
+	int nY;
+	double latSouth;
+	double lonWest;
+	double cellLat;
+	double cellLon;
+	double * maxChord2;
+};
+
+/**
+ * struct NNIndex: a reusable spatial index of source cells for nearest neighbor search (see "buildNNIndex")
+ * ITEMS:
+ *	int indexType:			NN_INDEX_GRID, NN_INDEX_GRID_SWATH, NN_INDEX_KDTREE or NN_INDEX_DUAL_GRID
+ *	int nSou:			the number of source cells
+ *	double maxradian:		the maximum distance (in radians) to define neighboring cells
+ *	int nBlockY:			the number of rows of the block index (grid types)
+ *	double latBlockR:		the latitude range of each row (grid types)
+ *	int blockWindow:		the number of blocks on each side of a target's block within maxR (grid types)
+ *	int rowBegin, rowEnd:		the range of rows kept in the block index; the other rows hold no indexed cell (grid types)
+ *	int nIndexed:			the number of indexed source cells (grid types)
+ *	struct LonBlocks * souIndex:	the block index of rows rowBegin to rowEnd - 1 (grid types)
+ *	double * souX, * souY, * souZ:	the unit vectors of indexed source cells in index order (grid types)
+ *	int * souID:			the original IDs of indexed source cells (grid types)
+ *	struct SwathRecord * souWalk:	the unit vector and position in the index of each original source cell ID from walkBegin (NN_INDEX_GRID_SWATH only)
+ *	int walkBegin, walkEnd:		the range of original IDs of indexed source cells (NN_INDEX_GRID_SWATH only)
+ *	struct KDTree * souTree:	the k-d tree (NN_INDEX_KDTREE only)
+ *	struct LatLonRegion region:	the region of indexed source cells extended by maxR; targets outside it have no neighbor (grid types)
+ *	int capRows:			the number of rows at each pole indexed by a polar cap grid instead of blocks, 0 if not used (grid types)
+ *	int capGrid:			the number of grid cells along x and y of each polar cap
+ *	double capCellSize:		the size of a polar cap grid cell (on x and y of unit vectors)
+ *	double capRho:			the half width of the polar cap grids (the largest distance to the polar axis of cells in cap rows)
+ *	int * capIndexID[2]:		the starting and ending index of cells in each grid cell of the south and north caps (capGrid * capGrid + 1 items)
+ *	int queryOrder:			the order target cells are queried in (see "setNNIndexQueryOrder")
+ *	double approxFactor:		1 + the relative distance error allowed in nearest neighbor queries (see "setNNIndexApproximation"), 1 for exact search
+ *	struct CellRadiusGrid * radiusGrid:	the search radii of source cells (see "setNNIndexCellRadius"), NULL to search maxR around all targets (grid types)
+ */
+struct NNIndex {
+	int indexType;
+	int nSou;
+	double maxradian;
+	int nBlockY;
+	double latBlockR;
+	int blockWindow;
+	int rowBegin;
+	int rowEnd;
+	int nIndexed;
+	struct LonBlocks * souIndex;
+	double * souX;
+	double * souY;
+	double * souZ;
+	int * souID;
+	struct SwathRecord * souWalk;
+	int walkBegin;
+	int walkEnd;
+	struct KDTree * souTree;
+	struct LatLonRegion region;
+	int capRows;
+	int capGrid;
+	double capCellSize;
+	double capRho;
+	int * capIndexID[2];
+	int queryOrder;
+	double approxFactor;
+	struct CellRadiusGrid * radiusGrid;
+};
+
+/**
+ * NAME:	indexRow
+ * DESCRIPTION:	The row j of the block index, or NULL if the row holds no indexed cell
+ */
+static inline const struct LonBlocks * indexRow(const struct NNIndex * index, int j) {
+	if(j < index->rowBegin || j >= index->rowEnd) {
+		return NULL;
+	}
+	return index->souIndex + (j - index->rowBegin);
+}
+
+/**
+ * NAME:	rowFirstCell
+ * DESCRIPTION:	The position (in index order) of the first indexed cell in row j or in the rows after it
+ */
+static inline int rowFirstCell(const struct NNIndex * index, int j) {
+	if(j <= index->rowBegin) {
+		return 0;
+	}
+	if(j >= index->rowEnd) {
+		return index->nIndexed;
+	}
+	return index->souIndex[j - index->rowBegin].indexID[0];
+}
+
+/**
+ * NAME:	targetSearchChord2
+ * DESCRIPTION:	The squared chord of the search radius of a target (latitude and longitude in degrees): maxR, or if source cells have their own
+ *		radius ("setNNIndexCellRadius"), the largest radius of the source cells in the 3 x 3 grid cells around the target. A source cell
+ *		whose radius reaches the target is always within it, so the nearest cell is the same as searching maxR for such targets
+ */
+static inline double targetSearchChord2(const struct NNIndex * index, double lat, double lon, double maxChord2) {
+	const struct CellRadiusGrid * grid = index->radiusGrid;
+	if(grid == NULL) {
+		return maxChord2;
+	}
+	double d = fmod(lon - grid->lonWest, 360.0);
+	if(d < 0) {
+		d += 360;
+	}
+	int gx = (int)floor(d / grid->cellLon);
+	int gy = (int)floor((lat - grid->latSouth) / grid->cellLat);
+	double chord2 = 0;
+	for(int y = gy - 1; y <= gy + 1; y++) {
+		if(y < 0 || y >= grid->nY) {
+			continue;
+		}
+		for(int x = gx - 1; x <= gx + 1; x++) {
+			if(x >= 0 && x < grid->nX && grid->maxChord2[(long long)y * grid->nX + x] > chord2) {
+				chord2 = grid->maxChord2[(long long)y * grid->nX + x];
+			}
+		}
+	}
+	return (chord2 < maxChord2) ? chord2 : maxChord2;
+}
+
+/**
+ * NAME:	blockCells
+ * DESCRIPTION:	The range [begin, end) of indexed cells in block k of a row. k may be beyond either end of the row (it wraps around the dateline),
+ *		and blocks not kept in the row are empty
+ */
+static inline void blockCells(const struct LonBlocks * row, int k, int * begin, int * end) {
+	int slot = (k - row->firstBlock) % row->nBlocks;
+	if(slot < 0) {
+		slot += row->nBlocks;
+	}
+	if(slot >= row->nStored) {
+		*begin = row->indexID[0];
+		*end = row->indexID[0];
+		return;
+	}
+	*begin = row->indexID[slot];
+	*end = row->indexID[slot + 1];
+}
+
+/**
+ * NAME:	blockRangeCells
+ * DESCRIPTION:	The indexed cells of blocks k0 to k1 of a row (at most nBlocks blocks, k0 and k1 may be beyond either end of the row). Blocks next
+ *		to each other hold consecutive cells, so the cells are in one run, or two if the blocks wrap around the kept blocks of the row.
+ *		The runs are in the order of the blocks
+ * PARAMETERS:
+ *	struct LonBlocks * row:	the row of the block index
+ *	int k0, int k1:		the first and last block
+ * Output:
+ *	int * begin, int * end:	the ranges [begin, end) of the runs (2 items)
+ *	the number of runs
+ */
+static inline int blockRangeCells(const struct LonBlocks * row, int k0, int k1, int * begin, int * end) {
+	int slot = (k0 - row->firstBlock) % row->nBlocks;
+	if(slot < 0) {
+		slot += row->nBlocks;
+	}
+	int slotEnd = slot + (k1 - k0 + 1);
+	int nRuns = 1;
+	begin[0] = row->indexID[(slot < row->nStored) ? slot : row->nStored];
+	end[0] = row->indexID[(slotEnd < row->nStored) ? slotEnd : row->nStored];
+	if(slotEnd > row->nBlocks) {
+		slotEnd -= row->nBlocks;
+		begin[1] = row->indexID[0];
+		end[1] = row->indexID[(slotEnd < row->nStored) ? slotEnd : row->nStored];
+		nRuns = 2;
+	}
+	return nRuns;
+}
+
+/**
+ * NAME:	buildPolarCaps
+ * DESCRIPTION:	Regroup the indexed source cells of the POLAR_CAP_ROWS rows at each pole by a grid on the x and y of their unit vectors (an
+ *		azimuthal projection centered on the pole). Grid cells are a fraction (POLAR_CAP_CELL_SPLIT) of a block, and a query only scans
+ *		the grid cells within its current nearest distance, so the number of candidates stays bounded up to the poles. Cells keep
+ *		their order within a grid cell.
+ *		Caps are not used if the block index has too few rows
+ * PARAMETERS:
+ *	struct NNIndex * index:	the block index (the source cells and IDs of cap rows are reordered in place)
+ */
+static void buildPolarCaps(struct NNIndex * index) {
+
+	int nBlockY = index->nBlockY;
+	if(nBlockY < 4 * POLAR_CAP_ROWS) {
+		return;
+	}
+	int capRows = POLAR_CAP_ROWS;
+	double capCellSize = 2 * sin(index->latBlockR / 2) / POLAR_CAP_CELL_SPLIT;
+	double capRho = sin(capRows * index->latBlockR);
+	int capGrid = (int)(2 * capRho / capCellSize) + 1;
+	index->capRows = capRows;
+	index->capGrid = capGrid;
+	index->capCellSize = capCellSize;
+	index->capRho = capRho;
+
+	int capBegin[2];
+	int capEnd[2];
+	capBegin[0] = rowFirstCell(index, 0);
+	capEnd[0] = rowFirstCell(index, capRows);
+	capBegin[1] = rowFirstCell(index, nBlockY - capRows);
+	capEnd[1] = index->nIndexed;
+
+	for(int cap = 0; cap < 2; cap++) {
+
+		int begin = capBegin[cap];
+		int count = capEnd[cap] - begin;
+		int * indexID;
+		int * cellGrid;
+		if(NULL == (indexID = (int *)calloc((size_t)capGrid * capGrid + 1, sizeof(int)))) {
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+		if(NULL == (cellGrid = (int *)malloc(sizeof(int) * (count > 0 ? count : 1)))) {
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+
+		// counting sort of the cap's cells by grid cell
+		for(int l = 0; l < count; l++) {
+			int cx = (int)((index->souX[begin + l] + capRho) / capCellSize);
+			int cy = (int)((index->souY[begin + l] + capRho) / capCellSize);
+			cx = (cx < 0) ? 0 : ((cx >= capGrid) ? capGrid - 1 : cx);
+			cy = (cy < 0) ? 0 : ((cy >= capGrid) ? capGrid - 1 : cy);
+			cellGrid[l] = cy * capGrid + cx;
+			indexID[cellGrid[l] + 1] ++;
+		}
+		indexID[0] = begin;
+		for(int g = 0; g < capGrid * capGrid; g++) {
+			indexID[g + 1] += indexID[g];
+		}
+
+		double * tmp;
+		int * tmpID;
+		int * pos;
+		if(NULL == (tmp = (double *)malloc(sizeof(double) * (count > 0 ? count : 1)))) {
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+		if(NULL == (tmpID = (int *)malloc(sizeof(int) * (count > 0 ? count : 1)))) {
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+		if(NULL == (pos = (int *)malloc(sizeof(int) * (count > 0 ? count : 1)))) {
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+		int * next;
+		if(NULL == (next = (int *)malloc(sizeof(int) * capGrid * capGrid))) {
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+		for(int g = 0; g < capGrid * capGrid; g++) {
+			next[g] = indexID[g] - begin;
+		}
+		for(int l = 0; l < count; l++) {
+			pos[l] = next[cellGrid[l]]++;
+		}
+
+		double * coord[3] = {index->souX + begin, index->souY + begin, index->souZ + begin};
+		for(int d = 0; d < 3; d++) {
+			for(int l = 0; l < count; l++) {
+				tmp[pos[l]] = coord[d][l];
+			}
+			for(int l = 0; l < count; l++) {
+				coord[d][l] = tmp[l];
+			}
+		}
+		for(int l = 0; l < count; l++) {
+			tmpID[pos[l]] = index->souID[begin + l];
+		}
+		for(int l = 0; l < count; l++) {
+			index->souID[begin + l] = tmpID[l];
+		}
+
+		free(tmp);
+		free(tmpID);
+		free(pos);
+		free(next);
+		free(cellGrid);
+		index->capIndexID[cap] = indexID;
+	}
+}
+
+/**
+ * NAME:	capWindow
+ * DESCRIPTION:	Find the grid cells of a polar cap overlapping the square of half width "chord" around a target's x and y.
+ *		Source cells within this chord distance of the target are in these grid cells, as the x and y differences never exceed the chord
+ * Output:
+ *	0 if no grid cell overlaps, 1 otherwise (with the range of grid cells in cx0 ~ cx1 and cy0 ~ cy1)
+ */
+static inline int capWindow(const struct NNIndex * index, double tX, double tY, double chord, int * cx0, int * cx1, int * cy0, int * cy1) {
+	double rho = index->capRho;
+	double size = index->capCellSize;
+	int last = index->capGrid - 1;
+	if(tX - chord > rho || tX + chord < -rho || tY - chord > rho || tY + chord < -rho) {
+		return 0;
+	}
+	*cx0 = (int)((tX - chord + rho) / size);
+	*cx1 = (int)((tX + chord + rho) / size);
+	*cy0 = (int)((tY - chord + rho) / size);
+	*cy1 = (int)((tY + chord + rho) / size);
+	*cx0 = (*cx0 < 0) ? 0 : *cx0;
+	*cy0 = (*cy0 < 0) ? 0 : *cy0;
+	*cx1 = (*cx1 > last) ? last : *cx1;
+	*cy1 = (*cy1 > last) ? last : *cy1;
+	return 1;
+}
+
+/**
+ * NAME:	scanPolarCap
+ * DESCRIPTION:	Nearest neighbor scan of the grid cells of a polar cap around a target (within the current nearest distance)
+ * PARAMETERS:
+ *	struct NNIndex * index:	the block index
+ *	int cap:		0 for the south cap, 1 for the north cap
+ *	double tX, tY, tZ:	the unit vector of the target cell
+ *	double * nnDis:		the current nearest squared chord length
+ *	int * nnID:		the current nearest source cell (index into souX, -1 if none)
+ */
+static inline void scanPolarCap(const struct NNIndex * index, int cap, double tX, double tY, double tZ, double * nnDis, int * nnID) {
+	int cx0, cx1, cy0, cy1;
+	if(!capWindow(index, tX, tY, sqrt(*nnDis), &cx0, &cx1, &cy0, &cy1)) {
+		return;
+	}
+	const int * indexID = index->capIndexID[cap];
+	for(int cy = cy0; cy <= cy1; cy++) {
+		// grid cells of a grid row are contiguous
+		scanNearestCandidate(index->souX, index->souY, index->souZ, indexID[cy * index->capGrid + cx0], indexID[cy * index->capGrid + cx1 + 1], tX, tY, tZ, nnDis, nnID);
+	}
+}
+
+/**
+ * NAME:	buildNNIndexInRegion
+ * DESCRIPTION:	Build a spatial index of source cells in a region for nearest neighbor search. The input arrays are not changed,
+ *		and the index can be queried any number of times with "queryNNIndex". Source cells out of the region are dropped before
+ *		the index is built, and the IDs of the indexed cells are mapped back to the input arrays
+ * PARAMETERS:
+ *	double * souLat:	the latitudes of source cells
+ *	double * souLon:	the longitudes of source cells
+ *	int nSou:		the number of source cells
+ *	double maxR:		the maximum distance (in meters) to define neighboring cells
+ *	int indexType:		NN_INDEX_GRID, NN_INDEX_GRID_SWATH, NN_INDEX_KDTREE or NN_INDEX_DUAL_GRID
+ *	struct LatLonRegion * region:	the region of source cells to be indexed (NULL for all source cells)
+ * Output:
+ *	the index (release it with "freeNNIndex")
+ */
+struct NNIndex * buildNNIndexInRegion(const double * souLat, const double * souLon, int nSou, double maxR, int indexType, const struct LatLonRegion * region) {
+
+	const double earthRadius = 6371009;
+	//const double earthRadius = 6367444;
+
+#if DEBUG_ELAPSE_TIME
+	double buildStart = omp_get_wtime();
+#endif
+
+	struct NNIndex * index;
+	if(NULL == (index = (struct NNIndex *)malloc(sizeof(struct NNIndex)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	index->indexType = indexType;
+	index->nSou = nSou;
+	index->maxradian = maxR / earthRadius;
+	index->nBlockY = 0;
+	index->latBlockR = 0;
+	index->blockWindow = 1;
+	index->rowBegin = 0;
+	index->rowEnd = 0;
+	index->nIndexed = 0;
+	index->souIndex = NULL;
+	index->souX = NULL;
+	index->souY = NULL;
+	index->souZ = NULL;
+	index->souID = NULL;
+	index->souWalk = NULL;
+	index->walkBegin = 0;
+	index->walkEnd = 0;
+	index->souTree = NULL;
+	index->capRows = 0;
+	index->capIndexID[0] = NULL;
+	index->capIndexID[1] = NULL;
+	index->queryOrder = NN_QUERY_ORDER_STORAGE;
+	index->approxFactor = 1;
+	index->radiusGrid = NULL;
+
+	int i;
+
+	// IDs of source cells in the region, in the original order
+	int nCells = nSou;
+	int * cellID = NULL;
+	if(region != NULL) {
+		char * inside;
+		if(NULL == (inside = (char *)malloc(sizeof(char) * nSou))) {
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+#pragma omp parallel for
+		for(i = 0; i < nSou; i++) {
+			inside[i] = inRegion(region, souLat[i], souLon[i]);
+		}
+		nCells = 0;
+		for(i = 0; i < nSou; i++) {
+			nCells += inside[i];
+		}
+		if(NULL == (cellID = (int *)malloc(sizeof(int) * (nCells > 0 ? nCells : 1)))) {
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+		int c = 0;
+		for(i = 0; i < nSou; i++) {
+			if(inside[i]) {
+				cellID[c++] = i;
+			}
+		}
+		free(inside);
+#if DEBUG_ELAPSE_TIME
+		printf("DBG_TIME> %s: %d of %d source cells in region\n", __FUNCTION__, nCells, nSou);
+#endif
+	}
+
+	if(indexType == NN_INDEX_KDTREE && cellID == NULL) {
+		index->souTree = buildKDTreeIndex(souLat, souLon, nSou);
+#if DEBUG_ELAPSE_TIME
+		printf("DBG_TIME> %s: k-d tree build %.3f sec\n", __FUNCTION__, omp_get_wtime() - buildStart);
+#endif
+		return index;
+	}
+
+	// latitudes and longitudes of the cells to be indexed (the block index reorders and frees the arrays it is given, so it works on copies)
+	double * cellLat;
+	double * cellLon;
+	if(NULL == (cellLat = (double *)malloc(sizeof(double) * (nCells > 0 ? nCells : 1)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (cellLon = (double *)malloc(sizeof(double) * (nCells > 0 ? nCells : 1)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+#pragma omp parallel for
+	for(i = 0; i < nCells; i++) {
+		int id = (cellID != NULL) ? cellID[i] : i;
+		cellLat[i] = souLat[id];
+		cellLon[i] = souLon[id];
+	}
+
+	if(indexType == NN_INDEX_KDTREE) {
+		index->souTree = buildKDTreeIndex(cellLat, cellLon, nCells);
+		remapKDTreeIndexIDs(index->souTree, cellID);
+		free(cellLat);
+		free(cellLon);
+		free(cellID);
+#if DEBUG_ELAPSE_TIME
+		printf("DBG_TIME> %s: k-d tree build %.3f sec\n", __FUNCTION__, omp_get_wtime() - buildStart);
+#endif
+		return index;
+	}
+
+	// targets farther than maxR from all indexed cells are answered without searching the blocks
+	latLonRegion(cellLat, cellLon, nCells, maxR, &index->region);
+
+	// Block size from the spacing of indexed cells (the region area over the number of cells): about NN_BLOCK_SPACINGS cells across a block,
+	// with a window of up to NN_BLOCK_WINDOW_MAX blocks on each side of a target's block to cover maxR, so the number of candidates of a
+	// query does not grow with maxR, from 15 m ASTER to 1 km MODIS sources. Blocks are never smaller than half the spacing, which bounds
+	// the index memory when maxR is much smaller than the spacing.
+	double regionLatMin = (index->region.latMin > -90) ? index->region.latMin : -90;
+	double regionLatMax = (index->region.latMax < 90) ? index->region.latMax : 90;
+	double regionArea = (sin(regionLatMax * M_PI / 180) - sin(regionLatMin * M_PI / 180)) * index->region.lonWidth * M_PI / 180;
+	double cellSpacing = sqrt(regionArea / (nCells > 0 ? nCells : 1));
+	int blockWindow = (int)ceil(index->maxradian / (NN_BLOCK_SPACINGS * cellSpacing));
+	if(blockWindow < 1) {
+		blockWindow = 1;
+	}
+	if(blockWindow > NN_BLOCK_WINDOW_MAX) {
+		blockWindow = NN_BLOCK_WINDOW_MAX;
+	}
+	if(indexType == NN_INDEX_GRID_SWATH) {
+		// seeded queries only scan the latitude band of their bound in each block, so blocks of maxR cost less than more blocks
+		blockWindow = 1;
+	}
+	double blockSizeRadian = index->maxradian / blockWindow;
+	if(blockSizeRadian < cellSpacing / 2) {
+		blockSizeRadian = cellSpacing / 2;
+	}
+	index->blockWindow = blockWindow;
+
+	int nBlockY = M_PI / blockSizeRadian;
+	if(nBlockY < 1) {
+		nBlockY = 1;
+	}
+	index->nBlockY = nBlockY;
+	index->latBlockR = M_PI / nBlockY;
+
+	double * souLatR = cellLat;
+	double * souLonR = cellLon;
+#pragma omp parallel for
+	for(i = 0; i < nCells; i++) {
+		souLatR[i] = souLatR[i] * M_PI / 180;
+		souLonR[i] = souLonR[i] * M_PI / 180;
+	}
+
+	if(NULL == (index->souID = (int *)malloc(sizeof(int) * (nCells > 0 ? nCells : 1)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	index->souIndex = pointIndexOnLatLon(&souLatR, &souLonR, index->souID, nCells, nBlockY, blockSizeRadian, index->region.lonWest * M_PI / 180, &index->rowBegin, &index->rowEnd);
+	int nRows = index->rowEnd - index->rowBegin;
+
+	int nIndexed = index->souIndex[nRows - 1].indexID[index->souIndex[nRows - 1].nStored];
+	index->nIndexed = nIndexed;
+#if DEBUG_ELAPSE_TIME
+	printf("DBG_TIME> %s: %d rows of %.1f m blocks, window %d\n", __FUNCTION__, nRows, index->latBlockR * earthRadius, blockWindow);
+#endif
+
+	// map positions in the region back to source cell IDs
+	if(cellID != NULL) {
+#pragma omp parallel for
+		for(i = 0; i < nIndexed; i++) {
+			index->souID[i] = cellID[index->souID[i]];
+		}
+		free(cellID);
+	}
+
+	// Convert the (sorted) source cells to unit vectors once. x and y overwrite the reordered latitudes and longitudes.
+	index->souX = souLatR;
+	index->souY = souLonR;
+	if(NULL == (index->souZ = (double *)malloc(sizeof(double) * (nCells > 0 ? nCells : 1)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	latLonToUnitVector(souLatR, souLonR, index->souX, index->souY, index->souZ, nIndexed);
+
+	if(indexType == NN_INDEX_GRID_SWATH) {
+		sortBlocksByZ(index->souIndex, nRows, index->souX, index->souY, index->souZ, index->souID);
+	}
+
+	// cells near the poles are searched on the polar cap grids
+	buildPolarCaps(index);
+
+	if(indexType == NN_INDEX_GRID_SWATH) {
+
+		// records of indexed source cells by original ID, for walking along the swath. Only the range of IDs in the index is kept
+		int walkBegin = nSou;
+		int walkEnd = 0;
+#pragma omp parallel for reduction(min:walkBegin) reduction(max:walkEnd)
+		for(i = 0; i < nIndexed; i++) {
+			if(index->souID[i] < walkBegin) {
+				walkBegin = index->souID[i];
+			}
+			if(index->souID[i] + 1 > walkEnd) {
+				walkEnd = index->souID[i] + 1;
+			}
+		}
+		if(walkEnd < walkBegin) {
+			walkBegin = 0;
+			walkEnd = 0;
+		}
+		index->walkBegin = walkBegin;
+		index->walkEnd = walkEnd;
+		// aligned to a cache line, so no 32-byte record crosses one (freed with free as the other arrays)
+		void * walkMem = NULL;
+		if(0 != posix_memalign(&walkMem, 64, sizeof(struct SwathRecord) * (walkEnd > walkBegin ? walkEnd - walkBegin : 1))) {
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+		index->souWalk = (struct SwathRecord *)walkMem;
+#pragma omp parallel for
+		for(i = 0; i < walkEnd - walkBegin; i++) {
+			index->souWalk[i].pos = -1;
+		}
+#pragma omp parallel for
+		for(i = 0; i < nIndexed; i++) {
+			struct SwathRecord * rec = index->souWalk + (index->souID[i] - walkBegin);
+			rec->x = index->souX[i];
+			rec->y = index->souY[i];
+			rec->z = index->souZ[i];
+			rec->pos = i;
+		}
+	}
+
+#if DEBUG_ELAPSE_TIME
+	printf("DBG_TIME> %s: block index build %.3f sec\n", __FUNCTION__, omp_get_wtime() - buildStart);
+#endif
+
+	return index;
+}
+
+/**
+ * NAME:	buildNNIndex
+ * DESCRIPTION:	Build a spatial index of all source cells for nearest neighbor search (see "buildNNIndexInRegion")
+ */
+struct NNIndex * buildNNIndex(const double * souLat, const double * souLon, int nSou, double maxR, int indexType) {
+	return buildNNIndexInRegion(souLat, souLon, nSou, maxR, indexType, NULL);
+}
+
+/**
+ * NAME:	rowLatGap
+ * DESCRIPTION:	Lower bound (in radians) of the distance from a target to the cells of a row of the block index, from the latitude difference
+ */
+static inline double rowLatGap(int j, double latBlockR, double tLat) {
+	if(tLat < -M_PI / 2 + latBlockR * j) {
+		return -M_PI / 2 + latBlockR * j - tLat;
+	}
+	if(tLat > -M_PI / 2 + latBlockR * (j + 1)) {
+		return tLat - (-M_PI / 2 + latBlockR * (j + 1));
+	}
+	return 0;
+}
+
+/**
+ * NAME:	blockLowerBound
+ * DESCRIPTION:	Lower bound (in radians) of the distance from a target to the cells of block k of a row, with a small margin so rounding never
+ *		skips a block holding a closer cell. Blocks other than the target's block (colID) are bounded by their nearest meridian
+ * PARAMETERS:
+ *	struct LonBlocks * row:	the row of the block index
+ *	int k, int colID:	the block (before wrapping around the dateline) and the target's block in the row
+ *	double latGap:		the lower bound of the distance to the row (see "rowLatGap")
+ *	double tLon:		the longitude (in radians) of the target
+ *	double cosTLat:		the cosine of the latitude of the target
+ */
+static inline double blockLowerBound(const struct LonBlocks * row, int k, int colID, double latGap, double tLon, double cosTLat) {
+
+	// lower bound of the distance to the block from the longitude difference (distance to the bounding meridian)
+	double lonGap = 0;
+	if(row->nBlocks > 1) {
+		if(k < colID) {
+			lonGap = tLon + M_PI - row->blockSizeR * (k + 1);
+		}
+		else if(k > colID) {
+			lonGap = row->blockSizeR * k - (tLon + M_PI);
+		}
+	}
+	double lowerBound = latGap;
+	if(lonGap > 0 && lonGap < M_PI / 2) {
+		double meridianGap = asin(cosTLat * sin(lonGap));
+		if(meridianGap > lowerBound) {
+			lowerBound = meridianGap;
+		}
+	}
+	return lowerBound * (1 - 1e-9) - 1e-12;
+}
+
+/**
+ * NAME:	queryBlockIndex
+ * DESCRIPTION:	Nearest neighbor query of each target cell on the blocks within blockWindow blocks around it (NN_INDEX_GRID). The nearest cell of the
+ *		target's own block bounds the search: rows and blocks farther than it are skipped, and the blocks left in a row are scanned as one
+ *		run of cells, in order, so the result is the same as scanning all blocks around the target
+ */
+static void queryBlockIndex(const struct NNIndex * index, const double * tarLat, const double * tarLon, int * tarNNSouID, double * tarNNDis, long long nTar) {
+
+	const double earthRadius = 6371009;
+
+	const double * souX = index->souX;
+	const double * souY = index->souY;
+	const double * souZ = index->souZ;
+	const int * souID = index->souID;
+	int nBlockY = index->nBlockY;
+	double latBlockR = index->latBlockR;
+	int capRows = index->capRows;
+	int w = index->blockWindow;
+	double approxFactor = index->approxFactor;
+
+	// Candidates are ranked by squared chord length, which is monotonic with the great circle distance
+	double maxChord2 = chordSquareFromRadian(index->maxradian);
+
+	long long i;
+	int j, k;
+#pragma omp parallel for private(j, k)
+	for(i = 0; i < nTar; i ++) {
+
+		if(!inRegion(&index->region, tarLat[i], tarLon[i])) {
+			tarNNSouID[i] = -1;
+			if(tarNNDis != NULL) { 
+				tarNNDis[i] = -1;
+			}
+			continue;
+		}
+		
+		double tLat = tarLat[i] * M_PI / 180;
+		double tLon = tarLon[i] * M_PI / 180;
+		double cosTLat = cos(tLat);
+		double tX = cosTLat * cos(tLon);
+		double tY = cosTLat * sin(tLon);
+		double tZ = sin(tLat);
+		int rowID, colID;
+		int begin, end;
+		// start just above the squared chord of the search radius, so a candidate at exactly the radius is still accepted
+		double nnDis = nextafter(targetSearchChord2(index, tarLat[i], tarLon[i], maxChord2), 4.0);
+		int nnSouIndex = -1;
+
+		rowID = (tLat + M_PI / 2) / latBlockR;
+
+		// bound of the search from the target's own block (rows with fewer blocks than the window are scanned as a whole)
+		double bound = nnDis;
+		int boundID = -1;
+		const struct LonBlocks * row = (rowID >= capRows && rowID < nBlockY - capRows) ? indexRow(index, rowID) : NULL;
+		if(row != NULL) {
+			if(row->nBlocks < 2 * w + 1) {
+				begin = row->indexID[0];
+				end = row->indexID[row->nStored];
+			}
+			else {
+				blockCells(row, (int)((tLon + M_PI) / row->blockSizeR), &begin, &end);
+			}
+			scanNearestCandidate(souX, souY, souZ, begin, end, tX, tY, tZ, &bound, &boundID);
+		}
+
+		// Rows and blocks within the bound (with a small margin so rounding never skips a cell as close as the bound).
+		// Approximate search only searches for cells approxFactor times closer than the nearest cell of the own block
+		double boundR = radianFromChordSquare(bound);
+		if(approxFactor > 1 && boundID >= 0) {
+			boundR /= approxFactor;
+		}
+		boundR = boundR * (1 + 1e-9) + 1e-12;
+		double sinDLon = sin(boundR) / cosTLat;
+		double dLon = (boundR < M_PI / 2 && sinDLon < 1) ? asin(sinDLon) : M_PI;
+
+		for(j = rowID - w; j <= rowID + w; j ++) {
+			if(j < capRows || j >= nBlockY - capRows || rowLatGap(j, latBlockR, tLat) > boundR) {
+				continue;
+			}
+			row = indexRow(index, j);
+			if(row == NULL) {
+				continue;
+			}
+
+			if(row->nBlocks < 2 * w + 1) {
+				scanNearestCandidate(souX, souY, souZ, row->indexID[0], row->indexID[row->nStored], tX, tY, tZ, &nnDis, &nnSouIndex);
+			} 
+			else {
+				colID = (tLon + M_PI) / row->blockSizeR;
+				int k0 = colID - w;
+				int k1 = colID + w;
+				if(dLon < M_PI) {
+					int kWest = (int)floor((tLon - dLon + M_PI) / row->blockSizeR);
+					int kEast = (int)floor((tLon + dLon + M_PI) / row->blockSizeR);
+					k0 = (kWest > k0) ? kWest : k0;
+					k1 = (kEast < k1) ? kEast : k1;
+				}
+				if(k0 > k1) {
+					continue;
+				}
+				int runBegin[2], runEnd[2];
+				int nRuns = blockRangeCells(row, k0, k1, runBegin, runEnd);
+				for(k = 0; k < nRuns; k ++) {
+					scanNearestCandidate(souX, souY, souZ, runBegin[k], runEnd[k], tX, tY, tZ, &nnDis, &nnSouIndex);
+				}
+			}
+		}
+		if(capRows > 0 && rowID + w >= 0 && rowID - w < capRows) {
+			scanPolarCap(index, 0, tX, tY, tZ, &nnDis, &nnSouIndex);
+		}
+		if(capRows > 0 && rowID - w < nBlockY && rowID + w >= nBlockY - capRows) {
+			scanPolarCap(index, 1, tX, tY, tZ, &nnDis, &nnSouIndex);
+		}
+
+
+		if(nnSouIndex < 0) {
+			tarNNSouID[i] = -1;
+			if(tarNNDis != NULL) { 
+				tarNNDis[i] = -1;
+			}
+		}
+		else {
+			tarNNSouID[i] = souID[nnSouIndex];
+			if(tarNNDis != NULL) {
+				tarNNDis[i] = radianFromChordSquare(nnDis) * earthRadius;
+			}
+		}
+			
+	}	
+}
+
+
+/**
+ * NAME:	querySwath
+ * DESCRIPTION:	Nearest neighbor query of target cells in runs of consecutive cells, each query seeded with the previous result of its run (NN_INDEX_GRID_SWATH).
+ *		The seed is the latest target of the run which had a neighbor. It walks along the source swath to get a close candidate, whose distance
+ *		then bounds an exact search on the blocks: blocks farther than the candidate are skipped, and only the cells within the candidate's
+ *		latitude band are scanned in the other blocks (cells of each block are sorted by latitude). Without a seed (start of a run), or if the
+ *		walk ends beyond maxR, the bound is maxR, which is the plain block search.
+ */
+static void querySwath(const struct NNIndex * index, const double * tarLat, const double * tarLon, int * tarNNSouID, double * tarNNDis, long long nTar) {
+
+	const double earthRadius = 6371009;
+
+	const double * souX = index->souX;
+	const double * souY = index->souY;
+	const double * souZ = index->souZ;
+	const int * souID = index->souID;
+	const struct SwathRecord * souWalk = index->souWalk;
+	int walkBegin = index->walkBegin;
+	int walkEnd = index->walkEnd;
+	double approxFactor = index->approxFactor;
+	int nBlockY = index->nBlockY;
+	double latBlockR = index->latBlockR;
+	int capRows = index->capRows;
+	int w = index->blockWindow;
+
+	double maxChord2 = chordSquareFromRadian(index->maxradian);
+
+	long long i;
+	int j, k;
+
+	long long nRuns = (nTar + SWATH_RUN_SIZE - 1) / SWATH_RUN_SIZE;
+	long long r;
+#pragma omp parallel for private(i, j, k) schedule(dynamic)
+	for(r = 0; r < nRuns; r++) {
+
+		int seed = -1;
+		long long runEnd = (r + 1) * SWATH_RUN_SIZE;
+		if(runEnd > nTar) {
+			runEnd = nTar;
+		}
+
+		for(i = r * SWATH_RUN_SIZE; i < runEnd; i++) {
+
+			double tLat = tarLat[i] * M_PI / 180;
+			double tLon = tarLon[i] * M_PI / 180;
+			int rowID = (tLat + M_PI / 2) / latBlockR;
+			double nnDis = nextafter(targetSearchChord2(index, tarLat[i], tarLon[i], maxChord2), 4.0);
+			int nnSouIndex = -1;
+
+			if(rowID > -1 - w && rowID < nBlockY + w && inRegion(&index->region, tarLat[i], tarLon[i])) {
+
+				double cosTLat = cos(tLat);
+				double tX = cosTLat * cos(tLon);
+				double tY = cosTLat * sin(tLon);
+				double tZ = sin(tLat);
+
+				if(seed >= 0) {
+					// the seed may be a little beyond maxR when targets are sparser than sources, so walk first and check maxR after
+					const struct SwathRecord * rec = souWalk + (seed - walkBegin);
+					double dX = rec->x - tX;
+					double dY = rec->y - tY;
+					double dZ = rec->z - tZ;
+					double walkDis = dX * dX + dY * dY + dZ * dZ;
+					int walkID = seed;
+					walkNearestCandidate(souWalk, walkBegin, walkEnd, tX, tY, tZ, &walkDis, &walkID);
+					if(walkDis < nnDis) {
+						nnDis = walkDis;
+						nnSouIndex = souWalk[walkID - walkBegin].pos;
+					}
+				}
+
+				for(j = rowID - w; j <= rowID + w; j ++) {
+					if(j < capRows || j >= nBlockY - capRows) {
+						continue;
+					}
+					const struct LonBlocks * row = indexRow(index, j);
+					if(row == NULL) {
+						continue;
+					}
+
+					// rows and blocks farther than the current nearest cell are skipped
+					double latGap = rowLatGap(j, latBlockR, tLat);
+					double boundR = radianFromChordSquare(nnDis) * (1 + 1e-9) + 1e-12;
+					if(latGap > boundR) {
+						continue;
+					}
+
+					// all blocks of rows with fewer blocks than the window are searched (bounded by the latitude difference only)
+					int colID = (tLon + M_PI) / row->blockSizeR;
+					int wholeRow = (row->nBlocks < 2 * w + 1);
+					int kBegin = colID - w;
+					int kEnd = colID + w + 1;
+					double sinDLon = sin(boundR) / cosTLat;
+					if(wholeRow) {
+						kBegin = 0;
+						kEnd = row->nStored;
+					}
+					else if(boundR < M_PI / 2 && sinDLon < 1) {
+						double dLon = asin(sinDLon);
+						int kWest = (int)floor((tLon - dLon + M_PI) / row->blockSizeR);
+						int kEast = (int)floor((tLon + dLon + M_PI) / row->blockSizeR) + 1;
+						kBegin = (kWest > kBegin) ? kWest : kBegin;
+						kEnd = (kEast < kEnd) ? kEast : kEnd;
+					}
+
+					for(k = kBegin; k < kEnd; k ++) {
+
+						double lowerBound = blockLowerBound(row, wholeRow ? colID : k, colID, latGap, tLon, cosTLat);
+						if(lowerBound > 0 && chordSquareFromRadian(lowerBound) > nnDis) {
+							continue;
+						}
+						// approximate search: skip the block if even its nearest possible cell would not be approxFactor times closer
+						if(approxFactor > 1 && nnSouIndex >= 0 && lowerBound * approxFactor >= radianFromChordSquare(nnDis)) {
+							continue;
+						}
+
+						int blockBegin, blockEnd;
+						if(wholeRow) {
+							blockBegin = row->indexID[k];
+							blockEnd = row->indexID[k + 1];
+						}
+						else {
+							blockCells(row, k, &blockBegin, &blockEnd);
+						}
+
+						// cells closer than the current nearest one (approxFactor times closer in approximate search) lie within its latitude band
+						double bandR = radianFromChordSquare(nnDis);
+						if(approxFactor > 1 && nnSouIndex >= 0) {
+							bandR /= approxFactor;
+						}
+						bandR = bandR * (1 + 1e-9) + 1e-12;
+						double zLow = (tLat - bandR > -M_PI / 2) ? sin(tLat - bandR) : -1.0;
+						double zHigh = (tLat + bandR < M_PI / 2) ? sin(tLat + bandR) : 1.0;
+						int begin = lowerBoundZ(souZ, blockBegin, blockEnd, zLow);
+						int end = lowerBoundZ(souZ, begin, blockEnd, nextafter(zHigh, 2.0));
+
+						scanNearestCandidate(souX, souY, souZ, begin, end, tX, tY, tZ, &nnDis, &nnSouIndex);
+					}
+				}
+				if(capRows > 0 && rowID - w < capRows) {
+					scanPolarCap(index, 0, tX, tY, tZ, &nnDis, &nnSouIndex);
+				}
+				if(capRows > 0 && rowID + w >= nBlockY - capRows) {
+					scanPolarCap(index, 1, tX, tY, tZ, &nnDis, &nnSouIndex);
+				}
+			}
+
+			if(nnSouIndex >= 0) {
+				seed = souID[nnSouIndex];
+			}
+
+			if(nnSouIndex < 0) {
+				tarNNSouID[i] = -1;
+				if(tarNNDis != NULL) {
+					tarNNDis[i] = -1;
+				}
+			}
+			else {
+				tarNNSouID[i] = souID[nnSouIndex];
+				if(tarNNDis != NULL) {
+					tarNNDis[i] = radianFromChordSquare(nnDis) * earthRadius;
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Number of target cells in a tile of "queryDualGrid" (on average, from the binning of target cells)
+ */
+#define DUAL_GRID_TILE_SIZE 16
+
+/**
+ * Maximum number of candidate source cells of a tile of target cells. Each target of a tile scans all candidates of the tile,
+ * so the targets of tiles with more candidates (a source much finer than the targets) are searched one by one
+ */
+#define DUAL_GRID_MAX_CANDIDATES 256
+
+/**
+ * struct JoinWork: work space of a thread for "joinTile"
+ * ITEMS:
+ *	int * runBegin, * runEnd:	the runs of indexed cells in the candidate blocks of a tile (maxRuns items)
+ *	int maxRuns:			the size of runBegin and runEnd
+ *	double * candX, * candY, * candZ:	the unit vectors of the candidate cells of a tile, gathered (maxCand items)
+ *	int * candPos:			the position of the candidate cells in the index
+ *	int maxCand:			the size of the candidate arrays (grown as needed)
+ */
+struct JoinWork {
+	int * runBegin;
+	int * runEnd;
+	int maxRuns;
+	double * candX;
+	double * candY;
+	double * candZ;
+	int * candPos;
+	int maxCand;
+};
+
+/**
+ * NAME:	joinTile
+ * DESCRIPTION:	Nearest neighbor query of a tile of target cells at once (NN_INDEX_DUAL_GRID). The tile is bounded by a cap around the mean of
+ *		its unit vectors. The nearest cell of the center's own block bounds the nearest distance of every target in the tile (by the
+ *		tile radius), so the source cells farther than that from the whole tile are pruned once: the candidate blocks are selected
+ *		for the tile, and their cells within reach of the center are gathered into one list, which every target of the tile scans.
+ *		A tile wider than maxR is split in halves, and the targets of a tile with more than DUAL_GRID_MAX_CANDIDATES candidates
+ *		are searched one by one
+ * PARAMETERS:
+ *	struct NNIndex * index:	the block index
+ *	double * tX, * tY, * tZ:	the unit vectors of the target cells of the tile
+ *	int nTile:		the number of target cells of the tile
+ *	int * nnID:		the output nearest source cells (position in the index, -1 if none)
+ *	double * nnDis:		input the squared chords of the search radii of the targets (see "targetSearchChord2"),
+ *				output the nearest squared chord lengths
+ *	struct JoinWork * work:	work space of the thread
+ */
+static void joinTile(const struct NNIndex * index, const double * tX, const double * tY, const double * tZ, int nTile, int * nnID, double * nnDis, struct JoinWork * work) {
+
+	const double * souX = index->souX;
+	const double * souY = index->souY;
+	const double * souZ = index->souZ;
+	int nBlockY = index->nBlockY;
+	double latBlockR = index->latBlockR;
+	int capRows = index->capRows;
+	int half = nTile / 2;
+	int t;
+
+	// search radius of the tile: the largest of its targets
+	double maxChord2 = 0;
+	for(t = 0; t < nTile; t++) {
+		maxChord2 = (nnDis[t] > maxChord2) ? nnDis[t] : maxChord2;
+	}
+
+	// center and radius of the tile
+	double cX = 0, cY = 0, cZ = 0;
+	for(t = 0; t < nTile; t++) {
+		cX += tX[t];
+		cY += tY[t];
+		cZ += tZ[t];
+	}
+	double norm = sqrt(cX * cX + cY * cY + cZ * cZ);
+	double tileR = M_PI;
+	if(norm > 0) {
+		cX /= norm;
+		cY /= norm;
+		cZ /= norm;
+		double tileChord2 = 0;
+		for(t = 0; t < nTile; t++) {
+			double dX = tX[t] - cX;
+			double dY = tY[t] - cY;
+			double dZ = tZ[t] - cZ;
+			double chord2 = dX * dX + dY * dY + dZ * dZ;
+			tileChord2 = (chord2 > tileChord2) ? chord2 : tileChord2;
+		}
+		tileR = radianFromChordSquare((tileChord2 < 4) ? tileChord2 : 4);
+	}
+	if(nTile > 1 && tileR > index->maxradian) {
+		joinTile(index, tX, tY, tZ, half, nnID, nnDis, work);
+		joinTile(index, tX + half, tY + half, tZ + half, nTile - half, nnID + half, nnDis + half, work);
+		return;
+	}
+	double cLat = asin((cZ > 1) ? 1 : ((cZ < -1) ? -1 : cZ));
+	double cLon = atan2(cY, cX);
+
+	// bound of the nearest distance of all targets from the nearest cell of the center's own block
+	double seedDis = nextafter(maxChord2, 4.0);
+	int seedID = -1;
+	int begin, end;
+	int cRow = (cLat + M_PI / 2) / latBlockR;
+	const struct LonBlocks * row = (cRow >= capRows && cRow < nBlockY - capRows) ? indexRow(index, cRow) : NULL;
+	if(row != NULL) {
+		blockCells(row, (int)((cLon + M_PI) / row->blockSizeR), &begin, &end);
+		scanNearestCandidate(souX, souY, souZ, begin, end, cX, cY, cZ, &seedDis, &seedID);
+	}
+	double bound = radianFromChordSquare(maxChord2);
+	if(seedID >= 0 && radianFromChordSquare(seedDis) + tileR < bound) {
+		bound = radianFromChordSquare(seedDis) + tileR;
+	}
+
+	// blocks which may hold the nearest cell of a target of the tile (with a small margin for rounding)
+	double reach = (bound + tileR) * (1 + 1e-9) + 1e-12;
+	double sinDLon = sin(reach) / cos(cLat);
+	double dLon = (reach < M_PI / 2 && sinDLon < 1) ? asin(sinDLon) : M_PI;
+	int j0 = (int)floor((cLat - reach + M_PI / 2) / latBlockR);
+	int j1 = (int)floor((cLat + reach + M_PI / 2) / latBlockR);
+	int nRuns = 0;
+	long long nCells = 0;
+	for(int j = (j0 > capRows) ? j0 : capRows; j <= j1 && j < nBlockY - capRows; j ++) {
+		row = indexRow(index, j);
+		if(row == NULL) {
+			continue;
+		}
+		int k0 = (int)floor((cLon - dLon + M_PI) / row->blockSizeR);
+		int k1 = (int)floor((cLon + dLon + M_PI) / row->blockSizeR);
+		if(dLon >= M_PI || k1 - k0 + 1 >= row->nBlocks) {
+			work->runBegin[nRuns] = row->indexID[0];
+			work->runEnd[nRuns] = row->indexID[row->nStored];
+			nCells += work->runEnd[nRuns] - work->runBegin[nRuns];
+			nRuns ++;
+			continue;
+		}
+		int n = blockRangeCells(row, k0, k1, work->runBegin + nRuns, work->runEnd + nRuns);
+		for(int run = nRuns; run < nRuns + n; run ++) {
+			nCells += work->runEnd[run] - work->runBegin[run];
+		}
+		nRuns += n;
+	}
+	if(nTile > 1 && nCells > DUAL_GRID_MAX_CANDIDATES) {
+		for(t = 0; t < nTile; t ++) {
+			joinTile(index, tX + t, tY + t, tZ + t, 1, nnID + t, nnDis + t, work);
+		}
+		return;
+	}
+	int southCap = (capRows > 0 && j0 < capRows);
+	int northCap = (capRows > 0 && j1 >= nBlockY - capRows);
+
+	if(nTile == 1) {
+		// a single target scans the blocks in place
+		double best = nextafter(nnDis[0], 4.0);
+		int bestID = -1;
+		for(int run = 0; run < nRuns; run ++) {
+			scanNearestCandidate(souX, souY, souZ, work->runBegin[run], work->runEnd[run], tX[0], tY[0], tZ[0], &best, &bestID);
+		}
+		if(southCap) {
+			scanPolarCap(index, 0, tX[0], tY[0], tZ[0], &best, &bestID);
+		}
+		if(northCap) {
+			scanPolarCap(index, 1, tX[0], tY[0], tZ[0], &best, &bestID);
+		}
+		nnID[0] = bestID;
+		nnDis[0] = best;
+		return;
+	}
+
+	// gather the cells within reach of the center
+	if(nCells > work->maxCand) {
+		work->maxCand = (int)nCells;
+		if(NULL == (work->candX = (double *)realloc(work->candX, sizeof(double) * work->maxCand)) ||
+		   NULL == (work->candY = (double *)realloc(work->candY, sizeof(double) * work->maxCand)) ||
+		   NULL == (work->candZ = (double *)realloc(work->candZ, sizeof(double) * work->maxCand)) ||
+		   NULL == (work->candPos = (int *)realloc(work->candPos, sizeof(int) * work->maxCand))) {
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+	}
+	double reachChord2 = chordSquareFromRadian((reach < M_PI) ? reach : M_PI);
+	int nCand = 0;
+	for(int run = 0; run < nRuns; run ++) {
+		for(int l = work->runBegin[run]; l < work->runEnd[run]; l ++) {
+			double dX = souX[l] - cX;
+			double dY = souY[l] - cY;
+			double dZ = souZ[l] - cZ;
+			if(dX * dX + dY * dY + dZ * dZ <= reachChord2) {
+				work->candX[nCand] = souX[l];
+				work->candY[nCand] = souY[l];
+				work->candZ[nCand] = souZ[l];
+				work->candPos[nCand] = l;
+				nCand ++;
+			}
+		}
+	}
+
+	// each target scans the candidates of the tile (and the polar caps within its nearest distance)
+	for(t = 0; t < nTile; t++) {
+		double best = nextafter(nnDis[t], 4.0);
+		int bestID = -1;
+		scanNearestCandidate(work->candX, work->candY, work->candZ, 0, nCand, tX[t], tY[t], tZ[t], &best, &bestID);
+		if(bestID >= 0) {
+			bestID = work->candPos[bestID];
+		}
+		if(southCap) {
+			scanPolarCap(index, 0, tX[t], tY[t], tZ[t], &best, &bestID);
+		}
+		if(northCap) {
+			scanPolarCap(index, 1, tX[t], tY[t], tZ[t], &best, &bestID);
+		}
+		nnID[t] = bestID;
+		nnDis[t] = best;
+	}
+}
+
+/**
+ * NAME:	queryDualGrid
+ * DESCRIPTION:	Nearest neighbor join of target cells with the block index (NN_INDEX_DUAL_GRID). Target cells are binned (with one counting sort pass)
+ *		on a latitude/longitude grid over their region, whose cells hold about DUAL_GRID_TILE_SIZE targets, and the targets of each grid
+ *		cell are pruned against the source blocks by tiles of up to DUAL_GRID_TILE_SIZE cells ("joinTile"), so the candidate search is
+ *		shared by neighboring targets. Grid cells are processed in parallel, row by row in alternating directions so consecutive ones
+ *		are adjacent. The result is the same as "queryBlockIndex", except for the choice among equally distant source cells
+ */
+static void queryDualGrid(const struct NNIndex * index, const double * tarLat, const double * tarLon, int * tarNNSouID, double * tarNNDis, long long nTar) {
+
+	const double earthRadius = 6371009;
+	double maxChord2 = chordSquareFromRadian(index->maxradian);
+
+	// grid of tiles over the region of target cells, with square cells on the ground at its middle latitude
+	struct LatLonRegion tarRegion;
+	latLonRegion(tarLat, tarLon, nTar, 0, &tarRegion);
+	double latSpan = (tarRegion.latMax > tarRegion.latMin) ? tarRegion.latMax - tarRegion.latMin : 1e-6;
+	double lonSpan = (tarRegion.lonWidth > 0) ? tarRegion.lonWidth : 1e-6;
+	double cosMid = cos((tarRegion.latMax + tarRegion.latMin) / 2 * M_PI / 180);
+	cosMid = (cosMid > 0.01) ? cosMid : 0.01;
+	double cellDeg = sqrt(latSpan * lonSpan * cosMid * DUAL_GRID_TILE_SIZE / ((tarRegion.nCells > 0) ? tarRegion.nCells : 1));
+	double nCellY = ceil(latSpan / cellDeg);
+	double nCellX = ceil(lonSpan * cosMid / cellDeg);
+	int nY = (nCellY < 1) ? 1 : ((nCellY > 65536) ? 65536 : (int)nCellY);
+	int nX = (nCellX < 1) ? 1 : ((nCellX > 65536) ? 65536 : (int)nCellX);
+	while((long long)nX * nY > nTar / DUAL_GRID_TILE_SIZE * 4 + 1) {
+		nX = (nX + 1) / 2;
+		nY = (nY + 1) / 2;
+	}
+	// cells outside the valid latitude/longitude range go to the last bin
+	long long nBins = (long long)nX * nY + 1;
+
+	int * bin;
+	long long * binBegin;
+	long long * order;
+	if(NULL == (bin = (int *)malloc(sizeof(int) * nTar))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (binBegin = (long long *)calloc(nBins + 1, sizeof(long long)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (order = (long long *)malloc(sizeof(long long) * nTar))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	long long i;
+#pragma omp parallel for
+	for(i = 0; i < nTar; i++) {
+		if(!(tarLat[i] >= -90 && tarLat[i] <= 90 && tarLon[i] >= -180 && tarLon[i] <= 180)) {
+			bin[i] = (int)(nBins - 1);
+			continue;
+		}
+		double d = fmod(tarLon[i] - tarRegion.lonWest, 360.0);
+		if(d < 0) {
+			d += 360;
+		}
+		int y = (int)((tarLat[i] - tarRegion.latMin) / latSpan * nY);
+		int x = (int)(d / lonSpan * nX);
+		y = (y < 0) ? 0 : ((y >= nY) ? nY - 1 : y);
+		x = (x < 0) ? 0 : ((x >= nX) ? nX - 1 : x);
+		bin[i] = y * nX + ((y % 2 == 0) ? x : nX - 1 - x);
+	}
+	for(i = 0; i < nTar; i++) {
+		binBegin[bin[i] + 1] ++;
+	}
+	for(long long b = 0; b < nBins; b++) {
+		binBegin[b + 1] += binBegin[b];
+	}
+	for(i = 0; i < nTar; i++) {
+		order[binBegin[bin[i]] ++] = i;
+	}
+	// the slots were advanced to the end of each bin, shift them back
+	for(long long b = nBins; b > 0; b--) {
+		binBegin[b] = binBegin[b - 1];
+	}
+	binBegin[0] = 0;
+	free(bin);
+
+	// candidate runs of a tile: a tile is at most maxR wide and its bound is at most maxR, so rows within 2 maxR of its center (2 runs each)
+	int maxRows = (int)(4 * index->maxradian * (1 + 1e-9) / index->latBlockR) + 3;
+	maxRows = (maxRows < index->nBlockY) ? maxRows : index->nBlockY;
+
+#pragma omp parallel
+	{
+		struct JoinWork work;
+		work.maxRuns = 2 * (maxRows + 1);
+		work.maxCand = DUAL_GRID_MAX_CANDIDATES;
+		if(NULL == (work.runBegin = (int *)malloc(sizeof(int) * work.maxRuns)) ||
+		   NULL == (work.runEnd = (int *)malloc(sizeof(int) * work.maxRuns)) ||
+		   NULL == (work.candX = (double *)malloc(sizeof(double) * work.maxCand)) ||
+		   NULL == (work.candY = (double *)malloc(sizeof(double) * work.maxCand)) ||
+		   NULL == (work.candZ = (double *)malloc(sizeof(double) * work.maxCand)) ||
+		   NULL == (work.candPos = (int *)malloc(sizeof(int) * work.maxCand))) {
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+		long long tileID[DUAL_GRID_TILE_SIZE];
+		double tX[DUAL_GRID_TILE_SIZE], tY[DUAL_GRID_TILE_SIZE], tZ[DUAL_GRID_TILE_SIZE];
+		int nnID[DUAL_GRID_TILE_SIZE];
+		double nnDis[DUAL_GRID_TILE_SIZE];
+
+		long long b;
+#pragma omp for schedule(dynamic, 16)
+		for(b = 0; b < nBins; b ++) {
+			for(long long first = binBegin[b]; first < binBegin[b + 1]; first += DUAL_GRID_TILE_SIZE) {
+				long long last = (first + DUAL_GRID_TILE_SIZE < binBegin[b + 1]) ? first + DUAL_GRID_TILE_SIZE : binBegin[b + 1];
+				int nTile = 0;
+				for(long long l = first; l < last; l ++) {
+					long long t = order[l];
+					if(!inRegion(&index->region, tarLat[t], tarLon[t])) {
+						tarNNSouID[t] = -1;
+						if(tarNNDis != NULL) {
+							tarNNDis[t] = -1;
+						}
+						continue;
+					}
+					tileID[nTile] = t;
+					nnDis[nTile] = targetSearchChord2(index, tarLat[t], tarLon[t], maxChord2);
+					double tLat = tarLat[t] * M_PI / 180;
+					double tLon = tarLon[t] * M_PI / 180;
+					tX[nTile] = cos(tLat) * cos(tLon);
+					tY[nTile] = cos(tLat) * sin(tLon);
+					tZ[nTile] = sin(tLat);
+					nTile ++;
+				}
+				if(nTile == 0) {
+					continue;
+				}
+
+				joinTile(index, tX, tY, tZ, nTile, nnID, nnDis, &work);
+
+				for(int k = 0; k < nTile; k ++) {
+					long long t = tileID[k];
+					if(nnID[k] < 0) {
+						tarNNSouID[t] = -1;
+						if(tarNNDis != NULL) {
+							tarNNDis[t] = -1;
+						}
+					}
+					else {
+						tarNNSouID[t] = index->souID[nnID[k]];
+						if(tarNNDis != NULL) {
+							tarNNDis[t] = radianFromChordSquare(nnDis[k]) * earthRadius;
+						}
+					}
+				}
+			}
+		}
+		free(work.runBegin);
+		free(work.runEnd);
+		free(work.candX);
+		free(work.candY);
+		free(work.candZ);
+		free(work.candPos);
+	}
+
+	free(order);
+	free(binBegin);
+}
+
+/**
+ * NAME:	setNNIndexQueryOrder
+ * DESCRIPTION:	Set the order target cells are queried in by "queryNNIndex" and "queryKNNIndex". Results are always returned in the storage order
+ * PARAMETERS:
+ *	struct NNIndex * index:	the index of source cells
+ *	int queryOrder:		NN_QUERY_ORDER_STORAGE (default), NN_QUERY_ORDER_MORTON or NN_QUERY_ORDER_HILBERT
+ */
+void setNNIndexQueryOrder(struct NNIndex * index, int queryOrder) {
+	index->queryOrder = queryOrder;
+}
+
+/**
+ * NAME:	setNNIndexApproximation
+ * DESCRIPTION:	Allow nearest neighbor queries ("queryNNIndex") to return a source cell that is not the nearest one, but within (1 + maxError)
+ *		times the distance of the nearest one. Blocks (or k-d tree nodes) which cannot hold a cell that much closer than the current
+ *		candidate are skipped. A target with a source cell within maxR always gets one. k nearest neighbor queries stay exact
+ * PARAMETERS:
+ *	struct NNIndex * index:	the index of source cells
+ *	double maxError:	the relative distance error allowed (e.g. 0.1 for 10%), 0 for exact search (default)
+ */
+void setNNIndexApproximation(struct NNIndex * index, double maxError) {
+	index->approxFactor = (maxError > 0) ? 1 + maxError : 1;
+}
+
+/**
+ * NAME:	setNNIndexCellRadius
+ * DESCRIPTION:	Give each source cell its own search radius (at most maxR), e.g. from the growth of MODIS pixels with the scan angle.
+ *		The largest radius of the source cells is kept for each cell of a latitude/longitude grid of maxR over the region of the index,
+ *		and a target is searched within the largest radius of the source cells around it ("targetSearchChord2") instead of maxR.
+ *		A target reached by the radius of a source cell gets the same nearest cell as with maxR; other targets may get none.
+ *		NN_INDEX_KDTREE indexes search maxR around all targets
+ * PARAMETERS:
+ *	struct NNIndex * index:	the index of source cells
+ *	double * souR:		the search radius (in meters) of source cells by column: the source cell of original ID i has radius souR[i % nCols]
+ *	int nCols:		the number of columns, e.g. the cross-track width of a swath stored scan line by scan line (nSou for a radius per cell)
+ */
+void setNNIndexCellRadius(struct NNIndex * index, const double * souR, int nCols) {
+
+	const double earthRadius = 6371009;
+
+	if(index->radiusGrid != NULL) {
+		free(index->radiusGrid->maxChord2);
+		free(index->radiusGrid);
+		index->radiusGrid = NULL;
+	}
+	const struct LatLonRegion * region = &index->region;
+	if(index->indexType == NN_INDEX_KDTREE || index->nIndexed == 0 || region->nCells == 0 || !(index->maxradian > 0) || nCols < 1) {
+		return;
+	}
+
+	// grid cells of at least maxR, on latitude and on longitude at the latitude of the region farthest from the equator
+	double cellLat = index->maxradian * 180 / M_PI;
+	double cellLon = 360;
+	double latAbs = (fabs(region->latMin) > fabs(region->latMax)) ? fabs(region->latMin) : fabs(region->latMax);
+	double sinDLon = (latAbs < 90) ? sin(index->maxradian) / cos(latAbs * M_PI / 180) : 2;
+	if(sinDLon < 1 && region->lonWidth + asin(sinDLon) * 180 / M_PI < 360) {
+		cellLon = asin(sinDLon) * 180 / M_PI;
+	}
+	double latSpan = region->latMax - region->latMin;
+	long long nY = (long long)(latSpan / cellLat) + 1;
+	long long nX = (cellLon < 360) ? (long long)(region->lonWidth / cellLon) + 1 : 1;
+	if(nX * nY > RADIUS_GRID_MAX_CELLS) {
+		double scale = sqrt((double)(nX * nY) / RADIUS_GRID_MAX_CELLS);
+		cellLat *= scale;
+		nY = (long long)(latSpan / cellLat) + 1;
+		if(nX > 1) {
+			cellLon = (region->lonWidth + cellLon * scale < 360) ? cellLon * scale : 360;
+			nX = (cellLon < 360) ? (long long)(region->lonWidth / cellLon) + 1 : 1;
+		}
+	}
+
+	struct CellRadiusGrid * grid;
+	if(NULL == (grid = (struct CellRadiusGrid *)malloc(sizeof(struct CellRadiusGrid)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	grid->nX = (int)nX;
+	grid->nY = (int)nY;
+	grid->latSouth = region->latMin;
+	grid->lonWest = region->lonWest;
+	grid->cellLat = cellLat;
+	grid->cellLon = cellLon;
+	if(NULL == (grid->maxChord2 = (double *)calloc(nX * nY, sizeof(double)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	// each thread keeps the largest radii of its cells, then merges them into the grid
+#pragma omp parallel
+	{
+		double * local;
+		if(NULL == (local = (double *)calloc(nX * nY, sizeof(double)))) {
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+		int p;
+#pragma omp for
+		for(p = 0; p < index->nIndexed; p++) {
+			double r = souR[index->souID[p] % nCols] / earthRadius;
+			if(!(r > 0)) {
+				continue;
+			}
+			r = (r < index->maxradian) ? r : index->maxradian;
+			double z = index->souZ[p];
+			double lat = asin((z > 1) ? 1 : ((z < -1) ? -1 : z)) * 180 / M_PI;
+			double d = fmod(atan2(index->souY[p], index->souX[p]) * 180 / M_PI - grid->lonWest, 360.0);
+			if(d < 0) {
+				d += 360;
+			}
+			long long gx = (long long)(d / cellLon);
+			long long gy = (long long)((lat - grid->latSouth) / cellLat);
+			gx = (gx < 0) ? 0 : ((gx >= nX) ? nX - 1 : gx);
+			gy = (gy < 0) ? 0 : ((gy >= nY) ? nY - 1 : gy);
+			double chord2 = chordSquareFromRadian(r);
+			if(chord2 > local[gy * nX + gx]) {
+				local[gy * nX + gx] = chord2;
+			}
+		}
+#pragma omp critical
+		{
+			for(long long g = 0; g < nX * nY; g++) {
+				if(local[g] > grid->maxChord2[g]) {
+					grid->maxChord2[g] = local[g];
+				}
+			}
+		}
+		free(local);
+	}
+	index->radiusGrid = grid;
+}
+
+/**
+ * NAME:	approximateNNError
+ * DESCRIPTION:	Measure the distance error of approximate nearest neighbor queries (see "setNNIndexApproximation") on evenly spaced target cells,
+ *		by querying them both approximately and exactly. The error of a target is (approximate distance - exact distance) / exact distance
+ * PARAMETERS:
+ *	struct NNIndex * index:	the index of source cells
+ *	double * tarLat:	the latitudes of target cells
+ *	double * tarLon:	the longitudes of target cells
+ *	long long nTar:		the number of target cells
+ *	long long nSample:	the number of target cells to check
+ * Output:
+ *	double * maxError:	the largest error of checked target cells
+ *	double * meanError:	the mean error of checked target cells
+ *	the number of checked target cells with a neighboring source cell
+ */
+long long approximateNNError(const struct NNIndex * index, const double * tarLat, const double * tarLon, long long nTar, long long nSample, double * maxError, double * meanError) {
+
+	*maxError = 0;
+	*meanError = 0;
+	if(nSample > nTar) {
+		nSample = nTar;
+	}
+	if(nSample <= 0) {
+		return 0;
+	}
+
+	double * sampleLat;
+	double * sampleLon;
+	int * sampleID;
+	double * approxDis;
+	double * exactDis;
+	if(NULL == (sampleLat = (double *)malloc(sizeof(double) * nSample))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (sampleLon = (double *)malloc(sizeof(double) * nSample))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (sampleID = (int *)malloc(sizeof(int) * nSample))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (approxDis = (double *)malloc(sizeof(double) * nSample))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (exactDis = (double *)malloc(sizeof(double) * nSample))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	long long i;
+	for(i = 0; i < nSample; i++) {
+		long long t = i * (nTar / nSample);
+		sampleLat[i] = tarLat[t];
+		sampleLon[i] = tarLon[t];
+	}
+
+	struct NNIndex sampleIndex = *index;
+	sampleIndex.queryOrder = NN_QUERY_ORDER_STORAGE;
+	queryNNIndex(&sampleIndex, sampleLat, sampleLon, sampleID, approxDis, nSample);
+	sampleIndex.approxFactor = 1;
+	queryNNIndex(&sampleIndex, sampleLat, sampleLon, sampleID, exactDis, nSample);
+
+	long long nChecked = 0;
+	double sumError = 0;
+	for(i = 0; i < nSample; i++) {
+		if(exactDis[i] < 0) {
+			continue;
+		}
+		double error = (exactDis[i] > 0) ? (approxDis[i] - exactDis[i]) / exactDis[i] : 0;
+		if(error > *maxError) {
+			*maxError = error;
+		}
+		sumError += error;
+		nChecked++;
+	}
+	if(nChecked > 0) {
+		*meanError = sumError / nChecked;
+	}
+
+	free(sampleLat);
+	free(sampleLon);
+	free(sampleID);
+	free(approxDis);
+	free(exactDis);
+
+	return nChecked;
+}
+
+/**
+ * NAME:	gatherCurveOrder
+ * DESCRIPTION:	Order target cells along a space-filling curve (see "spaceFillingCurveOrder") and gather their latitudes and longitudes in that order
+ * PARAMETERS:
+ *	int curve:		NN_QUERY_ORDER_MORTON or NN_QUERY_ORDER_HILBERT
+ *	double * tarLat:	the latitudes of target cells
+ *	double * tarLon:	the longitudes of target cells
+ *	long long nTar:		the number of target cells
+ * Output:
+ *	long long ** pOrder:	the IDs of target cells along the curve
+ *	double ** pCurveLat:	the latitudes of target cells along the curve
+ *	double ** pCurveLon:	the longitudes of target cells along the curve
+ */
+static void gatherCurveOrder(int curve, const double * tarLat, const double * tarLon, long long nTar, long long ** pOrder, double ** pCurveLat, double ** pCurveLon) {
+
+	long long * order;
+	double * curveLat;
+	double * curveLon;
+	if(NULL == (order = (long long *)malloc(sizeof(long long) * nTar))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (curveLat = (double *)malloc(sizeof(double) * nTar))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (curveLon = (double *)malloc(sizeof(double) * nTar))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	spaceFillingCurveOrder(tarLat, tarLon, nTar, curve, order);
+	long long i;
+#pragma omp parallel for
+	for(i = 0; i < nTar; i++) {
+		curveLat[i] = tarLat[order[i]];
+		curveLon[i] = tarLon[order[i]];
+	}
+
+	*pOrder = order;
+	*pCurveLat = curveLat;
+	*pCurveLon = curveLon;
+}
+
+/**
+ * NAME:	queryNNIndex
+ * DESCRIPTION:	Find the nearest neighboring source cell's ID for each target cell, using an index built by "buildNNIndex". The input arrays are not changed
+ * PARAMETERS:
+ *	struct NNIndex * index:	the index of source cells
+ *	double * tarLat:	the latitudes of target cells
+ *	double * tarLon:	the longitudes of target cells
+ *	int * tarNNSouID:	the output IDs of nearest neighboring source cells
+ *	double * tarNNDis	the output nearest distance for each target cell (input NULL if you don't need this field)
+ *	int nTar:		the number of target cells
+ * Output:
+ *	int * tarNNSouID:	the output IDs of nearest neighboring source cells
+ *	double * tarNNDis	the output nearest distance for each target cell (input NULL if you don't need this field)
+ */
+void queryNNIndex(const struct NNIndex * index, const double * tarLat, const double * tarLon, int * tarNNSouID, double * tarNNDis, long long nTar) {
+
+	const double earthRadius = 6371009;
+
+#if DEBUG_ELAPSE_TIME
+	double queryStart = omp_get_wtime();
+#endif
+
+	if(index->indexType == NN_INDEX_DUAL_GRID) {
+		// tiles target cells by its own binning
+		queryDualGrid(index, tarLat, tarLon, tarNNSouID, tarNNDis, nTar);
+	}
+	else if(index->queryOrder != NN_QUERY_ORDER_STORAGE) {
+		// query in curve order, then scatter results back to the storage order
+		long long * order;
+		double * curveLat;
+		double * curveLon;
+		int * curveNNSouID;
+		double * curveNNDis = NULL;
+		gatherCurveOrder(index->queryOrder, tarLat, tarLon, nTar, &order, &curveLat, &curveLon);
+		if(NULL == (curveNNSouID = (int *)malloc(sizeof(int) * nTar))) {
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+		if(tarNNDis != NULL && NULL == (curveNNDis = (double *)malloc(sizeof(double) * nTar))) {
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+
+		struct NNIndex storageOrder = *index;
+		storageOrder.queryOrder = NN_QUERY_ORDER_STORAGE;
+		queryNNIndex(&storageOrder, curveLat, curveLon, curveNNSouID, curveNNDis, nTar);
+
+		long long i;
+#pragma omp parallel for
+		for(i = 0; i < nTar; i++) {
+			tarNNSouID[order[i]] = curveNNSouID[i];
+			if(tarNNDis != NULL) {
+				tarNNDis[order[i]] = curveNNDis[i];
+			}
+		}
+		free(order);
+		free(curveLat);
+		free(curveLon);
+		free(curveNNSouID);
+		free(curveNNDis);
+	}
+	else if(index->indexType == NN_INDEX_KDTREE) {
+		queryKDTreeIndex(index->souTree, tarLat, tarLon, tarNNSouID, tarNNDis, nTar, index->maxradian * earthRadius, index->approxFactor);
+	}
+	else if(index->indexType == NN_INDEX_GRID_SWATH) {
+		querySwath(index, tarLat, tarLon, tarNNSouID, tarNNDis, nTar);
+	}
+	else {
+		queryBlockIndex(index, tarLat, tarLon, tarNNSouID, tarNNDis, nTar);
+	}
+
+#if DEBUG_ELAPSE_TIME
+	printf("DBG_TIME> %s: query %.3f sec\n", __FUNCTION__, omp_get_wtime() - queryStart);
+#endif
+}
+
+/**
+ * NAME:	scanKNNCandidate
+ * DESCRIPTION:	Scan a contiguous run [begin, end) of source unit vectors for the k closest to a target.
+ *		A candidate replaces the k-th nearest one only if it is strictly closer, and equally distant candidates keep the scan order
+ * PARAMETERS:
+ *	double * souX, * souY, * souZ:	the unit vectors of source cells
+ *	int begin, int end:	the range of source cells to scan
+ *	double tX, tY, tZ:	the unit vector of the target cell
+ *	int k:			the number of nearest candidates to keep
+ *	double * knnDis:	the current k nearest squared chord lengths, nearest first
+ *	int * knnID:		the current k nearest source cells (index into souX, -1 if none)
+ * Output:
+ *	double * knnDis, int * knnID are updated if closer candidates are found
+ */
+static inline void scanKNNCandidate(const double * souX, const double * souY, const double * souZ, int begin, int end, double tX, double tY, double tZ, int k, double * knnDis, int * knnID) {
+
+	double kthDis = knnDis[k - 1];
+
+	for(int l = begin; l < end; l++) {
+		double dX = souX[l] - tX;
+		double dY = souY[l] - tY;
+		double dZ = souZ[l] - tZ;
+		double pDis = dX * dX + dY * dY + dZ * dZ;
+		if(pDis < kthDis) {
+			int m = k - 1;
+			while(m > 0 && knnDis[m - 1] > pDis) {
+				knnDis[m] = knnDis[m - 1];
+				knnID[m] = knnID[m - 1];
+				m --;
+			}
+			knnDis[m] = pDis;
+			knnID[m] = l;
+			kthDis = knnDis[k - 1];
+		}
+	}
+}
+
+/**
+ * NAME:	scanPolarCapKNN
+ * DESCRIPTION:	k nearest neighbor scan of the grid cells of a polar cap around a target (within the current k-th nearest distance)
+ * PARAMETERS:
+ *	struct NNIndex * index:	the block index
+ *	int cap:		0 for the south cap, 1 for the north cap
+ *	double tX, tY, tZ:	the unit vector of the target cell
+ *	int k:			the number of nearest candidates to keep
+ *	double * knnDis:	the current k nearest squared chord lengths, nearest first
+ *	int * knnID:		the current k nearest source cells (index into souX, -1 if none)
+ */
+static inline void scanPolarCapKNN(const struct NNIndex * index, int cap, double tX, double tY, double tZ, int k, double * knnDis, int * knnID) {
+	int cx0, cx1, cy0, cy1;
+	if(!capWindow(index, tX, tY, sqrt(knnDis[k - 1]), &cx0, &cx1, &cy0, &cy1)) {
+		return;
+	}
+	const int * indexID = index->capIndexID[cap];
+	for(int cy = cy0; cy <= cy1; cy++) {
+		scanKNNCandidate(index->souX, index->souY, index->souZ, indexID[cy * index->capGrid + cx0], indexID[cy * index->capGrid + cx1 + 1], tX, tY, tZ, k, knnDis, knnID);
+	}
+}
+
+/**
+ * NAME:	queryKNNBlockIndex
+ * DESCRIPTION:	k nearest neighbor query of each target cell on the blocks within blockWindow blocks around it (grid types).
+ *		Rows with no more blocks than the window are scanned as a whole, so no block is scanned twice
+ */
+static void queryKNNBlockIndex(const struct NNIndex * index, const double * tarLat, const double * tarLon, int k, int * tarKNNSouID, double * tarKNNDis, long long nTar) {
+
+	const double earthRadius = 6371009;
+
+	const double * souX = index->souX;
+	const double * souY = index->souY;
+	const double * souZ = index->souZ;
+	const int * souID = index->souID;
+	int nBlockY = index->nBlockY;
+	double latBlockR = index->latBlockR;
+	int capRows = index->capRows;
+	int w = index->blockWindow;
+
+	double maxChord2 = chordSquareFromRadian(index->maxradian);
+
+	long long i;
+#pragma omp parallel for schedule(dynamic, 1024)
+	for(i = 0; i < nTar; i ++) {
+
+		// the k nearest are kept in place in the output arrays, as squared chords and index positions until the end
+		int * knnID = tarKNNSouID + (size_t)i * k;
+		double * knnDis = tarKNNDis + (size_t)i * k;
+		double searchChord2 = targetSearchChord2(index, tarLat[i], tarLon[i], maxChord2);
+		for(int l = 0; l < k; l++) {
+			knnID[l] = -1;
+			knnDis[l] = nextafter(searchChord2, 4.0);
+		}
+		if(!inRegion(&index->region, tarLat[i], tarLon[i])) {
+			for(int l = 0; l < k; l++) {
+				knnDis[l] = -1;
+			}
+			continue;
+		}
+
+		double tLat = tarLat[i] * M_PI / 180;
+		double tLon = tarLon[i] * M_PI / 180;
+		double tX = cos(tLat) * cos(tLon);
+		double tY = cos(tLat) * sin(tLon);
+		double tZ = sin(tLat);
+
+		int rowID = (tLat + M_PI / 2) / latBlockR;
+
+		for(int j = rowID - w; j <= rowID + w; j ++) {
+			if(j < capRows || j >= nBlockY - capRows) {
+				continue;
+			}
+			const struct LonBlocks * row = indexRow(index, j);
+			if(row == NULL) {
+				continue;
+			}
+			int nBlocks = row->nBlocks;
+			if(nBlocks <= 2 * w + 1) {
+				scanKNNCandidate(souX, souY, souZ, row->indexID[0], row->indexID[row->nStored], tX, tY, tZ, k, knnDis, knnID);
+				continue;
+			}
+			int colID = (tLon + M_PI) / row->blockSizeR;
+			if(colID < 0) {
+				colID = 0;
+			}
+			if(colID >= nBlocks) {
+				colID = nBlocks - 1;
+			}
+			int runBegin[2], runEnd[2];
+			int nRuns = blockRangeCells(row, colID - w, colID + w, runBegin, runEnd);
+			for(int run = 0; run < nRuns; run ++) {
+				scanKNNCandidate(souX, souY, souZ, runBegin[run], runEnd[run], tX, tY, tZ, k, knnDis, knnID);
+			}
+		}
+		if(capRows > 0 && rowID + w >= 0 && rowID - w < capRows) {
+			scanPolarCapKNN(index, 0, tX, tY, tZ, k, knnDis, knnID);
+		}
+		if(capRows > 0 && rowID - w < nBlockY && rowID + w >= nBlockY - capRows) {
+			scanPolarCapKNN(index, 1, tX, tY, tZ, k, knnDis, knnID);
+		}
+
+		for(int l = 0; l < k; l++) {
+			if(knnID[l] < 0) {
+				knnDis[l] = -1;
+			}
+			else {
+				knnID[l] = souID[knnID[l]];
+				knnDis[l] = radianFromChordSquare(knnDis[l]) * earthRadius;
+			}
+		}
+	}
+}
+
+/**
+ * NAME:	queryKNNIndex
+ * DESCRIPTION:	Find the k nearest neighboring source cells' IDs for each target cell, using an index built by "buildNNIndex". The input arrays are not changed
+ * PARAMETERS:
+ *	struct NNIndex * index:	the index of source cells
+ *	double * tarLat:	the latitudes of target cells
+ *	double * tarLon:	the longitudes of target cells
+ *	int k:			the number of nearest neighbors for each target cell
+ *	int * tarKNNSouID:	the output IDs of k nearest neighboring source cells (nTar * k, nearest first, -1 for the slots not found)
+ *	double * tarKNNDis:	the output distances (in meters) to the k nearest neighboring source cells (nTar * k, -1 for the slots not found)
+ *	int nTar:		the number of target cells
+ * Output:
+ *	int * tarKNNSouID:	the output IDs of k nearest neighboring source cells
+ *	double * tarKNNDis:	the output distances to the k nearest neighboring source cells
+ */
+void queryKNNIndex(const struct NNIndex * index, const double * tarLat, const double * tarLon, int k, int * tarKNNSouID, double * tarKNNDis, long long nTar) {
+
+	const double earthRadius = 6371009;
+
+#if DEBUG_ELAPSE_TIME
+	double queryStart = omp_get_wtime();
+#endif
+
+	if(index->queryOrder != NN_QUERY_ORDER_STORAGE) {
+		// query in curve order, then scatter the k results of each target back to the storage order
+		long long * order;
+		double * curveLat;
+		double * curveLon;
+		int * curveKNNSouID;
+		double * curveKNNDis = NULL;
+		gatherCurveOrder(index->queryOrder, tarLat, tarLon, nTar, &order, &curveLat, &curveLon);
+		if(NULL == (curveKNNSouID = (int *)malloc(sizeof(int) * nTar * k))) {
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+		if(tarKNNDis != NULL && NULL == (curveKNNDis = (double *)malloc(sizeof(double) * nTar * k))) {
+			printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+			exit(1);
+		}
+
+		struct NNIndex storageOrder = *index;
+		storageOrder.queryOrder = NN_QUERY_ORDER_STORAGE;
+		queryKNNIndex(&storageOrder, curveLat, curveLon, k, curveKNNSouID, curveKNNDis, nTar);
+
+		long long i;
+#pragma omp parallel for
+		for(i = 0; i < nTar; i++) {
+			long long t = order[i];
+			for(int j = 0; j < k; j++) {
+				tarKNNSouID[t * k + j] = curveKNNSouID[i * k + j];
+				if(tarKNNDis != NULL) {
+					tarKNNDis[t * k + j] = curveKNNDis[i * k + j];
+				}
+			}
+		}
+		free(order);
+		free(curveLat);
+		free(curveLon);
+		free(curveKNNSouID);
+		free(curveKNNDis);
+	}
+	else if(index->indexType == NN_INDEX_KDTREE) {
+		queryKNNKDTreeIndex(index->souTree, tarLat, tarLon, k, tarKNNSouID, tarKNNDis, nTar, index->maxradian * earthRadius);
+	}
+	else {
+		queryKNNBlockIndex(index, tarLat, tarLon, k, tarKNNSouID, tarKNNDis, nTar);
+	}
+
+#if DEBUG_ELAPSE_TIME
+	printf("DBG_TIME> %s: query %.3f sec\n", __FUNCTION__, omp_get_wtime() - queryStart);
+#endif
+}
+
+/**
+ * NAME:	freeNNIndex
+ * DESCRIPTION:	Release an index built by "buildNNIndex"
+ */
+void freeNNIndex(struct NNIndex * index) {
+
+	if(index->souTree != NULL) {
+		freeKDTreeIndex(index->souTree);
+	}
+	if(index->souIndex != NULL) {
+		freeLatLonIndex(index->souIndex);
+	}
+	free(index->souX);
+	free(index->souY);
+	free(index->souZ);
+	free(index->souID);
+	free(index->souWalk);
+	free(index->capIndexID[0]);
+	free(index->capIndexID[1]);
+	if(index->radiusGrid != NULL) {
+		free(index->radiusGrid->maxChord2);
+		free(index->radiusGrid);
+	}
+	free(index);
+}
+
+ /**
+ * NAME:	nearestNeighborBlockIndex
+ * DESCRIPTION:	Find the nearest neighboring source cell's ID for each target cell
+ * PARAMETERS:
+ *	double ** psouLat:	the pointer to the array of latitudes of source cells (not changed)
+ *	double ** psouLon:	the pointer to the array of longitudes of source cells (not changed)
+ *	int nSou:		the number of source cells
+ *	double * tarLat:	the latitudes of target cells
+ *	double * tarLon:	the longitudes of target cells
+ *	int * tarNNSouID:	the output IDs of nearest neighboring source cells 
+ *	double * tarNNDis	the output nearest distance for each target cell (input NULL if you don't need this field)
+ *	int nTar:		the number of target cells
+ *	double maxR:		the maximum distance (in meters) to define neighboring cells
+ * Output: 	
+ *	int * tarNNSouID:	the output IDs of nearest neighboring source cells 
+ *	double * tarNNDis	the output nearest distance for each target cell (input NULL if you don't need this field)
+ */
+void nearestNeighborBlockIndex(double ** psouLat, double ** psouLon, int nSou, double * tarLat, double * tarLon, int * tarNNSouID, double * tarNNDis, int nTar, double maxR) {
+
+	struct NNIndex * index = buildNNIndex(*psouLat, *psouLon, nSou, maxR, NN_INDEX_GRID);
+	queryNNIndex(index, tarLat, tarLon, tarNNSouID, tarNNDis, nTar);
+	freeNNIndex(index);
+}
+
+/**
+ * NAME:	nearestNeighborSwath
+ * DESCRIPTION:	Find the nearest neighboring source cell's ID for each target cell, exploiting the scan line order of target cells (see "querySwath").
+ *		Results are the same as "nearestNeighborBlockIndex", except that which one of equally distant source cells is chosen may differ.
+ * PARAMETERS:
+ *	double ** psouLat:	the pointer to the array of latitudes of source cells (not changed)
+ *	double ** psouLon:	the pointer to the array of longitudes of source cells (not changed)
+ *	int nSou:		the number of source cells
+ *	double * tarLat:	the latitudes of target cells
+ *	double * tarLon:	the longitudes of target cells
+ *	int * tarNNSouID:	the output IDs of nearest neighboring source cells
+ *	double * tarNNDis	the output nearest distance for each target cell (input NULL if you don't need this field)
+ *	int nTar:		the number of target cells
+ *	double maxR:		the maximum distance (in meters) to define neighboring cells
+ * Output:
+ *	int * tarNNSouID:	the output IDs of nearest neighboring source cells
+ *	double * tarNNDis	the output nearest distance for each target cell (input NULL if you don't need this field)
+ */
+void nearestNeighborSwath(double ** psouLat, double ** psouLon, int nSou, double * tarLat, double * tarLon, int * tarNNSouID, double * tarNNDis, int nTar, double maxR) {
+
+	struct NNIndex * index = buildNNIndex(*psouLat, *psouLon, nSou, maxR, NN_INDEX_GRID_SWATH);
+	queryNNIndex(index, tarLat, tarLon, tarNNSouID, tarNNDis, nTar);
+	freeNNIndex(index);
+}
+
+
+
+/**
+ * NAME:	nearestNeighbor
+ * DESCRIPTION:	Find the nearest neighboring source cell's ID for each target cell
+ * PARAMETERS:
+ *	double ** psouLat:	the pointer to the array of latitudes of source cells (the data are changed during in the function, so please do the output before this function)
+ *	double ** psouLon:	the pointer to the array of longitudes of source cells (the data are changed during in the function, so please do the output before this function)
+ *	int nSou:		the number of source cells
+ *	double * tarLat:	the latitudes of target cells
+ *	double * tarLon:	the longitudes of target cells
+ *	int * tarNNSouID:	the output IDs of nearest neighboring source cells 
+ *	double * tarNNDis	the output nearest distance for each target cell (input NULL if you don't need this field)
+ *	int nTar:		the number of target cells
+ *	double maxR:		the maximum distance (in meters) to define neighboring cells
+ * Output: 	
+ *	int * tarNNSouID:	the output IDs of nearest neighboring source cells 
+ *	double * tarNNDis	the output nearest distance for each target cell (input NULL if you don't need this field)
+ */ 
+void nearestNeighbor(double ** psouLat, double ** psouLon, int nSou, double * tarLat, double * tarLon, int * tarNNSouID, double * tarNNDis, int nTar, double maxR) {
+
+	//printf("%0x\n", souLat);
+	double * souLat = *psouLat;
+	double * souLon = *psouLon;
+
+	const double earthRadius = 6371009;
+	//const double earthRadius = 6367444;
+	double maxradian = maxR / earthRadius;
+	int nBlockY = M_PI / maxradian;
+
+	double blockR = M_PI / nBlockY;
+	
+	int i;
+#pragma omp parallel for
+	for(i = 0; i < nSou; i++) {
+		souLat[i] = souLat[i] * M_PI / 180;
+		souLon[i] = souLon[i] * M_PI / 180;
+	}
+
+#pragma omp parallel for
+	for(i = 0; i < nTar; i++) {
+		tarLat[i] = tarLat[i] * M_PI / 180;
+		tarLon[i] = tarLon[i] * M_PI / 180;
+	}
+
+	int * souID;
+	if(NULL == (souID = (int *)malloc(sizeof(double) * nSou))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+#if DEBUG_ELAPSE_TIME
+	double buildStart = omp_get_wtime();
+#endif
+	int * souIndex = pointIndexOnLat(psouLat, psouLon, souID, nSou, nBlockY);
+	souLat = *psouLat;
+	souLon = *psouLon;
+
+	// Convert the (sorted) source cells to unit vectors once. x and y overwrite souLat and souLon.
+	double * souX = souLat;
+	double * souY = souLon;
+	double * souZ;
+	if(NULL == (souZ = (double *)malloc(sizeof(double) * nSou))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	latLonToUnitVector(souLat, souLon, souX, souY, souZ, souIndex[nBlockY]);
+
+	double maxChord2 = chordSquareFromRadian(maxradian);
+
+
+#if DEBUG_ELAPSE_TIME
+	double queryStart = omp_get_wtime();
+#endif
+#pragma omp parallel for
+	for(i = 0; i < nTar; i ++) {
+
+		double tLat = tarLat[i];
+		double tLon = tarLon[i];
+		double tX = cos(tLat) * cos(tLon);
+		double tY = cos(tLat) * sin(tLon);
+		double tZ = sin(tLat);
+		
+		// start just above the squared chord of maxR, so a candidate at exactly maxR is still accepted
+		double nnDis = nextafter(maxChord2, 4.0);
+		int nnSouIndex = -1;
+
+		int blockID = (tLat + M_PI / 2) / blockR;
+		int startBlock = blockID - 1;
+		int endBlock = blockID + 1;
+
+		if(startBlock < 0) {
+			startBlock = 0;
+		}
+		if(endBlock > nBlockY - 1) {
+			endBlock = nBlockY - 1;
+		}
+
+		scanNearestCandidate(souX, souY, souZ, souIndex[startBlock], souIndex[endBlock+1], tX, tY, tZ, &nnDis, &nnSouIndex);
+
+		if(nnSouIndex < 0) {
+			tarNNSouID[i] = -1;
+			if(tarNNDis != NULL) {
+				tarNNDis[i] = -1;
+			}
+		}
+		else {
+			tarNNSouID[i] = souID[nnSouIndex];
+			if(tarNNDis != NULL) {
+				tarNNDis[i] = radianFromChordSquare(nnDis) * earthRadius;
+			}
+		}
+	
+		 
+	}
+
+#if DEBUG_ELAPSE_TIME
+	printf("DBG_TIME> %s: index build %.3f sec, query %.3f sec\n", __FUNCTION__, queryStart - buildStart, omp_get_wtime() - queryStart);
+#endif
+
+	free(souID);
+	free(souZ);
+	free(souIndex);
+	
+	return;	
+}
+
+/* Old version of "nearestNeighbor", no longer in use
+ 
+void nearestNeighbor(double ** psouLat, double ** psouLon, int nSou, double * tarLat, double * tarLon, int * tarNNSouID, int nTar, double maxR) {
+
+	//printf("%0x\n", souLat);
+	double * souLat = *psouLat;
+	double * souLon = *psouLon;
+
+	const double earthRadius = 6367444;
+	double maxradian = maxR / earthRadius;
+	int nBlockY = M_PI / maxradian;
+
+	double blockR = M_PI / nBlockY;
+	
+
+	for(int i = 0; i < nSou; i++) {
+		souLat[i] = souLat[i] * M_PI / 180;
+		souLon[i] = souLon[i] * M_PI / 180;
+	}
+
+	for(int i = 0; i < nTar; i++) {
+		tarLat[i] = tarLat[i] * M_PI / 180;
+		tarLon[i] = tarLon[i] * M_PI / 180;
+	}
+
+	int * souID;
+	if(NULL == (souID = (int *)malloc(sizeof(double) * nSou))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	int * souIndex = pointIndexOnLat(psouLat, psouLon, souID, nSou, nBlockY);
+	souLat = *psouLat;
+	souLon = *psouLon;
+
+	double tLat, tLon;
+	double sLat, sLon;
+	int blockID;
+	int startBlock, endBlock;
+
+	double pDis;	
+	double nnDis;
+	int nnSouID;
+
+	for(int i = 0; i < nTar; i ++) {
+
+		tLat = tarLat[i];
+		tLon = tarLon[i];
+
+		blockID = (tLat + M_PI / 2) / blockR;
+		startBlock = blockID - 1;
+		endBlock = blockID + 1;
+
+		if(startBlock < 0) {
+			startBlock = 0;
+		}
+		if(endBlock > nBlockY - 1) {
+			endBlock = nBlockY - 1;
+		}
+
+		nnDis = -1;
+		
+		for(int j = souIndex[startBlock]; j < souIndex[endBlock+1]; j++) {
+			
+			sLat = souLat[j];
+			sLon = souLon[j];
+
+			pDis = acos(sin(tLat) * sin(sLat) + cos(tLat) * cos(sLat) * cos(tLon - sLon));
+				
+			if((nnDis < 0 || nnDis > pDis) && pDis <= maxradian) {
+				nnDis = pDis;
+				nnSouID = souID[j];
+			}
+				
+		}
+
+		if(nnDis < 0) {
+			tarNNSouID[i] = -1;
+		}
+		else {
+			tarNNSouID[i] = nnSouID;
+		}
+	
+		 
+	}
+	
+	free(souID);
+	free(souIndex);
+	
+	return;	
+}
+*/
+
+
+/**
+ * NAME:	nnInterpolate
+ * DESCRIPTION:	Nearest neighbor interpolation
+ * PARAMETERS:
+ * 	double * souVal:	the input values at source cells
+ * 	double * tarVal:	the output values at target cells
+ * 	int * tarNNSouID:	the IDs of nearest neighboring source cells for each target cells (generated from "nearestNeighbor") 
+ *	int nTar:		the number of target cells
+ * Output: 	
+ * 	double * tarVal:	the output values at target cells
+ */ 
+template <typename T>
+static void nnInterpolateKernel(const T * souVal, T * tarVal, const int * tarNNSouID, int nTar) {
+
+	int nnSouID;
+	int i;
+
+#pragma omp parallel for private(nnSouID)
+	for(i = 0; i < nTar; i++) {
+		nnSouID = tarNNSouID[i];
+		if(nnSouID < 0) {
+			tarVal[i] = -999;
+		}
+		else {
+			tarVal[i] = souVal[nnSouID];
+		}
+	}
+}
+
+void nnInterpolate(double * souVal, double * tarVal, int * tarNNSouID, int nTar) {
+	nnInterpolateKernel<double>(souVal, tarVal, tarNNSouID, nTar);
+}
+
+void nnInterpolate(float * souVal, float * tarVal, int * tarNNSouID, int nTar) {
+	nnInterpolateKernel<float>(souVal, tarVal, tarNNSouID, nTar);
+}
+
+
+/**
+ * Number of target cells per tile in "nnInterpolateMultiBand". The IDs of a tile stay in cache while all bands are gathered
+ */
+#define NN_MULTIBAND_TILE 2048
+
+/**
+ * NAME:	nnInterpolateMultiBand
+ * DESCRIPTION:	Nearest neighbor interpolation of several bands in one pass over the nearest neighbor IDs.
+ *		Target cells are processed in tiles, and each tile of IDs is read from memory once for all bands
+ * PARAMETERS:
+ * 	double ** souVal:	the input values at source cells, one array per band
+ * 	double ** tarVal:	the output values at target cells, one array per band
+ *	int nBands:		the number of bands
+ * 	int * tarNNSouID:	the IDs of nearest neighboring source cells for each target cells (generated from "nearestNeighbor") 
+ *	int nTar:		the number of target cells
+ * Output: 	
+ * 	double ** tarVal:	the output values at target cells
+ */ 
+template <typename T>
+static void nnInterpolateMultiBandKernel(T ** souVal, T ** tarVal, int nBands, const int * tarNNSouID, int nTar) {
+
+	int t;
+#pragma omp parallel for schedule(static)
+	for(t = 0; t < nTar; t += NN_MULTIBAND_TILE) {
+		int tEnd = t + NN_MULTIBAND_TILE;
+		if(tEnd > nTar) {
+			tEnd = nTar;
+		}
+		for(int b = 0; b < nBands; b++) {
+			const T * bandSouVal = souVal[b];
+			T * bandTarVal = tarVal[b];
+			for(int i = t; i < tEnd; i++) {
+				int nnSouID = tarNNSouID[i];
+				bandTarVal[i] = (nnSouID < 0) ? -999 : bandSouVal[nnSouID];
+			}
+		}
+	}
+}
+
+void nnInterpolateMultiBand(double ** souVal, double ** tarVal, int nBands, int * tarNNSouID, int nTar) {
+	nnInterpolateMultiBandKernel<double>(souVal, tarVal, nBands, tarNNSouID, nTar);
+}
+
+void nnInterpolateMultiBand(float ** souVal, float ** tarVal, int nBands, int * tarNNSouID, int nTar) {
+	nnInterpolateMultiBandKernel<float>(souVal, tarVal, nBands, tarNNSouID, nTar);
+}
+
+
+/**
+ * NAME:	idwWeights
+ * DESCRIPTION:	Inverse distance weights of the k nearest neighboring source cells of each target cell, normalized to sum to 1.
+ *		A source cell at (almost) zero distance takes the whole weight. Compute them once and use them for all bands with "idwInterpolate"
+ * PARAMETERS:
+ * 	int * tarKNNSouID:	the IDs of k nearest neighboring source cells for each target cell (generated from "queryKNNIndex")
+ * 	double * tarKNNDis:	the distances to k nearest neighboring source cells for each target cell (generated from "queryKNNIndex")
+ * 	float * tarKNNWeight:	the output weights (nTar * k, 0 for the slots not found)
+ *	int k:			the number of nearest neighbors for each target cell
+ *	double power:		the power of distance (2 for the usual inverse squared distance)
+ *	int nTar:		the number of target cells
+ * Output:
+ * 	float * tarKNNWeight:	the output weights
+ */
+void idwWeights(const int * tarKNNSouID, const double * tarKNNDis, float * tarKNNWeight, int k, double power, int nTar) {
+
+	// closer than this (in meters) is treated as the same location
+	const double minDis = 1e-3;
+
+	int i;
+#pragma omp parallel for
+	for(i = 0; i < nTar; i++) {
+		const int * ids = tarKNNSouID + (size_t)i * k;
+		const double * dis = tarKNNDis + (size_t)i * k;
+		float * w = tarKNNWeight + (size_t)i * k;
+
+		double wSum = 0;
+		int l;
+		for(l = 0; l < k; l++) {
+			w[l] = 0;
+		}
+		// neighbors are sorted nearest first, so only the first one can be at zero distance
+		if(ids[0] >= 0 && dis[0] < minDis) {
+			w[0] = 1;
+			continue;
+		}
+		// relative to the nearest one, so the weights stay in (0, 1] for any power
+		for(l = 0; l < k && ids[l] >= 0; l++) {
+			w[l] = pow(dis[0] / dis[l], power);
+			wSum += w[l];
+		}
+		for(int m = 0; m < l; m++) {
+			w[m] = w[m] / wSum;
+		}
+	}
+}
+
+
+/**
+ * NAME:	idwInterpolate
+ * DESCRIPTION:	Inverse distance weighted interpolation with weights generated from "idwWeights".
+ *		Source cells with fill (negative) values are left out and the weights of the others are renormalized; -999 if none is left
+ * PARAMETERS:
+ * 	double * souVal:	the input values at source cells
+ * 	double * tarVal:	the output values at target cells
+ * 	int * tarKNNSouID:	the IDs of k nearest neighboring source cells for each target cell (generated from "queryKNNIndex")
+ * 	float * tarKNNWeight:	the weights of k nearest neighboring source cells for each target cell (generated from "idwWeights")
+ *	int k:			the number of nearest neighbors for each target cell
+ *	int nTar:		the number of target cells
+ * Output:
+ * 	double * tarVal:	the output values at target cells
+ */
+template <typename T>
+static void idwInterpolateKernel(const T * souVal, T * tarVal, const int * tarKNNSouID, const float * tarKNNWeight, int k, int nTar) {
+
+	int i;
+#pragma omp parallel for
+	for(i = 0; i < nTar; i++) {
+		const int * ids = tarKNNSouID + (size_t)i * k;
+		const float * w = tarKNNWeight + (size_t)i * k;
+		double sum = 0;
+		double wSum = 0;
+		for(int l = 0; l < k; l++) {
+			int id = ids[l];
+			if(id < 0) {
+				break;
+			}
+			double v = souVal[id];
+			if(v >= 0) {
+				sum += w[l] * v;
+				wSum += w[l];
+			}
+		}
+		tarVal[i] = (wSum > 0) ? sum / wSum : -999;
+	}
+}
+
+void idwInterpolate(double * souVal, double * tarVal, int * tarKNNSouID, float * tarKNNWeight, int k, int nTar) {
+	idwInterpolateKernel<double>(souVal, tarVal, tarKNNSouID, tarKNNWeight, k, nTar);
+}
+
+void idwInterpolate(float * souVal, float * tarVal, int * tarKNNSouID, float * tarKNNWeight, int k, int nTar) {
+	idwInterpolateKernel<float>(souVal, tarVal, tarKNNSouID, tarKNNWeight, k, nTar);
+}
+
+
+/**
+ * Number of source values kept per target cell for the approximate median in "summaryStatistics".
+ * The median is exact for target cells with up to this many valid source cells
+ */
+#define MEDIAN_SKETCH_SIZE 15
+
+/**
+ * NAME:	sketchHash
+ * DESCRIPTION:	Hash of a source cell ID (64-bit finalizer of MurmurHash3), used to pick the sample of source values kept for the median.
+ *		The sample only depends on the source cell IDs, so the median does not depend on how source cells are split among threads
+ * PARAMETERS:
+ *	long long souID:	the source cell ID
+ * Output:
+ *	the hash value
+ */
+static inline unsigned int sketchHash(long long souID) {
+	unsigned long long h = (unsigned long long)souID;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return (unsigned int)h;
+}
+
+/**
+ * NAME:	sketchInsert
+ * DESCRIPTION:	Insert a (hash, value) pair into the median sketch of one target cell. Entries are kept sorted by (hash, value),
+ *		and the largest one is dropped when the sketch is full, so the sketch is a bottom-k sample of the source values
+ * PARAMETERS:
+ *	unsigned int * hash:	the hashes of the sketch entries
+ *	T * val:		the values of the sketch entries
+ *	unsigned char * n:	the number of entries in the sketch
+ *	unsigned int h:		the hash to be inserted
+ *	T v:			the value to be inserted
+ */
+template <typename T>
+static inline void sketchInsert(unsigned int * hash, T * val, unsigned char * n, unsigned int h, T v) {
+	int pos = *n;
+	while(pos > 0 && (hash[pos - 1] > h || (hash[pos - 1] == h && val[pos - 1] > v))) {
+		pos--;
+	}
+	if(pos >= MEDIAN_SKETCH_SIZE) {
+		return;
+	}
+	int last = (*n < MEDIAN_SKETCH_SIZE) ? *n : MEDIAN_SKETCH_SIZE - 1;
+	for(int j = last; j > pos; j--) {
+		hash[j] = hash[j - 1];
+		val[j] = val[j - 1];
+	}
+	hash[pos] = h;
+	val[pos] = v;
+	if(*n < MEDIAN_SKETCH_SIZE) {
+		(*n)++;
+	}
+}
+
+/**
+ * struct SummaryPartial: the partial statistics of one thread over the target cells [minTar, maxTar] hit by its range of source cells.
+ * Arrays of statistics that are not requested stay NULL. Median sketches are only allocated for target cells that are hit
+ * (sketchSlot is -1 otherwise), as a range of target IDs can be much larger than the number of target cells in it
+ */
+template <typename T>
+struct SummaryPartial {
+	int minTar;
+	int maxTar;
+	double * sum;
+	double * m2;
+	int * count;
+	int * total;
+	T * min;
+	T * max;
+	int * sketchSlot;
+	int nSlots;
+	int maxSlots;
+	unsigned int * sketchHash;
+	T * sketchVal;
+	unsigned char * sketchN;
+};
+
+/**
+ * NAME:	summaryFinish
+ * DESCRIPTION:	Write the statistics of one target cell from its accumulated values (shared by the scatter and the gather kernels)
+ * PARAMETERS:
+ *	int i:			the target cell ID
+ *	int n:			the number of valid source cells
+ *	int total:		the number of source cells including fill values
+ *	double sum:		the sum of valid source values
+ *	double m2:		the sum of squared differences from the mean
+ *	T vMin, vMax:		the minimum and maximum valid source values
+ *	T * val:		the median sketch values (sorted in place)
+ *	unsigned char nVal:	the number of median sketch values
+ *	T * tarVal, tarSD, nSouPixels, tarMin, tarMax, tarValidFraction, tarMedian:	the outputs as in "summaryStatistics"
+ */
+template <typename T>
+static inline void summaryFinish(int i, int n, int total, double sum, double m2, T vMin, T vMax, T * val, unsigned char nVal, T * tarVal, T * tarSD, int * nSouPixels, T * tarMin, T * tarMax, T * tarValidFraction, T * tarMedian) {
+	nSouPixels[i] = n;
+
+	if(tarValidFraction != NULL) {
+		tarValidFraction[i] = (total > 0) ? (double)n / total : -999;
+	}
+	if(n > 0) {
+		double mean = sum / n;
+		tarVal[i] = mean;
+		if(tarSD != NULL) {
+			tarSD[i] = (m2 > 0) ? sqrt(m2 / n) : 0;
+		}
+		if(tarMin != NULL) {
+			tarMin[i] = vMin;
+		}
+		if(tarMax != NULL) {
+			tarMax[i] = vMax;
+		}
+		if(tarMedian != NULL) {
+			// sort the sampled values, then take the middle one (or the average of the middle two)
+			for(int a = 1; a < nVal; a++) {
+				T v = val[a];
+				int b = a;
+				while(b > 0 && val[b - 1] > v) {
+					val[b] = val[b - 1];
+					b--;
+				}
+				val[b] = v;
+			}
+			if(nVal % 2 == 1) {
+				tarMedian[i] = val[nVal / 2];
+			}
+			else {
+				tarMedian[i] = ((double)val[nVal / 2 - 1] + val[nVal / 2]) / 2;
+			}
+		}
+	}
+	else {
+		tarVal[i] = -999;
+		if(tarSD != NULL) {
+			tarSD[i] = -999;
+		}
+		if(tarMin != NULL) {
+			tarMin[i] = -999;
+		}
+		if(tarMax != NULL) {
+			tarMax[i] = -999;
+		}
+		if(tarMedian != NULL) {
+			tarMedian[i] = -999;
+		}
+	}
+}
+
+/**
+ * NAME:	summaryStatistics
+ * DESCRIPTION:	Summary of fine resolution source cells at coarse resolution target cells, computing all requested statistics
+ *		in one pass over the source cells. Mean and standard deviation use Welford's update, and partial results of threads
+ *		are merged with Chan's formula. The median is approximate: it is the median of a sample of up to MEDIAN_SKETCH_SIZE
+ *		source values per target cell. Source values below 0 (fill values) are not counted
+ * PARAMETERS:
+ * 	double * souVal:	the input values at source cells
+ * 	int * souNNTarID:	the IDs of nearest neighboring target cells for each source cells (generated from "nearestNeighbor")
+ * 	long long nSou:		the number of source cells
+ * 	double * tarVal:	the output (average) values at target cells
+ * 	double * tarSD:		the standard deviation (SD) value at target cells (can be NULL)
+ * 	int * nSouPixels:	the output numbers of contributing source cells to each target cell
+ * 	double * tarMin:	the minimum value at target cells (can be NULL)
+ * 	double * tarMax:	the maximum value at target cells (can be NULL)
+ * 	double * tarValidFraction:	the fraction of source cells of each target cell that are not fill values (can be NULL)
+ * 	double * tarMedian:	the approximate median value at target cells (can be NULL)
+ *	int nTar:		the number of target cells
+ * Output:
+ * 	double * tarVal, tarSD, tarMin, tarMax, tarValidFraction, tarMedian:	the statistics at target cells, -999 for target cells without source cells
+ * 	int * nSouPixels:	the output numbers of contributing source cells to each target cell
+ */
+template <typename T>
+static void summaryStatisticsKernel(const T * souVal, const int * souNNTarID, long long nSou, T * tarVal, T * tarSD, int * nSouPixels, T * tarMin, T * tarMax, T * tarValidFraction, T * tarMedian, int nTar) {
+
+	// Sums are kept in double for any value type T.
+	// Each thread processes a contiguous range of source cells into its own partial statistics. Source cells are in scan order, so the
+	// target cells hit by one range are close together, and the partial statistics only cover the range of target IDs actually hit.
+	// The partial statistics are then merged per target cell in thread order, which keeps the result independent of scheduling.
+	int maxThreads = omp_get_max_threads();
+	struct SummaryPartial<T> * partials;
+	if(NULL == (partials = (struct SummaryPartial<T> *)malloc(sizeof(struct SummaryPartial<T>) * maxThreads))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+#pragma omp parallel num_threads(maxThreads)
+	{
+		int nThreads = omp_get_num_threads();
+		int t = omp_get_thread_num();
+		long long souBegin = nSou * t / nThreads;
+		long long souEnd = nSou * (t + 1) / nThreads;
+
+		struct SummaryPartial<T> p = {nTar, -1, NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0, 0, NULL, NULL, NULL};
+		int nnTarID;
+		if(nThreads == 1) {
+			// a single range covers all target cells anyway, so skip the extra pass
+			p.minTar = 0;
+			p.maxTar = nTar - 1;
+		}
+		else {
+			for(long long i = souBegin; i < souEnd; i++) {
+				nnTarID = souNNTarID[i];
+				if(nnTarID > 0) {
+					if(nnTarID < p.minTar) {
+						p.minTar = nnTarID;
+					}
+					if(nnTarID > p.maxTar) {
+						p.maxTar = nnTarID;
+					}
+				}
+			}
+		}
+
+		if(p.maxTar >= p.minTar) {
+			int range = p.maxTar - p.minTar + 1;
+			if(NULL == (p.sum = (double *)calloc(range, sizeof(double)))) {
+				printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+				exit(1);
+			}
+			if(NULL == (p.count = (int *)calloc(range, sizeof(int)))) {
+				printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+				exit(1);
+			}
+			if(tarSD != NULL) {
+				if(NULL == (p.m2 = (double *)calloc(range, sizeof(double)))) {
+					printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+					exit(1);
+				}
+			}
+			if(tarValidFraction != NULL) {
+				if(NULL == (p.total = (int *)calloc(range, sizeof(int)))) {
+					printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+					exit(1);
+				}
+			}
+			if(tarMin != NULL) {
+				if(NULL == (p.min = (T *)malloc(sizeof(T) * range))) {
+					printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+					exit(1);
+				}
+			}
+			if(tarMax != NULL) {
+				if(NULL == (p.max = (T *)malloc(sizeof(T) * range))) {
+					printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+					exit(1);
+				}
+			}
+			if(tarMedian != NULL) {
+				if(NULL == (p.sketchSlot = (int *)malloc(sizeof(int) * range))) {
+					printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+					exit(1);
+				}
+				for(int j = 0; j < range; j++) {
+					p.sketchSlot[j] = -1;
+				}
+			}
+
+			for(long long i = souBegin; i < souEnd; i++) {
+				nnTarID = souNNTarID[i];
+				if(nnTarID <= 0) {
+					continue;
+				}
+				int j = nnTarID - p.minTar;
+				if(p.total != NULL) {
+					p.total[j] ++;
+				}
+				T v = souVal[i];
+				if(v < 0) {
+					continue;
+				}
+				int c = p.count[j];
+				if(p.m2 != NULL && c > 0) {
+					// Welford's update, with the running mean taken from the running sum
+					double d = v - p.sum[j] / c;
+					p.sum[j] += v;
+					p.m2[j] += d * (v - p.sum[j] / (c + 1));
+				}
+				else {
+					p.sum[j] += v;
+				}
+				p.count[j] = c + 1;
+				if(p.min != NULL && (c == 0 || v < p.min[j])) {
+					p.min[j] = v;
+				}
+				if(p.max != NULL && (c == 0 || v > p.max[j])) {
+					p.max[j] = v;
+				}
+				if(p.sketchSlot != NULL) {
+					int slot = p.sketchSlot[j];
+					if(slot < 0) {
+						if(p.nSlots == p.maxSlots) {
+							p.maxSlots = (p.maxSlots == 0) ? 1024 : p.maxSlots * 2;
+							if(NULL == (p.sketchHash = (unsigned int *)realloc(p.sketchHash, sizeof(unsigned int) * p.maxSlots * MEDIAN_SKETCH_SIZE))) {
+								printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+								exit(1);
+							}
+							if(NULL == (p.sketchVal = (T *)realloc(p.sketchVal, sizeof(T) * p.maxSlots * MEDIAN_SKETCH_SIZE))) {
+								printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+								exit(1);
+							}
+							if(NULL == (p.sketchN = (unsigned char *)realloc(p.sketchN, sizeof(unsigned char) * p.maxSlots))) {
+								printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+								exit(1);
+							}
+						}
+						slot = p.nSlots++;
+						p.sketchSlot[j] = slot;
+						p.sketchN[slot] = 0;
+					}
+					sketchInsert<T>(p.sketchHash + (long long)slot * MEDIAN_SKETCH_SIZE, p.sketchVal + (long long)slot * MEDIAN_SKETCH_SIZE, p.sketchN + slot, sketchHash(i), v);
+				}
+			}
+		}
+		partials[t] = p;
+
+#pragma omp barrier
+
+#pragma omp for
+		for(int i = 0; i < nTar; i++) {
+
+			double sum = 0;
+			double m2 = 0;
+			int n = 0;
+			int total = 0;
+			T vMin = 0;
+			T vMax = 0;
+			unsigned int hash[MEDIAN_SKETCH_SIZE];
+			T val[MEDIAN_SKETCH_SIZE];
+			unsigned char nVal = 0;
+			for(int tt = 0; tt < nThreads; tt++) {
+				const struct SummaryPartial<T> * q = partials + tt;
+				if(i < q->minTar || i > q->maxTar) {
+					continue;
+				}
+				int j = i - q->minTar;
+				if(q->total != NULL) {
+					total += q->total[j];
+				}
+				int nb = q->count[j];
+				if(nb == 0) {
+					continue;
+				}
+				if(n == 0) {
+					sum = q->sum[j];
+					if(q->m2 != NULL) {
+						m2 = q->m2[j];
+					}
+					if(q->min != NULL) {
+						vMin = q->min[j];
+					}
+					if(q->max != NULL) {
+						vMax = q->max[j];
+					}
+				}
+				else {
+					if(q->m2 != NULL) {
+						// Chan's formula for merging two sets of mean and sum of squared differences
+						double d = q->sum[j] / nb - sum / n;
+						m2 += q->m2[j] + d * d * ((double)n * nb / (n + nb));
+					}
+					sum += q->sum[j];
+					if(q->min != NULL && q->min[j] < vMin) {
+						vMin = q->min[j];
+					}
+					if(q->max != NULL && q->max[j] > vMax) {
+						vMax = q->max[j];
+					}
+				}
+				n += nb;
+				if(q->sketchSlot != NULL) {
+					long long slot = q->sketchSlot[j];
+					for(int e = 0; e < q->sketchN[slot]; e++) {
+						sketchInsert<T>(hash, val, &nVal, q->sketchHash[slot * MEDIAN_SKETCH_SIZE + e], q->sketchVal[slot * MEDIAN_SKETCH_SIZE + e]);
+					}
+				}
+			}
+			summaryFinish<T>(i, n, total, sum, m2, vMin, vMax, val, nVal, tarVal, tarSD, nSouPixels, tarMin, tarMax, tarValidFraction, tarMedian);
+		}
+
+		free(p.sum);
+		free(p.m2);
+		free(p.count);
+		free(p.total);
+		free(p.min);
+		free(p.max);
+		free(p.sketchSlot);
+		free(p.sketchHash);
+		free(p.sketchVal);
+		free(p.sketchN);
+	}
+
+	free(partials);
+}
+
+void summaryStatistics(double * souVal, int * souNNTarID, long long nSou, double * tarVal, double * tarSD, int * nSouPixels, double * tarMin, double * tarMax, double * tarValidFraction, double * tarMedian, int nTar) {
+	summaryStatisticsKernel<double>(souVal, souNNTarID, nSou, tarVal, tarSD, nSouPixels, tarMin, tarMax, tarValidFraction, tarMedian, nTar);
+}
+
+void summaryStatistics(float * souVal, int * souNNTarID, long long nSou, float * tarVal, float * tarSD, int * nSouPixels, float * tarMin, float * tarMax, float * tarValidFraction, float * tarMedian, int nTar) {
+	summaryStatisticsKernel<float>(souVal, souNNTarID, nSou, tarVal, tarSD, nSouPixels, tarMin, tarMax, tarValidFraction, tarMedian, nTar);
+}
+
+void summaryInterpolate(double * souVal, int * souNNTarID, long long nSou, double * tarVal, double * tarSD, int * nSouPixels, int nTar) {
+	summaryStatisticsKernel<double>(souVal, souNNTarID, nSou, tarVal, tarSD, nSouPixels, NULL, NULL, NULL, NULL, nTar);
+}
+
+void summaryInterpolate(float * souVal, int * souNNTarID, long long nSou, float * tarVal, float * tarSD, int * nSouPixels, int nTar) {
+	summaryStatisticsKernel<float>(souVal, souNNTarID, nSou, tarVal, tarSD, nSouPixels, NULL, NULL, NULL, NULL, nTar);
+}
+
+
+/**
+ * struct SummaryIndex: the resampling operator, a sparse matrix from source cells to target cells, built once and reused for every band.
+ * Variable length rows are in compressed sparse row form, built from the nearest neighbor mapping ("buildSummaryIndex"), a radius query
+ * ("queryRadiusNNIndex") or the point spread function of the target cells ("queryPSFNNIndex"): the source cells of target cell i are
+ * souID[tarBegin[i]] ... souID[tarBegin[i + 1] - 1], in ascending order, with their weights in weight[] (NULL if all weights are 1).
+ * Fixed length rows ("nnSummaryIndex", "idwSummaryIndex") have tarBegin NULL and point to the nearest neighbor IDs and weights of the
+ * caller instead: the source cells of target cell i are rowSouID[i * rowWidth] ... up to the first negative ID, with their weights in
+ * rowWeight[] (NULL for nearest neighbor rows, which pass the value of their source cell through as is)
+ */
+struct SummaryIndex {
+	int nTar;
+	long long nSou;
+	long long * tarBegin;
+	long long * souID;
+	float * weight;
+	int rowWidth;
+	const int * rowSouID;
+	const float * rowWeight;
+};
+
+/**
+ * NAME:	buildSummaryIndex
+ * DESCRIPTION:	Build the list of source cells of each target cell from the nearest neighbor target cell of each source cell
+ * PARAMETERS:
+ * 	int * souNNTarID:	the IDs of nearest neighboring target cells for each source cells (generated from "nearestNeighbor")
+ * 	long long nSou:		the number of source cells
+ *	int nTar:		the number of target cells
+ * Output:
+ *	the index (release it with "freeSummaryIndex")
+ */
+struct SummaryIndex * buildSummaryIndex(const int * souNNTarID, long long nSou, int nTar) {
+
+	struct SummaryIndex * index;
+	if(NULL == (index = (struct SummaryIndex *)malloc(sizeof(struct SummaryIndex)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	index->nTar = nTar;
+	index->nSou = nSou;
+	if(NULL == (index->tarBegin = (long long *)calloc((long long)nTar + 1, sizeof(long long)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	index->souID = NULL;
+	index->weight = NULL;
+	index->rowWidth = 0;
+	index->rowSouID = NULL;
+	index->rowWeight = NULL;
+
+	// A counting sort by target cell. As in "summaryStatistics", each thread counts a contiguous range of source cells over the
+	// range of target IDs it hits. The counts are turned into the starting positions of each thread in each target cell, in thread
+	// order, so every thread scatters its own source cells without contention and the source cells stay in ascending order.
+	int maxThreads = omp_get_max_threads();
+	int * minTar;
+	int * maxTar;
+	long long ** pos;
+	if(NULL == (minTar = (int *)malloc(sizeof(int) * maxThreads))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (maxTar = (int *)malloc(sizeof(int) * maxThreads))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (pos = (long long **)malloc(sizeof(long long *) * maxThreads))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+#pragma omp parallel num_threads(maxThreads)
+	{
+		int nThreads = omp_get_num_threads();
+		int t = omp_get_thread_num();
+		long long souBegin = nSou * t / nThreads;
+		long long souEnd = nSou * (t + 1) / nThreads;
+
+		int lo = nTar;
+		int hi = -1;
+		int nnTarID;
+		for(long long i = souBegin; i < souEnd; i++) {
+			nnTarID = souNNTarID[i];
+			if(nnTarID > 0) {
+				if(nnTarID < lo) {
+					lo = nnTarID;
+				}
+				if(nnTarID > hi) {
+					hi = nnTarID;
+				}
+			}
+		}
+		long long * p = NULL;
+		if(hi >= lo) {
+			if(NULL == (p = (long long *)calloc(hi - lo + 1, sizeof(long long)))) {
+				printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+				exit(1);
+			}
+			for(long long i = souBegin; i < souEnd; i++) {
+				nnTarID = souNNTarID[i];
+				if(nnTarID > 0) {
+					p[nnTarID - lo] ++;
+				}
+			}
+		}
+		minTar[t] = lo;
+		maxTar[t] = hi;
+		pos[t] = p;
+
+#pragma omp barrier
+
+#pragma omp for
+		for(int i = 0; i < nTar; i++) {
+			long long n = 0;
+			for(int tt = 0; tt < nThreads; tt++) {
+				if(i >= minTar[tt] && i <= maxTar[tt]) {
+					n += pos[tt][i - minTar[tt]];
+				}
+			}
+			index->tarBegin[i + 1] = n;
+		}
+
+#pragma omp single
+		{
+			for(int i = 0; i < nTar; i++) {
+				index->tarBegin[i + 1] += index->tarBegin[i];
+			}
+			if(NULL == (index->souID = (long long *)malloc(sizeof(long long) * (index->tarBegin[nTar] > 0 ? index->tarBegin[nTar] : 1)))) {
+				printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+				exit(1);
+			}
+		}
+
+#pragma omp for
+		for(int i = 0; i < nTar; i++) {
+			long long next = index->tarBegin[i];
+			for(int tt = 0; tt < nThreads; tt++) {
+				if(i >= minTar[tt] && i <= maxTar[tt]) {
+					long long n = pos[tt][i - minTar[tt]];
+					pos[tt][i - minTar[tt]] = next;
+					next += n;
+				}
+			}
+		}
+
+		for(long long i = souBegin; i < souEnd; i++) {
+			nnTarID = souNNTarID[i];
+			if(nnTarID > 0) {
+				index->souID[p[nnTarID - lo] ++] = i;
+			}
+		}
+		free(p);
+	}
+
+	free(minTar);
+	free(maxTar);
+	free(pos);
+
+	return index;
+}
+
+/**
+ * NAME:	freeSummaryIndex
+ * DESCRIPTION:	Release an index built by "buildSummaryIndex" (or any other operator). The arrays fixed length rows point to are not released
+ */
+void freeSummaryIndex(struct SummaryIndex * index) {
+	if(index == NULL) {
+		return;
+	}
+	free(index->tarBegin);
+	free(index->souID);
+	free(index->weight);
+	free(index);
+}
+
+/**
+ * NAME:	fixedRowSummaryIndex
+ * DESCRIPTION:	An operator over fixed length rows of nearest neighbor IDs (and weights), pointing to the arrays of the caller
+ */
+static struct SummaryIndex * fixedRowSummaryIndex(const int * tarSouID, const float * tarWeight, int k, long long nSou, int nTar) {
+	struct SummaryIndex * index;
+	if(NULL == (index = (struct SummaryIndex *)malloc(sizeof(struct SummaryIndex)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	index->nTar = nTar;
+	index->nSou = nSou;
+	index->tarBegin = NULL;
+	index->souID = NULL;
+	index->weight = NULL;
+	index->rowWidth = k;
+	index->rowSouID = tarSouID;
+	index->rowWeight = tarWeight;
+	return index;
+}
+
+/**
+ * NAME:	nnSummaryIndex
+ * DESCRIPTION:	The resampling operator of nearest neighbor interpolation, one source cell per target cell.
+ *		The operator points to tarNNSouID, so keep it until the operator is released
+ * PARAMETERS:
+ * 	int * tarNNSouID:	the IDs of nearest neighboring source cells for each target cells (generated from "queryNNIndex")
+ * 	long long nSou:		the number of source cells
+ *	int nTar:		the number of target cells
+ * Output:
+ *	the operator (release it with "freeSummaryIndex")
+ */
+struct SummaryIndex * nnSummaryIndex(const int * tarNNSouID, long long nSou, int nTar) {
+	return fixedRowSummaryIndex(tarNNSouID, NULL, 1, nSou, nTar);
+}
+
+/**
+ * NAME:	idwSummaryIndex
+ * DESCRIPTION:	The resampling operator of inverse distance weighted interpolation, k weighted source cells per target cell.
+ *		The operator points to tarKNNSouID and tarKNNWeight, so keep them until the operator is released
+ * PARAMETERS:
+ * 	int * tarKNNSouID:	the IDs of k nearest neighboring source cells for each target cell (generated from "queryKNNIndex")
+ * 	float * tarKNNWeight:	the weights of k nearest neighboring source cells for each target cell (generated from "idwWeights")
+ *	int k:			the number of nearest neighbors for each target cell
+ * 	long long nSou:		the number of source cells
+ *	int nTar:		the number of target cells
+ * Output:
+ *	the operator (release it with "freeSummaryIndex")
+ */
+struct SummaryIndex * idwSummaryIndex(const int * tarKNNSouID, const float * tarKNNWeight, int k, long long nSou, int nTar) {
+	return fixedRowSummaryIndex(tarKNNSouID, tarKNNWeight, k, nSou, nTar);
+}
+
+/**
+ * NAME:	writeSummaryIndex
+ * DESCRIPTION:	Write an operator in compressed sparse row form to a file, so it can be applied to later orbits with the same geometry
+ *		("readSummaryIndex"). Layout: int64 nTar, nSou, number of pairs and has-weight flag, then tarBegin[nTar + 1], souID[], weight[]
+ * PARAMETERS:
+ *	struct SummaryIndex * index:	the operator (not a fixed length row one)
+ *	FILE * fp:		the file, opened for binary writing
+ * Output:
+ *	0 on success, -1 if the operator has fixed length rows or writing failed
+ */
+int writeSummaryIndex(const struct SummaryIndex * index, FILE * fp) {
+	if(index->tarBegin == NULL) {
+		return -1;
+	}
+	long long header[4] = {index->nTar, index->nSou, index->tarBegin[index->nTar], (index->weight != NULL) ? 1 : 0};
+	size_t nPairs = (size_t)header[2];
+	if(fwrite(header, sizeof(long long), 4, fp) != 4
+	   || fwrite(index->tarBegin, sizeof(long long), (size_t)index->nTar + 1, fp) != (size_t)index->nTar + 1
+	   || fwrite(index->souID, sizeof(long long), nPairs, fp) != nPairs
+	   || (index->weight != NULL && fwrite(index->weight, sizeof(float), nPairs, fp) != nPairs)) {
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * NAME:	readSummaryIndex
+ * DESCRIPTION:	Read an operator written by "writeSummaryIndex". The counts of the header are checked against the rest of the file before
+ *		anything is allocated, and the row offsets and source cell IDs after reading, so a truncated or corrupted file gives NULL
+ *		instead of running out of memory or an operator reading out of range
+ * PARAMETERS:
+ *	FILE * fp:		the file, opened for binary reading at the position the operator was written to
+ * Output:
+ *	the operator (release it with "freeSummaryIndex"), NULL if the file does not hold a valid one
+ */
+struct SummaryIndex * readSummaryIndex(FILE * fp) {
+	long long header[4];
+	if(fread(header, sizeof(long long), 4, fp) != 4 || header[0] < 0 || header[0] > INT_MAX || header[1] < 0 || header[2] < 0) {
+		return NULL;
+	}
+
+	// the arrays must fit in the rest of the file
+	off_t start = ftello(fp);
+	if(start < 0 || fseeko(fp, 0, SEEK_END) != 0) {
+		return NULL;
+	}
+	off_t end = ftello(fp);
+	if(end < start || fseeko(fp, start, SEEK_SET) != 0) {
+		return NULL;
+	}
+	long long remain = (long long)(end - start);
+	long long pairSize = sizeof(long long) + (header[3] ? sizeof(float) : 0);
+	if(header[2] > remain / pairSize || (header[0] + 1) * (long long)sizeof(long long) > remain - header[2] * pairSize) {
+		return NULL;
+	}
+
+	struct SummaryIndex * index;
+	if(NULL == (index = (struct SummaryIndex *)malloc(sizeof(struct SummaryIndex)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	index->nTar = (int)header[0];
+	index->nSou = header[1];
+	index->souID = NULL;
+	index->weight = NULL;
+	index->rowWidth = 0;
+	index->rowSouID = NULL;
+	index->rowWeight = NULL;
+	size_t nPairs = (size_t)header[2];
+	if(NULL == (index->tarBegin = (long long *)malloc(sizeof(long long) * ((size_t)index->nTar + 1)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (index->souID = (long long *)malloc(sizeof(long long) * (nPairs > 0 ? nPairs : 1)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(header[3] && NULL == (index->weight = (float *)malloc(sizeof(float) * (nPairs > 0 ? nPairs : 1)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	int valid = fread(index->tarBegin, sizeof(long long), (size_t)index->nTar + 1, fp) == (size_t)index->nTar + 1
+	            && fread(index->souID, sizeof(long long), nPairs, fp) == nPairs
+	            && (index->weight == NULL || fread(index->weight, sizeof(float), nPairs, fp) == nPairs);
+	valid = valid && index->tarBegin[0] == 0 && index->tarBegin[index->nTar] == (long long)nPairs;
+	for(int i = 0; valid && i < index->nTar; i++) {
+		valid = index->tarBegin[i] <= index->tarBegin[i + 1];
+	}
+	for(size_t e = 0; valid && e < nPairs; e++) {
+		valid = index->souID[e] >= 0 && index->souID[e] < index->nSou;
+	}
+	if(!valid) {
+		freeSummaryIndex(index);
+		return NULL;
+	}
+	return index;
+}
+
+/**
+ * NAME:	scanRadiusCandidate
+ * DESCRIPTION:	Collect the source cells of a contiguous run [begin, end) within a squared chord length of a target
+ * PARAMETERS:
+ *	double * souX, * souY, * souZ:	the unit vectors of source cells
+ *	int * souID:		the IDs of source cells in the input arrays
+ *	int begin, int end:	the range of source cells to scan
+ *	double tX, tY, tZ:	the unit vector of the target cell
+ *	double chord2:		the (inclusive) squared chord bound
+ *	long long * out:	the output IDs of the cells found (NULL to only count them)
+ * Output:
+ *	the number of cells found
+ */
+static inline int scanRadiusCandidate(const double * souX, const double * souY, const double * souZ, const int * souID, int begin, int end, double tX, double tY, double tZ, double chord2, long long * out) {
+	int n = 0;
+	for(int l = begin; l < end; l++) {
+		double dX = souX[l] - tX;
+		double dY = souY[l] - tY;
+		double dZ = souZ[l] - tZ;
+		if(dX * dX + dY * dY + dZ * dZ <= chord2) {
+			if(out != NULL) {
+				out[n] = souID[l];
+			}
+			n ++;
+		}
+	}
+	return n;
+}
+
+/**
+ * NAME:	radiusBlockIndex
+ * DESCRIPTION:	Find the source cells within a distance of one target cell on the blocks within blockWindow blocks around it
+ *		(grid types). Rows and blocks farther than the distance are skipped as in "queryBlockIndex"
+ * PARAMETERS:
+ *	struct NNIndex * index:	the block index
+ *	double tarLat, tarLon:	the latitude and longitude of the target cell
+ *	double radian:		the distance (in radians), not more than the maximum distance of the index
+ *	long long * out:	the output IDs of the cells found (NULL to only count them)
+ * Output:
+ *	the number of cells found
+ */
+static int radiusBlockIndex(const struct NNIndex * index, double tarLat, double tarLon, double radian, long long * out) {
+
+	if(!inRegion(&index->region, tarLat, tarLon)) {
+		return 0;
+	}
+
+	const double * souX = index->souX;
+	const double * souY = index->souY;
+	const double * souZ = index->souZ;
+	const int * souID = index->souID;
+	int nBlockY = index->nBlockY;
+	double latBlockR = index->latBlockR;
+	int capRows = index->capRows;
+	int w = index->blockWindow;
+
+	double tLat = tarLat * M_PI / 180;
+	double tLon = tarLon * M_PI / 180;
+	double cosTLat = cos(tLat);
+	double tX = cosTLat * cos(tLon);
+	double tY = cosTLat * sin(tLon);
+	double tZ = sin(tLat);
+	double chord2 = chordSquareFromRadian(radian);
+
+	// rows and blocks within the distance, with a small margin so rounding never skips a cell at the distance
+	double boundR = radian * (1 + 1e-9) + 1e-12;
+	double sinDLon = sin(boundR) / cosTLat;
+	double dLon = (boundR < M_PI / 2 && sinDLon < 1) ? asin(sinDLon) : M_PI;
+
+	int n = 0;
+	int rowID = (tLat + M_PI / 2) / latBlockR;
+	for(int j = rowID - w; j <= rowID + w; j ++) {
+		if(j < capRows || j >= nBlockY - capRows || rowLatGap(j, latBlockR, tLat) > boundR) {
+			continue;
+		}
+		const struct LonBlocks * row = indexRow(index, j);
+		if(row == NULL) {
+			continue;
+		}
+		if(row->nBlocks < 2 * w + 1) {
+			n += scanRadiusCandidate(souX, souY, souZ, souID, row->indexID[0], row->indexID[row->nStored], tX, tY, tZ, chord2, (out != NULL) ? out + n : NULL);
+			continue;
+		}
+		int colID = (tLon + M_PI) / row->blockSizeR;
+		int k0 = colID - w;
+		int k1 = colID + w;
+		if(dLon < M_PI) {
+			int kWest = (int)floor((tLon - dLon + M_PI) / row->blockSizeR);
+			int kEast = (int)floor((tLon + dLon + M_PI) / row->blockSizeR);
+			k0 = (kWest > k0) ? kWest : k0;
+			k1 = (kEast < k1) ? kEast : k1;
+		}
+		if(k0 > k1) {
+			continue;
+		}
+		int runBegin[2], runEnd[2];
+		int nRuns = blockRangeCells(row, k0, k1, runBegin, runEnd);
+		for(int run = 0; run < nRuns; run ++) {
+			n += scanRadiusCandidate(souX, souY, souZ, souID, runBegin[run], runEnd[run], tX, tY, tZ, chord2, (out != NULL) ? out + n : NULL);
+		}
+	}
+	for(int cap = 0; cap < 2; cap ++) {
+		if(capRows == 0 || (cap == 0 && (rowID + w < 0 || rowID - w >= capRows)) || (cap == 1 && (rowID - w >= nBlockY || rowID + w < nBlockY - capRows))) {
+			continue;
+		}
+		int cx0, cx1, cy0, cy1;
+		if(!capWindow(index, tX, tY, sqrt(chord2), &cx0, &cx1, &cy0, &cy1)) {
+			continue;
+		}
+		const int * indexID = index->capIndexID[cap];
+		for(int cy = cy0; cy <= cy1; cy++) {
+			n += scanRadiusCandidate(souX, souY, souZ, souID, indexID[cy * index->capGrid + cx0], indexID[cy * index->capGrid + cx1 + 1], tX, tY, tZ, chord2, (out != NULL) ? out + n : NULL);
+		}
+	}
+	return n;
 }
 
-/* Old version of "nearestNeighbor", no longer in use
- 
-void nearestNeighbor(double ** psouLat, double ** psouLon, int nSou, double * tarLat, double * tarLon, int * tarNNSouID, int nTar, double maxR) {
+static int compareSourceID(const void * a, const void * b) {
+	long long x = *(const long long *)a;
+	long long y = *(const long long *)b;
+	return (x > y) - (x < y);
+}
 
-	//printf("%0x\n", souLat);
-	double * souLat = *psouLat;
-	double * souLon = *psouLon;
+/**
+ * NAME:	queryRadiusNNIndex
+ * DESCRIPTION:	Find all source cells within a distance of each target cell, using an index built by "buildNNIndex". Target cells are queried
+ *		in parallel twice: once to count the cells of each target cell, then to write them into their slots, so no list needs to grow
+ * PARAMETERS:
+ *	struct NNIndex * index:	the index of source cells
+ *	double * tarLat:	the latitudes of target cells
+ *	double * tarLon:	the longitudes of target cells
+ *	double radius:		the distance (in meters), limited to the maximum distance the index was built with
+ *	int nTar:		the number of target cells
+ * Output:
+ *	the source cells of each target cell (in ascending order, release it with "freeSummaryIndex")
+ */
+struct SummaryIndex * queryRadiusNNIndex(const struct NNIndex * index, const double * tarLat, const double * tarLon, double radius, int nTar) {
 
-	const double earthRadius = 6367444;
-	double maxradian = maxR / earthRadius;
-	int nBlockY = M_PI / maxradian;
+	const double earthRadius = 6371009;
 
-	double blockR = M_PI / nBlockY;
-	
+#if DEBUG_ELAPSE_TIME
+	double queryStart = omp_get_wtime();
+#endif
 
-	for(int i = 0; i < nSou; i++) {
-		souLat[i] = souLat[i] * M_PI / 180;
-		souLon[i] = souLon[i] * M_PI / 180;
+	double radian = radius / earthRadius;
+	if(radian > index->maxradian) {
+		radian = index->maxradian;
 	}
 
-	for(int i = 0; i < nTar; i++) {
-		tarLat[i] = tarLat[i] * M_PI / 180;
-		tarLon[i] = tarLon[i] * M_PI / 180;
+	struct SummaryIndex * result;
+	if(NULL == (result = (struct SummaryIndex *)malloc(sizeof(struct SummaryIndex)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
 	}
-
-	int * souID;
-	if(NULL == (souID = (int *)malloc(sizeof(double) * nSou))) {
+	result->nTar = nTar;
+	result->nSou = index->nSou;
+	result->weight = NULL;
+	result->rowWidth = 0;
+	result->rowSouID = NULL;
+	result->rowWeight = NULL;
+	if(NULL == (result->tarBegin = (long long *)malloc(sizeof(long long) * ((long long)nTar + 1)))) {
 		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
 		exit(1);
 	}
-	int * souIndex = pointIndexOnLat(psouLat, psouLon, souID, nSou, nBlockY);
-	souLat = *psouLat;
-	souLon = *psouLon;
 
-	double tLat, tLon;
-	double sLat, sLon;
-	int blockID;
-	int startBlock, endBlock;
+	int i;
+	result->tarBegin[0] = 0;
+#pragma omp parallel for schedule(dynamic, 1024)
+	for(i = 0; i < nTar; i++) {
+		if(index->indexType == NN_INDEX_KDTREE) {
+			result->tarBegin[i + 1] = queryRadiusKDTreeIndex(index->souTree, tarLat[i], tarLon[i], radian * earthRadius, NULL);
+		}
+		else {
+			result->tarBegin[i + 1] = radiusBlockIndex(index, tarLat[i], tarLon[i], radian, NULL);
+		}
+	}
+	for(i = 0; i < nTar; i++) {
+		result->tarBegin[i + 1] += result->tarBegin[i];
+	}
 
-	double pDis;	
-	double nnDis;
-	int nnSouID;
+	if(NULL == (result->souID = (long long *)malloc(sizeof(long long) * (result->tarBegin[nTar] > 0 ? result->tarBegin[nTar] : 1)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+#pragma omp parallel for schedule(dynamic, 1024)
+	for(i = 0; i < nTar; i++) {
+		long long * out = result->souID + result->tarBegin[i];
+		int n;
+		if(index->indexType == NN_INDEX_KDTREE) {
+			n = queryRadiusKDTreeIndex(index->souTree, tarLat[i], tarLon[i], radian * earthRadius, out);
+		}
+		else {
+			n = radiusBlockIndex(index, tarLat[i], tarLon[i], radian, out);
+		}
+		// the same order for any index type, so sums over the cells do not depend on it
+		qsort(out, n, sizeof(long long), compareSourceID);
+	}
 
-	for(int i = 0; i < nTar; i ++) {
+#if DEBUG_ELAPSE_TIME
+	printf("DBG_TIME> %s: query %.3f sec, %lld pairs\n", __FUNCTION__, omp_get_wtime() - queryStart, result->tarBegin[nTar]);
+#endif
 
-		tLat = tarLat[i];
-		tLon = tarLon[i];
+	return result;
+}
 
-		blockID = (tLat + M_PI / 2) / blockR;
-		startBlock = blockID - 1;
-		endBlock = blockID + 1;
+/**
+ * NAME:	validUnitVector
+ * DESCRIPTION:	The unit vector of a location (in degrees), or 0 if the location is out of the valid latitude/longitude range
+ */
+static inline int validUnitVector(double lat, double lon, double * v) {
+	if(!(lat >= -90 && lat <= 90 && lon >= -180 && lon <= 180)) {
+		return 0;
+	}
+	double cosLat = cos(lat * M_PI / 180);
+	v[0] = cosLat * cos(lon * M_PI / 180);
+	v[1] = cosLat * sin(lon * M_PI / 180);
+	v[2] = sin(lat * M_PI / 180);
+	return 1;
+}
 
-		if(startBlock < 0) {
-			startBlock = 0;
-		}
-		if(endBlock > nBlockY - 1) {
-			endBlock = nBlockY - 1;
-		}
+/**
+ * NAME:	psfFrame
+ * DESCRIPTION:	The along-scan and along-track axes of a target cell of a scanned swath, from its neighbors along the scan line and on the
+ *		scan lines before and after it. The axes are in the tangent plane at the target, and scaled by one over the cell spacing along
+ *		them, so the dot product of an axis and (source - target) unit vectors is the offset of the source in target cells.
+ *		The along-track spacing is taken as the along-scan one if the target has no neighbor on the lines before and after it
+ * PARAMETERS:
+ *	double * tarLat, * tarLon:	the latitudes and longitudes of target cells, scan line by scan line
+ *	int tarWidth:			the number of target cells of a scan line
+ *	int nTar:			the number of target cells
+ *	int i:				the target cell
+ * Output:
+ *	double * t:			the unit vector of the target cell
+ *	double * scanAxis, * trackAxis:	the scaled along-scan and along-track axes
+ *	double * radian:		the distance (in radians) from the target to the farthest corner of its support (one cell along the scan on each side,
+ *					half a cell along the track)
+ *	0 if the target, or both of its neighbors along the scan line, are out of the valid latitude/longitude range, 1 otherwise
+ */
+static inline int psfFrame(const double * tarLat, const double * tarLon, int tarWidth, int nTar, int i, double * t, double * scanAxis, double * trackAxis, double * radian) {
 
-		nnDis = -1;
-		
-		for(int j = souIndex[startBlock]; j < souIndex[endBlock+1]; j++) {
-			
-			sLat = souLat[j];
-			sLon = souLon[j];
+	double prev[3], next[3];
+	if(!validUnitVector(tarLat[i], tarLon[i], t)) {
+		return 0;
+	}
 
-			pDis = acos(sin(tLat) * sin(sLat) + cos(tLat) * cos(sLat) * cos(tLon - sLon));
-				
-			if((nnDis < 0 || nnDis > pDis) && pDis <= maxradian) {
-				nnDis = pDis;
-				nnSouID = souID[j];
-			}
-				
-		}
+	// along the scan line, centered on the target if both neighbors are valid
+	int col = i % tarWidth;
+	int hasPrev = (col > 0) && validUnitVector(tarLat[i - 1], tarLon[i - 1], prev);
+	int hasNext = (col < tarWidth - 1 && i + 1 < nTar) && validUnitVector(tarLat[i + 1], tarLon[i + 1], next);
+	if(!hasPrev && !hasNext) {
+		return 0;
+	}
+	double d[3];
+	for(int c = 0; c < 3; c++) {
+		d[c] = (hasNext ? next[c] : t[c]) - (hasPrev ? prev[c] : t[c]);
+	}
+	double steps = hasPrev + hasNext;
+	double dt = d[0] * t[0] + d[1] * t[1] + d[2] * t[2];
+	for(int c = 0; c < 3; c++) {
+		d[c] -= dt * t[c];
+	}
+	double length = sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+	if(!(length > 0)) {
+		return 0;
+	}
+	double scanSpacing = length / steps;
+	double scanHat[3] = {d[0] / length, d[1] / length, d[2] / length};
+	double trackHat[3] = {t[1] * scanHat[2] - t[2] * scanHat[1], t[2] * scanHat[0] - t[0] * scanHat[2], t[0] * scanHat[1] - t[1] * scanHat[0]};
 
-		if(nnDis < 0) {
-			tarNNSouID[i] = -1;
+	// across scan lines, projected on the along-track axis
+	hasPrev = (i - tarWidth >= 0) && validUnitVector(tarLat[i - tarWidth], tarLon[i - tarWidth], prev);
+	hasNext = (i + tarWidth < nTar) && validUnitVector(tarLat[i + tarWidth], tarLon[i + tarWidth], next);
+	double trackSpacing = scanSpacing;
+	if(hasPrev || hasNext) {
+		double e = 0;
+		for(int c = 0; c < 3; c++) {
+			e += ((hasNext ? next[c] : t[c]) - (hasPrev ? prev[c] : t[c])) * trackHat[c];
 		}
-		else {
-			tarNNSouID[i] = nnSouID;
+		e = fabs(e) / (hasPrev + hasNext);
+		if(e > 0) {
+			trackSpacing = e;
 		}
-	
-		 
 	}
-	
-	free(souID);
-	free(souIndex);
-	
-	return;	
+
+	for(int c = 0; c < 3; c++) {
+		scanAxis[c] = scanHat[c] / scanSpacing;
+		trackAxis[c] = trackHat[c] / trackSpacing;
+	}
+	double chord2 = scanSpacing * scanSpacing + trackSpacing * trackSpacing / 4;
+	// the offsets are measured in the tangent plane, so allow for the chord being slightly longer than its projection
+	*radian = radianFromChordSquare((chord2 < 4) ? chord2 : 4) * (1 + 1e-6) + 1e-12;
+	return 1;
 }
-*/
 
+/**
+ * NAME:	psfWeight
+ * DESCRIPTION:	The MODIS point spread function at an offset (in target cells) from the center of a target cell: triangular along the scan
+ *		(1 at the center, 0 at the centers of the neighboring cells) and flat over the cell along the track
+ */
+static inline float psfWeight(double u, double v) {
+	u = fabs(u);
+	if(u >= 1 || fabs(v) > 0.5) {
+		return 0;
+	}
+	return (float)(1 - u);
+}
 
 /**
- * NAME:	nnInterpolate
- * DESCRIPTION:	Nearest neighbor interpolation
+ * NAME:	queryPSFNNIndex
+ * DESCRIPTION:	Find the source cells within the point spread function of each target cell of a scanned swath (MODIS), with their weights.
+ *		The along-scan and along-track axes and spacings of each target cell come from its neighbors in the swath ("psfFrame"),
+ *		so the support grows with the scan angle. Target cells are queried in parallel twice, as in "queryRadiusNNIndex": once to count
+ *		the candidates within the support radius of each target cell, then to write and weigh them in their slots. Candidates of zero
+ *		weight are then dropped
  * PARAMETERS:
- * 	double * souVal:	the input values at source cells
- * 	double * tarVal:	the output values at target cells
- * 	int * tarNNSouID:	the IDs of nearest neighboring source cells for each target cells (generated from "nearestNeighbor") 
+ *	struct NNIndex * index:	the index of source cells (built with a maximum distance covering the support of the largest target cell)
+ *	double * souLat:	the latitudes of source cells (the ones the index was built with)
+ *	double * souLon:	the longitudes of source cells
+ *	double * tarLat:	the latitudes of target cells, scan line by scan line
+ *	double * tarLon:	the longitudes of target cells
+ *	int tarWidth:		the number of target cells of a scan line (e.g. 1354 for MODIS 1KM)
  *	int nTar:		the number of target cells
- * Output: 	
- * 	double * tarVal:	the output values at target cells
- */ 
-void nnInterpolate(double * souVal, double * tarVal, int * tarNNSouID, int nTar) {
+ * Output:
+ *	the source cells of each target cell, in ascending order, with their weights (release it with "freeSummaryIndex")
+ */
+struct SummaryIndex * queryPSFNNIndex(const struct NNIndex * index, const double * souLat, const double * souLon, const double * tarLat, const double * tarLon, int tarWidth, int nTar) {
 
-	int nnSouID;
+	const double earthRadius = 6371009;
+
+#if DEBUG_ELAPSE_TIME
+	double queryStart = omp_get_wtime();
+#endif
+
+	struct SummaryIndex * result;
+	long long * count;
+	if(NULL == (result = (struct SummaryIndex *)malloc(sizeof(struct SummaryIndex)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (count = (long long *)malloc(sizeof(long long) * ((long long)nTar + 1)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	result->nTar = nTar;
+	result->nSou = index->nSou;
+	result->rowWidth = 0;
+	result->rowSouID = NULL;
+	result->rowWeight = NULL;
+	if(NULL == (result->tarBegin = (long long *)malloc(sizeof(long long) * ((long long)nTar + 1)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+
+	// candidates within the support radius of each target cell
 	int i;
+	count[0] = 0;
+#pragma omp parallel for schedule(dynamic, 1024)
+	for(i = 0; i < nTar; i++) {
+		double t[3], scanAxis[3], trackAxis[3], radian;
+		count[i + 1] = 0;
+		if(!psfFrame(tarLat, tarLon, tarWidth, nTar, i, t, scanAxis, trackAxis, &radian)) {
+			continue;
+		}
+		radian = (radian < index->maxradian) ? radian : index->maxradian;
+		if(index->indexType == NN_INDEX_KDTREE) {
+			count[i + 1] = queryRadiusKDTreeIndex(index->souTree, tarLat[i], tarLon[i], radian * earthRadius, NULL);
+		}
+		else {
+			count[i + 1] = radiusBlockIndex(index, tarLat[i], tarLon[i], radian, NULL);
+		}
+	}
+	for(i = 0; i < nTar; i++) {
+		count[i + 1] += count[i];
+	}
 
-#pragma omp parallel for private(nnSouID)
+	// weigh the candidates in their slots, keeping the ones of nonzero weight at the front
+	long long * candID;
+	float * candWeight;
+	if(NULL == (candID = (long long *)malloc(sizeof(long long) * (count[nTar] > 0 ? count[nTar] : 1)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (candWeight = (float *)malloc(sizeof(float) * (count[nTar] > 0 ? count[nTar] : 1)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	result->tarBegin[0] = 0;
+#pragma omp parallel for schedule(dynamic, 1024)
 	for(i = 0; i < nTar; i++) {
-		nnSouID = tarNNSouID[i];
-		if(nnSouID < 0) {
-			tarVal[i] = -999;
+		double t[3], scanAxis[3], trackAxis[3], radian;
+		result->tarBegin[i + 1] = 0;
+		if(count[i + 1] == count[i] || !psfFrame(tarLat, tarLon, tarWidth, nTar, i, t, scanAxis, trackAxis, &radian)) {
+			continue;
+		}
+		radian = (radian < index->maxradian) ? radian : index->maxradian;
+		long long * out = candID + count[i];
+		int n;
+		if(index->indexType == NN_INDEX_KDTREE) {
+			n = queryRadiusKDTreeIndex(index->souTree, tarLat[i], tarLon[i], radian * earthRadius, out);
 		}
 		else {
-			tarVal[i] = souVal[nnSouID];
+			n = radiusBlockIndex(index, tarLat[i], tarLon[i], radian, out);
+		}
+		// the same order for any index type, so sums over the cells do not depend on it
+		qsort(out, n, sizeof(long long), compareSourceID);
+		int kept = 0;
+		for(int l = 0; l < n; l++) {
+			double q[3];
+			if(!validUnitVector(souLat[out[l]], souLon[out[l]], q)) {
+				continue;
+			}
+			double dX = q[0] - t[0];
+			double dY = q[1] - t[1];
+			double dZ = q[2] - t[2];
+			float w = psfWeight(dX * scanAxis[0] + dY * scanAxis[1] + dZ * scanAxis[2], dX * trackAxis[0] + dY * trackAxis[1] + dZ * trackAxis[2]);
+			if(w > 0) {
+				out[kept] = out[l];
+				candWeight[count[i] + kept] = w;
+				kept ++;
+			}
 		}
+		result->tarBegin[i + 1] = kept;
 	}
-}
+	for(i = 0; i < nTar; i++) {
+		result->tarBegin[i + 1] += result->tarBegin[i];
+	}
+
+	// compact the kept cells
+	long long nPairs = result->tarBegin[nTar];
+	if(NULL == (result->souID = (long long *)malloc(sizeof(long long) * (nPairs > 0 ? nPairs : 1)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+	if(NULL == (result->weight = (float *)malloc(sizeof(float) * (nPairs > 0 ? nPairs : 1)))) {
+		printf("ERROR: Out of memory at line %d in file %s\n", __LINE__, __FILE__);
+		exit(1);
+	}
+#pragma omp parallel for schedule(dynamic, 1024)
+	for(i = 0; i < nTar; i++) {
+		long long n = result->tarBegin[i + 1] - result->tarBegin[i];
+		memcpy(result->souID + result->tarBegin[i], candID + count[i], sizeof(long long) * n);
+		memcpy(result->weight + result->tarBegin[i], candWeight + count[i], sizeof(float) * n);
+	}
+	free(candID);
+	free(candWeight);
+	free(count);
 
+#if DEBUG_ELAPSE_TIME
+	printf("DBG_TIME> %s: query %.3f sec, %lld pairs\n", __FUNCTION__, omp_get_wtime() - queryStart, nPairs);
+#endif
+
+	return result;
+}
 
 /**
- * NAME:	summaryInterpolate
- * DESCRIPTION:	Interpolation (summary) from fine resolution to coarse resolution
+ * NAME:	summaryStatistics (with a "SummaryIndex")
+ * DESCRIPTION:	Same statistics as "summaryStatistics", but each target cell gathers its own source cells from the index, so target cells
+ *		are processed in parallel with no partial results to merge. Source cells are accumulated in ascending order, so the result
+ *		does not depend on the number of threads
  * PARAMETERS:
  * 	double * souVal:	the input values at source cells
- * 	int * souNNTarID:	the IDs of nearest neighboring target cells for each source cells (generated from "nearestNeighbor")
- * 	int nSou:		the number of source cells
- * 	double * tarVal:	the output (average) values at target cells
- * 	double * tarSD:		the standard deviation (SD) value at target cells (can be NULL if no SD values need to be reported)
+ *	struct SummaryIndex * index:	the source cells of each target cell (generated from "buildSummaryIndex")
+ * 	double * tarVal, tarSD, tarMin, tarMax, tarValidFraction, tarMedian:	the statistics at target cells (all but tarVal can be NULL)
  * 	int * nSouPixels:	the output numbers of contributing source cells to each target cell
- *	int nTar:		the number of target cells
  * Output:
- * 	double * tarVal:	the output (average) values at target cells
- * 	double * tarSD:		the standard deviation (SD) value at target cells (can be NULL if no SD values need to be reported)
+ * 	double * tarVal, tarSD, tarMin, tarMax, tarValidFraction, tarMedian:	the statistics at target cells, -999 for target cells without source cells
  * 	int * nSouPixels:	the output numbers of contributing source cells to each target cell
  */
-void summaryInterpolate(double * souVal, int * souNNTarID, int nSou, double * tarVal, double * tarSD, int * nSouPixels, int nTar) {
+template <typename T>
+static void summaryStatisticsGatherKernel(const T * souVal, const struct SummaryIndex * index, T * tarVal, T * tarSD, int * nSouPixels, T * tarMin, T * tarMax, T * tarValidFraction, T * tarMedian) {
 
-	for(int i = 0; i < nTar; i++) {
-	
-		tarVal[i] = 0;
-		if (tarSD != NULL) {
-			tarSD[i] = 0;
+	const long long * tarBegin = index->tarBegin;
+	const long long * souID = index->souID;
+
+#pragma omp parallel for schedule(dynamic, 1024)
+	for(int i = 0; i < index->nTar; i++) {
+
+		double sum = 0;
+		double m2 = 0;
+		int n = 0;
+		T vMin = 0;
+		T vMax = 0;
+		unsigned int hash[MEDIAN_SKETCH_SIZE];
+		T val[MEDIAN_SKETCH_SIZE];
+		unsigned char nVal = 0;
+		for(long long e = tarBegin[i]; e < tarBegin[i + 1]; e++) {
+			long long s = souID[e];
+			T v = souVal[s];
+			if(v < 0) {
+				continue;
+			}
+			if(tarSD != NULL && n > 0) {
+				// Welford's update, with the running mean taken from the running sum
+				double d = v - sum / n;
+				sum += v;
+				m2 += d * (v - sum / (n + 1));
+			}
+			else {
+				sum += v;
+			}
+			if(n == 0 || v < vMin) {
+				vMin = v;
+			}
+			if(n == 0 || v > vMax) {
+				vMax = v;
+			}
+			n ++;
+			if(tarMedian != NULL) {
+				sketchInsert<T>(hash, val, &nVal, sketchHash(s), v);
+			}
 		}
-		nSouPixels[i] = 0;
+		summaryFinish<T>(i, n, (int)(tarBegin[i + 1] - tarBegin[i]), sum, m2, vMin, vMax, val, nVal, tarVal, tarSD, nSouPixels, tarMin, tarMax, tarValidFraction, tarMedian);
 	}
+}
 
-	int nnTarID;
-	for(int i = 0; i < nSou; i++) {
-		
-		nnTarID = souNNTarID[i];
-		if(nnTarID > 0 && souVal[i] >= 0) {
-			tarVal[nnTarID] += souVal[i];
-			if (tarSD != NULL) {
-				tarSD[nnTarID] += souVal[i] * souVal[i];
+void summaryStatistics(double * souVal, const struct SummaryIndex * index, double * tarVal, double * tarSD, int * nSouPixels, double * tarMin, double * tarMax, double * tarValidFraction, double * tarMedian) {
+	summaryStatisticsGatherKernel<double>(souVal, index, tarVal, tarSD, nSouPixels, tarMin, tarMax, tarValidFraction, tarMedian);
+}
+
+void summaryStatistics(float * souVal, const struct SummaryIndex * index, float * tarVal, float * tarSD, int * nSouPixels, float * tarMin, float * tarMax, float * tarValidFraction, float * tarMedian) {
+	summaryStatisticsGatherKernel<float>(souVal, index, tarVal, tarSD, nSouPixels, tarMin, tarMax, tarValidFraction, tarMedian);
+}
+
+void summaryInterpolate(double * souVal, const struct SummaryIndex * index, double * tarVal, double * tarSD, int * nSouPixels) {
+	summaryStatisticsGatherKernel<double>(souVal, index, tarVal, tarSD, nSouPixels, NULL, NULL, NULL, NULL);
+}
+
+void summaryInterpolate(float * souVal, const struct SummaryIndex * index, float * tarVal, float * tarSD, int * nSouPixels) {
+	summaryStatisticsGatherKernel<float>(souVal, index, tarVal, tarSD, nSouPixels, NULL, NULL, NULL, NULL);
+}
+
+
+/**
+ * Number of bands accumulated together by "resampleMultiBand", so the sums of a target cell stay in registers
+ */
+#define RESAMPLE_BAND_GROUP 8
+
+/**
+ * NAME:	resampleRow
+ * DESCRIPTION:	Weighted mean (and standard deviation) of the source cells of one target cell for a group of bands, the row of the
+ *		resampling operator applied to up to RESAMPLE_BAND_GROUP right hand sides. Each (source cell, weight) pair is read once for
+ *		the group. Source cells with negative (fill) values are left out of the band, and their weights with them. The standard
+ *		deviation uses West's weighted form of Welford's update, which is the update of "summaryStatistics" when all weights are 1
+ * PARAMETERS:
+ *	T ** souVal:		the input values at source cells of the group, one array per band
+ *	ID * ids:		the source cells of the row
+ *	float * weights:	the weights of the source cells (NULL if all are 1)
+ *	long long n:		the number of source cells of the row (fixed length rows end early at a negative ID)
+ *	int i:			the target cell
+ *	T ** tarVal, tarSD, nSouPixels:	the outputs of the group, as in "resampleMultiBand"
+ *	int nGroup:		the number of bands of the group
+ */
+template <typename T, typename ID, bool withSD>
+static inline void resampleRow(T ** souVal, const ID * ids, const float * weights, long long n, int i, T ** tarVal, T ** tarSD, int ** nSouPixels, int nGroup) {
+
+	double sum[RESAMPLE_BAND_GROUP], m2[RESAMPLE_BAND_GROUP], wSum[RESAMPLE_BAND_GROUP];
+	int count[RESAMPLE_BAND_GROUP];
+	for(int b = 0; b < nGroup; b++) {
+		sum[b] = 0;
+		m2[b] = 0;
+		wSum[b] = 0;
+		count[b] = 0;
+	}
+	for(long long e = 0; e < n; e++) {
+		ID s = ids[e];
+		if(s < 0) {
+			break;
+		}
+		double w = (weights != NULL) ? weights[e] : 1;
+		for(int b = 0; b < nGroup; b++) {
+			double v = souVal[b][s];
+			if(v < 0) {
+				continue;
+			}
+			if(withSD && wSum[b] > 0) {
+				// West's update, with the running mean taken from the running sums
+				double d = v - sum[b] / wSum[b];
+				sum[b] += w * v;
+				wSum[b] += w;
+				m2[b] += w * d * (v - sum[b] / wSum[b]);
+			}
+			else {
+				sum[b] += w * v;
+				wSum[b] += w;
 			}
-			nSouPixels[nnTarID] ++;	
+			count[b] ++;
 		}
 	}
+	for(int b = 0; b < nGroup; b++) {
+		double mean = (wSum[b] > 0) ? sum[b] / wSum[b] : 0;
+		tarVal[b][i] = (wSum[b] > 0) ? mean : -999;
+		if(withSD) {
+			tarSD[b][i] = (wSum[b] > 0) ? ((m2[b] > 0) ? sqrt(m2[b] / wSum[b]) : 0) : -999;
+		}
+		if(nSouPixels != NULL) {
+			nSouPixels[b][i] = count[b];
+		}
+	}
+}
 
+/**
+ * NAME:	resampleRows
+ * DESCRIPTION:	Apply the rows of a CSR or fixed length resampling operator in parallel, see "resampleMultiBand".
+ *		The standard deviation is a template parameter so that the inner loop does not test for it
+ */
+template <typename T, bool withSD>
+static void resampleRows(T ** souVal, const struct SummaryIndex * index, T ** tarVal, T ** tarSD, int ** nSouPixels, int nBands) {
 
-	for(int i = 0; i < nTar; i++) {
-	
-		if(nSouPixels[i] > 0) {
-			tarVal[i] = tarVal[i] / nSouPixels[i];
-			if (tarSD != NULL) {
-				if(tarSD[i] / nSouPixels[i] - tarVal[i] * tarVal[i] < 0) {
-					tarSD[i] = 0;
-				}
-				else {
-					tarSD[i] = sqrt(tarSD[i] / nSouPixels[i] - tarVal[i] * tarVal[i]);
-				}
+	const long long * tarBegin = index->tarBegin;
+	int k = index->rowWidth;
+
+#pragma omp parallel for schedule(dynamic, 1024)
+	for(int i = 0; i < index->nTar; i++) {
+		for(int b0 = 0; b0 < nBands; b0 += RESAMPLE_BAND_GROUP) {
+			int nGroup = (nBands - b0 < RESAMPLE_BAND_GROUP) ? nBands - b0 : RESAMPLE_BAND_GROUP;
+			if(tarBegin != NULL) {
+				resampleRow<T, long long, withSD>(souVal + b0, index->souID + tarBegin[i], (index->weight != NULL) ? index->weight + tarBegin[i] : NULL, tarBegin[i + 1] - tarBegin[i],
+				                                  i, tarVal + b0, withSD ? tarSD + b0 : NULL, (nSouPixels != NULL) ? nSouPixels + b0 : NULL, nGroup);
 			}
-			
-		}
-		else {
-			tarVal[i] = -999;
-			if (tarSD != NULL) {
-				tarSD[i] = -999;
+			else {
+				resampleRow<T, int, withSD>(souVal + b0, index->rowSouID + (long long)i * k, index->rowWeight + (long long)i * k, k,
+				                            i, tarVal + b0, withSD ? tarSD + b0 : NULL, (nSouPixels != NULL) ? nSouPixels + b0 : NULL, nGroup);
 			}
 		}
 	}
 }
 
+/**
+ * NAME:	resampleMultiBand
+ * DESCRIPTION:	Apply the resampling operator to several bands at once (a sparse matrix times a dense matrix of bands). Target cells
+ *		are computed in parallel, and the source cells and weights of a target cell are read once for each group of RESAMPLE_BAND_GROUP
+ *		bands. Each target cell gets the weighted mean of its source cells with valid (non-negative) values, so one kernel serves
+ *		summary, footprint, PSF and inverse distance weighted operators. Nearest neighbor operators copy the source value as
+ *		"nnInterpolateMultiBand" does
+ * PARAMETERS:
+ * 	double ** souVal:	the input values at source cells, one array per band
+ *	struct SummaryIndex * index:	the resampling operator
+ * 	double ** tarVal:	the output values at target cells, one array per band
+ * 	double ** tarSD:	the output weighted standard deviations at target cells, one array per band (NULL if not needed)
+ * 	int ** nSouPixels:	the output numbers of contributing source cells to each target cell, one array per band (NULL if not needed)
+ *	int nBands:		the number of bands
+ * Output:
+ * 	double ** tarVal, tarSD:	-999 for target cells without valid source cells
+ */
+template <typename T>
+static void resampleMultiBandKernel(T ** souVal, const struct SummaryIndex * index, T ** tarVal, T ** tarSD, int ** nSouPixels, int nBands) {
+
+	// nearest neighbor rows: a plain gather, which also passes fill values through
+	if(index->tarBegin == NULL && index->rowWeight == NULL) {
+		nnInterpolateMultiBandKernel<T>(souVal, tarVal, nBands, index->rowSouID, index->nTar);
+		return;
+	}
+
+	if(tarSD != NULL) {
+		resampleRows<T, true>(souVal, index, tarVal, tarSD, nSouPixels, nBands);
+	}
+	else {
+		resampleRows<T, false>(souVal, index, tarVal, tarSD, nSouPixels, nBands);
+	}
+}
+
+void resampleMultiBand(double ** souVal, const struct SummaryIndex * index, double ** tarVal, double ** tarSD, int ** nSouPixels, int nBands) {
+	resampleMultiBandKernel<double>(souVal, index, tarVal, tarSD, nSouPixels, nBands);
+}
+
+void resampleMultiBand(float ** souVal, const struct SummaryIndex * index, float ** tarVal, float ** tarSD, int ** nSouPixels, int nBands) {
+	resampleMultiBandKernel<float>(souVal, index, tarVal, tarSD, nSouPixels, nBands);
+}
+
 
 
 /**
@@ -7,13 +7,231 @@
 #ifndef REPROH
 #define REPROH
 
+#include <stdio.h>
+
+/**
+ * Types of spatial index for "buildNNIndex"
+ */
+#define NN_INDEX_GRID		0	// latitude/longitude block grid (same as "nearestNeighborBlockIndex")
+#define NN_INDEX_GRID_SWATH	1	// latitude/longitude block grid queried along the swath (same as "nearestNeighborSwath")
+#define NN_INDEX_KDTREE		2	// k-d tree (same as "nearestNeighborKDTree")
+#define NN_INDEX_DUAL_GRID	3	// latitude/longitude block grid joined with tiles of neighboring target cells
+
+/**
+ * Orders target cells are queried in by "queryNNIndex" and "queryKNNIndex" (see "setNNIndexQueryOrder")
+ */
+#define NN_QUERY_ORDER_STORAGE	0	// the order of the input arrays
+#define NN_QUERY_ORDER_MORTON	1	// along a Morton (Z-order) curve over the region of target cells
+#define NN_QUERY_ORDER_HILBERT	2	// along a Hilbert curve over the region of target cells
+
+/**
+ * struct NNIndex: a reusable spatial index of source cells for nearest neighbor search
+ */
+struct NNIndex;
+
+/**
+ * struct LatLonRegion: a latitude/longitude region bounding a set of cells (see "latLonRegion")
+ * ITEMS:
+ *	long long nCells:	the number of valid cells in the region (0 for an empty region)
+ *	double latMin, latMax:	the latitude range (in degrees)
+ *	double lonWest:		the western edge (in degrees); the region may cross the dateline
+ *	double lonWidth:	the longitude range (in degrees) eastward from lonWest, 360 if the region covers all longitudes (e.g. near a pole)
+ */
+struct LatLonRegion {
+	long long nCells;
+	double latMin;
+	double latMax;
+	double lonWest;
+	double lonWidth;
+};
+
+
+/**
+ * NAME:	latLonRegion
+ * DESCRIPTION:	Compute the region bounding a set of cells, extended by a distance. The longitude range is the smallest one found on a 0.1 degree
+ *		grid, so a set crossing the dateline does not span all longitudes. The region covers all longitudes if it reaches a pole.
+ *		Cells outside the valid latitude/longitude range (e.g. fill values) are ignored
+ * PARAMETERS:
+ *	double * lat:		the latitudes of cells
+ *	double * lon:		the longitudes of cells
+ *	long long n:		the number of cells
+ *	double maxR:		the distance (in meters) to extend the region by
+ * Output:
+ *	struct LatLonRegion * region:	the region
+ */
+void latLonRegion(const double * lat, const double * lon, long long n, double maxR, struct LatLonRegion * region);
+
+
+/**
+ * NAME:	isInLatLonRegion
+ * DESCRIPTION:	Check if a location is in a region computed by "latLonRegion"
+ * Output:
+ *	1 if the location is in the region, 0 otherwise
+ */
+int isInLatLonRegion(const struct LatLonRegion * region, double lat, double lon);
+
+
+/**
+ * NAME:	spaceFillingCurveOrder
+ * DESCRIPTION:	Order a set of cells along a space-filling curve over their region (see "latLonRegion"), so cells next to each other in the order
+ *		are close on the sphere. Cells outside the valid latitude/longitude range (e.g. fill values) are placed at the end
+ * PARAMETERS:
+ *	double * lat:		the latitudes of cells
+ *	double * lon:		the longitudes of cells
+ *	long long n:		the number of cells
+ *	int curve:		NN_QUERY_ORDER_MORTON or NN_QUERY_ORDER_HILBERT
+ * Output:
+ *	long long * order:	the IDs of cells along the curve (n items)
+ */
+void spaceFillingCurveOrder(const double * lat, const double * lon, long long n, int curve, long long * order);
+
+
+
+/**
+ * NAME:	buildNNIndex
+ * DESCRIPTION:	Build a spatial index of source cells for nearest neighbor search. The input arrays are not changed (the index keeps its own
+ *		reordered copy), so the same geolocation can still be used for output, and the index can serve any number of targets
+ * PARAMETERS:
+ *	double * souLat:	the latitudes of source cells
+ *	double * souLon:	the longitudes of source cells
+ *	int nSou:		the number of source cells
+ *	double maxR:		the maximum distance (in meters) to define neighboring cells
+ *	int indexType:		NN_INDEX_GRID, NN_INDEX_GRID_SWATH, NN_INDEX_KDTREE or NN_INDEX_DUAL_GRID
+ * Output:
+ *	the index (release it with "freeNNIndex")
+ */
+struct NNIndex * buildNNIndex(const double * souLat, const double * souLon, int nSou, double maxR, int indexType);
+
+
+/**
+ * NAME:	buildNNIndexInRegion
+ * DESCRIPTION:	Same as "buildNNIndex", but only source cells in a region are indexed, so index memory and build time follow the overlap
+ *		of the source and the targets. With the region of all target cells extended by maxR (see "latLonRegion"), query results are
+ *		the same as with "buildNNIndex". IDs of source cells in query results are still the IDs in the input arrays
+ * PARAMETERS:
+ *	double * souLat:	the latitudes of source cells
+ *	double * souLon:	the longitudes of source cells
+ *	int nSou:		the number of source cells
+ *	double maxR:		the maximum distance (in meters) to define neighboring cells
+ *	int indexType:		NN_INDEX_GRID, NN_INDEX_GRID_SWATH, NN_INDEX_KDTREE or NN_INDEX_DUAL_GRID
+ *	struct LatLonRegion * region:	the region of source cells to be indexed (NULL for all source cells)
+ * Output:
+ *	the index (release it with "freeNNIndex")
+ */
+struct NNIndex * buildNNIndexInRegion(const double * souLat, const double * souLon, int nSou, double maxR, int indexType, const struct LatLonRegion * region);
+
+
+/**
+ * NAME:	setNNIndexQueryOrder
+ * DESCRIPTION:	Set the order target cells are queried in by "queryNNIndex" and "queryKNNIndex". Querying along a space-filling curve makes
+ *		consecutive queries of each thread hit the same source blocks (fewer cache misses when targets are not stored in spatial order,
+ *		e.g. USER_DEFINE grids or shifted MISR blocks). Results are returned in the storage order of target cells and are the same,
+ *		except that NN_INDEX_GRID_SWATH may choose another one of equally distant source cells.
+ *		NN_INDEX_DUAL_GRID always tiles target cells by location for "queryNNIndex", so the order only applies to "queryKNNIndex"
+ * PARAMETERS:
+ *	struct NNIndex * index:	the index of source cells
+ *	int queryOrder:		NN_QUERY_ORDER_STORAGE (default), NN_QUERY_ORDER_MORTON or NN_QUERY_ORDER_HILBERT
+ */
+void setNNIndexQueryOrder(struct NNIndex * index, int queryOrder);
+
+
+/**
+ * NAME:	setNNIndexApproximation
+ * DESCRIPTION:	Allow nearest neighbor queries ("queryNNIndex") to return a source cell that is not the nearest one, but within (1 + maxError)
+ *		times the distance of the nearest one, for faster previews. Blocks (or k-d tree nodes) which cannot hold a cell that much closer
+ *		than the current candidate are skipped. A target with a source cell within maxR always gets one. k nearest neighbor queries stay exact
+ * PARAMETERS:
+ *	struct NNIndex * index:	the index of source cells
+ *	double maxError:	the relative distance error allowed (e.g. 0.1 for 10%), 0 for exact search (default)
+ */
+void setNNIndexApproximation(struct NNIndex * index, double maxError);
+
+
+/**
+ * NAME:	setNNIndexCellRadius
+ * DESCRIPTION:	Give each source cell its own search radius (at most maxR), e.g. from the growth of MODIS pixels with the scan angle, so targets
+ *		are searched within the largest radius of the source cells around them instead of maxR ("queryNNIndex" and "queryKNNIndex").
+ *		A target reached by the radius of a source cell gets the same nearest cell as with maxR; other targets may get none.
+ *		NN_INDEX_KDTREE indexes search maxR around all targets
+ * PARAMETERS:
+ *	struct NNIndex * index:	the index of source cells
+ *	double * souR:		the search radius (in meters) of source cells by column: the source cell of original ID i has radius souR[i % nCols]
+ *	int nCols:		the number of columns, e.g. the cross-track width of a swath stored scan line by scan line (nSou for a radius per cell)
+ */
+void setNNIndexCellRadius(struct NNIndex * index, const double * souR, int nCols);
+
+
+/**
+ * NAME:	approximateNNError
+ * DESCRIPTION:	Measure the distance error of approximate nearest neighbor queries (see "setNNIndexApproximation") on evenly spaced target cells,
+ *		by querying them both approximately and exactly. The error of a target is (approximate distance - exact distance) / exact distance
+ * PARAMETERS:
+ *	struct NNIndex * index:	the index of source cells
+ *	double * tarLat:	the latitudes of target cells
+ *	double * tarLon:	the longitudes of target cells
+ *	long long nTar:		the number of target cells
+ *	long long nSample:	the number of target cells to check
+ * Output:
+ *	double * maxError:	the largest error of checked target cells
+ *	double * meanError:	the mean error of checked target cells
+ *	the number of checked target cells with a neighboring source cell
+ */
+long long approximateNNError(const struct NNIndex * index, const double * tarLat, const double * tarLon, long long nTar, long long nSample, double * maxError, double * meanError);
+
+
+/**
+ * NAME:	queryNNIndex
+ * DESCRIPTION:	Find the nearest neighboring source cell's ID for each target cell, using an index built by "buildNNIndex". The input arrays are not changed.
+ *		With NN_INDEX_DUAL_GRID, target cells are joined with the source blocks by tiles of neighboring target cells: blocks are pruned
+ *		once for a whole tile, and its targets share the candidates. The result is the same as NN_INDEX_GRID, except for the choice among
+ *		equally distant source cells
+ * PARAMETERS:
+ *	struct NNIndex * index:	the index of source cells
+ *	double * tarLat:	the latitudes of target cells
+ *	double * tarLon:	the longitudes of target cells
+ *	int * tarNNSouID:	the output IDs of nearest neighboring source cells
+ *	double * tarNNDis	the output nearest distance for each target cell (input NULL if you don't need this field)
+ *	long long nTar:		the number of target cells
+ * Output:
+ *	int * tarNNSouID:	the output IDs of nearest neighboring source cells
+ *	double * tarNNDis	the output nearest distance for each target cell (input NULL if you don't need this field)
+ */
+void queryNNIndex(const struct NNIndex * index, const double * tarLat, const double * tarLon, int * tarNNSouID, double * tarNNDis, long long nTar);
+
+
+/**
+ * NAME:	queryKNNIndex
+ * DESCRIPTION:	Find the k nearest neighboring source cells' IDs for each target cell, using an index built by "buildNNIndex". The input arrays are not changed.
+ *		Results are stored with a fixed stride of k per target cell
+ * PARAMETERS:
+ *	struct NNIndex * index:	the index of source cells
+ *	double * tarLat:	the latitudes of target cells
+ *	double * tarLon:	the longitudes of target cells
+ *	int k:			the number of nearest neighbors for each target cell
+ *	int * tarKNNSouID:	the output IDs of k nearest neighboring source cells (nTar * k, nearest first, -1 for the slots not found)
+ *	double * tarKNNDis:	the output distances (in meters) to the k nearest neighboring source cells (nTar * k, -1 for the slots not found)
+ *	long long nTar:		the number of target cells
+ * Output:
+ *	int * tarKNNSouID:	the output IDs of k nearest neighboring source cells
+ *	double * tarKNNDis:	the output distances to the k nearest neighboring source cells
+ */
+void queryKNNIndex(const struct NNIndex * index, const double * tarLat, const double * tarLon, int k, int * tarKNNSouID, double * tarKNNDis, long long nTar);
+
+
+/**
+ * NAME:	freeNNIndex
+ * DESCRIPTION:	Release an index built by "buildNNIndex"
+ */
+void freeNNIndex(struct NNIndex * index);
+
+
 
 /**
  * NAME:	nearestNeighborBlockIndex
  * DESCRIPTION:	Find the nearest neighboring source cell's ID for each target cell
  * PARAMETERS:
- *	double ** psouLat:	the pointer to the array of latitudes of source cells (the data are changed during in the function, so please do the output before this function)
- *	double ** psouLon:	the pointer to the array of longitudes of source cells (the data are changed during in the function, so please do the output before this function)
+ *	double ** psouLat:	the pointer to the array of latitudes of source cells (not changed)
+ *	double ** psouLon:	the pointer to the array of longitudes of source cells (not changed)
  *	int nSou:		the number of source cells
  *	double * tarLat:	the latitudes of target cells
  *	double * tarLon:	the longitudes of target cells
@@ -28,6 +246,29 @@
 void nearestNeighborBlockIndex(double ** psouLat, double ** psouLon, int nSou, double * tarLat, double * tarLon, int * tarNNSouID, double * tarNNDis, int nTar, double maxR);
 
 
+/**
+ * NAME:	nearestNeighborSwath
+ * DESCRIPTION:	Find the nearest neighboring source cell's ID for each target cell, exploiting the scan line order of target cells:
+ *		each query is seeded with the previous target's result and walks along the source swath, and the seed's distance
+ *		limits the block search to a few cells. Runs of consecutive target cells are processed in parallel.
+ *		Results are the same as "nearestNeighborBlockIndex" (exact search within maxR), except for the choice among equally distant source cells
+ * PARAMETERS:
+ *	double ** psouLat:	the pointer to the array of latitudes of source cells (not changed)
+ *	double ** psouLon:	the pointer to the array of longitudes of source cells (not changed)
+ *	int nSou:		the number of source cells
+ *	double * tarLat:	the latitudes of target cells
+ *	double * tarLon:	the longitudes of target cells
+ *	int * tarNNSouID:	the output IDs of nearest neighboring source cells 
+ *	double * tarNNDis	the output nearest distance for each target cell (input NULL if you don't need this field)
+ *	int nTar:		the number of target cells
+ *	double maxR:		the maximum distance (in meters) to define neighboring cells
+ * Output: 	
+ *	int * tarNNSouID:	the output IDs of nearest neighboring source cells 
+ *	double * tarNNDis	the output nearest distance for each target cell (input NULL if you don't need this field)
+ */ 
+void nearestNeighborSwath(double ** psouLat, double ** psouLon, int nSou, double * tarLat, double * tarLon, int * tarNNSouID, double * tarNNDis, int nTar, double maxR);
+
+
 /**
  * NAME:	nearestNeighbor
  * DESCRIPTION:	Find the nearest neighboring source cell's ID for each target cell
@@ -60,15 +301,66 @@ void nearestNeighbor(double ** psouLat, double ** psouLon, int nSou, double * ta
  * 	double * tarVal:	the output values at target cells
  */ 
 void nnInterpolate(double * souVal, double * tarVal, int * tarNNSouID, int nTar);
+void nnInterpolate(float * souVal, float * tarVal, int * tarNNSouID, int nTar);	// single precision
+
+
+/**
+ * NAME:	nnInterpolateMultiBand
+ * DESCRIPTION:	Nearest neighbor interpolation of several bands in one pass over the nearest neighbor IDs
+ * PARAMETERS:
+ * 	double ** souVal:	the input values at source cells, one array per band
+ * 	double ** tarVal:	the output values at target cells, one array per band
+ *	int nBands:		the number of bands
+ * 	int * tarNNSouID:	the IDs of nearest neighboring source cells for each target cells (generated from "nearestNeighbor") 
+ *	int nTar:		the number of target cells
+ * Output: 	
+ * 	double ** tarVal:	the output values at target cells
+ */ 
+void nnInterpolateMultiBand(double ** souVal, double ** tarVal, int nBands, int * tarNNSouID, int nTar);
+void nnInterpolateMultiBand(float ** souVal, float ** tarVal, int nBands, int * tarNNSouID, int nTar);	// single precision
+
+
+/**
+ * NAME:	idwWeights
+ * DESCRIPTION:	Inverse distance weights of the k nearest neighboring source cells of each target cell, normalized to sum to 1
+ * PARAMETERS:
+ * 	int * tarKNNSouID:	the IDs of k nearest neighboring source cells for each target cell (generated from "queryKNNIndex")
+ * 	double * tarKNNDis:	the distances to k nearest neighboring source cells for each target cell (generated from "queryKNNIndex")
+ * 	float * tarKNNWeight:	the output weights (nTar * k, 0 for the slots not found)
+ *	int k:			the number of nearest neighbors for each target cell
+ *	double power:		the power of distance (2 for the usual inverse squared distance)
+ *	int nTar:		the number of target cells
+ * Output:
+ * 	float * tarKNNWeight:	the output weights
+ */
+void idwWeights(const int * tarKNNSouID, const double * tarKNNDis, float * tarKNNWeight, int k, double power, int nTar);
+
+
+/**
+ * NAME:	idwInterpolate
+ * DESCRIPTION:	Inverse distance weighted interpolation; source cells with fill (negative) values are left out
+ * PARAMETERS:
+ * 	double * souVal:	the input values at source cells
+ * 	double * tarVal:	the output values at target cells
+ * 	int * tarKNNSouID:	the IDs of k nearest neighboring source cells for each target cell (generated from "queryKNNIndex")
+ * 	float * tarKNNWeight:	the weights of k nearest neighboring source cells for each target cell (generated from "idwWeights")
+ *	int k:			the number of nearest neighbors for each target cell
+ *	int nTar:		the number of target cells
+ * Output:
+ * 	double * tarVal:	the output values at target cells
+ */
+void idwInterpolate(double * souVal, double * tarVal, int * tarKNNSouID, float * tarKNNWeight, int k, int nTar);
+void idwInterpolate(float * souVal, float * tarVal, int * tarKNNSouID, float * tarKNNWeight, int k, int nTar);	// single precision
 
 
 /**
  * NAME:	summaryInterpolate
- * DESCRIPTION:	Interpolation (summary) from fine resolution to coarse resolution
+ * DESCRIPTION:	Interpolation (summary) from fine resolution to coarse resolution. Sums are accumulated in double for both the double and float versions,
+ *		and the SD uses Welford's update instead of the sum of squares
  * PARAMETERS:
  * 	double * souVal:	the input values at source cells
  * 	int * souNNTarID:	the IDs of nearest neighboring target cells for each source cells (generated from "nearestNeighbor")
- * 	int nSou:		the number of source cells
+ * 	long long nSou:		the number of source cells
  * 	double * tarVal:	the output (average) values at target cells
  * 	double * tarSD:		the standard deviation (SD) value at target cells (can be NULL if no SD values need to be reported)
  * 	int * nSouPixels:	the output numbers of contributing source cells to each target cell
@@ -78,7 +370,167 @@ void nnInterpolate(double * souVal, double * tarVal, int * tarNNSouID, int nTar)
  * 	double * tarSD:		the standard deviation (SD) value at target cells (can be NULL if no SD values need to be reported)
  * 	int * nSouPixels:	the output numbers of contributing source cells to each target cell
  */
-void summaryInterpolate(double * souVal, int * souNNTarID, int nSou, double * tarVal, double * tarSD, int * nSouPixels, int nTar);
+void summaryInterpolate(double * souVal, int * souNNTarID, long long nSou, double * tarVal, double * tarSD, int * nSouPixels, int nTar);
+void summaryInterpolate(float * souVal, int * souNNTarID, long long nSou, float * tarVal, float * tarSD, int * nSouPixels, int nTar);	// single precision
+
+
+/**
+ * NAME:	summaryStatistics
+ * DESCRIPTION:	Summary (as "summaryInterpolate") with extra statistics, all computed in one pass over the source cells.
+ *		Mean and SD use Welford's update. The median is approximate, from a sample of up to 15 source values per target cell
+ * PARAMETERS:
+ * 	double * souVal:	the input values at source cells
+ * 	int * souNNTarID:	the IDs of nearest neighboring target cells for each source cells (generated from "nearestNeighbor")
+ * 	long long nSou:		the number of source cells
+ * 	double * tarVal:	the output (average) values at target cells
+ * 	double * tarSD:		the standard deviation (SD) value at target cells (can be NULL)
+ * 	int * nSouPixels:	the output numbers of contributing source cells to each target cell
+ * 	double * tarMin:	the minimum value at target cells (can be NULL)
+ * 	double * tarMax:	the maximum value at target cells (can be NULL)
+ * 	double * tarValidFraction:	the fraction of source cells of each target cell that are not fill values (can be NULL)
+ * 	double * tarMedian:	the approximate median value at target cells (can be NULL)
+ *	int nTar:		the number of target cells
+ * Output:
+ * 	double * tarVal, tarSD, tarMin, tarMax, tarValidFraction, tarMedian:	the statistics at target cells, -999 for target cells without source cells
+ * 	int * nSouPixels:	the output numbers of contributing source cells to each target cell
+ */
+void summaryStatistics(double * souVal, int * souNNTarID, long long nSou, double * tarVal, double * tarSD, int * nSouPixels, double * tarMin, double * tarMax, double * tarValidFraction, double * tarMedian, int nTar);
+void summaryStatistics(float * souVal, int * souNNTarID, long long nSou, float * tarVal, float * tarSD, int * nSouPixels, float * tarMin, float * tarMax, float * tarValidFraction, float * tarMedian, int nTar);	// single precision
+
+
+/**
+ * struct SummaryIndex: the resampling operator, a sparse matrix of the (weighted) source cells of each target cell. It is built once
+ * from the nearest neighbor mapping ("buildSummaryIndex", "nnSummaryIndex", "idwSummaryIndex"), from a radius query ("queryRadiusNNIndex")
+ * or with weights from the point spread function of the target cells ("queryPSFNNIndex"), and applied to every band ("resampleMultiBand")
+ */
+struct SummaryIndex;
+
+/**
+ * NAME:	buildSummaryIndex
+ * DESCRIPTION:	Build the list of source cells of each target cell (in compressed sparse row form) for "summaryInterpolate" and
+ *		"summaryStatistics". Source cells without a target cell (ID <= 0) are left out
+ * PARAMETERS:
+ * 	int * souNNTarID:	the IDs of nearest neighboring target cells for each source cells (generated from "nearestNeighbor")
+ * 	long long nSou:		the number of source cells
+ *	int nTar:		the number of target cells
+ * Output:
+ *	the index (release it with "freeSummaryIndex")
+ */
+struct SummaryIndex * buildSummaryIndex(const int * souNNTarID, long long nSou, int nTar);
+
+/**
+ * NAME:	freeSummaryIndex
+ * DESCRIPTION:	Release an index built by "buildSummaryIndex" or any other operator
+ */
+void freeSummaryIndex(struct SummaryIndex * index);
+
+/**
+ * NAME:	nnSummaryIndex, idwSummaryIndex
+ * DESCRIPTION:	The resampling operators of nearest neighbor and inverse distance weighted interpolation, for "resampleMultiBand".
+ *		They point to the IDs (and weights) of the caller instead of copying them, so keep those until the operator is released
+ * PARAMETERS:
+ * 	int * tarNNSouID:	the IDs of nearest neighboring source cells for each target cells (generated from "queryNNIndex")
+ * 	int * tarKNNSouID:	the IDs of k nearest neighboring source cells for each target cell (generated from "queryKNNIndex")
+ * 	float * tarKNNWeight:	the weights of k nearest neighboring source cells for each target cell (generated from "idwWeights")
+ *	int k:			the number of nearest neighbors for each target cell
+ * 	long long nSou:		the number of source cells
+ *	int nTar:		the number of target cells
+ * Output:
+ *	the operator (release it with "freeSummaryIndex")
+ */
+struct SummaryIndex * nnSummaryIndex(const int * tarNNSouID, long long nSou, int nTar);
+struct SummaryIndex * idwSummaryIndex(const int * tarKNNSouID, const float * tarKNNWeight, int k, long long nSou, int nTar);
+
+/**
+ * NAME:	writeSummaryIndex, readSummaryIndex
+ * DESCRIPTION:	Save an operator to a file and load it back, to apply it to later orbits with the same geometry.
+ *		Only operators with their own lists of source cells (not from "nnSummaryIndex" or "idwSummaryIndex") are written
+ * PARAMETERS:
+ *	struct SummaryIndex * index:	the operator
+ *	FILE * fp:		the file, opened for binary writing or reading
+ * Output:
+ *	writeSummaryIndex: 0 on success, -1 on failure
+ *	readSummaryIndex: the operator (release it with "freeSummaryIndex"), NULL if the file does not hold a valid one
+ */
+int writeSummaryIndex(const struct SummaryIndex * index, FILE * fp);
+struct SummaryIndex * readSummaryIndex(FILE * fp);
+
+/**
+ * NAME:	queryRadiusNNIndex
+ * DESCRIPTION:	Find all source cells within a distance of each target cell (the footprint of the target cell), using an index built by "buildNNIndex".
+ *		Unlike the nearest neighbor mapping, a source cell can be in the footprints of several target cells
+ * PARAMETERS:
+ *	struct NNIndex * index:	the index of source cells
+ *	double * tarLat:	the latitudes of target cells
+ *	double * tarLon:	the longitudes of target cells
+ *	double radius:		the distance (in meters), limited to the maximum distance the index was built with. Cells at exactly this distance are included
+ *	int nTar:		the number of target cells
+ * Output:
+ *	the source cells of each target cell, in ascending order (release it with "freeSummaryIndex")
+ */
+struct SummaryIndex * queryRadiusNNIndex(const struct NNIndex * index, const double * tarLat, const double * tarLon, double radius, int nTar);
+
+/**
+ * NAME:	queryPSFNNIndex
+ * DESCRIPTION:	Find the source cells within the point spread function of each target cell of a scanned swath (MODIS), with their weights,
+ *		using an index built by "buildNNIndex". The point spread function is triangular along the scan, falling from 1 at the center
+ *		of the target cell to 0 at the centers of its neighbors on the scan line, and flat over the cell along the track. The spacings
+ *		along the scan and the track are taken from the neighbors of each target cell, so the support grows with the scan angle.
+ *		The weights depend only on the geolocation, so build them once and apply them to every band with "resampleMultiBand"
+ * PARAMETERS:
+ *	struct NNIndex * index:	the index of source cells, built with a maximum distance covering the largest target cell
+ *	double * souLat:	the latitudes of source cells (the ones the index was built with)
+ *	double * souLon:	the longitudes of source cells
+ *	double * tarLat:	the latitudes of target cells, scan line by scan line
+ *	double * tarLon:	the longitudes of target cells
+ *	int tarWidth:		the number of target cells of a scan line (e.g. 1354 for MODIS 1KM)
+ *	int nTar:		the number of target cells
+ * Output:
+ *	the source cells of each target cell, in ascending order, with their weights (release it with "freeSummaryIndex").
+ *	Source cells of zero weight are left out
+ */
+struct SummaryIndex * queryPSFNNIndex(const struct NNIndex * index, const double * souLat, const double * souLon, const double * tarLat, const double * tarLon, int tarWidth, int nTar);
+
+/**
+ * NAME:	summaryInterpolate, summaryStatistics (with a "SummaryIndex")
+ * DESCRIPTION:	Same as the versions above, but each target cell gathers its own source cells from the index instead of scattering
+ *		every source cell to its target cell. Use these when several bands share one nearest neighbor mapping.
+ *		Source cells are accumulated in ascending order, so the result does not depend on the number of threads.
+ *		Only operators in compressed sparse row form ("buildSummaryIndex", "queryRadiusNNIndex", "queryPSFNNIndex") are supported,
+ *		and their weights are not used (see "resampleMultiBand")
+ * PARAMETERS:
+ * 	double * souVal:	the input values at source cells
+ *	struct SummaryIndex * index:	the source cells of each target cell (generated from "buildSummaryIndex" or "queryRadiusNNIndex")
+ * 	double * tarVal, tarSD, tarMin, tarMax, tarValidFraction, tarMedian:	the statistics at target cells (all but tarVal can be NULL)
+ * 	int * nSouPixels:	the output numbers of contributing source cells to each target cell
+ * Output:
+ * 	double * tarVal, tarSD, tarMin, tarMax, tarValidFraction, tarMedian:	the statistics at target cells, -999 for target cells without source cells
+ * 	int * nSouPixels:	the output numbers of contributing source cells to each target cell
+ */
+void summaryInterpolate(double * souVal, const struct SummaryIndex * index, double * tarVal, double * tarSD, int * nSouPixels);
+void summaryInterpolate(float * souVal, const struct SummaryIndex * index, float * tarVal, float * tarSD, int * nSouPixels);	// single precision
+void summaryStatistics(double * souVal, const struct SummaryIndex * index, double * tarVal, double * tarSD, int * nSouPixels, double * tarMin, double * tarMax, double * tarValidFraction, double * tarMedian);
+void summaryStatistics(float * souVal, const struct SummaryIndex * index, float * tarVal, float * tarSD, int * nSouPixels, float * tarMin, float * tarMax, float * tarValidFraction, float * tarMedian);	// single precision
+
+/**
+ * NAME:	resampleMultiBand
+ * DESCRIPTION:	Apply a resampling operator to several bands at once. Each target cell gets the weighted mean of its source cells,
+ *		leaving out source cells with negative (fill) values and their weights, so this is the summary mean, the footprint mean,
+ *		the PSF weighted mean or the inverse distance weighted interpolation depending on the operator. Operators from "nnSummaryIndex"
+ *		copy the value of the nearest source cell as is (as "nnInterpolateMultiBand"). The source cells and weights of a target cell
+ *		are read once for a group of bands, and target cells are computed in parallel
+ * PARAMETERS:
+ * 	double ** souVal:	the input values at source cells, one array per band
+ *	struct SummaryIndex * index:	the resampling operator
+ * 	double ** tarVal:	the output values at target cells, one array per band
+ * 	double ** tarSD:	the output weighted standard deviations at target cells, one array per band (can be NULL; not computed by nearest neighbor operators)
+ * 	int ** nSouPixels:	the output numbers of contributing source cells to each target cell, one array per band (can be NULL; not computed by nearest neighbor operators)
+ *	int nBands:		the number of bands
+ * Output:
+ * 	double ** tarVal, tarSD:	-999 for target cells without valid source cells
+ */
+void resampleMultiBand(double ** souVal, const struct SummaryIndex * index, double ** tarVal, double ** tarSD, int ** nSouPixels, int nBands);
+void resampleMultiBand(float ** souVal, const struct SummaryIndex * index, float ** tarVal, float ** tarSD, int ** nSouPixels, int nBands);	// single precision
 
 
 
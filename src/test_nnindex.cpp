@@ -0,0 +1,662 @@
+/*
+
+
+    AUTHOR:
+        agent
+
+    EMAIL:
+        agent@local
+
+    Checks the nearest neighbor index of every index type against a brute force search on synthetic
+    cells, so no input file is needed: a mid-latitude area, cells across the dateline and a polar cap.
+    Prints each check and exits with 1 if any of them fails.
+    Indexes cropped to the region of part of the target cells (buildNNIndexInRegion) are checked the
+    same way. Approximate search (setNNIndexApproximation) is checked against its distance error bound,
+    and the source cells found by radius queries (queryRadiusNNIndex) against the brute force ones.
+    Nearest neighbor queries are also checked with target cells queried along the Morton and Hilbert
+    curves (setNNIndexQueryOrder), and with a search radius of each source cell (setNNIndexCellRadius):
+    a target cell within the radius of some source cell must get the same nearest cell as with maxR.
+    Two clusters far apart make the grid of these radii coarser than maxR.
+    The point spread function weights of queryPSFNNIndex are checked on a regular swath over a regular
+    grid of source cells, where the support of every target cell is known exactly.
+
+*/
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "reproject.h"
+
+const double earthRadius = 6371009;
+// distances closer than this (in meters) are taken as equal
+const double disTolerance = 1e-3;
+
+struct TestCells {
+	const char * name;
+	std::vector<double> souLat, souLon;
+	std::vector<double> tarLat, tarLon;
+	// target cells below this latitude are used for the cropped index checks
+	double cropLat;
+	// unit vectors of source cells for brute force search (see "setUnitVectors")
+	std::vector<double> souXYZ;
+};
+
+static double uniform(double a, double b) {
+	return a + (b - a) * rand() / RAND_MAX;
+}
+
+static double wrapLon(double lon) {
+	while(lon >= 180) {
+		lon -= 360;
+	}
+	while(lon < -180) {
+		lon += 360;
+	}
+	return lon;
+}
+
+/*
+ * Random cells over a latitude/longitude box (the longitude range may cross the dateline), with a few fill values
+ */
+static void makeCells(double latMin, double latMax, double lonWest, double lonWidth, int n, std::vector<double> &lat, std::vector<double> &lon) {
+	lat.resize(n);
+	lon.resize(n);
+	for(int i = 0; i < n; i++) {
+		if(i % 500 == 7) {
+			lat[i] = -999;
+			lon[i] = -999;
+			continue;
+		}
+		lat[i] = uniform(latMin, latMax);
+		lon[i] = wrapLon(uniform(lonWest, lonWest + lonWidth));
+	}
+}
+
+static int isValidCell(double lat, double lon) {
+	return lat >= -90 && lat <= 90 && lon >= -180 && lon <= 180;
+}
+
+static void unitVector(double lat, double lon, double * v) {
+	double la = lat * M_PI / 180;
+	double lo = lon * M_PI / 180;
+	v[0] = cos(la) * cos(lo);
+	v[1] = cos(la) * sin(lo);
+	v[2] = sin(la);
+}
+
+/*
+ * Great circle distance (in meters) between two unit vectors, from their chord length as in reproject.cpp
+ */
+static double distance(const double * a, const double * b) {
+	double c2 = (a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) + (a[2] - b[2]) * (a[2] - b[2]);
+	return 2 * asin(sqrt(c2) / 2) * earthRadius;
+}
+
+static double distance(double lat1, double lon1, double lat2, double lon2) {
+	double a[3], b[3];
+	unitVector(lat1, lon1, a);
+	unitVector(lat2, lon2, b);
+	return distance(a, b);
+}
+
+static void setUnitVectors(TestCells &cells) {
+	cells.souXYZ.resize(cells.souLat.size() * 3);
+	for(size_t s = 0; s < cells.souLat.size(); s++) {
+		unitVector(cells.souLat[s], cells.souLon[s], &cells.souXYZ[s * 3]);
+	}
+}
+
+/*
+ * Distances (in meters) of all valid source cells within maxR of a target cell, ascending
+ */
+static void bruteForce(const TestCells &cells, int t, double maxR, std::vector<double> &dis) {
+	double v[3];
+	unitVector(cells.tarLat[t], cells.tarLon[t], v);
+	dis.clear();
+	for(size_t s = 0; s < cells.souLat.size(); s++) {
+		if(!isValidCell(cells.souLat[s], cells.souLon[s])) {
+			continue;
+		}
+		double d = distance(v, &cells.souXYZ[s * 3]);
+		if(d <= maxR + disTolerance) {
+			dis.push_back(d);
+		}
+	}
+	std::sort(dis.begin(), dis.end());
+}
+
+static int nFailed = 0;
+
+static void report(const char * check, const TestCells &cells, int nBad) {
+	printf("%-44s %-13s %s", check, cells.name, (nBad == 0) ? "PASS\n" : "FAIL");
+	if(nBad != 0) {
+		printf(" (%d target cells)\n", nBad);
+		nFailed ++;
+	}
+}
+
+/*
+ * Check the nearest source cell of each target cell: same distance as the brute force one (any of equally distant ones), or none
+ * when no source cell is within maxR
+ */
+static int checkNN(const TestCells &cells, const std::vector<std::vector<double> > &expect, const int * nnID, const double * nnDis, double maxR) {
+	int nBad = 0;
+	for(size_t t = 0; t < cells.tarLat.size(); t++) {
+		const std::vector<double> &dis = expect[t];
+		// too close to maxR to tell
+		if(!dis.empty() && fabs(dis[0] - maxR) < disTolerance) {
+			continue;
+		}
+		if(dis.empty() || dis[0] > maxR) {
+			nBad += (nnID[t] != -1);
+			continue;
+		}
+		if(nnID[t] < 0 || nnID[t] >= (int)cells.souLat.size()) {
+			nBad ++;
+			continue;
+		}
+		double d = distance(cells.tarLat[t], cells.tarLon[t], cells.souLat[nnID[t]], cells.souLon[nnID[t]]);
+		if(fabs(d - dis[0]) > disTolerance || (nnDis != NULL && fabs(nnDis[t] - d) > disTolerance)) {
+			nBad ++;
+		}
+	}
+	return nBad;
+}
+
+/*
+ * Check the source cell of each target cell found by approximate search: within (1 + maxError) times the brute force nearest
+ * distance, and none only when no source cell is within maxR
+ */
+static int checkApproxNN(const TestCells &cells, const std::vector<std::vector<double> > &expect, const int * nnID, const double * nnDis, double maxR, double maxError) {
+	int nBad = 0;
+	for(size_t t = 0; t < cells.tarLat.size(); t++) {
+		const std::vector<double> &dis = expect[t];
+		if(!dis.empty() && fabs(dis[0] - maxR) < disTolerance) {
+			continue;
+		}
+		if(dis.empty() || dis[0] > maxR) {
+			nBad += (nnID[t] != -1);
+			continue;
+		}
+		if(nnID[t] < 0 || nnID[t] >= (int)cells.souLat.size()) {
+			nBad ++;
+			continue;
+		}
+		double d = distance(cells.tarLat[t], cells.tarLon[t], cells.souLat[nnID[t]], cells.souLon[nnID[t]]);
+		if(d > dis[0] * (1 + maxError) + disTolerance || fabs(nnDis[t] - d) > disTolerance) {
+			nBad ++;
+		}
+	}
+	return nBad;
+}
+
+/*
+ * Check the k nearest source cells of each target cell: distinct cells at the k smallest brute force distances, nearest first,
+ * and -1 for the slots beyond the source cells within maxR
+ */
+static int checkKNN(const TestCells &cells, const std::vector<std::vector<double> > &expect, const int * knnID, const double * knnDis, int k, double maxR) {
+	int nBad = 0;
+	for(size_t t = 0; t < cells.tarLat.size(); t++) {
+		const std::vector<double> &dis = expect[t];
+		int nIn = 0;
+		int unsure = 0;
+		for(size_t l = 0; l < dis.size(); l++) {
+			unsure |= fabs(dis[l] - maxR) < disTolerance;
+			nIn += (dis[l] <= maxR);
+		}
+		if(unsure) {
+			continue;
+		}
+		const int * ids = knnID + t * k;
+		int bad = 0;
+		for(int l = 0; l < k; l++) {
+			if(l >= nIn) {
+				bad |= (ids[l] != -1) || (knnDis[t * k + l] != -1);
+				continue;
+			}
+			if(ids[l] < 0 || ids[l] >= (int)cells.souLat.size()) {
+				bad = 1;
+				break;
+			}
+			for(int m = 0; m < l; m++) {
+				bad |= (ids[m] == ids[l]);
+			}
+			double d = distance(cells.tarLat[t], cells.tarLon[t], cells.souLat[ids[l]], cells.souLon[ids[l]]);
+			bad |= fabs(d - dis[l]) > disTolerance || fabs(knnDis[t * k + l] - d) > disTolerance;
+		}
+		nBad += bad;
+	}
+	return nBad;
+}
+
+/*
+ * Whether each target cell is within the own search radius of some source cell (see "setNNIndexCellRadius"): the source cell of ID s
+ * has radius souR[s % nCols]. Target cells too close to the radius to tell are left as not reached
+ */
+static void bruteForceReached(const TestCells &cells, const std::vector<double> &souR, std::vector<char> &reached) {
+	int nSou = (int)cells.souLat.size();
+	int nTar = (int)cells.tarLat.size();
+	int nCols = (int)souR.size();
+	reached.assign(nTar, 0);
+	for(int t = 0; t < nTar; t++) {
+		double v[3];
+		unitVector(cells.tarLat[t], cells.tarLon[t], v);
+		for(int s = 0; s < nSou && !reached[t]; s++) {
+			if(isValidCell(cells.souLat[s], cells.souLon[s])) {
+				reached[t] = distance(v, &cells.souXYZ[s * 3]) < souR[s % nCols] - disTolerance;
+			}
+		}
+	}
+}
+
+/*
+ * Check the nearest source cell of each target cell with search radii of source cells: target cells reached by the radius of a source
+ * cell get the brute force nearest one, as with maxR; the others get either none or the brute force nearest one
+ */
+static int checkCellRadiusNN(const TestCells &cells, const std::vector<std::vector<double> > &expect, const std::vector<char> &reached, const int * nnID, const double * nnDis, double maxR) {
+	int nBad = 0;
+	for(size_t t = 0; t < cells.tarLat.size(); t++) {
+		const std::vector<double> &dis = expect[t];
+		if(!dis.empty() && fabs(dis[0] - maxR) < disTolerance) {
+			continue;
+		}
+		if(nnID[t] == -1) {
+			nBad += reached[t];
+			continue;
+		}
+		if(nnID[t] < 0 || nnID[t] >= (int)cells.souLat.size() || dis.empty()) {
+			nBad ++;
+			continue;
+		}
+		double d = distance(cells.tarLat[t], cells.tarLon[t], cells.souLat[nnID[t]], cells.souLon[nnID[t]]);
+		if(fabs(d - dis[0]) > disTolerance || fabs(nnDis[t] - d) > disTolerance) {
+			nBad ++;
+		}
+	}
+	return nBad;
+}
+
+/*
+ * Check the k nearest source cells of each target cell with search radii of source cells: the first ones of the brute force k nearest
+ * (at least the nearest one for target cells reached by the radius of a source cell), then -1 for the other slots
+ */
+static int checkCellRadiusKNN(const TestCells &cells, const std::vector<std::vector<double> > &expect, const std::vector<char> &reached, const int * knnID, const double * knnDis, int k, double maxR) {
+	int nBad = 0;
+	for(size_t t = 0; t < cells.tarLat.size(); t++) {
+		const std::vector<double> &dis = expect[t];
+		int nIn = 0;
+		int unsure = 0;
+		for(size_t l = 0; l < dis.size(); l++) {
+			unsure |= fabs(dis[l] - maxR) < disTolerance;
+			nIn += (dis[l] <= maxR);
+		}
+		if(unsure) {
+			continue;
+		}
+		const int * ids = knnID + t * k;
+		int nFound = 0;
+		while(nFound < k && ids[nFound] != -1) {
+			nFound ++;
+		}
+		int bad = (nFound > nIn) || (reached[t] && nFound == 0);
+		for(int l = 0; l < k && !bad; l++) {
+			if(l >= nFound) {
+				bad |= (ids[l] != -1) || (knnDis[t * k + l] != -1);
+				continue;
+			}
+			if(ids[l] < 0 || ids[l] >= (int)cells.souLat.size()) {
+				bad = 1;
+				break;
+			}
+			for(int m = 0; m < l; m++) {
+				bad |= (ids[m] == ids[l]);
+			}
+			double d = distance(cells.tarLat[t], cells.tarLon[t], cells.souLat[ids[l]], cells.souLon[ids[l]]);
+			bad |= fabs(d - dis[l]) > disTolerance || fabs(knnDis[t * k + l] - d) > disTolerance;
+		}
+		nBad += bad;
+	}
+	return nBad;
+}
+
+/*
+ * Number of valid source cells within a radius of each target cell and the sum of their IDs + 1 (-1 when a source cell is too
+ * close to the radius to tell)
+ */
+static void bruteForceRadius(const TestCells &cells, double radius, std::vector<int> &count, std::vector<double> &idSum) {
+	int nSou = (int)cells.souLat.size();
+	int nTar = (int)cells.tarLat.size();
+	count.assign(nTar, 0);
+	idSum.assign(nTar, 0);
+	for(int t = 0; t < nTar; t++) {
+		double v[3];
+		unitVector(cells.tarLat[t], cells.tarLon[t], v);
+		for(int s = 0; s < nSou; s++) {
+			if(!isValidCell(cells.souLat[s], cells.souLon[s])) {
+				continue;
+			}
+			double d = distance(v, &cells.souXYZ[s * 3]);
+			if(fabs(d - radius) < disTolerance) {
+				count[t] = -1;
+				break;
+			}
+			if(d <= radius) {
+				count[t] ++;
+				idSum[t] += s + 1;
+			}
+		}
+	}
+}
+
+/*
+ * Check the source cells found within a radius of each target cell: the number of them and the sum of their IDs (read through
+ * "summaryInterpolate" with the ID + 1 as the source value) are the brute force ones
+ */
+static int checkRadius(const TestCells &cells, const struct SummaryIndex * found, const std::vector<int> &expectCount, const std::vector<double> &expectIDSum) {
+	int nSou = (int)cells.souLat.size();
+	int nTar = (int)cells.tarLat.size();
+	std::vector<double> souVal(nSou);
+	for(int s = 0; s < nSou; s++) {
+		souVal[s] = s + 1;
+	}
+	std::vector<double> mean(nTar);
+	std::vector<int> count(nTar);
+	summaryInterpolate(&souVal[0], found, &mean[0], NULL, &count[0]);
+
+	int nBad = 0;
+	for(int t = 0; t < nTar; t++) {
+		int n = expectCount[t];
+		if(n < 0) {
+			continue;
+		}
+		if(count[t] != n || (n > 0 && fabs(mean[t] * n - expectIDSum[t]) > 1e-6 * expectIDSum[t]) || (n == 0 && mean[t] != -999)) {
+			nBad ++;
+		}
+	}
+	return nBad;
+}
+
+/*
+ * Target cells of a regular swath over the equator across the dateline: tarWidth cells 1 km apart along the scan (east) on each of
+ * nLines scan lines trackSpacing km apart (north), with the middle one a fill value. Source cells are on a 100 m grid offset by half a
+ * cell and reach 1.45 km beyond the target cells, so no source cell is on the edge of a point spread function and cells at the edge of
+ * the swath have full support. Positions (in km) are kept for the expected weights
+ */
+static void makeSwath(int tarWidth, int nLines, double trackSpacing, TestCells &cells, std::vector<double> &tarX, std::vector<double> &tarY, std::vector<double> &souX, std::vector<double> &souY) {
+	const double kmToDegree = 180 / M_PI / (earthRadius / 1000);
+	double halfX = (tarWidth - 1) / 2.0;
+	double halfY = (nLines - 1) / 2.0 * trackSpacing;
+	for(int line = 0; line < nLines; line++) {
+		for(int col = 0; col < tarWidth; col++) {
+			double x = col - halfX;
+			double y = line * trackSpacing - halfY;
+			int fill = (nLines > 2 && line == nLines / 2 && col == tarWidth / 2);
+			tarX.push_back(x);
+			tarY.push_back(y);
+			cells.tarLat.push_back(fill ? -999 : y * kmToDegree);
+			cells.tarLon.push_back(fill ? -999 : wrapLon(180 + x * kmToDegree));
+		}
+	}
+	int nX = (int)((2 * halfX + 2.9) / 0.1 + 0.5) + 1;
+	int nY = (int)((2 * halfY + 2.9) / 0.1 + 0.5) + 1;
+	for(int j = 0; j < nY; j++) {
+		for(int i = 0; i < nX; i++) {
+			double x = -halfX - 1.45 + 0.1 * i;
+			double y = -halfY - 1.45 + 0.1 * j;
+			souX.push_back(x);
+			souY.push_back(y);
+			cells.souLat.push_back(y * kmToDegree);
+			cells.souLon.push_back(wrapLon(180 + x * kmToDegree));
+		}
+	}
+	cells.name = (nLines > 1) ? "swath" : "one scan line";
+	setUnitVectors(cells);
+}
+
+/*
+ * Check the point spread function weights of a regular swath (see "makeSwath") from "queryPSFNNIndex": the number of source cells of
+ * each target cell, the weighted mean of random values against the weights from the known spacings (1 km along the scan, the line
+ * spacing along the track, or 1 km on a single scan line), and the weighted centroid of the source cells against the target cell.
+ * With a small maxR, the support is clamped to maxR
+ */
+static void checkPSF(int tarWidth, int nLines, double trackSpacing, double maxR) {
+	TestCells cells;
+	std::vector<double> tarX, tarY, souX, souY;
+	makeSwath(tarWidth, nLines, trackSpacing, cells, tarX, tarY, souX, souY);
+	int nSou = (int)cells.souLat.size();
+	int nTar = (int)cells.tarLat.size();
+	double expectTrack = (nLines > 1) ? trackSpacing : 1;
+
+	// bands: random values, then the positions (in km) east and north offset to keep them valid
+	std::vector<std::vector<double> > souVal(3, std::vector<double>(nSou));
+	for(int s = 0; s < nSou; s++) {
+		souVal[0][s] = uniform(0, 100);
+		souVal[1][s] = 1000 + souX[s];
+		souVal[2][s] = 1000 + souY[s];
+	}
+	std::vector<int> expectCount(nTar, 0);
+	std::vector<double> expectMean(nTar, -999);
+	for(int t = 0; t < nTar; t++) {
+		if(!isValidCell(cells.tarLat[t], cells.tarLon[t])) {
+			continue;
+		}
+		double v[3];
+		unitVector(cells.tarLat[t], cells.tarLon[t], v);
+		double sum = 0, wSum = 0;
+		for(int s = 0; s < nSou; s++) {
+			double u = fabs(souX[s] - tarX[t]);
+			double a = fabs(souY[s] - tarY[t]) / expectTrack;
+			if(u >= 1 || a > 0.5 || distance(v, &cells.souXYZ[s * 3]) > maxR) {
+				continue;
+			}
+			expectCount[t] ++;
+			sum += (1 - u) * souVal[0][s];
+			wSum += 1 - u;
+		}
+		expectMean[t] = (wSum > 0) ? sum / wSum : -999;
+	}
+
+	std::vector<std::vector<double> > tarVal(3, std::vector<double>(nTar));
+	std::vector<std::vector<int> > count(3, std::vector<int>(nTar));
+	std::vector<double *> souPtr(3), tarPtr(3);
+	std::vector<int *> countPtr(3);
+	for(int band = 0; band < 3; band++) {
+		souPtr[band] = &souVal[band][0];
+		tarPtr[band] = &tarVal[band][0];
+		countPtr[band] = &count[band][0];
+	}
+
+	const int indexTypes[4] = {NN_INDEX_GRID, NN_INDEX_GRID_SWATH, NN_INDEX_KDTREE, NN_INDEX_DUAL_GRID};
+	const char * indexNames[4] = {"GRID", "GRID_SWATH", "KDTREE", "DUAL_GRID"};
+	char check[128];
+	for(int i = 0; i < 4; i++) {
+		struct NNIndex * index = buildNNIndex(&cells.souLat[0], &cells.souLon[0], nSou, maxR, indexTypes[i]);
+		struct SummaryIndex * psf = queryPSFNNIndex(index, &cells.souLat[0], &cells.souLon[0], &cells.tarLat[0], &cells.tarLon[0], tarWidth, nTar);
+		resampleMultiBand(&souPtr[0], psf, &tarPtr[0], NULL, &countPtr[0], 3);
+
+		int nBadCount = 0, nBadMean = 0, nBadCentroid = 0;
+		for(int t = 0; t < nTar; t++) {
+			nBadCount += (count[0][t] != expectCount[t]);
+			if(expectCount[t] == 0) {
+				nBadMean += (tarVal[0][t] != -999);
+				continue;
+			}
+			nBadMean += fabs(tarVal[0][t] - expectMean[t]) > 1e-6 * expectMean[t];
+			nBadCentroid += fabs(tarVal[1][t] - 1000 - tarX[t]) > 1e-5 || fabs(tarVal[2][t] - 1000 - tarY[t]) > 1e-5;
+		}
+		sprintf(check, "queryPSFNNIndex %s%s count", indexNames[i], (maxR < 3000) ? " clamped" : "");
+		report(check, cells, nBadCount);
+		sprintf(check, "queryPSFNNIndex %s%s weights", indexNames[i], (maxR < 3000) ? " clamped" : "");
+		report(check, cells, nBadMean);
+		sprintf(check, "queryPSFNNIndex %s%s centroid", indexNames[i], (maxR < 3000) ? " clamped" : "");
+		report(check, cells, nBadCentroid);
+
+		freeSummaryIndex(psf);
+		freeNNIndex(index);
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	const double maxR = 5000;
+	const int k = 4;
+	const int nSou = 12000;
+	const int nTar = 3000;
+	const double maxError = 0.25;
+	const double radius = 3000;
+	srand(20190601);
+
+	std::vector<TestCells> tests(4);
+	std::vector<double> lat, lon;
+	// targets reach a little beyond the source cells, so some of them have no neighbor
+	tests[0].name = "mid-latitude";
+	makeCells(30, 32, 10, 2, nSou, tests[0].souLat, tests[0].souLon);
+	makeCells(29.9, 32.1, 9.9, 2.2, nTar, tests[0].tarLat, tests[0].tarLon);
+	tests[0].cropLat = 31;
+	tests[1].name = "dateline";
+	makeCells(-1, 1, 179, 2, nSou, tests[1].souLat, tests[1].souLon);
+	makeCells(-1.1, 1.1, 178.9, 2.2, nTar, tests[1].tarLat, tests[1].tarLon);
+	tests[1].cropLat = 0;
+	tests[2].name = "polar cap";
+	makeCells(88.5, 90, -180, 360, nSou, tests[2].souLat, tests[2].souLon);
+	makeCells(88.4, 90, -180, 360, nTar, tests[2].tarLat, tests[2].tarLon);
+	// a ring around the pole, so source cells near the pole are cropped
+	tests[2].cropLat = 89.2;
+	// two clusters far apart, so the grid of search radii over their region is made coarser than maxR
+	tests[3].name = "two clusters";
+	makeCells(-41, -39, 0, 2, nSou / 2, tests[3].souLat, tests[3].souLon);
+	makeCells(39, 41, 68, 2, nSou - nSou / 2, lat, lon);
+	tests[3].souLat.insert(tests[3].souLat.end(), lat.begin(), lat.end());
+	tests[3].souLon.insert(tests[3].souLon.end(), lon.begin(), lon.end());
+	makeCells(-41.1, -38.9, -0.1, 2.2, nTar / 2, tests[3].tarLat, tests[3].tarLon);
+	makeCells(38.9, 41.1, 67.9, 2.2, nTar - nTar / 2, lat, lon);
+	tests[3].tarLat.insert(tests[3].tarLat.end(), lat.begin(), lat.end());
+	tests[3].tarLon.insert(tests[3].tarLon.end(), lon.begin(), lon.end());
+	tests[3].cropLat = 0;
+	for(size_t c = 0; c < tests.size(); c++) {
+		setUnitVectors(tests[c]);
+	}
+
+	const int indexTypes[4] = {NN_INDEX_GRID, NN_INDEX_GRID_SWATH, NN_INDEX_KDTREE, NN_INDEX_DUAL_GRID};
+	const char * indexNames[4] = {"GRID", "GRID_SWATH", "KDTREE", "DUAL_GRID"};
+	const int queryOrders[3] = {NN_QUERY_ORDER_STORAGE, NN_QUERY_ORDER_MORTON, NN_QUERY_ORDER_HILBERT};
+	const char * orderNames[3] = {"", " Morton", " Hilbert"};
+	char check[128];
+
+	// search radii of source cells by column, up to maxR
+	const int nCols = 97;
+	std::vector<double> souR(nCols);
+	for(int c = 0; c < nCols; c++) {
+		souR[c] = 500 + (maxR - 500) * c / (nCols - 1);
+	}
+
+	std::vector<int> nnID(nTar);
+	std::vector<double> nnDis(nTar);
+	std::vector<int> knnID(nTar * k);
+	std::vector<double> knnDis(nTar * k);
+
+	for(size_t c = 0; c < tests.size(); c++) {
+		const TestCells &cells = tests[c];
+		std::vector<std::vector<double> > expect(nTar);
+		for(int t = 0; t < nTar; t++) {
+			bruteForce(cells, t, maxR, expect[t]);
+		}
+		std::vector<int> radiusCount;
+		std::vector<double> radiusIDSum;
+		bruteForceRadius(cells, radius, radiusCount, radiusIDSum);
+		std::vector<char> reached;
+		bruteForceReached(cells, souR, reached);
+
+		for(int i = 0; i < 4; i++) {
+			struct NNIndex * index = buildNNIndex(&cells.souLat[0], &cells.souLon[0], nSou, maxR, indexTypes[i]);
+
+			// results are returned in the storage order of target cells whatever order they are queried in
+			for(int o = 0; o < 3; o++) {
+				setNNIndexQueryOrder(index, queryOrders[o]);
+
+				queryNNIndex(index, &cells.tarLat[0], &cells.tarLon[0], &nnID[0], &nnDis[0], nTar);
+				sprintf(check, "queryNNIndex %s%s", indexNames[i], orderNames[o]);
+				report(check, cells, checkNN(cells, expect, &nnID[0], &nnDis[0], maxR));
+
+				queryKNNIndex(index, &cells.tarLat[0], &cells.tarLon[0], k, &knnID[0], &knnDis[0], nTar);
+				sprintf(check, "queryKNNIndex %s%s", indexNames[i], orderNames[o]);
+				report(check, cells, checkKNN(cells, expect, &knnID[0], &knnDis[0], k, maxR));
+			}
+			setNNIndexQueryOrder(index, NN_QUERY_ORDER_STORAGE);
+
+			setNNIndexApproximation(index, maxError);
+			queryNNIndex(index, &cells.tarLat[0], &cells.tarLon[0], &nnID[0], &nnDis[0], nTar);
+			sprintf(check, "queryNNIndex %s approximate", indexNames[i]);
+			report(check, cells, checkApproxNN(cells, expect, &nnID[0], &nnDis[0], maxR, maxError));
+
+			double approxMax, approxMean;
+			approximateNNError(index, &cells.tarLat[0], &cells.tarLon[0], nTar, 500, &approxMax, &approxMean);
+			sprintf(check, "approximateNNError %s", indexNames[i]);
+			report(check, cells, (approxMax <= maxError + 1e-9 && approxMean <= approxMax) ? 0 : 1);
+
+			struct SummaryIndex * found = queryRadiusNNIndex(index, &cells.tarLat[0], &cells.tarLon[0], radius, nTar);
+			sprintf(check, "queryRadiusNNIndex %s", indexNames[i]);
+			report(check, cells, checkRadius(cells, found, radiusCount, radiusIDSum));
+			freeSummaryIndex(found);
+
+			setNNIndexApproximation(index, 0);
+			setNNIndexCellRadius(index, &souR[0], nCols);
+			queryNNIndex(index, &cells.tarLat[0], &cells.tarLon[0], &nnID[0], &nnDis[0], nTar);
+			sprintf(check, "queryNNIndex %s cell radius", indexNames[i]);
+			report(check, cells, checkCellRadiusNN(cells, expect, reached, &nnID[0], &nnDis[0], maxR));
+
+			queryKNNIndex(index, &cells.tarLat[0], &cells.tarLon[0], k, &knnID[0], &knnDis[0], nTar);
+			sprintf(check, "queryKNNIndex %s cell radius", indexNames[i]);
+			report(check, cells, checkCellRadiusKNN(cells, expect, reached, &knnID[0], &knnDis[0], k, maxR));
+
+			freeNNIndex(index);
+		}
+
+		// index only the source cells in the region of the target cells below cropLat (extended by maxR)
+		TestCells part;
+		part.name = cells.name;
+		part.souLat = cells.souLat;
+		part.souLon = cells.souLon;
+		part.souXYZ = cells.souXYZ;
+		std::vector<std::vector<double> > partExpect;
+		for(int t = 0; t < nTar; t++) {
+			if(cells.tarLat[t] >= -90 && cells.tarLat[t] < cells.cropLat) {
+				part.tarLat.push_back(cells.tarLat[t]);
+				part.tarLon.push_back(cells.tarLon[t]);
+				partExpect.push_back(expect[t]);
+			}
+		}
+		int nPart = (int)part.tarLat.size();
+		struct LatLonRegion region;
+		latLonRegion(&part.tarLat[0], &part.tarLon[0], nPart, maxR, &region);
+		int nCropped = 0;
+		for(int s = 0; s < nSou; s++) {
+			nCropped += isValidCell(cells.souLat[s], cells.souLon[s]) && !isInLatLonRegion(&region, cells.souLat[s], cells.souLon[s]);
+		}
+		report("latLonRegion crops source cells", cells, (nCropped > 0) ? 0 : 1);
+
+		for(int i = 0; i < 4; i++) {
+			struct NNIndex * index = buildNNIndexInRegion(&cells.souLat[0], &cells.souLon[0], nSou, maxR, indexTypes[i], &region);
+
+			queryNNIndex(index, &part.tarLat[0], &part.tarLon[0], &nnID[0], &nnDis[0], nPart);
+			sprintf(check, "queryNNIndex %s cropped", indexNames[i]);
+			report(check, part, checkNN(part, partExpect, &nnID[0], &nnDis[0], maxR));
+
+			queryKNNIndex(index, &part.tarLat[0], &part.tarLon[0], k, &knnID[0], &knnDis[0], nPart);
+			sprintf(check, "queryKNNIndex %s cropped", indexNames[i]);
+			report(check, part, checkKNN(part, partExpect, &knnID[0], &knnDis[0], k, maxR));
+
+			freeNNIndex(index);
+		}
+	}
+
+	// point spread function weights: 2 km scan lines (400 source cells per target cell), a single scan line (200), and a support
+	// clamped to a maxR shorter than its corners
+	checkPSF(21, 11, 2, 3000);
+	checkPSF(21, 1, 2, 3000);
+	checkPSF(21, 11, 2, 1200);
+
+	printf("%s\n", (nFailed == 0) ? "All checks passed" : "Some checks FAILED");
+	return (nFailed == 0) ? 0 : 1;
+}
@@ -0,0 +1,550 @@
+/*
+
+
+    AUTHOR:
+        agent
+
+    EMAIL:
+        agent@local
+
+    Checks the summary statistics (summaryStatistics, summaryInterpolate) against a direct computation
+    on synthetic source values and nearest neighbor mapping, so no input file is needed. Target cells
+    get from none to a few hundred source cells, some of them fill values, and one set of values has
+    a large offset to catch cancellation in the SD. The gather versions on a list of source cells per
+    target cell (buildSummaryIndex) are checked the same way. resampleMultiBand must give the same results
+    as summaryInterpolate, nnInterpolate and idwInterpolate for each kind of operator, also after the
+    operator is written to a file and read back. The single precision versions of the kernels must give
+    the double precision results within the rounding of single precision.
+    Prints each check and exits with 1 if any of them fails.
+
+*/
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include "reproject.h"
+
+/*
+ * Statistics of each target cell computed directly from its valid source values
+ */
+struct Expected {
+	std::vector<int> n;		// valid source cells
+	std::vector<int> total;		// source cells including fill values
+	std::vector<double> mean, sd;
+	std::vector<std::vector<double> > val;	// valid source values, ascending
+};
+
+static double uniform(double a, double b) {
+	return a + (b - a) * rand() / RAND_MAX;
+}
+
+/*
+ * Source values: uniform in [offset, offset + spread), with about one in ten a fill value
+ */
+static void makeValues(double offset, double spread, std::vector<double> &souVal) {
+	for(size_t s = 0; s < souVal.size(); s++) {
+		souVal[s] = (rand() % 10 == 0) ? -999 : uniform(offset, offset + spread);
+	}
+}
+
+static void computeExpected(const std::vector<double> &souVal, const std::vector<int> &souNNTarID, int nTar, Expected &e) {
+	e.n.assign(nTar, 0);
+	e.total.assign(nTar, 0);
+	e.mean.assign(nTar, 0);
+	e.sd.assign(nTar, 0);
+	e.val.assign(nTar, std::vector<double>());
+	for(size_t s = 0; s < souVal.size(); s++) {
+		int t = souNNTarID[s];
+		// as in summaryInterpolate, target cell 0 is not summarized
+		if(t <= 0) {
+			continue;
+		}
+		e.total[t] ++;
+		if(souVal[s] >= 0) {
+			e.val[t].push_back(souVal[s]);
+		}
+	}
+	for(int t = 0; t < nTar; t++) {
+		std::vector<double> &v = e.val[t];
+		std::sort(v.begin(), v.end());
+		e.n[t] = (int)v.size();
+		if(v.empty()) {
+			continue;
+		}
+		// two passes in long double
+		long double sum = 0;
+		for(size_t l = 0; l < v.size(); l++) {
+			sum += v[l];
+		}
+		long double mean = sum / v.size();
+		long double m2 = 0;
+		for(size_t l = 0; l < v.size(); l++) {
+			m2 += (v[l] - mean) * (v[l] - mean);
+		}
+		e.mean[t] = (double)mean;
+		e.sd[t] = (double)sqrtl(m2 / v.size());
+	}
+}
+
+static int nFailed = 0;
+
+static void report(const char * check, const char * values, int nBad) {
+	printf("%-44s %-14s %s", check, values, (nBad == 0) ? "PASS\n" : "FAIL");
+	if(nBad != 0) {
+		printf(" (%d target cells)\n", nBad);
+		nFailed ++;
+	}
+}
+
+static int checkMean(const Expected &e, const double * tarVal) {
+	int nBad = 0;
+	for(size_t t = 0; t < e.n.size(); t++) {
+		if(e.n[t] == 0) {
+			nBad += (tarVal[t] != -999);
+		}
+		else {
+			nBad += fabs(tarVal[t] - e.mean[t]) > 1e-12 * e.mean[t];
+		}
+	}
+	return nBad;
+}
+
+/*
+ * SD: exactly 0 for a single source value, otherwise within rounding of the mean's magnitude
+ */
+static int checkSD(const Expected &e, const double * tarSD) {
+	int nBad = 0;
+	for(size_t t = 0; t < e.n.size(); t++) {
+		if(e.n[t] == 0) {
+			nBad += (tarSD[t] != -999);
+		}
+		else if(e.n[t] == 1) {
+			nBad += (tarSD[t] != 0);
+		}
+		else {
+			nBad += fabs(tarSD[t] - e.sd[t]) > 1e-9 * e.sd[t] + 1e-12 * e.mean[t];
+		}
+	}
+	return nBad;
+}
+
+static int checkCount(const Expected &e, const int * nSouPixels) {
+	int nBad = 0;
+	for(size_t t = 0; t < e.n.size(); t++) {
+		nBad += (nSouPixels[t] != e.n[t]);
+	}
+	return nBad;
+}
+
+static int checkMinMax(const Expected &e, const double * tarMin, const double * tarMax) {
+	int nBad = 0;
+	for(size_t t = 0; t < e.n.size(); t++) {
+		if(e.n[t] == 0) {
+			nBad += (tarMin[t] != -999 || tarMax[t] != -999);
+		}
+		else {
+			nBad += (tarMin[t] != e.val[t].front() || tarMax[t] != e.val[t].back());
+		}
+	}
+	return nBad;
+}
+
+static int checkValidFraction(const Expected &e, const double * tarValidFraction) {
+	int nBad = 0;
+	for(size_t t = 0; t < e.n.size(); t++) {
+		if(e.total[t] == 0) {
+			nBad += (tarValidFraction[t] != -999);
+		}
+		else {
+			nBad += fabs(tarValidFraction[t] - (double)e.n[t] / e.total[t]) > 1e-12;
+		}
+	}
+	return nBad;
+}
+
+/*
+ * Median: exact for up to 15 valid source values, otherwise one of the values (from a sample of them)
+ */
+static int checkMedian(const Expected &e, const double * tarMedian) {
+	int nBad = 0;
+	for(size_t t = 0; t < e.n.size(); t++) {
+		const std::vector<double> &v = e.val[t];
+		int n = e.n[t];
+		if(n == 0) {
+			nBad += (tarMedian[t] != -999);
+		}
+		else if(n <= 15) {
+			double median = (n % 2 == 1) ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+			nBad += fabs(tarMedian[t] - median) > 1e-12 * median;
+		}
+		else {
+			nBad += (tarMedian[t] < v.front() || tarMedian[t] > v.back());
+		}
+	}
+	return nBad;
+}
+
+/*
+ * Number of target cells of any band where two results differ (bitwise, so the same summation order is required)
+ */
+static int compareBands(const std::vector<std::vector<double> > &a, const std::vector<std::vector<double> > &b) {
+	int nBad = 0;
+	for(size_t t = 0; t < a[0].size(); t++) {
+		int bad = 0;
+		for(size_t band = 0; band < a.size(); band++) {
+			bad |= (a[band][t] != b[band][t]);
+		}
+		nBad += bad;
+	}
+	return nBad;
+}
+
+static int compareBands(const std::vector<std::vector<int> > &a, const std::vector<std::vector<int> > &b) {
+	int nBad = 0;
+	for(size_t t = 0; t < a[0].size(); t++) {
+		int bad = 0;
+		for(size_t band = 0; band < a.size(); band++) {
+			bad |= (a[band][t] != b[band][t]);
+		}
+		nBad += bad;
+	}
+	return nBad;
+}
+
+static std::vector<double *> bandPointers(std::vector<std::vector<double> > &v) {
+	std::vector<double *> p(v.size());
+	for(size_t band = 0; band < v.size(); band++) {
+		p[band] = &v[band][0];
+	}
+	return p;
+}
+
+static std::vector<int *> bandPointers(std::vector<std::vector<int> > &v) {
+	std::vector<int *> p(v.size());
+	for(size_t band = 0; band < v.size(); band++) {
+		p[band] = &v[band][0];
+	}
+	return p;
+}
+
+/*
+ * Write an operator to a temporary file and read it back (NULL if it cannot be read). With truncate > 0, that many bytes are cut
+ * from the end of the file first; with hugeCount, the number of pairs in the header is replaced by a huge one
+ */
+static struct SummaryIndex * writeAndRead(const struct SummaryIndex * op, int truncate, int hugeCount) {
+	FILE * fp = tmpfile();
+	if(fp == NULL || writeSummaryIndex(op, fp) != 0) {
+		return NULL;
+	}
+	long size = ftell(fp);
+	std::vector<char> bytes(size);
+	rewind(fp);
+	if(fread(&bytes[0], 1, size, fp) != (size_t)size) {
+		return NULL;
+	}
+	fclose(fp);
+	if(hugeCount) {
+		long long count = 1LL << 50;
+		memcpy(&bytes[2 * sizeof(long long)], &count, sizeof(long long));
+	}
+	fp = tmpfile();
+	fwrite(&bytes[0], 1, size - truncate, fp);
+	rewind(fp);
+	struct SummaryIndex * result = readSummaryIndex(fp);
+	fclose(fp);
+	return result;
+}
+
+/*
+ * Check resampleMultiBand against the single band kernels of each kind of operator, on more bands than one band group
+ */
+static void checkResampleMultiBand(const std::vector<int> &souNNTarID, int nTar) {
+	const int nBands = 11;
+	const int k = 4;
+	long long nSou = (long long)souNNTarID.size();
+	const char * bandNames = "11 bands";
+
+	std::vector<std::vector<double> > souVal(nBands, std::vector<double>(nSou));
+	for(int band = 0; band < nBands; band++) {
+		makeValues((band % 2) ? 1e6 : 0, (band % 2) ? 1 : 1000, souVal[band]);
+	}
+	std::vector<std::vector<double> > tarVal(nBands, std::vector<double>(nTar)), tarSD(nBands, std::vector<double>(nTar));
+	std::vector<std::vector<double> > expectVal(nBands, std::vector<double>(nTar)), expectSD(nBands, std::vector<double>(nTar));
+	std::vector<std::vector<int> > count(nBands, std::vector<int>(nTar)), expectCount(nBands, std::vector<int>(nTar));
+	std::vector<double *> pSou = bandPointers(souVal);
+	std::vector<double *> pVal = bandPointers(tarVal);
+	std::vector<double *> pSD = bandPointers(tarSD);
+	std::vector<int *> pCount = bandPointers(count);
+
+	// summary operator: same mean, SD and count as summaryInterpolate, and the SD also checked directly
+	struct SummaryIndex * index = buildSummaryIndex(&souNNTarID[0], nSou, nTar);
+	for(int band = 0; band < nBands; band++) {
+		summaryInterpolate(&souVal[band][0], index, &expectVal[band][0], &expectSD[band][0], &expectCount[band][0]);
+	}
+	resampleMultiBand(&pSou[0], index, &pVal[0], &pSD[0], &pCount[0], nBands);
+	report("resampleMultiBand (summary) mean", bandNames, compareBands(tarVal, expectVal));
+	report("resampleMultiBand (summary) SD", bandNames, compareBands(tarSD, expectSD));
+	report("resampleMultiBand (summary) count", bandNames, compareBands(count, expectCount));
+	int nBad = 0;
+	Expected e;
+	for(int band = 0; band < nBands; band++) {
+		computeExpected(souVal[band], souNNTarID, nTar, e);
+		nBad += checkSD(e, &tarSD[band][0]);
+	}
+	report("resampleMultiBand (summary) SD direct", bandNames, nBad);
+
+	// the same operator read back from a file, and files which must be rejected
+	struct SummaryIndex * loaded = writeAndRead(index, 0, 0);
+	nBad = (loaded == NULL) ? nTar : 0;
+	if(loaded != NULL) {
+		resampleMultiBand(&pSou[0], loaded, &pVal[0], &pSD[0], &pCount[0], nBands);
+		nBad = compareBands(tarVal, expectVal) + compareBands(tarSD, expectSD) + compareBands(count, expectCount);
+		freeSummaryIndex(loaded);
+	}
+	report("readSummaryIndex round trip", bandNames, nBad);
+	loaded = writeAndRead(index, 1, 0);
+	report("readSummaryIndex rejects a truncated file", "", (loaded == NULL) ? 0 : 1);
+	freeSummaryIndex(loaded);
+	loaded = writeAndRead(index, 0, 1);
+	report("readSummaryIndex rejects a huge count", "", (loaded == NULL) ? 0 : 1);
+	freeSummaryIndex(loaded);
+	freeSummaryIndex(index);
+
+	// nearest neighbor operator: the value of the nearest source cell, fill values included
+	std::vector<int> tarNNSouID(nTar);
+	for(int t = 0; t < nTar; t++) {
+		tarNNSouID[t] = (rand() % 20 == 0) ? -1 : (int)(rand() % nSou);
+	}
+	for(int band = 0; band < nBands; band++) {
+		nnInterpolate(&souVal[band][0], &expectVal[band][0], &tarNNSouID[0], nTar);
+	}
+	index = nnSummaryIndex(&tarNNSouID[0], nSou, nTar);
+	resampleMultiBand(&pSou[0], index, &pVal[0], NULL, NULL, nBands);
+	report("resampleMultiBand (nn) = nnInterpolate", bandNames, compareBands(tarVal, expectVal));
+	FILE * fp = tmpfile();
+	report("writeSummaryIndex rejects an nn operator", "", (writeSummaryIndex(index, fp) != 0) ? 0 : 1);
+	fclose(fp);
+	freeSummaryIndex(index);
+
+	// inverse distance weighted operator, with fewer than k neighbors for some target cells
+	std::vector<int> tarKNNSouID(nTar * k);
+	std::vector<double> tarKNNDis(nTar * k);
+	std::vector<float> tarKNNWeight(nTar * k);
+	for(int t = 0; t < nTar; t++) {
+		int nFound = rand() % (k + 1);
+		for(int l = 0; l < k; l++) {
+			tarKNNSouID[t * k + l] = (l < nFound) ? (int)(rand() % nSou) : -1;
+			tarKNNDis[t * k + l] = (l < nFound) ? 100 * (l + 1) + rand() % 100 : -1;
+		}
+	}
+	idwWeights(&tarKNNSouID[0], &tarKNNDis[0], &tarKNNWeight[0], k, 2, nTar);
+	for(int band = 0; band < nBands; band++) {
+		idwInterpolate(&souVal[band][0], &expectVal[band][0], &tarKNNSouID[0], &tarKNNWeight[0], k, nTar);
+	}
+	index = idwSummaryIndex(&tarKNNSouID[0], &tarKNNWeight[0], k, nSou, nTar);
+	resampleMultiBand(&pSou[0], index, &pVal[0], NULL, NULL, nBands);
+	report("resampleMultiBand (idw) = idwInterpolate", bandNames, compareBands(tarVal, expectVal));
+	freeSummaryIndex(index);
+}
+
+/*
+ * Number of target cells where a single precision result is not the double precision one (fill values must match, other values
+ * within tolerance)
+ */
+static int compareSingle(const std::vector<float> &f, const std::vector<double> &d, double tolerance) {
+	int nBad = 0;
+	for(size_t t = 0; t < d.size(); t++) {
+		if(d[t] == -999 || f[t] == -999) {
+			nBad += (f[t] != d[t]);
+		}
+		else {
+			nBad += fabs(f[t] - d[t]) > tolerance;
+		}
+	}
+	return nBad;
+}
+
+static int compareSingle(const std::vector<std::vector<float> > &f, const std::vector<std::vector<double> > &d, double tolerance) {
+	int nBad = 0;
+	for(size_t band = 0; band < d.size(); band++) {
+		nBad += compareSingle(f[band], d[band], tolerance);
+	}
+	return nBad;
+}
+
+static int compareCount(const std::vector<int> &a, const std::vector<int> &b) {
+	int nBad = 0;
+	for(size_t t = 0; t < a.size(); t++) {
+		nBad += (a[t] != b[t]);
+	}
+	return nBad;
+}
+
+/*
+ * Check the single precision kernels against the double precision ones on the same values (single precision values below 1000,
+ * with fill values), so results agree within the rounding of single precision
+ */
+static void checkSinglePrecision(std::vector<int> &souNNTarID, int nTar) {
+	const int nBands = 3;
+	const int k = 4;
+	const double tolerance = 1e-3;
+	long long nSou = (long long)souNNTarID.size();
+	int * souNN = &souNNTarID[0];
+	const char * name = "float";
+
+	std::vector<std::vector<double> > souVal(nBands, std::vector<double>(nSou));
+	std::vector<std::vector<float> > souValF(nBands, std::vector<float>(nSou));
+	for(int band = 0; band < nBands; band++) {
+		makeValues(0, 1000, souVal[band]);
+		for(long long s = 0; s < nSou; s++) {
+			souValF[band][s] = (float)souVal[band][s];
+			souVal[band][s] = souValF[band][s];
+		}
+	}
+	std::vector<double> tarVal(nTar), tarSD(nTar), tarMin(nTar), tarMax(nTar), tarValidFraction(nTar), tarMedian(nTar);
+	std::vector<float> tarValF(nTar), tarSDF(nTar), tarMinF(nTar), tarMaxF(nTar), tarValidFractionF(nTar), tarMedianF(nTar);
+	std::vector<int> count(nTar), countF(nTar);
+
+	summaryStatistics(&souVal[0][0], souNN, nSou, &tarVal[0], &tarSD[0], &count[0], &tarMin[0], &tarMax[0], &tarValidFraction[0], &tarMedian[0], nTar);
+	summaryStatistics(&souValF[0][0], souNN, nSou, &tarValF[0], &tarSDF[0], &countF[0], &tarMinF[0], &tarMaxF[0], &tarValidFractionF[0], &tarMedianF[0], nTar);
+	report("summaryStatistics mean, SD", name, compareSingle(tarValF, tarVal, tolerance) + compareSingle(tarSDF, tarSD, tolerance));
+	report("summaryStatistics count, min/max", name, compareCount(countF, count) + compareSingle(tarMinF, tarMin, 0) + compareSingle(tarMaxF, tarMax, 0));
+	report("summaryStatistics valid fraction, median", name, compareSingle(tarValidFractionF, tarValidFraction, 1e-6) + compareSingle(tarMedianF, tarMedian, tolerance));
+
+	summaryInterpolate(&souVal[0][0], souNN, nSou, &tarVal[0], &tarSD[0], &count[0], nTar);
+	summaryInterpolate(&souValF[0][0], souNN, nSou, &tarValF[0], &tarSDF[0], &countF[0], nTar);
+	report("summaryInterpolate", name, compareSingle(tarValF, tarVal, tolerance) + compareSingle(tarSDF, tarSD, tolerance) + compareCount(countF, count));
+
+	struct SummaryIndex * index = buildSummaryIndex(souNN, nSou, nTar);
+	summaryStatistics(&souVal[0][0], index, &tarVal[0], &tarSD[0], &count[0], &tarMin[0], &tarMax[0], &tarValidFraction[0], &tarMedian[0]);
+	summaryStatistics(&souValF[0][0], index, &tarValF[0], &tarSDF[0], &countF[0], &tarMinF[0], &tarMaxF[0], &tarValidFractionF[0], &tarMedianF[0]);
+	report("summaryStatistics (index)", name, compareSingle(tarValF, tarVal, tolerance) + compareSingle(tarSDF, tarSD, tolerance) + compareCount(countF, count)
+	       + compareSingle(tarMinF, tarMin, 0) + compareSingle(tarMaxF, tarMax, 0) + compareSingle(tarValidFractionF, tarValidFraction, 1e-6)
+	       + compareSingle(tarMedianF, tarMedian, tolerance));
+
+	summaryInterpolate(&souVal[0][0], index, &tarVal[0], &tarSD[0], &count[0]);
+	summaryInterpolate(&souValF[0][0], index, &tarValF[0], &tarSDF[0], &countF[0]);
+	report("summaryInterpolate (index)", name, compareSingle(tarValF, tarVal, tolerance) + compareSingle(tarSDF, tarSD, tolerance) + compareCount(countF, count));
+
+	// resampleMultiBand with each kind of operator
+	std::vector<std::vector<double> > bandVal(nBands, std::vector<double>(nTar)), bandSD(nBands, std::vector<double>(nTar));
+	std::vector<std::vector<float> > bandValF(nBands, std::vector<float>(nTar)), bandSDF(nBands, std::vector<float>(nTar));
+	std::vector<std::vector<int> > bandCount(nBands, std::vector<int>(nTar)), bandCountF(nBands, std::vector<int>(nTar));
+	std::vector<double *> pSou = bandPointers(souVal), pVal = bandPointers(bandVal), pSD = bandPointers(bandSD);
+	std::vector<int *> pCount = bandPointers(bandCount), pCountF = bandPointers(bandCountF);
+	std::vector<float *> pSouF(nBands), pValF(nBands), pSDF(nBands);
+	for(int band = 0; band < nBands; band++) {
+		pSouF[band] = &souValF[band][0];
+		pValF[band] = &bandValF[band][0];
+		pSDF[band] = &bandSDF[band][0];
+	}
+	resampleMultiBand(&pSou[0], index, &pVal[0], &pSD[0], &pCount[0], nBands);
+	resampleMultiBand(&pSouF[0], index, &pValF[0], &pSDF[0], &pCountF[0], nBands);
+	report("resampleMultiBand (summary)", name, compareSingle(bandValF, bandVal, tolerance) + compareSingle(bandSDF, bandSD, tolerance) + compareBands(bandCountF, bandCount));
+	freeSummaryIndex(index);
+
+	std::vector<int> tarNNSouID(nTar);
+	for(int t = 0; t < nTar; t++) {
+		tarNNSouID[t] = (rand() % 20 == 0) ? -1 : (int)(rand() % nSou);
+	}
+	nnInterpolate(&souVal[0][0], &tarVal[0], &tarNNSouID[0], nTar);
+	nnInterpolate(&souValF[0][0], &tarValF[0], &tarNNSouID[0], nTar);
+	report("nnInterpolate", name, compareSingle(tarValF, tarVal, 0));
+	index = nnSummaryIndex(&tarNNSouID[0], nSou, nTar);
+	resampleMultiBand(&pSou[0], index, &pVal[0], NULL, NULL, nBands);
+	resampleMultiBand(&pSouF[0], index, &pValF[0], NULL, NULL, nBands);
+	report("resampleMultiBand (nn)", name, compareSingle(bandValF, bandVal, 0));
+	freeSummaryIndex(index);
+
+	std::vector<int> tarKNNSouID(nTar * k);
+	std::vector<double> tarKNNDis(nTar * k);
+	std::vector<float> tarKNNWeight(nTar * k);
+	for(int t = 0; t < nTar; t++) {
+		int nFound = rand() % (k + 1);
+		for(int l = 0; l < k; l++) {
+			tarKNNSouID[t * k + l] = (l < nFound) ? (int)(rand() % nSou) : -1;
+			tarKNNDis[t * k + l] = (l < nFound) ? 100 * (l + 1) + rand() % 100 : -1;
+		}
+	}
+	idwWeights(&tarKNNSouID[0], &tarKNNDis[0], &tarKNNWeight[0], k, 2, nTar);
+	idwInterpolate(&souVal[0][0], &tarVal[0], &tarKNNSouID[0], &tarKNNWeight[0], k, nTar);
+	idwInterpolate(&souValF[0][0], &tarValF[0], &tarKNNSouID[0], &tarKNNWeight[0], k, nTar);
+	report("idwInterpolate", name, compareSingle(tarValF, tarVal, tolerance));
+	index = idwSummaryIndex(&tarKNNSouID[0], &tarKNNWeight[0], k, nSou, nTar);
+	resampleMultiBand(&pSou[0], index, &pVal[0], NULL, NULL, nBands);
+	resampleMultiBand(&pSouF[0], index, &pValF[0], NULL, NULL, nBands);
+	report("resampleMultiBand (idw)", name, compareSingle(bandValF, bandVal, tolerance));
+	freeSummaryIndex(index);
+}
+
+int main(int argc, char ** argv)
+{
+	const long long nSou = 60000;
+	const int nTar = 5000;
+	srand(20190601);
+
+	// about a third of the source cells go to the first 200 target cells (~100 each), the others ~8 each,
+	// the last 100 target cells get none, and some source cells have no target cell
+	std::vector<int> souNNTarID(nSou);
+	for(long long s = 0; s < nSou; s++) {
+		int r = rand() % 30;
+		if(r == 0) {
+			souNNTarID[s] = -1;
+		}
+		else if(r < 10) {
+			souNNTarID[s] = rand() % 200;
+		}
+		else {
+			souNNTarID[s] = 200 + rand() % (nTar - 300);
+		}
+	}
+
+	const char * valueNames[2] = {"values", "offset values"};
+	const double offsets[2] = {0, 1e6};
+	const double spreads[2] = {1000, 1};
+	std::vector<double> souVal(nSou);
+	std::vector<double> tarVal(nTar), tarSD(nTar), tarMin(nTar), tarMax(nTar), tarValidFraction(nTar), tarMedian(nTar);
+	std::vector<int> nSouPixels(nTar);
+	Expected e;
+	struct SummaryIndex * index = buildSummaryIndex(&souNNTarID[0], nSou, nTar);
+
+	for(int c = 0; c < 2; c++) {
+		makeValues(offsets[c], spreads[c], souVal);
+		computeExpected(souVal, souNNTarID, nTar, e);
+
+		summaryStatistics(&souVal[0], &souNNTarID[0], nSou, &tarVal[0], &tarSD[0], &nSouPixels[0], &tarMin[0], &tarMax[0], &tarValidFraction[0], &tarMedian[0], nTar);
+		report("summaryStatistics mean", valueNames[c], checkMean(e, &tarVal[0]));
+		report("summaryStatistics SD", valueNames[c], checkSD(e, &tarSD[0]));
+		report("summaryStatistics count", valueNames[c], checkCount(e, &nSouPixels[0]));
+		report("summaryStatistics min/max", valueNames[c], checkMinMax(e, &tarMin[0], &tarMax[0]));
+		report("summaryStatistics valid fraction", valueNames[c], checkValidFraction(e, &tarValidFraction[0]));
+		report("summaryStatistics median", valueNames[c], checkMedian(e, &tarMedian[0]));
+
+		summaryInterpolate(&souVal[0], &souNNTarID[0], nSou, &tarVal[0], &tarSD[0], &nSouPixels[0], nTar);
+		report("summaryInterpolate mean", valueNames[c], checkMean(e, &tarVal[0]));
+		report("summaryInterpolate SD", valueNames[c], checkSD(e, &tarSD[0]));
+		report("summaryInterpolate count", valueNames[c], checkCount(e, &nSouPixels[0]));
+
+		summaryStatistics(&souVal[0], index, &tarVal[0], &tarSD[0], &nSouPixels[0], &tarMin[0], &tarMax[0], &tarValidFraction[0], &tarMedian[0]);
+		report("summaryStatistics (index) mean", valueNames[c], checkMean(e, &tarVal[0]));
+		report("summaryStatistics (index) SD", valueNames[c], checkSD(e, &tarSD[0]));
+		report("summaryStatistics (index) count", valueNames[c], checkCount(e, &nSouPixels[0]));
+		report("summaryStatistics (index) min/max", valueNames[c], checkMinMax(e, &tarMin[0], &tarMax[0]));
+		report("summaryStatistics (index) valid fraction", valueNames[c], checkValidFraction(e, &tarValidFraction[0]));
+		report("summaryStatistics (index) median", valueNames[c], checkMedian(e, &tarMedian[0]));
+
+		summaryInterpolate(&souVal[0], index, &tarVal[0], &tarSD[0], &nSouPixels[0]);
+		report("summaryInterpolate (index) mean", valueNames[c], checkMean(e, &tarVal[0]));
+		report("summaryInterpolate (index) SD", valueNames[c], checkSD(e, &tarSD[0]));
+		report("summaryInterpolate (index) count", valueNames[c], checkCount(e, &nSouPixels[0]));
+	}
+	freeSummaryIndex(index);
+
+	checkResampleMultiBand(souNNTarID, nTar);
+	checkSinglePrecision(souNNTarID, nTar);
+
+	printf("%s\n", (nFailed == 0) ? "All checks passed" : "Some checks FAILED");
+	return (nFailed == 0) ? 0 : 1;
+}